@@ -9,7 +9,14 @@ import optimizedDepthwise_cuda
 class OptimizedDepthwiseFunction(torch.autograd.Function):
     @staticmethod
     def forward(ctx, input, filter, filterHeight, stride, padding, dilation, groups):
-        ctx.save_for_backward(input, filter)    
+        # under torch.autocast of the device of input (DCU: "cuda", host: "cpu") run in its autocast dtype
+        # (fp16 / bf16) like nn.Conv2d, the kernels accumulate in fp32.
+        # autograd casts the gradients back to the dtype of input / filter.
+        deviceType = input.device.type
+        if torch.is_autocast_enabled(deviceType):
+            input = input.to(torch.get_autocast_dtype(deviceType))
+        filter = filter.to(input.dtype)
+        ctx.save_for_backward(input, filter)
         ctx.conf = {
             "filterHeight": filterHeight,
             "stride": stride,
@@ -18,7 +25,7 @@ class OptimizedDepthwiseFunction(torch.autograd.Function):
             "groups": groups
         }
 
-        output = optimizedDepthwise_cuda.forward(input, filter, filterHeight, stride)
+        output = optimizedDepthwise_cuda.forward(input, filter, filterHeight, stride, dilation=dilation)
         return output
 
     @staticmethod
@@ -28,32 +35,23 @@ class OptimizedDepthwiseFunction(torch.autograd.Function):
         conf = ctx.conf
         grad_input = grad_weight = None
 
-        if ctx.needs_input_grad[0]:
-            #input_ = grad_output.new_empty(1).expand(input.shape)
-            grad_input = torch.ops.aten.convolution_backward(grad_output, input, filter, None,
-                                               (conf["stride"], conf["stride"]), (conf["padding"], conf["padding"]), (conf["dilation"], conf["dilation"]),
-                                               False, [0], conf["groups"], (True, False, False))[0]
-        
-        if ctx.needs_input_grad[1]:
-            #filter_ = grad_output.new_empty(1).expand(filter.shape)
-            grad_weight = torch.ops.aten.convolution_backward(grad_output, input, filter, None,
-                                               (conf["stride"], conf["stride"]), (conf["padding"], conf["padding"]), (conf["dilation"], conf["dilation"]),
-                                               False, [0], conf["groups"], (False, True, False))[1]
+        # both gradients in one pass over grad_output
+        if ctx.needs_input_grad[0] or ctx.needs_input_grad[1]:
+            grad_input, grad_weight = optimizedDepthwise_cuda.backward(grad_output, input, filter, conf["filterHeight"], conf["stride"],
+                                               ctx.needs_input_grad[0], ctx.needs_input_grad[1], dilation=conf["dilation"])
         
         return grad_input, grad_weight, None, None, None, None, None
         
 class OptimizedDepthwiseLayer(nn.Module):
-    def __init__(self, inputChannel, outputChannel, filterHeight, stride):
+    def __init__(self, inputChannel, outputChannel, filterHeight, stride, dilation=1):
         super(OptimizedDepthwiseLayer, self).__init__()
         self.inputChannel = inputChannel
         self.outputChannel = outputChannel
         self.filterHeight = filterHeight
         self.stride = stride
-        if(self.filterHeight == 3):
-            self.padding = 1
-        elif(self.filterHeight == 5):
-            self.padding = 2
-        self.dilation = 1
+        # atrous convolution: "same" padding of the dilated filter
+        self.dilation = dilation
+        self.padding = dilation * (self.filterHeight - 1) // 2
         self.groups = inputChannel
     
         self.filter = nn.Parameter(torch.empty((self.inputChannel, 1, self.filterHeight, self.filterHeight), dtype = torch.float))
@@ -4,14 +4,21 @@ from torch import nn
 import math
 
 # extension name
-import optimizedPointwise_cuda
+import optimizedDepthwise_cuda
 
 class OptimizedPointwiseFunction(torch.autograd.Function):
     @staticmethod
     def forward(ctx, input, filter):
+        # under torch.autocast of the device of input (DCU: "cuda", host: "cpu") run in its autocast dtype
+        # (fp16 / bf16) like nn.Conv2d, the kernels accumulate in fp32.
+        # autograd casts the gradients back to the dtype of input / filter.
+        deviceType = input.device.type
+        if torch.is_autocast_enabled(deviceType):
+            input = input.to(torch.get_autocast_dtype(deviceType))
+        filter = filter.to(input.dtype)
         ctx.save_for_backward(input, filter)
 
-        output = optimizedPointwise_cuda.forward(input, filter)
+        output = optimizedDepthwise_cuda.pointwise_forward(input, filter)
         return output
 
     @staticmethod
@@ -4,35 +4,885 @@
 //#include <ATen/Functions.h>
 //#include <ATen/Config.h>
 #include <array>
+#include <string>
+
+#include "DepthwiseEpilogue.h"
+#include "CPU_DepthwiseWorkspace.h"
+#include "CPU_DepthwiseNetwork.h"
 
 #define CHECK_CUDA(x) TORCH_CHECK(x.device().is_cuda(), #x " must be a CUDA tensor")
+#define CHECK_CPU(x) TORCH_CHECK(x.device().is_cpu(), #x " must be a CPU tensor")
+#define CHECK_FLOATING(x) TORCH_CHECK(x.scalar_type() == torch::kFloat || x.scalar_type() == torch::kHalf || x.scalar_type() == torch::kBFloat16, \
+  #x " must be a float, half or bfloat16 tensor")
+#define CHECK_SAME_DEVICE(x, y) TORCH_CHECK(x.device() == y.device(), #x " must be on the same device as " #y)
 #define CHECK_CONTIGUOUS(x) TORCH_CHECK(x.is_contiguous(), #x " must be contiguous")
+#define CHECK_CHANNELS_LAST(x) TORCH_CHECK(x.is_contiguous(torch::MemoryFormat::ChannelsLast), #x " must be channels last contiguous")
 #define CHECK_INPUT(x) CHECK_CUDA(x); CHECK_CONTIGUOUS(x)
+#define CHECK_CPU_INPUT(x) CHECK_CPU(x); CHECK_FLOATING(x); CHECK_CONTIGUOUS(x)
+#define CHECK_CHANNELS_LAST_INPUT(x) CHECK_CUDA(x); CHECK_CHANNELS_LAST(x)
+#define CHECK_CPU_CHANNELS_LAST_INPUT(x) CHECK_CPU(x); CHECK_FLOATING(x); CHECK_CHANNELS_LAST(x)
 
 // CUDA forward declaration
 torch::Tensor optimizedDepthwise_cuda_forward(
-  torch::Tensor input, 
+  torch::Tensor input,
   torch::Tensor filter,
   int filterHeight,
-  int stride);
+  int stride,
+  int dilation,
+  const torch::Tensor& scale,
+  const torch::Tensor& shift,
+  int activation,
+  torch::Tensor output);
+
+// CPU forward declaration
+torch::Tensor optimizedDepthwise_cpu_forward(
+  torch::Tensor input,
+  torch::Tensor filter,
+  int filterHeight,
+  int stride,
+  int dilation,
+  const torch::Tensor& scale,
+  const torch::Tensor& shift,
+  int activation,
+  torch::Tensor output,
+  DepthwiseCpuWorkspace* workspace);
+
+// Channels last (NHWC) forward declarations, input and output are torch.channels_last
+torch::Tensor optimizedDepthwiseChannelsLast_cuda_forward(
+  torch::Tensor input,
+  torch::Tensor filter,
+  int filterHeight,
+  int stride,
+  int dilation,
+  const torch::Tensor& scale,
+  const torch::Tensor& shift,
+  int activation,
+  torch::Tensor output);
+
+torch::Tensor optimizedDepthwiseChannelsLast_cpu_forward(
+  torch::Tensor input,
+  torch::Tensor filter,
+  int filterHeight,
+  int stride,
+  int dilation,
+  const torch::Tensor& scale,
+  const torch::Tensor& shift,
+  int activation,
+  torch::Tensor output,
+  DepthwiseCpuWorkspace* workspace);
+
+// Fused depthwise separable block forward declarations
+torch::Tensor optimizedDepthwisePointwise_cuda_forward(
+  torch::Tensor input,
+  torch::Tensor depthwiseFilter,
+  int filterHeight,
+  int stride,
+  torch::Tensor pointwiseFilter,
+  const torch::Tensor& depthwiseScale,
+  const torch::Tensor& depthwiseShift,
+  int depthwiseActivation,
+  const torch::Tensor& pointwiseScale,
+  const torch::Tensor& pointwiseShift,
+  int pointwiseActivation,
+  torch::Tensor output);
+
+torch::Tensor optimizedDepthwisePointwise_cpu_forward(
+  torch::Tensor input,
+  torch::Tensor depthwiseFilter,
+  int filterHeight,
+  int stride,
+  torch::Tensor pointwiseFilter,
+  const torch::Tensor& depthwiseScale,
+  const torch::Tensor& depthwiseShift,
+  int depthwiseActivation,
+  const torch::Tensor& pointwiseScale,
+  const torch::Tensor& pointwiseShift,
+  int pointwiseActivation,
+  torch::Tensor output,
+  DepthwiseCpuWorkspace* workspace);
+
+// Pointwise convolution forward declarations
+torch::Tensor optimizedPointwise_cuda_forward(
+  torch::Tensor input,
+  torch::Tensor filter,
+  const torch::Tensor& scale,
+  const torch::Tensor& shift,
+  int activation,
+  torch::Tensor output);
+
+torch::Tensor optimizedPointwise_cpu_forward(
+  torch::Tensor input,
+  torch::Tensor filter,
+  const torch::Tensor& scale,
+  const torch::Tensor& shift,
+  int activation,
+  torch::Tensor output,
+  DepthwiseCpuWorkspace* workspace);
+
+torch::Tensor optimizedDepthwiseQuantized_cpu_forward(
+  torch::Tensor input,
+  torch::Tensor filter,
+  int filterHeight,
+  int stride,
+  double inputScale,
+  int64_t inputZeroPoint,
+  const torch::Tensor& filterScale,
+  double outputScale,
+  int64_t outputZeroPoint,
+  const torch::Tensor& bias,
+  int activation);
+
+// Depthwise convolution backward declarations
+std::vector<torch::Tensor> optimizedDepthwise_cuda_backward(
+  torch::Tensor gradOutput,
+  torch::Tensor input,
+  torch::Tensor filter,
+  int filterHeight,
+  int stride,
+  int dilation,
+  bool needsInputGrad,
+  bool needsFilterGrad);
+
+std::vector<torch::Tensor> optimizedDepthwise_cpu_backward(
+  torch::Tensor gradOutput,
+  torch::Tensor input,
+  torch::Tensor filter,
+  int filterHeight,
+  int stride,
+  int dilation,
+  bool needsInputGrad,
+  bool needsFilterGrad);
+
+// Check the shapes every backend relies on
+void checkDepthwiseShape(
+    const torch::Tensor& input,
+    const torch::Tensor& filter,
+    int filterHeight,
+    int stride,
+    int dilation = 1) {
+
+    TORCH_CHECK(input.dim() == 4, "input must be a 4D (N, C, H, W) tensor");
+    TORCH_CHECK(filter.dim() == 4 && filter.size(0) == input.size(1) && filter.size(1) == 1,
+      "filter must be a (C, 1, filterHeight, filterHeight) tensor matching the input channels");
+    TORCH_CHECK(filter.size(2) == filterHeight && filter.size(3) == filterHeight,
+      "filter spatial size must be filterHeight x filterHeight");
+    TORCH_CHECK(filterHeight > 0 && stride > 0, "filterHeight and stride must be positive");
+    TORCH_CHECK(dilation > 0, "dilation must be positive");
+
+    int padding = dilation * (filterHeight - 1) / 2;
+    int extent = dilation * (filterHeight - 1) + 1;
+    TORCH_CHECK(input.size(2) + 2 * padding >= extent && input.size(3) + 2 * padding >= extent,
+      "input is smaller than the filter");
+}
+
+// A torch.channels_last tensor that is not also NCHW contiguous (C == 1 or H == W == 1 are both)
+bool isChannelsLast(const torch::Tensor& tensor) {
+    return tensor.dim() == 4 && !tensor.is_contiguous() && tensor.is_contiguous(torch::MemoryFormat::ChannelsLast);
+}
+
+// Map the activation name of the Python API to DepthwiseActivation
+int depthwiseActivationFromName(const std::string& name) {
+    if (name == "none") return DepthwiseActivationNone;
+    if (name == "relu") return DepthwiseActivationReLU;
+    if (name == "relu6") return DepthwiseActivationReLU6;
+    if (name == "silu" || name == "swish") return DepthwiseActivationSiLU;
+    if (name == "hardswish") return DepthwiseActivationHardSwish;
+    TORCH_CHECK(false, "unknown activation \"", name, "\", expected none, relu, relu6, silu, swish or hardswish");
+    return DepthwiseActivationNone;
+}
+
+// Check an optional per channel epilogue tensor (bias, scale, shift)
+void checkEpilogueTensor(const c10::optional<torch::Tensor>& tensor, const torch::Tensor& input, int64_t channel, const char* name) {
+    if (!tensor.has_value()) {
+      return;
+    }
+    TORCH_CHECK(tensor->device() == input.device(), name, " must be on the same device as input");
+    TORCH_CHECK(tensor->is_floating_point(), name, " must be a floating point tensor");
+    TORCH_CHECK(tensor->numel() == channel, name, " must have one value per channel");
+}
+
+// Check the optional out= tensor of a forward: the device, dtype and sizes of the output, dense in the output
+// memory format and not overlapping the input. Returns it, or an undefined tensor (allocate) if absent.
+torch::Tensor checkOutTensor(
+    const c10::optional<torch::Tensor>& out,
+    const torch::Tensor& input,
+    const std::vector<int64_t>& sizes,
+    bool channelsLast) {
+
+    if (!out.has_value()) {
+      return torch::Tensor();
+    }
+    TORCH_CHECK(out->device() == input.device(), "out must be on the same device as input");
+    TORCH_CHECK(out->scalar_type() == input.scalar_type(), "out must have the dtype of input");
+    TORCH_CHECK(out->dim() == (int64_t)sizes.size(), "out must be a 4D tensor");
+    for (size_t i = 0; i < sizes.size(); i++) {
+      TORCH_CHECK(out->size(i) == sizes[i], "out must have the output shape (", sizes[0], ", ", sizes[1], ", ", sizes[2], ", ", sizes[3], ")");
+    }
+    if (channelsLast) {
+      TORCH_CHECK(out->is_contiguous(torch::MemoryFormat::ChannelsLast), "out must be channels last contiguous for a channels last input");
+    }
+    else {
+      TORCH_CHECK(out->is_contiguous(), "out must be contiguous");
+    }
+    const char* outBegin = static_cast<const char*>(out->data_ptr());
+    const char* inputBegin = static_cast<const char*>(input.data_ptr());
+    TORCH_CHECK(outBegin + out->numel() * out->element_size() <= inputBegin ||
+      inputBegin + input.numel() * input.element_size() <= outBegin, "out must not overlap input");
+    return *out;
+}
+
+// Output height / width of a forward with "same" padding, as computed by every backend
+int64_t depthwiseOutputSize(int64_t inputSize, int filterHeight, int stride, int dilation = 1) {
+    int padding = dilation * (filterHeight - 1) / 2;
+    return (inputSize + 2 * padding - dilation * (filterHeight - 1) - 1) / stride + 1;
+}
+
+// Fold the bias into the shift: (conv + bias) * scale + shift = conv * scale + (bias * scale + shift)
+// The epilogue is always float, also for half / bfloat16 tensors.
+void foldEpilogue(
+    const c10::optional<torch::Tensor>& bias,
+    const c10::optional<torch::Tensor>& scale,
+    const c10::optional<torch::Tensor>& shift,
+    torch::Tensor& epilogueScale,
+    torch::Tensor& epilogueShift) {
+
+    if (scale.has_value()) {
+      epilogueScale = scale->to(torch::kFloat).contiguous();
+    }
+    if (bias.has_value()) {
+      epilogueShift = bias->to(torch::kFloat);
+      if (scale.has_value()) {
+        epilogueShift = epilogueShift * epilogueScale;
+      }
+      if (shift.has_value()) {
+        epilogueShift = epilogueShift + shift->to(torch::kFloat);
+      }
+      epilogueShift = epilogueShift.contiguous();
+    }
+    else if (shift.has_value()) {
+      epilogueShift = shift->to(torch::kFloat).contiguous();
+    }
+}
 
 // CUDA forward definition
+// The DCU path runs on the device of input and on the current PyTorch stream of that device, the output is
+// allocated there too; filter and the epilogue tensors must be on the same device.
+// Optional fused epilogue: output = activation((conv + bias) * scale + shift), per channel.
+// BatchNorm in inference mode is scale = gamma / sqrt(var + eps), shift = beta - mean * scale.
+// A torch.channels_last input runs the NHWC kernels and gives a torch.channels_last output.
+// float, half and bfloat16 tensors, the filter is converted to the input type, accumulation is always fp32.
+// out: optional output tensor written in place of a new one. workspace: optional CPU scratch memory kept
+// across calls (CPU_DepthwiseWorkspace.h), so a host inference loop does not allocate in steady state.
+// dilation: atrous convolution, the taps dilation pixels apart with padding dilation * (filterHeight - 1) / 2; 3x3
+// and 5x5 filters with dilation 2 or 4 at stride 1 run Depthwise_Dilated on the DCU, the others Depthwise_Generic.
 torch::Tensor optimizedDepthwise_forward(
     torch::Tensor input,
     torch::Tensor filter,
     int filterHeight,
-    int stride) {
-    
+    int stride,
+    c10::optional<torch::Tensor> bias,
+    c10::optional<torch::Tensor> scale,
+    c10::optional<torch::Tensor> shift,
+    const std::string& activation,
+    c10::optional<torch::Tensor> out,
+    DepthwiseCpuWorkspace* workspace,
+    int dilation) {
+
+    checkDepthwiseShape(input, filter, filterHeight, stride, dilation);
+    filter = filter.to(input.scalar_type());
+    checkEpilogueTensor(bias, input, input.size(1), "bias");
+    checkEpilogueTensor(scale, input, input.size(1), "scale");
+    checkEpilogueTensor(shift, input, input.size(1), "shift");
+    int activationId = depthwiseActivationFromName(activation);
+
+    torch::Tensor output = checkOutTensor(out, input,
+      {input.size(0), input.size(1), depthwiseOutputSize(input.size(2), filterHeight, stride, dilation),
+        depthwiseOutputSize(input.size(3), filterHeight, stride, dilation)},
+      isChannelsLast(input));
+
+    torch::Tensor epilogueScale;
+    torch::Tensor epilogueShift;
+    foldEpilogue(bias, scale, shift, epilogueScale, epilogueShift);
+
+    if (isChannelsLast(input)) {
+      filter = filter.contiguous();
+
+      if (input.device().is_cpu()) {
+        CHECK_CPU_CHANNELS_LAST_INPUT(input);
+        CHECK_CPU_INPUT(filter);
+
+        return optimizedDepthwiseChannelsLast_cpu_forward(
+          input,
+          filter,
+          filterHeight,
+          stride,
+          dilation,
+          epilogueScale,
+          epilogueShift,
+          activationId,
+          output,
+          workspace);
+      }
+
+      CHECK_CHANNELS_LAST_INPUT(input);
+      CHECK_INPUT(filter);
+      CHECK_SAME_DEVICE(filter, input);
+
+      return optimizedDepthwiseChannelsLast_cuda_forward(
+        input,
+        filter,
+        filterHeight,
+        stride,
+        dilation,
+        epilogueScale,
+        epilogueShift,
+        activationId,
+        output);
+    }
+
+    if (input.device().is_cpu()) {
+      CHECK_CPU_INPUT(input);
+      CHECK_CPU_INPUT(filter);
+
+      return optimizedDepthwise_cpu_forward(
+        input,
+        filter,
+        filterHeight,
+        stride,
+        dilation,
+        epilogueScale,
+        epilogueShift,
+        activationId,
+        output,
+        workspace);
+    }
+
     CHECK_INPUT(input);
     CHECK_INPUT(filter);
+    CHECK_SAME_DEVICE(filter, input);
 
     return optimizedDepthwise_cuda_forward(
       input,
       filter,
       filterHeight,
-      stride);
+      stride,
+      dilation,
+      epilogueScale,
+      epilogueShift,
+      activationId,
+      output);
+}
+
+// Fused depthwise separable block: pointwise(depthwise(input)), each with an optional scale / shift / activation
+// epilogue (e.g. BatchNorm + ReLU6 after the depthwise convolution, BatchNorm after the pointwise one).
+// The depthwise output is never written to memory. out / workspace as in the depthwise forward.
+torch::Tensor optimizedDepthwisePointwise_forward(
+    torch::Tensor input,
+    torch::Tensor depthwiseFilter,
+    int filterHeight,
+    int stride,
+    torch::Tensor pointwiseFilter,
+    c10::optional<torch::Tensor> depthwiseScale,
+    c10::optional<torch::Tensor> depthwiseShift,
+    const std::string& depthwiseActivation,
+    c10::optional<torch::Tensor> pointwiseScale,
+    c10::optional<torch::Tensor> pointwiseShift,
+    const std::string& pointwiseActivation,
+    c10::optional<torch::Tensor> out,
+    DepthwiseCpuWorkspace* workspace) {
+
+    checkDepthwiseShape(input, depthwiseFilter, filterHeight, stride);
+    TORCH_CHECK((pointwiseFilter.dim() == 4 && pointwiseFilter.size(2) == 1 && pointwiseFilter.size(3) == 1) || pointwiseFilter.dim() == 2,
+      "pointwiseFilter must be a (outputChannel, C, 1, 1) or (outputChannel, C) tensor");
+    TORCH_CHECK(pointwiseFilter.size(1) == input.size(1), "pointwiseFilter must match the input channels");
+    int64_t outputChannel = pointwiseFilter.size(0);
+    depthwiseFilter = depthwiseFilter.to(input.scalar_type());
+    pointwiseFilter = pointwiseFilter.to(input.scalar_type());
+
+    checkEpilogueTensor(depthwiseScale, input, input.size(1), "depthwiseScale");
+    checkEpilogueTensor(depthwiseShift, input, input.size(1), "depthwiseShift");
+    checkEpilogueTensor(pointwiseScale, input, outputChannel, "pointwiseScale");
+    checkEpilogueTensor(pointwiseShift, input, outputChannel, "pointwiseShift");
+    int depthwiseActivationId = depthwiseActivationFromName(depthwiseActivation);
+    int pointwiseActivationId = depthwiseActivationFromName(pointwiseActivation);
+    torch::Tensor output = checkOutTensor(out, input,
+      {input.size(0), outputChannel, depthwiseOutputSize(input.size(2), filterHeight, stride), depthwiseOutputSize(input.size(3), filterHeight, stride)},
+      false);
+
+    torch::Tensor epilogueTensors[4];
+    const c10::optional<torch::Tensor>* optionalTensors[4] = { &depthwiseScale, &depthwiseShift, &pointwiseScale, &pointwiseShift };
+    for (int i = 0; i < 4; i++) {
+      if (optionalTensors[i]->has_value()) {
+        epilogueTensors[i] = (*optionalTensors[i])->to(torch::kFloat).contiguous();
+      }
+    }
+
+    if (input.device().is_cpu()) {
+      CHECK_CPU_INPUT(input);
+      CHECK_CPU_INPUT(depthwiseFilter);
+      CHECK_CPU_INPUT(pointwiseFilter);
+
+      return optimizedDepthwisePointwise_cpu_forward(
+        input,
+        depthwiseFilter,
+        filterHeight,
+        stride,
+        pointwiseFilter,
+        epilogueTensors[0],
+        epilogueTensors[1],
+        depthwiseActivationId,
+        epilogueTensors[2],
+        epilogueTensors[3],
+        pointwiseActivationId,
+        output,
+        workspace);
+    }
+
+    CHECK_INPUT(input);
+    CHECK_INPUT(depthwiseFilter);
+    CHECK_INPUT(pointwiseFilter);
+    CHECK_SAME_DEVICE(depthwiseFilter, input);
+    CHECK_SAME_DEVICE(pointwiseFilter, input);
+
+    return optimizedDepthwisePointwise_cuda_forward(
+      input,
+      depthwiseFilter,
+      filterHeight,
+      stride,
+      pointwiseFilter,
+      epilogueTensors[0],
+      epilogueTensors[1],
+      depthwiseActivationId,
+      epilogueTensors[2],
+      epilogueTensors[3],
+      pointwiseActivationId,
+      output);
+}
+
+// Pointwise (1 x 1) convolution, filter is (outputChannel, C, 1, 1) or (outputChannel, C).
+// Same optional epilogue, out and workspace as the depthwise forward.
+torch::Tensor optimizedPointwise_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    c10::optional<torch::Tensor> bias,
+    c10::optional<torch::Tensor> scale,
+    c10::optional<torch::Tensor> shift,
+    const std::string& activation,
+    c10::optional<torch::Tensor> out,
+    DepthwiseCpuWorkspace* workspace) {
+
+    TORCH_CHECK(input.dim() == 4, "input must be a 4D (N, C, H, W) tensor");
+    TORCH_CHECK((filter.dim() == 4 && filter.size(2) == 1 && filter.size(3) == 1) || filter.dim() == 2,
+      "filter must be a (outputChannel, C, 1, 1) or (outputChannel, C) tensor");
+    TORCH_CHECK(filter.size(1) == input.size(1), "filter must match the input channels");
+    int64_t outputChannel = filter.size(0);
+    filter = filter.to(input.scalar_type());
+
+    checkEpilogueTensor(bias, input, outputChannel, "bias");
+    checkEpilogueTensor(scale, input, outputChannel, "scale");
+    checkEpilogueTensor(shift, input, outputChannel, "shift");
+    int activationId = depthwiseActivationFromName(activation);
+    torch::Tensor output = checkOutTensor(out, input, {input.size(0), outputChannel, input.size(2), input.size(3)}, false);
+
+    torch::Tensor epilogueScale;
+    torch::Tensor epilogueShift;
+    foldEpilogue(bias, scale, shift, epilogueScale, epilogueShift);
+
+    if (input.device().is_cpu()) {
+      CHECK_CPU_INPUT(input);
+      CHECK_CPU_INPUT(filter);
+
+      return optimizedPointwise_cpu_forward(
+        input,
+        filter,
+        epilogueScale,
+        epilogueShift,
+        activationId,
+        output,
+        workspace);
+    }
+
+    CHECK_INPUT(input);
+    CHECK_INPUT(filter);
+    CHECK_SAME_DEVICE(filter, input);
+
+    return optimizedPointwise_cuda_forward(
+      input,
+      filter,
+      epilogueScale,
+      epilogueShift,
+      activationId,
+      output);
+}
+
+// Quantized depthwise forward: int8 input (per tensor inputScale / inputZeroPoint), int8 filter (symmetric,
+// per channel filterScale), int32 accumulation, requantized to an int8 output (outputScale / outputZeroPoint).
+// bias is an optional int32 tensor in units of inputScale * filterScale. activation is none, relu or relu6,
+// applied as a clamp of the quantized output. Host only: the DCU kernels have no int8 path.
+torch::Tensor optimizedDepthwiseQuantized_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    double inputScale,
+    int64_t inputZeroPoint,
+    torch::Tensor filterScale,
+    double outputScale,
+    int64_t outputZeroPoint,
+    c10::optional<torch::Tensor> bias,
+    const std::string& activation) {
+
+    checkDepthwiseShape(input, filter, filterHeight, stride);
+    TORCH_CHECK(input.device().is_cpu(), "quantized_forward runs on the host only, input must be a CPU tensor");
+    TORCH_CHECK(input.scalar_type() == torch::kInt8 && filter.scalar_type() == torch::kInt8, "input and filter must be int8 tensors");
+    TORCH_CHECK(inputScale > 0 && outputScale > 0, "inputScale and outputScale must be positive");
+    TORCH_CHECK(inputZeroPoint >= -128 && inputZeroPoint <= 127 && outputZeroPoint >= -128 && outputZeroPoint <= 127,
+      "zero points must be in the int8 range");
+    TORCH_CHECK(filterScale.numel() == input.size(1), "filterScale must have one value per channel");
+    int activationId = depthwiseActivationFromName(activation);
+    TORCH_CHECK(activationId == DepthwiseActivationNone || activationId == DepthwiseActivationReLU || activationId == DepthwiseActivationReLU6,
+      "quantized activation must be none, relu or relu6");
+
+    torch::Tensor quantizedBias;
+    if (bias.has_value()) {
+      TORCH_CHECK(bias->numel() == input.size(1), "bias must have one value per channel");
+      quantizedBias = bias->to(torch::kInt32).contiguous();
+      CHECK_CPU(quantizedBias);
+    }
+    filterScale = filterScale.to(torch::kFloat).contiguous();
+    CHECK_CPU(filterScale);
+    CHECK_CPU(filter);
+    CHECK_CONTIGUOUS(input);
+    CHECK_CONTIGUOUS(filter);
+
+    return optimizedDepthwiseQuantized_cpu_forward(
+      input,
+      filter,
+      filterHeight,
+      stride,
+      inputScale,
+      inputZeroPoint,
+      filterScale,
+      outputScale,
+      outputZeroPoint,
+      quantizedBias,
+      activationId);
+}
+
+// Depthwise convolution backward (no epilogue), same filterHeight / stride / dilation as forward.
+// Returns [grad_input, grad_weight], a gradient that is not needed is None.
+// Both gradients come from a single pass over gradOutput.
+// The backward kernels are NCHW: a torch.channels_last input is converted, and grad_input is returned channels last.
+std::vector<torch::Tensor> optimizedDepthwise_backward(
+    torch::Tensor gradOutput,
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    bool needsInputGrad,
+    bool needsFilterGrad,
+    int dilation) {
+
+    checkDepthwiseShape(input, filter, filterHeight, stride, dilation);
+    TORCH_CHECK(gradOutput.dim() == 4 && gradOutput.size(0) == input.size(0) && gradOutput.size(1) == input.size(1) &&
+      gradOutput.size(2) == depthwiseOutputSize(input.size(2), filterHeight, stride, dilation) &&
+      gradOutput.size(3) == depthwiseOutputSize(input.size(3), filterHeight, stride, dilation),
+      "gradOutput must have the shape of the forward output");
+    bool channelsLast = isChannelsLast(input);
+    gradOutput = gradOutput.to(input.scalar_type()).contiguous();
+    filter = filter.to(input.scalar_type());
+    if (channelsLast) {
+      input = input.contiguous();
+    }
+
+    std::vector<torch::Tensor> gradients;
+    if (input.device().is_cpu()) {
+      CHECK_CPU_INPUT(gradOutput);
+      CHECK_CPU_INPUT(input);
+      CHECK_CPU_INPUT(filter);
+
+      gradients = optimizedDepthwise_cpu_backward(
+        gradOutput,
+        input,
+        filter,
+        filterHeight,
+        stride,
+        dilation,
+        needsInputGrad,
+        needsFilterGrad);
+    }
+    else {
+      CHECK_INPUT(gradOutput);
+      CHECK_INPUT(input);
+      CHECK_INPUT(filter);
+      CHECK_SAME_DEVICE(gradOutput, input);
+      CHECK_SAME_DEVICE(filter, input);
+
+      gradients = optimizedDepthwise_cuda_backward(
+        gradOutput,
+        input,
+        filter,
+        filterHeight,
+        stride,
+        dilation,
+        needsInputGrad,
+        needsFilterGrad);
+    }
+
+    if (channelsLast && gradients[0].defined()) {
+      gradients[0] = gradients[0].contiguous(torch::MemoryFormat::ChannelsLast);
+    }
+    return gradients;
+}
+
+// Whole network executor (DepthwiseNetwork.h). The layers are added once; forward() plans them for the input shape
+// (kept until the shape changes), allocates the two or three activation buffers of the plan on the input device and
+// runs every step through the forwards above with out= views of those buffers, without returning to Python.
+// Weights are converted to the input dtype / device once and stay resident, so on the DCU the next layer's weights
+// are already there and every launch is queued on the current stream back to back; on the host the next step's
+// weights are prefetched into L2 (cpuPrefetchL2(), CPU_DepthwiseNetwork.h) and every step reuses one workspace.
+// The tensors given to add_depthwise / add_pointwise are kept as they are (master*), the resident copies are
+// made from them whenever the dtype or device changes.
+struct DepthwiseTorchNetwork {
+  std::vector<DepthwiseNetworkLayer> layers;
+  std::vector<torch::Tensor> masterFilters;
+  std::vector<torch::Tensor> masterScales;
+  std::vector<torch::Tensor> masterShifts;
+  std::vector<torch::Tensor> filters;
+  std::vector<torch::Tensor> scales;
+  std::vector<torch::Tensor> shifts;
+  DepthwiseNetworkPlan plan;
+  std::vector<int64_t> plannedShape;
+  std::vector<torch::Tensor> buffers;
+  DepthwiseCpuWorkspace workspace;
+
+  void addLayer(
+      const DepthwiseNetworkLayer& layer,
+      const torch::Tensor& filter,
+      const c10::optional<torch::Tensor>& bias,
+      const c10::optional<torch::Tensor>& scale,
+      const c10::optional<torch::Tensor>& shift) {
+
+    torch::Tensor epilogueScale;
+    torch::Tensor epilogueShift;
+    foldEpilogue(bias, scale, shift, epilogueScale, epilogueShift);
+    layers.push_back(layer);
+    masterFilters.push_back(filter);
+    masterScales.push_back(epilogueScale);
+    masterShifts.push_back(epilogueShift);
+    plannedShape.clear();
+  }
+
+  void addDepthwise(
+      torch::Tensor filter,
+      int filterHeight,
+      int stride,
+      c10::optional<torch::Tensor> bias,
+      c10::optional<torch::Tensor> scale,
+      c10::optional<torch::Tensor> shift,
+      const std::string& activation) {
+
+    TORCH_CHECK(filter.dim() == 4 && filter.size(1) == 1 && filter.size(2) == filterHeight && filter.size(3) == filterHeight,
+      "filter must be a (C, 1, filterHeight, filterHeight) tensor");
+    TORCH_CHECK(filterHeight > 0 && stride > 0, "filterHeight and stride must be positive");
+    addLayer(depthwiseNetworkDepthwiseLayer(filterHeight, stride, depthwiseActivationFromName(activation)), filter, bias, scale, shift);
+  }
+
+  // residual: -1, or the index of an earlier layer whose input is added to the output of this one
+  void addPointwise(
+      torch::Tensor filter,
+      c10::optional<torch::Tensor> bias,
+      c10::optional<torch::Tensor> scale,
+      c10::optional<torch::Tensor> shift,
+      const std::string& activation,
+      int residual) {
+
+    TORCH_CHECK((filter.dim() == 4 && filter.size(2) == 1 && filter.size(3) == 1) || filter.dim() == 2,
+      "filter must be a (outputChannel, C, 1, 1) or (outputChannel, C) tensor");
+    addLayer(depthwiseNetworkPointwiseLayer((int)filter.size(0), depthwiseActivationFromName(activation), residual), filter, bias, scale, shift);
+  }
+
+  // Plan for the shape of input and copy the weights to its dtype / device, unless the last forward did already
+  void prepare(const torch::Tensor& input, bool fuse) {
+    std::vector<int64_t> shape = { input.size(0), input.size(1), input.size(2), input.size(3), fuse, (int64_t)input.scalar_type() };
+    if (shape == plannedShape && filters.size() == layers.size() && filters[0].device() == input.device()) {
+      return;
+    }
+    TORCH_CHECK(planDepthwiseNetwork(layers, (int)input.size(0), (int)input.size(1), (int)input.size(2), (int)input.size(3), fuse, plan),
+      "the network does not fit the input: ", plan.error);
+
+    int64_t channel = input.size(1);
+    filters.assign(layers.size(), torch::Tensor());
+    scales.assign(layers.size(), torch::Tensor());
+    shifts.assign(layers.size(), torch::Tensor());
+    for (size_t i = 0; i < layers.size(); i++) {
+      int64_t outputChannel = layers[i].kind == DepthwiseNetworkDepthwise ? channel : layers[i].outputChannel;
+      TORCH_CHECK(masterFilters[i].size(0) == outputChannel &&
+        (layers[i].kind == DepthwiseNetworkDepthwise || masterFilters[i].size(1) == channel),
+        "the filter of layer ", i, " does not match its input channels");
+      TORCH_CHECK((!masterScales[i].defined() || masterScales[i].numel() == outputChannel) &&
+        (!masterShifts[i].defined() || masterShifts[i].numel() == outputChannel),
+        "the epilogue of layer ", i, " must have one value per output channel");
+      filters[i] = masterFilters[i].to(input.device(), input.scalar_type()).contiguous();
+      if (masterScales[i].defined()) {
+        scales[i] = masterScales[i].to(input.device(), torch::kFloat).contiguous();
+      }
+      if (masterShifts[i].defined()) {
+        shifts[i] = masterShifts[i].to(input.device(), torch::kFloat).contiguous();
+      }
+      // host weights are prefetched through the layer (DepthwiseTorchNetworkBackend::prefetch)
+      layers[i].filter = input.device().is_cpu() ? filters[i].data_ptr() : nullptr;
+      channel = outputChannel;
+    }
+
+    buffers.clear();
+    for (size_t i = 0; i < plan.bufferSizes.size(); i++) {
+      buffers.push_back(torch::empty({(int64_t)plan.bufferSizes[i]}, input.options()));
+    }
+    plannedShape = shape;
+  }
+
+  torch::Tensor forward(torch::Tensor input, bool fuse, c10::optional<torch::Tensor> out);
+};
+
+// The backend of runDepthwiseNetwork() on torch tensors: every step is a forward of this extension
+struct DepthwiseTorchNetworkBackend {
+  DepthwiseTorchNetwork& network;
+  const torch::Tensor& input;
+  const torch::Tensor& output;
+
+  torch::Tensor activation(int buffer, int channel, int height, int width) const {
+    if (buffer == DepthwiseNetworkInput) {
+      return input;
+    }
+    if (buffer == DepthwiseNetworkOutput) {
+      return output;
+    }
+    return network.buffers[buffer].narrow(0, 0, (int64_t)network.plan.batch * channel * height * width)
+      .view({network.plan.batch, channel, height, width});
+  }
+
+  torch::Tensor source(const DepthwiseNetworkStep& step) const {
+    return activation(step.inputBuffer, step.inputChannel, step.inputHeight, step.inputWidth);
+  }
+
+  torch::Tensor destination(const DepthwiseNetworkStep& step) const {
+    return activation(step.outputBuffer, step.outputChannel, step.outputHeight, step.outputWidth);
+  }
+
+  // The weights stay resident on the device of the network (DepthwiseTorchNetwork::prepare), the host ones of the
+  // next step are prefetched into L2 like in DepthwiseCpuNetworkBackend. The next step reads the output of this
+  // one, which is not written yet, so only its weights are prefetched.
+  void prefetch(const DepthwiseNetworkLayer& layer, size_t weights) {
+    if (layer.filter != nullptr) {
+      cpuPrefetchL2(layer.filter, std::min(weights * input.element_size(), cpuNetworkPrefetchBytes));
+    }
+  }
+
+  void depthwise(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& layer) {
+    int l = step.layer;
+    if (input.device().is_cpu()) {
+      optimizedDepthwise_cpu_forward(source(step), network.filters[l], step.filterSize, step.stride, 1,
+        network.scales[l], network.shifts[l], layer.epilogue.activation, destination(step), &network.workspace);
+    }
+    else {
+      optimizedDepthwise_cuda_forward(source(step), network.filters[l], step.filterSize, step.stride, 1,
+        network.scales[l], network.shifts[l], layer.epilogue.activation, destination(step));
+    }
+  }
+
+  void pointwise(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& layer) {
+    int l = step.layer;
+    if (input.device().is_cpu()) {
+      optimizedPointwise_cpu_forward(source(step), network.filters[l],
+        network.scales[l], network.shifts[l], layer.epilogue.activation, destination(step), &network.workspace);
+    }
+    else {
+      optimizedPointwise_cuda_forward(source(step), network.filters[l],
+        network.scales[l], network.shifts[l], layer.epilogue.activation, destination(step));
+    }
+  }
+
+  void fused(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& depthwise, const DepthwiseNetworkLayer& pointwise) {
+    int l = step.layer;
+    if (input.device().is_cpu()) {
+      optimizedDepthwisePointwise_cpu_forward(source(step), network.filters[l], step.filterSize, step.stride, network.filters[l + 1],
+        network.scales[l], network.shifts[l], depthwise.epilogue.activation,
+        network.scales[l + 1], network.shifts[l + 1], pointwise.epilogue.activation, destination(step), &network.workspace);
+    }
+    else {
+      optimizedDepthwisePointwise_cuda_forward(source(step), network.filters[l], step.filterSize, step.stride, network.filters[l + 1],
+        network.scales[l], network.shifts[l], depthwise.epilogue.activation,
+        network.scales[l + 1], network.shifts[l + 1], pointwise.epilogue.activation, destination(step));
+    }
+  }
+
+  void addResidual(const DepthwiseNetworkStep& step) {
+    destination(step).add_(activation(step.residualBuffer, step.outputChannel, step.outputHeight, step.outputWidth));
+  }
+};
+
+// Run the network on input (N, C, H, W), NCHW contiguous, float, half or bfloat16; fuse = false keeps every
+// depthwise and pointwise layer a launch of its own. out: optional output tensor written in place of a new one.
+torch::Tensor DepthwiseTorchNetwork::forward(torch::Tensor input, bool fuse, c10::optional<torch::Tensor> out) {
+  TORCH_CHECK(input.dim() == 4, "input must be a 4D (N, C, H, W) tensor");
+  if (input.device().is_cpu()) {
+    CHECK_CPU_INPUT(input);
+  }
+  else {
+    CHECK_INPUT(input);
+    CHECK_FLOATING(input);
+  }
+  prepare(input, fuse);
+
+  torch::Tensor output = checkOutTensor(out, input, {plan.batch, plan.outputChannel, plan.outputHeight, plan.outputWidth}, false);
+  if (!output.defined()) {
+    output = torch::empty({plan.batch, plan.outputChannel, plan.outputHeight, plan.outputWidth}, input.options());
+  }
+  DepthwiseTorchNetworkBackend backend = { *this, input, output };
+  runDepthwiseNetwork(plan, layers, backend);
+  return output;
 }
 
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
-    m.def("forward", &optimizedDepthwise_forward, "Optimized Depthwise forward (CUDA)");
+    py::class_<DepthwiseCpuWorkspace>(m, "Workspace", "Scratch memory of the CPU forward, reused by every call it is passed to")
+      .def(py::init<>())
+      .def("bytes", &DepthwiseCpuWorkspace::bytes, "Bytes held")
+      .def("release", &DepthwiseCpuWorkspace::release, "Free the memory, the next call grows it again");
+    m.def("forward", &optimizedDepthwise_forward, "Optimized Depthwise forward (CUDA and CPU), with optional fused bias / BatchNorm / activation, NCHW or channels last",
+      py::arg("input"), py::arg("filter"), py::arg("filterHeight"), py::arg("stride"),
+      py::arg("bias") = py::none(), py::arg("scale") = py::none(), py::arg("shift") = py::none(),
+      py::arg("activation") = "none", py::arg("out") = py::none(), py::arg("workspace") = py::none(), py::arg("dilation") = 1);
+    m.def("backward", &optimizedDepthwise_backward, "Optimized Depthwise backward (CUDA and CPU), grad_input and grad_weight in one pass",
+      py::arg("gradOutput"), py::arg("input"), py::arg("filter"), py::arg("filterHeight"), py::arg("stride"),
+      py::arg("needsInputGrad") = true, py::arg("needsFilterGrad") = true, py::arg("dilation") = 1);
+    m.def("pointwise_forward", &optimizedPointwise_forward, "Optimized Pointwise forward (CUDA and CPU), with optional fused bias / BatchNorm / activation",
+      py::arg("input"), py::arg("filter"),
+      py::arg("bias") = py::none(), py::arg("scale") = py::none(), py::arg("shift") = py::none(),
+      py::arg("activation") = "none", py::arg("out") = py::none(), py::arg("workspace") = py::none());
+    m.def("quantized_forward", &optimizedDepthwiseQuantized_forward,
+      "Quantized int8 Depthwise forward (CPU), per channel filter scales, int32 accumulation, fused requantization and relu / relu6",
+      py::arg("input"), py::arg("filter"), py::arg("filterHeight"), py::arg("stride"),
+      py::arg("inputScale"), py::arg("inputZeroPoint"), py::arg("filterScale"), py::arg("outputScale"), py::arg("outputZeroPoint"),
+      py::arg("bias") = py::none(), py::arg("activation") = "none");
+    m.def("depthwise_pointwise", &optimizedDepthwisePointwise_forward,
+      "Fused depthwise separable block forward (CUDA and CPU): depthwise, epilogue, pointwise, epilogue",
+      py::arg("input"), py::arg("depthwiseFilter"), py::arg("filterHeight"), py::arg("stride"), py::arg("pointwiseFilter"),
+      py::arg("depthwiseScale") = py::none(), py::arg("depthwiseShift") = py::none(), py::arg("depthwiseActivation") = "none",
+      py::arg("pointwiseScale") = py::none(), py::arg("pointwiseShift") = py::none(), py::arg("pointwiseActivation") = "none",
+      py::arg("out") = py::none(), py::arg("workspace") = py::none());
+    py::class_<DepthwiseTorchNetwork>(m, "Network",
+      "Depthwise separable network run in one call: layers planned once, reused activation buffers, resident weights")
+      .def(py::init<>())
+      .def("add_depthwise", &DepthwiseTorchNetwork::addDepthwise, "Append a depthwise layer (\"same\" padding)",
+        py::arg("filter"), py::arg("filterHeight"), py::arg("stride"),
+        py::arg("bias") = py::none(), py::arg("scale") = py::none(), py::arg("shift") = py::none(),
+        py::arg("activation") = "none")
+      .def("add_pointwise", &DepthwiseTorchNetwork::addPointwise,
+        "Append a pointwise layer, residual is the index of an earlier layer whose input is added to its output",
+        py::arg("filter"),
+        py::arg("bias") = py::none(), py::arg("scale") = py::none(), py::arg("shift") = py::none(),
+        py::arg("activation") = "none", py::arg("residual") = -1)
+      .def("forward", &DepthwiseTorchNetwork::forward, "Run every layer on input, fused depthwise / pointwise pairs unless fuse is False",
+        py::arg("input"), py::arg("fuse") = true, py::arg("out") = py::none());
 }
@@ -0,0 +1,341 @@
+#include <torch/extension.h>
+
+#include "CPU_Depthwise.h"
+#include "CPU_DepthwiseTuning.h"
+#include "CPU_DepthwiseNHWC.h"
+#include "CPU_DepthwiseInt8.h"
+#include "CPU_DepthwisePointwise.h"
+#include "CPU_Pointwise.h"
+#include "CPU_DepthwiseBackward.h"
+
+// Epilogue parameters of the kernels from the (optional, undefined if absent) scale / shift tensors
+static DepthwiseEpilogue depthwiseEpilogueOf(const torch::Tensor& scale, const torch::Tensor& shift, int activation) {
+	DepthwiseEpilogue epilogue = depthwiseNoEpilogue;
+	epilogue.scale = scale.defined() ? scale.data_ptr<float>() : nullptr;
+	epilogue.shift = shift.defined() ? shift.data_ptr<float>() : nullptr;
+	epilogue.activation = activation;
+	return epilogue;
+}
+
+// Data of a float / half / bfloat16 tensor as the storage type of the CPU backend (same layout, see DepthwiseHalf.h)
+template <typename storage_t>
+static storage_t* storageData(const torch::Tensor& tensor) {
+	return reinterpret_cast<storage_t*>(tensor.data_ptr());
+}
+
+// Call kernel with a null pointer of the storage type of tensor (float, half or bfloat16): the forwards keep
+// half / bfloat16 in 16 bits and widen them tile by tile, no float copy of the tensors is made
+template <typename Kernel>
+static void dispatchStorage(const torch::Tensor& tensor, Kernel kernel) {
+	if (tensor.scalar_type() == torch::kHalf) {
+		kernel((DepthwiseHalf*)nullptr);
+	}
+	else if (tensor.scalar_type() == torch::kBFloat16) {
+		kernel((DepthwiseBFloat16*)nullptr);
+	}
+	else {
+		kernel((float*)nullptr);
+	}
+}
+
+// The backward is float only and computes on a float copy
+static torch::Tensor floatTensor(const torch::Tensor& tensor) {
+	return tensor.scalar_type() == torch::kFloat ? tensor : tensor.to(torch::kFloat);
+}
+
+// Use the CPU backend for tensors that live on the host
+// scale / shift are optional (undefined tensor) per channel epilogue parameters, see DepthwiseEpilogue.h
+// half / bfloat16 input and output stay 16-bit, accumulation is fp32
+// The schedule comes from the autotuner (CPU_DepthwiseTuning.h), set DEPTHWISE_TUNING=0 for the default one
+// 3x3 / 5x5 filters at stride 1 with dilation 2 or 4 keep the SIMD rows of CPU_Depthwise.h
+// output is the out= tensor (undefined: allocated here), workspace the optional scratch memory (CPU_DepthwiseWorkspace.h)
+torch::Tensor optimizedDepthwise_cpu_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    int dilation,
+    const torch::Tensor& scale,
+    const torch::Tensor& shift,
+    int activation,
+    torch::Tensor output,
+    DepthwiseCpuWorkspace* workspace) {
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+	int filterLayerNumber = inputChannel;
+
+    int paddingHeight = dilation * (filterHeight - 1) / 2;
+    int paddingWidth = paddingHeight;
+
+    int outputBatchNumber = inputBatchNumber;
+    int outputChannel = inputChannel;
+    int outputHeight = (inputHeight + paddingHeight * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+    int outputWidth = (inputWidth + paddingWidth * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+
+	if (!output.defined()) {
+		output = torch::empty({outputBatchNumber, outputChannel, outputHeight, outputWidth}, input.options());
+	}
+
+    float alpha = 1.0f;
+	float beta = 0.0f;
+
+	DepthwiseEpilogue epilogue = depthwiseEpilogueOf(scale, shift, activation);
+
+	dispatchStorage(input, [&](auto* storage) {
+		typedef typename std::remove_pointer<decltype(storage)>::type storage_t;
+		CPU_Depthwise_Tuned(
+			storageData<const storage_t>(input), storageData<const storage_t>(filter), storageData<storage_t>(output),
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterHeight,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, stride, stride, dilation, dilation,
+			alpha, beta, epilogue, workspace);
+	});
+
+	return output;
+}
+
+// Channels last input on the host, vectorized across the channels of a pixel. The output is channels last too.
+// Same dtypes, out= and workspace as optimizedDepthwise_cpu_forward()
+torch::Tensor optimizedDepthwiseChannelsLast_cpu_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    int dilation,
+    const torch::Tensor& scale,
+    const torch::Tensor& shift,
+    int activation,
+    torch::Tensor output,
+    DepthwiseCpuWorkspace* workspace) {
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+    int padding = dilation * (filterHeight - 1) / 2;
+    int outputHeight = (inputHeight + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+    int outputWidth = (inputWidth + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+
+	if (!output.defined()) {
+		output = torch::empty({inputBatchNumber, inputChannel, outputHeight, outputWidth},
+			input.options().memory_format(torch::MemoryFormat::ChannelsLast));
+	}
+
+	dispatchStorage(input, [&](auto* storage) {
+		typedef typename std::remove_pointer<decltype(storage)>::type storage_t;
+		CPU_Depthwise_NHWC(
+			storageData<const storage_t>(input), storageData<const storage_t>(filter), storageData<storage_t>(output),
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			inputChannel, filterHeight, filterHeight,
+			inputBatchNumber, inputChannel, outputHeight, outputWidth,
+			padding, padding, stride, stride, dilation, dilation,
+			1.0f, 0.0f, depthwiseEpilogueOf(scale, shift, activation), workspace);
+	});
+
+	return output;
+}
+
+// Quantized (int8) NCHW input on the host, int32 accumulation and requantization to an int8 output.
+// filterScale is float (one value per channel), bias is an optional (undefined if absent) int32 tensor.
+torch::Tensor optimizedDepthwiseQuantized_cpu_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    double inputScale,
+    int64_t inputZeroPoint,
+    const torch::Tensor& filterScale,
+    double outputScale,
+    int64_t outputZeroPoint,
+    const torch::Tensor& bias,
+    int activation) {
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+	int filterLayerNumber = inputChannel;
+	int padding = (filterHeight - 1) / 2;
+
+    int outputBatchNumber = inputBatchNumber;
+    int outputChannel = inputChannel;
+    int outputHeight = (inputHeight + padding * 2 - filterHeight) / stride + 1;
+    int outputWidth = (inputWidth + padding * 2 - filterHeight) / stride + 1;
+
+	torch::Tensor output = torch::empty({outputBatchNumber, outputChannel, outputHeight, outputWidth}, input.options());
+
+	DepthwiseQuantization quantization;
+	quantization.inputScale = (float)inputScale;
+	quantization.inputZeroPoint = (int)inputZeroPoint;
+	quantization.filterScale = filterScale.data_ptr<float>();
+	quantization.bias = bias.defined() ? bias.data_ptr<int32_t>() : nullptr;
+	quantization.outputScale = (float)outputScale;
+	quantization.outputZeroPoint = (int)outputZeroPoint;
+	quantization.activation = activation;
+
+	CPU_Depthwise_Int8(
+		input.data_ptr<int8_t>(), filter.data_ptr<int8_t>(), output.data_ptr<int8_t>(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterHeight,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		padding, stride, quantization);
+
+	return output;
+}
+
+// Fused depthwise separable block on the host, the depthwise output stays in a per thread tile
+// Same dtypes, out= and workspace as optimizedDepthwise_cpu_forward()
+torch::Tensor optimizedDepthwisePointwise_cpu_forward(
+    torch::Tensor input,
+    torch::Tensor depthwiseFilter,
+    int filterHeight,
+    int stride,
+    torch::Tensor pointwiseFilter,
+    const torch::Tensor& depthwiseScale,
+    const torch::Tensor& depthwiseShift,
+    int depthwiseActivation,
+    const torch::Tensor& pointwiseScale,
+    const torch::Tensor& pointwiseShift,
+    int pointwiseActivation,
+    torch::Tensor output,
+    DepthwiseCpuWorkspace* workspace) {
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+    int padding = (filterHeight - 1) / 2;
+    int outputChannel = pointwiseFilter.size(0);
+    int outputHeight = (inputHeight + padding * 2 - filterHeight) / stride + 1;
+    int outputWidth = (inputWidth + padding * 2 - filterHeight) / stride + 1;
+
+	if (!output.defined()) {
+		output = torch::empty({inputBatchNumber, outputChannel, outputHeight, outputWidth}, input.options());
+	}
+
+	dispatchStorage(input, [&](auto* storage) {
+		typedef typename std::remove_pointer<decltype(storage)>::type storage_t;
+		CPU_DepthwisePointwise(
+			storageData<const storage_t>(input), storageData<const storage_t>(depthwiseFilter),
+			storageData<const storage_t>(pointwiseFilter), storageData<storage_t>(output),
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterHeight, filterHeight,
+			outputChannel, outputHeight, outputWidth,
+			padding, stride,
+			depthwiseEpilogueOf(depthwiseScale, depthwiseShift, depthwiseActivation),
+			depthwiseEpilogueOf(pointwiseScale, pointwiseShift, pointwiseActivation), workspace);
+	});
+
+	return output;
+}
+
+// Pointwise (1 x 1) convolution on the host, cache blocked SIMD GEMM
+// Same dtypes, out= and workspace as optimizedDepthwise_cpu_forward()
+torch::Tensor optimizedPointwise_cpu_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    const torch::Tensor& scale,
+    const torch::Tensor& shift,
+    int activation,
+    torch::Tensor output,
+    DepthwiseCpuWorkspace* workspace) {
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+    int outputChannel = filter.size(0);
+
+	if (!output.defined()) {
+		output = torch::empty({inputBatchNumber, outputChannel, inputHeight, inputWidth}, input.options());
+	}
+
+    float alpha = 1.0f;
+	float beta = 0.0f;
+
+	DepthwiseEpilogue epilogue = depthwiseEpilogueOf(scale, shift, activation);
+
+	dispatchStorage(input, [&](auto* storage) {
+		typedef typename std::remove_pointer<decltype(storage)>::type storage_t;
+		CPU_Pointwise(
+			storageData<const storage_t>(input), storageData<const storage_t>(filter), storageData<storage_t>(output),
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			outputChannel,
+			alpha, beta, epilogue, workspace);
+	});
+
+	return output;
+}
+
+// Depthwise convolution backward on the host, both gradients in one pass over gradOutput
+std::vector<torch::Tensor> optimizedDepthwise_cpu_backward(
+    torch::Tensor gradOutput,
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    int dilation,
+    bool needsInputGrad,
+    bool needsFilterGrad) {
+
+	if (input.scalar_type() != torch::kFloat) {
+		std::vector<torch::Tensor> gradients = optimizedDepthwise_cpu_backward(floatTensor(gradOutput), floatTensor(input), floatTensor(filter),
+			filterHeight, stride, dilation, needsInputGrad, needsFilterGrad);
+		for (size_t i = 0; i < gradients.size(); i++) {
+			if (gradients[i].defined()) {
+				gradients[i] = gradients[i].to(input.scalar_type());
+			}
+		}
+		return gradients;
+	}
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+    int padding = dilation * (filterHeight - 1) / 2;
+    int outputHeight = (inputHeight + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+    int outputWidth = (inputWidth + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+
+	// undefined tensors for the gradients that are not needed, None on the Python side
+	torch::Tensor gradInput;
+	torch::Tensor gradFilter;
+	if (needsInputGrad) {
+		gradInput = torch::empty({inputBatchNumber, inputChannel, inputHeight, inputWidth}, input.options());
+	}
+	if (needsFilterGrad) {
+		gradFilter = torch::empty({inputChannel, 1, filterHeight, filterHeight}, filter.options());
+	}
+
+	CPU_DepthwiseBackward(
+		gradOutput.data_ptr<float>(), input.data_ptr<float>(), filter.data_ptr<float>(),
+		needsInputGrad ? gradInput.data_ptr<float>() : nullptr,
+		needsFilterGrad ? gradFilter.data_ptr<float>() : nullptr,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterHeight,
+		outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation);
+
+	return {gradInput, gradFilter};
+}
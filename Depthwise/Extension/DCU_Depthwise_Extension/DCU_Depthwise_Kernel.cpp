@@ -1,6 +1,12 @@
 #include <torch/extension.h>
+#include <ATen/hip/HIPContext.h>
+#include <ATen/hip/impl/HIPGuardImplMasqueradingAsCUDA.h>
 #include <hip/hip_runtime.h>
+#include <map>
+#include <mutex>
+#include <string>
 
+#include "DepthwiseEpilogue.h"
 #include "Filter3x3_Input7x7_Stride1.h"
 #include "Filter5x5_Input7x7_Stride1.h"
 #include "Filter3x3_Input14x14_Stride1.h"
@@ -15,13 +21,208 @@
 #include "Filter5x5_Input56x56_Stride2.h"
 #include "Filter3x3_Input112x112_Stride1.h"
 #include "Filter3x3_Input112x112_Stride2.h"
+#include "Depthwise_Generic.h"
+#include "Depthwise_Dilated.h"
+#include "Depthwise_NHWC.h"
+#include "Depthwise_RowRolling.h"
+#include "DepthwiseRegistry.h"
+#include "DepthwiseTuning.h"
+#include "DepthwisePointwise_Fused.h"
+#include "Pointwise_Tiled.h"
+#include "Depthwise_Backward.h"
+
+/*
+Launch table for the specialised kernels, indexed by DepthwiseKernelId.
+*/
+template <typename scalar_t>
+struct DepthwiseKernelTable {
+	typedef void (*Function)(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+		int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+		int filterLayerNumber, int filterHeight, int filterWidth,
+		int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+		int padding, int stride,
+		float alpha, float beta, DepthwiseEpilogue epilogue);
+	static const Function kernels[DepthwiseKernelNumber];
+};
+
+template <typename scalar_t>
+const typename DepthwiseKernelTable<scalar_t>::Function DepthwiseKernelTable<scalar_t>::kernels[DepthwiseKernelNumber] = {
+#define DEPTHWISE_KERNEL(name, ...) name<scalar_t>,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRolling<scalar_t, inputHeight, filterSize, stride, channelGroupSize>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+};
+
+/*
+Launch table of Depthwise_RowRollingRect for the rectangular inputs, [transposed][DepthwiseKernelId].
+*/
+template <typename scalar_t>
+struct DepthwiseRectKernelTable {
+	typedef typename DepthwiseKernelTable<scalar_t>::Function Function;
+	static const Function kernels[2][DepthwiseKernelNumber];
+};
+
+template <typename scalar_t>
+const typename DepthwiseRectKernelTable<scalar_t>::Function DepthwiseRectKernelTable<scalar_t>::kernels[2][DepthwiseKernelNumber] = {
+	{
+#define DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, ...) \
+	Depthwise_RowRollingRect<scalar_t, inputHeight, filterSize, stride, channelGroupSize, false>,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRollingRect<scalar_t, inputHeight, filterSize, stride, channelGroupSize, false>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	},
+	{
+#define DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, ...) \
+	Depthwise_RowRollingRect<scalar_t, inputHeight, filterSize, stride, channelGroupSize, true>,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRollingRect<scalar_t, inputHeight, filterSize, stride, channelGroupSize, true>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	}
+};
+
+// Epilogue parameters of the kernels from the (optional, undefined if absent) scale / shift tensors
+static DepthwiseEpilogue depthwiseEpilogueOf(const torch::Tensor& scale, const torch::Tensor& shift, int activation) {
+	DepthwiseEpilogue epilogue = depthwiseNoEpilogue;
+	epilogue.scale = scale.defined() ? scale.data_ptr<float>() : nullptr;
+	epilogue.shift = shift.defined() ? shift.data_ptr<float>() : nullptr;
+	epilogue.activation = activation;
+	return epilogue;
+}
+
+/*
+depthwiseDeviceFingerprint():
+	Tuning fingerprint of the current device, "dcu:<name>:<architecture>:cu<compute units>".
+*/
+static std::string depthwiseDeviceFingerprint() {
+	static std::mutex mutex;
+	static std::map<int, std::string> fingerprints;
+
+	int device = 0;
+	hipGetDevice(&device);
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<int, std::string>::const_iterator it = fingerprints.find(device);
+	if (it != fingerprints.end()) {
+		return it->second;
+	}
+	hipDeviceProp_t properties;
+	hipGetDeviceProperties(&properties, device);
+	char text[640];
+	snprintf(text, sizeof(text), "dcu:%s:%s:cu%d", properties.name, properties.gcnArchName, properties.multiProcessorCount);
+	return fingerprints[device] = depthwiseFingerprintToken(text);
+}
+
+/*
+depthwiseDeviceTuningCandidates():
+	The registry kernel (the default when there is one), Depthwise_RowRollingRect for a rectangular shape with a
+	kernel for its height or width, Depthwise_Dilated for the dilated shapes it covers, Depthwise_Generic with its
+	own tile, and Depthwise_Generic with the tiles of 64 to 256 threads that fit the output.
+*/
+static std::vector<DepthwiseTuningConfig> depthwiseDeviceTuningCandidates(const DepthwiseKernelEntry* kernelEntry,
+	const DepthwiseRectKernel* rectKernel, const ConvShape& shape, int outputHeight, int outputWidth) {
+
+	std::vector<DepthwiseTuningConfig> candidates;
+	if (kernelEntry) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantSpecialised, 0, 0, 0));
+	}
+	if (rectKernel) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantRectangular, 0, 0, 0));
+	}
+	if (depthwiseDilatedSupported(shape)) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantDilated, 0, 0, 0));
+	}
+	candidates.push_back(depthwiseTuningConfig(DepthwiseVariantGeneric, 0, 0, 0));
+	const int tiles[][2] = { {64, 4}, {32, 8}, {32, 4}, {16, 16}, {16, 8}, {8, 8} };
+	for (int i = 0; i < 6; i++) {
+		if (tiles[i][0] < 2 * outputWidth && tiles[i][1] < 2 * outputHeight) {
+			candidates.push_back(depthwiseTuningConfig(DepthwiseVariantGeneric, tiles[i][0], tiles[i][1], 0));
+		}
+	}
+	return candidates;
+}
+
+/*
+launchDepthwiseConfig():
+	Launch one tuning candidate of a NCHW forward on stream.
+*/
+template <typename scalar_t>
+static void launchDepthwiseConfig(const DepthwiseTuningConfig& config, const DepthwiseKernelEntry* kernelEntry,
+	const DepthwiseRectKernel* rectKernel,
+	const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride, int dilation,
+	float alpha, float beta, DepthwiseEpilogue epilogue, hipStream_t stream) {
+
+	if (config.variant == DepthwiseVariantSpecialised && kernelEntry) {
+		dim3 gridSize(outputBatchNumber, kernelEntry->gridHeight(outputChannel));
+		dim3 blockSize(kernelEntry->blockSize, 1);
+		auto kernel = DepthwiseKernelTable<scalar_t>::kernels[kernelEntry->id];
+		kernel <<<gridSize, blockSize, 0, stream >>> (
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterHeight,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			padding, stride,
+			alpha, beta, epilogue);
+	}
+	else if (config.variant == DepthwiseVariantRectangular && rectKernel) {
+		dim3 gridSize(outputBatchNumber, outputChannel / rectKernel->entry->channelGroupSize, rectKernel->tileNumber);
+		dim3 blockSize(rectKernel->blockSize, 1);
+		auto kernel = DepthwiseRectKernelTable<scalar_t>::kernels[rectKernel->transposed][rectKernel->entry->id];
+		kernel <<<gridSize, blockSize, 0, stream >>> (
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterHeight,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			padding, stride,
+			alpha, beta, epilogue);
+	}
+	else if (config.variant == DepthwiseVariantDilated) {
+		launchDepthwiseDilated(
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterHeight,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			padding, padding, stride, stride, dilation, dilation,
+			alpha, beta, epilogue, stream);
+	}
+	else {
+		launchDepthwiseGeneric(
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterHeight,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			padding, padding, stride, stride, dilation, dilation,
+			alpha, beta, epilogue, stream, config.tileWidth, config.tileHeight);
+	}
+}
 
 // Use Dispatch function to invoke kernel
+// The launch geometry comes from the autotuner (DepthwiseTuning.h), set DEPTHWISE_TUNING=0 for the registry defaults
+// scale / shift are optional (undefined tensor) per channel epilogue parameters, see DepthwiseEpilogue.h
+// output is the out= tensor of the caller, undefined to allocate one
+// dilation > 1 spreads the filter taps dilation pixels apart, the padding keeps the output size at input / stride
 torch::Tensor optimizedDepthwise_cuda_forward(
     torch::Tensor input,
     torch::Tensor filter,
     int filterHeight,
-    int stride) {
+    int stride,
+    int dilation,
+    const torch::Tensor& scale,
+    const torch::Tensor& shift,
+    int activation,
+    torch::Tensor output) {
+
+	// the input's device and the current PyTorch stream of that device, not the default stream
+	const at::hip::OptionalHIPGuardMasqueradingAsCUDA deviceGuard(input.device());
+	hipStream_t stream = at::hip::getCurrentHIPStreamMasqueradingAsCUDA();
 
     auto inputShape = input.sizes();
     auto filterShape = filter.sizes();
@@ -33,194 +234,281 @@ torch::Tensor optimizedDepthwise_cuda_forward(
 
 	int filterLayerNumber = inputChannel;
 
-    int paddingHeight = 0;
-    int paddingWidth = 0;
-	if(filterHeight == 3) {
-		paddingHeight = paddingWidth = 1;
-	} else if(filterHeight == 5) {
-		paddingHeight = paddingWidth = 2;
-	}
+    int paddingHeight = dilation * (filterHeight - 1) / 2;
+    int paddingWidth = paddingHeight;
 
     int outputBatchNumber = inputBatchNumber;
     int outputChannel = inputChannel;
-    int outputHeight = (inputHeight + paddingHeight * 2 - filterHeight) / stride + 1;
-    int outputWidth = (inputWidth + paddingWidth * 2 - filterHeight) / stride + 1;
+    int outputHeight = (inputHeight + paddingHeight * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+    int outputWidth = (inputWidth + paddingWidth * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+
+	if (!output.defined()) {
+		output = torch::empty({outputBatchNumber, outputChannel, outputHeight, outputWidth}, input.options());
+	}
 
-	torch::Tensor output = torch::empty({outputBatchNumber, outputChannel, outputHeight, outputWidth}, torch::kCUDA);
-	
     float alpha = 1.0f;
 	float beta = 0.0f;
 
-    AT_DISPATCH_FLOATING_TYPES(input.type(), "optimizedDepthwise_cuda_forward", [&] {
+	DepthwiseEpilogue epilogue = depthwiseEpilogueOf(scale, shift, activation);
 
-	if (stride == 1) {
-		if (filterHeight == 3) {
-			if (inputHeight == 7) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				Filter3x3_Input7x7_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 16);
-				dim3 blockSize(14 * 16, 1);
-				Filter3x3_Input14x14_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 28) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 8);
-				dim3 blockSize(28 * 8, 1);
-				Filter3x3_Input28x28_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 56) {
-				dim3 gridSize(outputBatchNumber, outputChannel);
-				dim3 blockSize(4 * 56, 1);
-				Filter3x3_Input56x56_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 112) {
-				dim3 gridSize(outputBatchNumber, outputChannel * 4);
-				dim3 blockSize(2 * 112, 1);
-				Filter3x3_Input112x112_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-		}
-		else if (filterHeight == 5) {
-			if (inputHeight == 7) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				Filter5x5_Input7x7_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 16);
-				dim3 blockSize(14 * 16, 1);
-				Filter5x5_Input14x14_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 28) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 8);
-				dim3 blockSize(28 * 8, 1);
-				Filter5x5_Input28x28_Stride1 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-		}
-	}
-	else if (stride == 2) {
-		if (filterHeight == 3) {
-			if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				Filter3x3_Input14x14_Stride2 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 28) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 8); // if channel group size = 16, shared memory exceeded.
-				dim3 blockSize(14 * 8, 1);
-				Filter3x3_Input28x28_Stride2 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 56) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 2);
-				dim3 blockSize(28 * 2, 1);
-				Filter3x3_Input56x56_Stride2 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 112) {
-				dim3 gridSize(outputBatchNumber, outputChannel * 2);
-				dim3 blockSize(56 * 4, 1);
-				Filter3x3_Input112x112_Stride2 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-		}
-		else if (filterHeight == 5) {
-			if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				Filter5x5_Input14x14_Stride2 <<<gridSize, blockSize >>> (
-					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-			else if (inputHeight == 56) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 2);
-				dim3 blockSize(28 * 2, 1);
-				Filter5x5_Input56x56_Stride2 <<<gridSize, blockSize >>> (
+    AT_DISPATCH_FLOATING_TYPES_AND2(at::ScalarType::Half, at::ScalarType::BFloat16, input.scalar_type(), "optimizedDepthwise_cuda_forward", [&] {
+
+	ConvShape shape(inputHeight, inputWidth, filterHeight, filterHeight,
+		paddingHeight, paddingWidth, stride, stride, dilation, dilation);
+	const DepthwiseKernelEntry* kernelEntry = findDepthwiseKernel(shape, inputChannel);
+	// a rectangular input runs the registry kernel of its height (or width), tiled along the other dimension
+	DepthwiseRectKernel rect;
+	const DepthwiseRectKernel* rectKernel = !kernelEntry && findDepthwiseRectKernel(shape, inputChannel, rect) ? &rect : nullptr;
+
+	// the registry kernel (of one dimension for a rectangular input), Depthwise_Dilated for a dilated shape it
+	// covers, or the generic one, unless the autotuner found a faster one
+	int defaultVariant = kernelEntry ? DepthwiseVariantSpecialised :
+		rectKernel ? DepthwiseVariantRectangular :
+		depthwiseDilatedSupported(shape) ? DepthwiseVariantDilated : DepthwiseVariantGeneric;
+	DepthwiseTuningConfig config = depthwiseTuningConfig(defaultVariant, 0, 0, 0);
+	if (depthwiseTuningEnabled()) {
+		std::string key = depthwiseTuningKey("dcu", (int)sizeof(scalar_t), outputBatchNumber, outputChannel, shape);
+		config = depthwiseTune(depthwiseTuningDatabase(), depthwiseDeviceFingerprint(), key,
+			depthwiseDeviceTuningCandidates(kernelEntry, rectKernel, shape, outputHeight, outputWidth),
+			[&](const DepthwiseTuningConfig& candidate) {
+				hipEvent_t start, stop;
+				hipEventCreate(&start);
+				hipEventCreate(&stop);
+				hipGetLastError();
+				hipEventRecord(start, stream);
+				launchDepthwiseConfig(candidate, kernelEntry, rectKernel,
 					input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
 					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterHeight,
+					filterLayerNumber, filterHeight,
 					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-			}
-		}
+					paddingWidth, stride, dilation,
+					alpha, beta, epilogue, stream);
+				hipEventRecord(stop, stream);
+				hipEventSynchronize(stop);
+				float milliseconds = -1.0f;
+				if (hipGetLastError() == hipSuccess) {
+					hipEventElapsedTime(&milliseconds, start, stop);
+				}
+				hipEventDestroy(start);
+				hipEventDestroy(stop);
+				return milliseconds;
+			});
 	}
+
+	launchDepthwiseConfig(config, kernelEntry, rectKernel,
+		input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingWidth, stride, dilation,
+		alpha, beta, epilogue, stream);
 	
 	});
 
 	return output;
 }
+
+// Channels last input, threads run across the channels of a pixel. The output is channels last too.
+torch::Tensor optimizedDepthwiseChannelsLast_cuda_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    int dilation,
+    const torch::Tensor& scale,
+    const torch::Tensor& shift,
+    int activation,
+    torch::Tensor output) {
+
+	const at::hip::OptionalHIPGuardMasqueradingAsCUDA deviceGuard(input.device());
+	hipStream_t stream = at::hip::getCurrentHIPStreamMasqueradingAsCUDA();
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+    int padding = dilation * (filterHeight - 1) / 2;
+    int outputHeight = (inputHeight + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+    int outputWidth = (inputWidth + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+
+	if (!output.defined()) {
+		output = torch::empty({inputBatchNumber, inputChannel, outputHeight, outputWidth},
+			input.options().memory_format(torch::MemoryFormat::ChannelsLast));
+	}
+
+	DepthwiseEpilogue epilogue = depthwiseEpilogueOf(scale, shift, activation);
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(at::ScalarType::Half, at::ScalarType::BFloat16, input.scalar_type(), "optimizedDepthwiseChannelsLast_cuda_forward", [&] {
+
+	launchDepthwiseNHWC(
+		input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue, stream);
+
+	});
+
+	return output;
+}
+
+// Fused depthwise separable block, the depthwise output stays in shared memory
+torch::Tensor optimizedDepthwisePointwise_cuda_forward(
+    torch::Tensor input,
+    torch::Tensor depthwiseFilter,
+    int filterHeight,
+    int stride,
+    torch::Tensor pointwiseFilter,
+    const torch::Tensor& depthwiseScale,
+    const torch::Tensor& depthwiseShift,
+    int depthwiseActivation,
+    const torch::Tensor& pointwiseScale,
+    const torch::Tensor& pointwiseShift,
+    int pointwiseActivation,
+    torch::Tensor output) {
+
+	const at::hip::OptionalHIPGuardMasqueradingAsCUDA deviceGuard(input.device());
+	hipStream_t stream = at::hip::getCurrentHIPStreamMasqueradingAsCUDA();
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+    int padding = (filterHeight - 1) / 2;
+    int outputChannel = pointwiseFilter.size(0);
+    int outputHeight = (inputHeight + padding * 2 - filterHeight) / stride + 1;
+    int outputWidth = (inputWidth + padding * 2 - filterHeight) / stride + 1;
+
+	if (!output.defined()) {
+		output = torch::empty({inputBatchNumber, outputChannel, outputHeight, outputWidth}, input.options());
+	}
+
+	DepthwiseEpilogue depthwiseEpilogue = depthwiseEpilogueOf(depthwiseScale, depthwiseShift, depthwiseActivation);
+	DepthwiseEpilogue pointwiseEpilogue = depthwiseEpilogueOf(pointwiseScale, pointwiseShift, pointwiseActivation);
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(at::ScalarType::Half, at::ScalarType::BFloat16, input.scalar_type(), "optimizedDepthwisePointwise_cuda_forward", [&] {
+
+	launchDepthwisePointwise(
+		input.data_ptr<scalar_t>(), depthwiseFilter.data_ptr<scalar_t>(), pointwiseFilter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterHeight,
+		outputChannel, outputHeight, outputWidth,
+		padding, stride,
+		depthwiseEpilogue, pointwiseEpilogue, stream);
+
+	});
+
+	return output;
+}
+
+// Pointwise (1 x 1) convolution, shared memory tiled GEMM
+torch::Tensor optimizedPointwise_cuda_forward(
+    torch::Tensor input,
+    torch::Tensor filter,
+    const torch::Tensor& scale,
+    const torch::Tensor& shift,
+    int activation,
+    torch::Tensor output) {
+
+	const at::hip::OptionalHIPGuardMasqueradingAsCUDA deviceGuard(input.device());
+	hipStream_t stream = at::hip::getCurrentHIPStreamMasqueradingAsCUDA();
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+    int outputChannel = filter.size(0);
+
+	if (!output.defined()) {
+		output = torch::empty({inputBatchNumber, outputChannel, inputHeight, inputWidth}, input.options());
+	}
+
+    float alpha = 1.0f;
+	float beta = 0.0f;
+
+	DepthwiseEpilogue epilogue = depthwiseEpilogueOf(scale, shift, activation);
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(at::ScalarType::Half, at::ScalarType::BFloat16, input.scalar_type(), "optimizedPointwise_cuda_forward", [&] {
+
+	launchPointwise(
+		input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(), output.data_ptr<scalar_t>(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		outputChannel,
+		alpha, beta, epilogue, stream);
+
+	});
+
+	return output;
+}
+
+// Depthwise convolution backward, both gradients in one pass over gradOutput
+std::vector<torch::Tensor> optimizedDepthwise_cuda_backward(
+    torch::Tensor gradOutput,
+    torch::Tensor input,
+    torch::Tensor filter,
+    int filterHeight,
+    int stride,
+    int dilation,
+    bool needsInputGrad,
+    bool needsFilterGrad) {
+
+	const at::hip::OptionalHIPGuardMasqueradingAsCUDA deviceGuard(input.device());
+	hipStream_t stream = at::hip::getCurrentHIPStreamMasqueradingAsCUDA();
+
+    auto inputShape = input.sizes();
+
+    int inputBatchNumber = inputShape[0];
+    int inputChannel = inputShape[1];
+    int inputHeight = inputShape[2];
+    int inputWidth = inputShape[3];
+
+    int padding = dilation * (filterHeight - 1) / 2;
+    int outputHeight = (inputHeight + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+    int outputWidth = (inputWidth + padding * 2 - dilation * (filterHeight - 1) - 1) / stride + 1;
+
+	// undefined tensors for the gradients that are not needed, None on the Python side
+	torch::Tensor gradInput;
+	torch::Tensor gradFilter;
+	if (needsInputGrad) {
+		gradInput = torch::empty({inputBatchNumber, inputChannel, inputHeight, inputWidth}, input.options());
+	}
+	if (needsFilterGrad) {
+		gradFilter = torch::empty({inputChannel, 1, filterHeight, filterHeight}, filter.options());
+	}
+
+	// per (batch, band) grad_weight partials, reduced per channel by a second kernel
+	torch::Tensor workspace;
+	if (needsFilterGrad) {
+		int64_t workspaceSize = depthwiseBackwardWorkspaceSize(inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterHeight, filterHeight,
+			outputHeight, outputWidth,
+			padding, padding, stride, stride, dilation, dilation);
+		workspace = torch::empty({workspaceSize}, input.options().dtype(torch::kFloat));
+	}
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(at::ScalarType::Half, at::ScalarType::BFloat16, input.scalar_type(), "optimizedDepthwise_cuda_backward", [&] {
+
+	launchDepthwiseBackward(
+		gradOutput.data_ptr<scalar_t>(), input.data_ptr<scalar_t>(), filter.data_ptr<scalar_t>(),
+		needsInputGrad ? gradInput.data_ptr<scalar_t>() : nullptr,
+		needsFilterGrad ? gradFilter.data_ptr<scalar_t>() : nullptr,
+		needsFilterGrad ? workspace.data_ptr<float>() : nullptr,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterHeight,
+		outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		stream);
+
+	});
+
+	return {gradInput, gradFilter};
+}
@@ -1,5 +1,6 @@
 // !!! This is a file automatically generated by hipify!!!
 #include "hip/hip_runtime.h"
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -15,7 +16,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const scalar_t* __restrict__ inpu
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// filter is 3 x 3. 9 elements in total
 	__shared__ float filterData[9];
@@ -83,6 +84,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const scalar_t* __restrict__ inpu
 		(blockIdx.y / blockGroup) * outputHeight * outputWidth +
 		(blockIdx.y & 3) * (outputHeight / blockGroup) * outputWidth +
 		(threadIdx.x / outputWidth) * 14 * outputWidth + threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / inputWidth) * 14 * paddedWidth + threadIdx.x % inputWidth;
 	int inputAccessOffset = 0;
@@ -121,7 +123,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const scalar_t* __restrict__ inpu
 		sum1 = sum1 + filterData[5] * intemp2;
 		sum2 = sum2 + filterData[2] * intemp2;
 
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += outputWidth;
 
 		inputAccessOffset += paddedWidth;
@@ -138,7 +140,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const scalar_t* __restrict__ inpu
 		sum2 = sum2 + filterData[5] * intemp2;
 		sum0 = sum0 + filterData[2] * intemp2;
 
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += outputWidth;
 
 		inputAccessOffset += paddedWidth;
@@ -155,7 +157,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const scalar_t* __restrict__ inpu
 		sum0 = sum0 + filterData[5] * intemp2;
 		sum1 = sum1 + filterData[2] * intemp2;
 
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += outputWidth;
 	}
 
@@ -170,7 +172,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const scalar_t* __restrict__ inpu
 	sum0 = sum0 + filterData[8] * intemp2;
 	sum1 = sum1 + filterData[5] * intemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += inputWidth;
 
 	inputAccessOffset += paddedWidth;
@@ -181,5 +183,5 @@ __global__ void Filter3x3_Input112x112_Stride1(const scalar_t* __restrict__ inpu
 	intemp2 = inputData[inputAccessBase + inputAccessOffset + 2];
 	sum1 = sum1 + filterData[8] * intemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 }
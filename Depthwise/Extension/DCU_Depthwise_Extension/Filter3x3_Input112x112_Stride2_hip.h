@@ -1,5 +1,6 @@
 // !!! This is a file automatically generated by hipify!!!
 #include "hip/hip_runtime.h"
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -15,7 +16,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// filter is 3 x 3. 9 elements in total
 	__shared__ float filterData[9];
@@ -82,6 +83,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 		(blockIdx.y & 1) * (outputHeight / blockGroup) * outputWidth +
 		(threadIdx.x / outputWidth) * 7 * outputWidth + 
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * 14 * paddedWidth + threadIdx.x % outputWidth * 2;
 	int inputAccessOffset = 0;
@@ -115,7 +117,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	sum0 = sum0 + filterData[8] * intemp2;
 	sum1 = sum1 + filterData[2] * intemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// row 3
@@ -139,7 +141,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	sum0 = sum0 + filterData[2] * intemp2;
 	sum1 = sum1 + filterData[8] * intemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// row 5
@@ -163,7 +165,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	sum0 = sum0 + filterData[8] * intemp2;
 	sum1 = sum1 + filterData[2] * intemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// row 7
@@ -187,7 +189,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	sum1 = sum1 + filterData[8] * intemp2;
 	sum0 = sum0 + filterData[2] * intemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// row 9
@@ -211,7 +213,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	sum0 = sum0 + filterData[8] * intemp2;
 	sum1 = sum1 + filterData[2] * intemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// row 11
@@ -235,7 +237,7 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	sum1 = sum1 + filterData[8] * intemp2;
 	sum0 = sum0 + filterData[2] * intemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// row 13
@@ -256,5 +258,5 @@ __global__ void Filter3x3_Input112x112_Stride2(const scalar_t* __restrict__ inpu
 	intemp2 = inputData[inputAccessBase + inputAccessOffset + 2];
 	sum0 = sum0 + filterData[8] * intemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 }
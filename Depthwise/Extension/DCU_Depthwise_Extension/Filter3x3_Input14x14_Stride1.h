@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -15,7 +16,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 16 channels is a group.
 	__shared__ float filterData[16 * 9];	// filter is 3 x 3 = 9
@@ -67,6 +68,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % inputWidth;
 	int filterAccessBase = (threadIdx.x / inputWidth) * filterHeight * filterWidth;
@@ -109,7 +111,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 3rd row
@@ -133,7 +135,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 4th row
@@ -157,7 +159,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 5th row
@@ -181,7 +183,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 6th row
@@ -205,7 +207,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 7th row
@@ -229,7 +231,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 8th row
@@ -253,7 +255,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 9th row
@@ -277,7 +279,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 10th row
@@ -301,7 +303,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 11st row
@@ -325,7 +327,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 12nd row
@@ -349,7 +351,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 13rd row
@@ -373,7 +375,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 14th row
@@ -393,8 +395,8 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 }
@@ -1,5 +1,6 @@
 // !!! This is a file automatically generated by hipify!!!
 #include "hip/hip_runtime.h"
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -17,7 +18,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 16 channels is a group.
 	__shared__ float filterData[16 * 9];	// filter is 3 x 3 = 9
@@ -69,6 +70,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % inputWidth;
 	int filterAccessBase = (threadIdx.x / inputWidth) * filterHeight * filterWidth;
@@ -111,7 +113,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 3rd row
@@ -135,7 +137,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 4th row
@@ -159,7 +161,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 5th row
@@ -183,7 +185,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 6th row
@@ -207,7 +209,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 7th row
@@ -231,7 +233,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 8th row
@@ -255,7 +257,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 9th row
@@ -279,7 +281,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 10th row
@@ -303,7 +305,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 11st row
@@ -327,7 +329,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 12nd row
@@ -351,7 +353,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 13rd row
@@ -375,7 +377,7 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 14th row
@@ -395,8 +397,8 @@ __global__ void Filter3x3_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 }
@@ -1,5 +1,6 @@
 // !!! This is a file automatically generated by hipify!!!
 #include "hip/hip_runtime.h"
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -15,7 +16,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 32 channels is a group.
 	__shared__ float filterData[32 * 9];	// filter is 3 x 3 = 9
@@ -84,6 +85,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	int outputIdx = blockIdx.x * outputChannel * outputHeight * outputWidth +
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth + threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth * 2;
 	int filterAccessBase = (threadIdx.x / outputWidth) * filterHeight * filterWidth;
@@ -119,7 +121,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 3rd row
@@ -154,7 +156,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 5th row
@@ -189,7 +191,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 7th row
@@ -224,7 +226,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 9th row
@@ -259,7 +261,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 11st row
@@ -294,7 +296,7 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 13rd row
@@ -325,5 +327,5 @@ __global__ void Filter3x3_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	inTemp2 = inputData[inputAccessBase + inputAccessOffset + 2];
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 }
@@ -1,5 +1,6 @@
 // !!! This is a file automatically generated by hipify!!!
 #include "hip/hip_runtime.h"
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -15,7 +16,7 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 8 channels is a group.
 	__shared__ float filterData[8 * 9];	// filter is 3 x 3 = 9
@@ -81,6 +82,7 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth;
 	int filterAccessBase = (threadIdx.x / inputWidth) * filterHeight * filterWidth;
@@ -125,7 +127,7 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 		sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 3rd row
@@ -149,7 +151,7 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 		sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 4th row, 7th row
@@ -173,7 +175,7 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 		sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += outputWidth;
 	}
 
@@ -194,7 +196,7 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 27th row
@@ -214,7 +216,7 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 28th row
@@ -231,8 +233,8 @@ __global__ void Filter3x3_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 8] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 }
@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -14,7 +15,7 @@ __global__ void Filter3x3_Input28x28_Stride2(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 8 channels is a group.
 	__shared__ float filterData[8 * 9];	// filter is 3 x 3 = 9
@@ -58,6 +59,7 @@ __global__ void Filter3x3_Input28x28_Stride2(const scalar_t* __restrict__ input,
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth * 2;
 	int filterAccessBase = (threadIdx.x / outputWidth) * filterHeight * filterWidth;
@@ -92,7 +94,7 @@ __global__ void Filter3x3_Input28x28_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	#pragma unroll
@@ -127,7 +129,7 @@ __global__ void Filter3x3_Input28x28_Stride2(const scalar_t* __restrict__ input,
 		sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 		sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 5th row
@@ -160,7 +162,7 @@ __global__ void Filter3x3_Input28x28_Stride2(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 		sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += outputWidth;
 	}
 
@@ -190,6 +192,6 @@ __global__ void Filter3x3_Input28x28_Stride2(const scalar_t* __restrict__ input,
 	inTemp2 = inputData[inputAccessBase + inputAccessOffset + 2];
 	sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 }
@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -12,7 +13,7 @@ __global__ void Filter3x3_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	__shared__ float filterData[2 * 9];	// filter is 3 x 3 = 9
 	__shared__ float inputData[2 * 56 * 58]; // original input is 56 x 56, padded to be 58 x 58. ignore up and bottom padding, so 56 x 58
@@ -56,6 +57,7 @@ __global__ void Filter3x3_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	int outputIdx = blockIdx.x * outputChannel * outputHeight * outputWidth +
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth + threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth * 2;
 	int filterAccessBase = (threadIdx.x / outputWidth) * filterHeight * filterWidth;
@@ -90,7 +92,7 @@ __global__ void Filter3x3_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	#pragma unroll
@@ -125,7 +127,7 @@ __global__ void Filter3x3_Input56x56_Stride2(const scalar_t* __restrict__ input,
 		sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 		sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 5th row
@@ -158,7 +160,7 @@ __global__ void Filter3x3_Input56x56_Stride2(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 		sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += outputWidth;
 	}
 
@@ -188,6 +190,6 @@ __global__ void Filter3x3_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	inTemp2 = inputData[inputAccessBase + inputAccessOffset + 2];
 	sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 }
@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -14,7 +15,7 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 32 channels is a group.
 	__shared__ float filterData[32 * 9];	// filter is 3 x 3 = 9
@@ -61,6 +62,7 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth;
 	int filterAccessBase = (threadIdx.x / outputWidth) * filterHeight * filterWidth;
@@ -103,7 +105,7 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 3rd row
@@ -127,7 +129,7 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 4th row
@@ -151,7 +153,7 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 5th row
@@ -175,7 +177,7 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 	sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 6th row
@@ -199,7 +201,7 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 7th row
@@ -219,8 +221,8 @@ __global__ void Filter3x3_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum2 = sum2 + filterData[filterAccessBase + 8] * inTemp2;
 	sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 }
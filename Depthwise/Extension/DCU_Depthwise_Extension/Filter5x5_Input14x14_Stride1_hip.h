@@ -1,5 +1,6 @@
 // !!! This is a file automatically generated by hipify!!!
 #include "hip/hip_runtime.h"
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -17,7 +18,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 16 channels is a group.
 	__shared__ float filterData[16 * 25];	// filter is 5 x 5 = 25
@@ -73,6 +74,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth;
 	int filterAccessBase = (threadIdx.x / inputWidth) * filterHeight * filterWidth;
@@ -189,7 +191,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 		sum3 = sum3 + filterData[filterAccessBase + 9] * inTemp4;
 		sum4 = sum4 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 4th row, 9th row
@@ -234,7 +236,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		sum3 = sum3 + filterData[filterAccessBase + 14] * inTemp4;
 		sum4 = sum4 + filterData[filterAccessBase + 9] * inTemp4;
 		sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 5th row, 10th row
@@ -280,7 +282,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 9] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
 
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 6th row, 11th row
@@ -325,7 +327,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 9] * inTemp4;
 		sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum3 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum3 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 7th row, 12th row
@@ -370,7 +372,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 		sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 		sum2 = sum2 + filterData[filterAccessBase + 9] * inTemp4;
 		sum3 = sum3 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum4 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum4 * alpha + beta);
 		outputIdx += outputWidth;
 	}
 
@@ -411,7 +413,7 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum3 = sum3 + filterData[filterAccessBase + 9] * inTemp4;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 14th row
@@ -445,11 +447,11 @@ __global__ void Filter5x5_Input14x14_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 19] * inTemp4;
 	sum3 = sum3 + filterData[filterAccessBase + 14] * inTemp4;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum3 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum3 * alpha + beta);
 }
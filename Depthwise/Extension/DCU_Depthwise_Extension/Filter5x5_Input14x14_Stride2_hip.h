@@ -1,5 +1,6 @@
 // !!! This is a file automatically generated by hipify!!!
 #include "hip/hip_runtime.h"
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -15,7 +16,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 32 channels is a group.
 	__shared__ float filterData[32 * 25];	// filter is 5 x 5 = 25
@@ -95,6 +96,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth * 2;
 	int filterAccessBase = (threadIdx.x / outputWidth) * filterHeight * filterWidth;
@@ -179,7 +181,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 4th row
@@ -238,7 +240,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 6th row
@@ -296,7 +298,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 24] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 8th row
@@ -354,7 +356,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 10th row
@@ -413,7 +415,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 12th row
@@ -466,7 +468,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 24] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 14th row
@@ -488,6 +490,6 @@ __global__ void Filter5x5_Input14x14_Stride2(const scalar_t* __restrict__ input,
 	inTemp4 = inputData[inputAccessBase + 4 + inputAccessOffset];
 	sum0 = sum0 + filterData[filterAccessBase + 19] * inTemp4;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 }
@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -13,7 +14,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 8 channels is a group.
 	__shared__ float filterData[8 * 25];	// filter is 5 x 5 = 25
@@ -81,6 +82,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 
 	// convolution
 	int outputIdx = inputLoadIdxBase + (threadIdx.x / inputWidth) * inputHeight * inputWidth + threadIdx.x % inputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / inputWidth) * paddedWidth * inputHeight + threadIdx.x % inputWidth;
 	int filterAccessBase = (threadIdx.x / inputWidth) * filterHeight * filterWidth;
@@ -196,7 +198,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 		sum3 = sum3 + filterData[filterAccessBase + 9] * inTemp4;
 		sum4 = sum4 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 4th row
@@ -241,7 +243,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum3 = sum3 + filterData[filterAccessBase + 14] * inTemp4;
 		sum4 = sum4 + filterData[filterAccessBase + 9] * inTemp4;
 		sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 5th row
@@ -287,7 +289,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 9] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
 
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 6th row
@@ -332,7 +334,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 9] * inTemp4;
 		sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum3 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum3 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 7th row
@@ -377,7 +379,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 		sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 		sum2 = sum2 + filterData[filterAccessBase + 9] * inTemp4;
 		sum3 = sum3 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum4 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum4 * alpha + beta);
 		outputIdx += inputWidth;
 	}
 
@@ -417,7 +419,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum3 = sum3 + filterData[filterAccessBase + 9] * inTemp4;
 	sum4 = sum4 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 24th row
@@ -456,7 +458,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum3 = sum3 + filterData[filterAccessBase + 14] * inTemp4;
 	sum4 = sum4 + filterData[filterAccessBase + 9] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 25th row
@@ -496,7 +498,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 9] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 26th row
@@ -535,7 +537,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 9] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum3 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum3 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 27th row
@@ -569,7 +571,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 19] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 9] * inTemp4;
-	output[outputIdx] = sum4 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum4 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 28th row
@@ -598,12 +600,12 @@ __global__ void Filter5x5_Input28x28_Stride1(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 19] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += inputWidth;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += inputWidth;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += inputWidth;
 }
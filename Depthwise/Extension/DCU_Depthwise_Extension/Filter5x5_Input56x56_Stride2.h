@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -12,7 +13,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	__shared__ float filterData[2 * 25];	// filter is 5 x 5 = 25
 	__shared__ float inputData[2 * 56 * 60]; // original input is 56 x 56, padded to be 60 x 60. ignore up and bottom padding, so 56 x 60
@@ -62,6 +63,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	int outputIdx = blockIdx.x * outputChannel * outputHeight * outputWidth +
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth + threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth * 2;
 	int filterAccessBase = (threadIdx.x / outputWidth) * filterHeight * filterWidth;
@@ -148,7 +150,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 		sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 		sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 4th row
@@ -207,7 +209,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 		sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 		sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
 
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 6th row
@@ -265,7 +267,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 		sum2 = sum2 + filterData[filterAccessBase + 24] * inTemp4;
 		sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += outputWidth;
 
 		// 8th row, 50th row
@@ -325,7 +327,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 52nd row
@@ -384,7 +386,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 54th row
@@ -436,7 +438,7 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 	inTemp4 = inputData[inputAccessBase + 4 + inputAccessOffset];
 	sum2 = sum2 + filterData[filterAccessBase + 24] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 56th row
@@ -457,5 +459,5 @@ __global__ void Filter5x5_Input56x56_Stride2(const scalar_t* __restrict__ input,
 
 	inTemp4 = inputData[inputAccessBase + 4 + inputAccessOffset];
 	sum0 = sum0 + filterData[filterAccessBase + 19] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 }
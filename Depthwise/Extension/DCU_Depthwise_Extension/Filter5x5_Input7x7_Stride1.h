@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -13,7 +14,7 @@ __global__ void Filter5x5_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 32 channels is a group.
 	__shared__ float filterData[32 * 25];	// filter is 5 x 5 = 25
@@ -63,6 +64,7 @@ __global__ void Filter5x5_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / inputWidth) * paddedWidth * inputHeight + threadIdx.x % inputWidth;
 	int filterAccessBase = (threadIdx.x / inputWidth) * filterHeight * filterWidth;
@@ -177,7 +179,7 @@ __global__ void Filter5x5_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum3 = sum3 + filterData[filterAccessBase + 9] * inTemp4;
 	sum4 = sum4 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 4th row
@@ -222,7 +224,7 @@ __global__ void Filter5x5_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum3 = sum3 + filterData[filterAccessBase + 14] * inTemp4;
 	sum4 = sum4 + filterData[filterAccessBase + 9] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 5th row
@@ -268,7 +270,7 @@ __global__ void Filter5x5_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum0 = sum0 + filterData[filterAccessBase + 9] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 6th row
@@ -308,7 +310,7 @@ __global__ void Filter5x5_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 9] * inTemp4;
 
-	output[outputIdx] = sum3 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum3 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 7th row
@@ -342,11 +344,11 @@ __global__ void Filter5x5_Input7x7_Stride1(const scalar_t* __restrict__ input, c
 	sum0 = sum0 + filterData[filterAccessBase + 19] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 
-	output[outputIdx] = sum4 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum4 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 }
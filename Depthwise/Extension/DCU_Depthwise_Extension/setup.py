@@ -1,6 +1,10 @@
+import os
 from setuptools import setup
 from torch.utils.cpp_extension import BuildExtension, CUDAExtension
 
+# Host side headers (CPU backend) are shared with the kernel benchmark
+kernelDir = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', 'Kernel'))
+
 setup(
     name='optimizedDepthwise',
     version="1.0",
@@ -8,11 +12,14 @@ setup(
     description="Optimized Depthwise Convolution Implementations for MobileNet V2 and EfficientNet B0",
     author_email="",
     keywords="Deep Learning Depthwise Separable Convolution",
-    
+
     ext_modules=[
         CUDAExtension(
-            name='optimizedDepthwise_cuda', 
-            sources=['DCU_Depthwise.cpp','DCU_Depthwise_Kernel.hip'])
+            name='optimizedDepthwise_cuda',
+            sources=['DCU_Depthwise.cpp','DCU_Depthwise_CPU.cpp','DCU_Depthwise_Kernel.hip'],
+            include_dirs=[kernelDir],
+            extra_compile_args={'cxx': ['-O3', '-march=native', '-fopenmp'], 'nvcc': ['-O3']},
+            extra_link_args=['-fopenmp'])
     ],
     cmdclass={'build_ext': BuildExtension}
 )
@@ -0,0 +1,578 @@
+#pragma once
+/*
+Depthwise Convolution on CPU.
+
+Host backend for the depthwise convolution layers of MobileNet V2 and EfficientNet B0.
+CPU_Depthwise() takes exactly the same arguments as the DCU kernels (Filter*_Input*_Stride*),
+so a host without a DCU can serve every shape in the kernel set.
+
+	1)	filter 3 x 3 and 5 x 5, stride 1 and 2 use SIMD row kernels (AVX-512, AVX2 or scalar,
+		selected at compile time, build with -march=native to get the widest one), and so do the dilated
+		(atrous) 3 x 3 and 5 x 5 filters with dilation 2 or 4 at stride 1
+	2)	every other filter size / stride / padding / dilation goes through a scalar row kernel
+		(CPU_Depthwise_Generic)
+	3)	work is split across cores by (batch, channel) with OpenMP (build with -fopenmp), or by
+		(batch, channel, band of rows) with CPU_Depthwise_Scheduled()
+	4)	the bias / BatchNorm / activation epilogue (DepthwiseEpilogue.h) is applied to each output row
+		right after it is computed
+	5)	input / filter / output can be float, fp16 or bf16 (DepthwiseHalf.h); 16-bit values are widened
+		when the plane is padded and rounded when the row is stored, the arithmetic is always fp32
+
+Every (batch, channel) plane (or the rows of it a band reads) is first copied into a zero padded scratch
+plane, so the row kernels never need to check the borders.
+*/
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "DepthwiseEpilogue.h"
+#include "DepthwiseHalf.h"
+#include "CPU_DepthwiseWorkspace.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+SIMD helpers.
+cpuVector holds CPU_VECTOR_WIDTH floats. cpuVectorLoadStride2() gathers every second float,
+which is what a stride 2 row needs.
+*/
+#if defined(__AVX512F__)
+#define CPU_VECTOR_WIDTH 16
+typedef __m512 cpuVector;
+
+inline cpuVector cpuVectorSet(float value) { return _mm512_set1_ps(value); }
+inline cpuVector cpuVectorZero() { return _mm512_setzero_ps(); }
+inline cpuVector cpuVectorLoad(const float* src) { return _mm512_loadu_ps(src); }
+inline void cpuVectorStore(float* dst, cpuVector value) { _mm512_storeu_ps(dst, value); }
+inline cpuVector cpuVectorFmadd(cpuVector a, cpuVector b, cpuVector c) { return _mm512_fmadd_ps(a, b, c); }
+inline cpuVector cpuVectorAdd(cpuVector a, cpuVector b) { return _mm512_add_ps(a, b); }
+inline cpuVector cpuVectorSub(cpuVector a, cpuVector b) { return _mm512_sub_ps(a, b); }
+inline cpuVector cpuVectorMul(cpuVector a, cpuVector b) { return _mm512_mul_ps(a, b); }
+inline cpuVector cpuVectorMax(cpuVector a, cpuVector b) { return _mm512_max_ps(a, b); }
+inline cpuVector cpuVectorMin(cpuVector a, cpuVector b) { return _mm512_min_ps(a, b); }
+inline cpuVector cpuVectorLoadStride2(const float* src) {
+	const __m512i evenIdx = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+	return _mm512_permutex2var_ps(_mm512_loadu_ps(src), evenIdx, _mm512_loadu_ps(src + 16));
+}
+#elif defined(__AVX2__)
+#define CPU_VECTOR_WIDTH 8
+typedef __m256 cpuVector;
+
+inline cpuVector cpuVectorSet(float value) { return _mm256_set1_ps(value); }
+inline cpuVector cpuVectorZero() { return _mm256_setzero_ps(); }
+inline cpuVector cpuVectorLoad(const float* src) { return _mm256_loadu_ps(src); }
+inline void cpuVectorStore(float* dst, cpuVector value) { _mm256_storeu_ps(dst, value); }
+#ifdef __FMA__
+inline cpuVector cpuVectorFmadd(cpuVector a, cpuVector b, cpuVector c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+inline cpuVector cpuVectorFmadd(cpuVector a, cpuVector b, cpuVector c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+inline cpuVector cpuVectorAdd(cpuVector a, cpuVector b) { return _mm256_add_ps(a, b); }
+inline cpuVector cpuVectorSub(cpuVector a, cpuVector b) { return _mm256_sub_ps(a, b); }
+inline cpuVector cpuVectorMul(cpuVector a, cpuVector b) { return _mm256_mul_ps(a, b); }
+inline cpuVector cpuVectorMax(cpuVector a, cpuVector b) { return _mm256_max_ps(a, b); }
+inline cpuVector cpuVectorMin(cpuVector a, cpuVector b) { return _mm256_min_ps(a, b); }
+inline cpuVector cpuVectorLoadStride2(const float* src) {
+	// shuffle gives a0 a2 b0 b2 | a4 a6 b4 b6, permute puts the 64-bit pairs back in order
+	__m256 even = _mm256_shuffle_ps(_mm256_loadu_ps(src), _mm256_loadu_ps(src + 8), 0x88);
+	return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even), 0xD8));
+}
+#else
+#define CPU_VECTOR_WIDTH 1
+typedef float cpuVector;
+
+inline cpuVector cpuVectorSet(float value) { return value; }
+inline cpuVector cpuVectorZero() { return 0.0f; }
+inline cpuVector cpuVectorLoad(const float* src) { return *src; }
+inline void cpuVectorStore(float* dst, cpuVector value) { *dst = value; }
+inline cpuVector cpuVectorFmadd(cpuVector a, cpuVector b, cpuVector c) { return a * b + c; }
+inline cpuVector cpuVectorAdd(cpuVector a, cpuVector b) { return a + b; }
+inline cpuVector cpuVectorSub(cpuVector a, cpuVector b) { return a - b; }
+inline cpuVector cpuVectorMul(cpuVector a, cpuVector b) { return a * b; }
+inline cpuVector cpuVectorMax(cpuVector a, cpuVector b) { return a > b ? a : b; }
+inline cpuVector cpuVectorMin(cpuVector a, cpuVector b) { return a < b ? a : b; }
+inline cpuVector cpuVectorLoadStride2(const float* src) { return *src; }
+#endif
+
+template <int Stride>
+inline cpuVector cpuVectorLoadStrided(const float* src) {
+	return Stride == 1 ? cpuVectorLoad(src) : cpuVectorLoadStride2(src);
+}
+
+/*
+Storage conversion.
+cpuDepthwiseLoad() widens n values to float, cpuDepthwiseStore() rounds n floats back to the storage type.
+fp16 uses the AVX-512 / F16C conversion instructions, bf16 is a 16 bit shift on load; the rest is scalar.
+*/
+inline void cpuDepthwiseLoad(const float* src, float* dst, int n) {
+	std::memcpy(dst, src, n * sizeof(float));
+}
+
+inline void cpuDepthwiseLoad(const DepthwiseHalf* src, float* dst, int n) {
+	int i = 0;
+#if defined(__AVX512F__)
+	for (; i + 16 <= n; i += 16) {
+		_mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(src + i))));
+	}
+#elif defined(__F16C__)
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+	}
+#endif
+	for (; i < n; i++) {
+		dst[i] = depthwiseToFloat(src[i]);
+	}
+}
+
+inline void cpuDepthwiseLoad(const DepthwiseBFloat16* src, float* dst, int n) {
+	int i = 0;
+#if defined(__AVX512F__)
+	for (; i + 16 <= n; i += 16) {
+		__m512i wide = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(src + i)));
+		_mm512_storeu_ps(dst + i, _mm512_castsi512_ps(_mm512_slli_epi32(wide, 16)));
+	}
+#elif defined(__AVX2__)
+	for (; i + 8 <= n; i += 8) {
+		__m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+		_mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16)));
+	}
+#endif
+	for (; i < n; i++) {
+		dst[i] = depthwiseToFloat(src[i]);
+	}
+}
+
+inline void cpuDepthwiseStore(const float* src, float* dst, int n) {
+	if (src != dst) {
+		std::memcpy(dst, src, n * sizeof(float));
+	}
+}
+
+inline void cpuDepthwiseStore(const float* src, DepthwiseHalf* dst, int n) {
+	int i = 0;
+#if defined(__AVX512F__)
+	for (; i + 16 <= n; i += 16) {
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+#elif defined(__F16C__)
+	for (; i + 8 <= n; i += 8) {
+		_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+#endif
+	for (; i < n; i++) {
+		dst[i] = depthwiseFromFloat<DepthwiseHalf>(src[i]);
+	}
+}
+
+inline void cpuDepthwiseStore(const float* src, DepthwiseBFloat16* dst, int n) {
+	int i = 0;
+#if defined(__AVX512F__)
+	// round to nearest even on the integer bits, NaN is kept quiet
+	const __m512i roundingBias = _mm512_set1_epi32(0x7FFF);
+	const __m512i one = _mm512_set1_epi32(1);
+	for (; i + 16 <= n; i += 16) {
+		__m512 value = _mm512_loadu_ps(src + i);
+		__m512i bits = _mm512_castps_si512(value);
+		__m512i rounded = _mm512_add_epi32(bits, _mm512_add_epi32(roundingBias, _mm512_and_si512(_mm512_srli_epi32(bits, 16), one)));
+		rounded = _mm512_srli_epi32(rounded, 16);
+		__mmask16 nan = _mm512_cmp_ps_mask(value, value, _CMP_UNORD_Q);
+		rounded = _mm512_mask_mov_epi32(rounded, nan, _mm512_or_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(0x0040)));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtepi32_epi16(rounded));
+	}
+#endif
+	for (; i < n; i++) {
+		dst[i] = depthwiseFromFloat<DepthwiseBFloat16>(src[i]);
+	}
+}
+
+/*
+cpuDepthwiseFloatData():
+	float data as it is, 16-bit data widened into storage.
+*/
+inline const float* cpuDepthwiseFloatData(const float* data, size_t n, std::vector<float>& storage) {
+	return data;
+}
+
+template <typename scalar_t>
+inline const float* cpuDepthwiseFloatData(const scalar_t* data, size_t n, std::vector<float>& storage) {
+	storage.resize(n);
+	cpuDepthwiseLoad(data, storage.data(), (int)n);
+	return storage.data();
+}
+
+/*
+cpuDepthwiseRowData():
+	Where an output row is computed: in place for float, in the float scratch row for 16-bit output
+	(cpuDepthwiseStore() rounds it into the output afterwards).
+*/
+inline float* cpuDepthwiseRowData(float* outputRow, float* scratchRow) {
+	return outputRow;
+}
+
+template <typename scalar_t>
+inline float* cpuDepthwiseRowData(scalar_t* outputRow, float* scratchRow) {
+	return scratchRow;
+}
+
+/*
+cpuDepthwiseRow():
+	Compute one output row with a FilterSize x FilterSize filter, vectorized along the output width.
+	Dilation spaces the filter taps on both axes: each tap is still one unaligned load of consecutive inputs.
+Input:
+	paddedInput  - first padded input row under the filter window
+	paddedPitch  - distance between two padded input rows
+	filter       - FilterSize x FilterSize filter of this channel
+	outputRow    - output row to write
+	outputWidth  - number of outputs in the row
+*/
+template <int FilterSize, int Stride, int Dilation = 1>
+inline void cpuDepthwiseRow(const float* paddedInput, int paddedPitch, const float* filter,
+	float* outputRow, int outputWidth, float alpha, float beta) {
+
+	cpuVector filterVector[FilterSize * FilterSize];
+	for (int i = 0; i < FilterSize * FilterSize; i++) {
+		filterVector[i] = cpuVectorSet(filter[i]);
+	}
+	cpuVector alphaVector = cpuVectorSet(alpha);
+	cpuVector betaVector = cpuVectorSet(beta);
+
+	int x = 0;
+	for (; x + CPU_VECTOR_WIDTH <= outputWidth; x += CPU_VECTOR_WIDTH) {
+		cpuVector sum = cpuVectorZero();
+		for (int ky = 0; ky < FilterSize; ky++) {
+			const float* inputRow = paddedInput + ky * Dilation * paddedPitch + x * Stride;
+			for (int kx = 0; kx < FilterSize; kx++) {
+				sum = cpuVectorFmadd(filterVector[ky * FilterSize + kx], cpuVectorLoadStrided<Stride>(inputRow + kx * Dilation), sum);
+			}
+		}
+		cpuVectorStore(outputRow + x, cpuVectorFmadd(sum, alphaVector, betaVector));
+	}
+
+	// remaining outputs of the row
+	for (; x < outputWidth; x++) {
+		float sum = 0.0f;
+		for (int ky = 0; ky < FilterSize; ky++) {
+			const float* inputRow = paddedInput + ky * Dilation * paddedPitch + x * Stride;
+			for (int kx = 0; kx < FilterSize; kx++) {
+				sum += filter[ky * FilterSize + kx] * inputRow[kx * Dilation];
+			}
+		}
+		outputRow[x] = sum * alpha + beta;
+	}
+}
+
+/*
+cpuDepthwiseRowGeneric():
+	Scalar version of cpuDepthwiseRow() for any filter size, stride and dilation.
+*/
+inline void cpuDepthwiseRowGeneric(const float* paddedInput, int paddedPitch, const float* filter,
+	int filterHeight, int filterWidth, int strideWidth, int dilationHeight, int dilationWidth,
+	float* outputRow, int outputWidth, float alpha, float beta) {
+
+	for (int x = 0; x < outputWidth; x++) {
+		float sum = 0.0f;
+		for (int ky = 0; ky < filterHeight; ky++) {
+			const float* inputRow = paddedInput + ky * dilationHeight * paddedPitch + x * strideWidth;
+			for (int kx = 0; kx < filterWidth; kx++) {
+				sum += filter[ky * filterWidth + kx] * inputRow[kx * dilationWidth];
+			}
+		}
+		outputRow[x] = sum * alpha + beta;
+	}
+}
+
+/*
+cpuVectorActivate():
+	ReLU, ReLU6 and hardswish of a vector. SiLU is not vectorized, the callers handle it in scalar code.
+*/
+inline cpuVector cpuVectorActivate(cpuVector value, int activation) {
+	cpuVector zeroVector = cpuVectorZero();
+	cpuVector sixVector = cpuVectorSet(6.0f);
+	if (activation == DepthwiseActivationReLU) {
+		value = cpuVectorMax(value, zeroVector);
+	}
+	else if (activation == DepthwiseActivationReLU6) {
+		value = cpuVectorMin(cpuVectorMax(value, zeroVector), sixVector);
+	}
+	else if (activation == DepthwiseActivationHardSwish) {
+		cpuVector gate = cpuVectorMin(cpuVectorMax(cpuVectorAdd(value, cpuVectorSet(3.0f)), zeroVector), sixVector);
+		value = cpuVectorMul(cpuVectorMul(value, gate), cpuVectorSet(1.0f / 6.0f));
+	}
+	return value;
+}
+
+/*
+cpuDepthwiseEpilogueRow():
+	Apply the epilogue of one channel to an output row in place, while the row is still in cache.
+	Scale / shift, ReLU, ReLU6 and hardswish are vectorized, SiLU is scalar.
+*/
+inline void cpuDepthwiseEpilogueRow(float* outputRow, int outputWidth, const DepthwiseChannelEpilogue& epilogue) {
+	int x = 0;
+	if (epilogue.activation != DepthwiseActivationSiLU) {
+		cpuVector scaleVector = cpuVectorSet(epilogue.scale);
+		cpuVector shiftVector = cpuVectorSet(epilogue.shift);
+
+		for (; x + CPU_VECTOR_WIDTH <= outputWidth; x += CPU_VECTOR_WIDTH) {
+			cpuVector value = cpuVectorFmadd(cpuVectorLoad(outputRow + x), scaleVector, shiftVector);
+			cpuVectorStore(outputRow + x, cpuVectorActivate(value, epilogue.activation));
+		}
+	}
+
+	// remaining outputs of the row, and SiLU
+	for (; x < outputWidth; x++) {
+		outputRow[x] = epilogue.apply(outputRow[x]);
+	}
+}
+
+/*
+cpuDepthwiseComputeRow():
+	Compute one output row with the SIMD row kernel of the filter (fastFilter = 3 or 5 with the same stride and
+	dilation on both axes, see cpuDepthwiseFastFilter(), 0 otherwise), or with the scalar one.
+*/
+inline void cpuDepthwiseComputeRow(const float* paddedInput, int paddedPitch, const float* filter,
+	int fastFilter, int filterHeight, int filterWidth, int strideWidth, int dilationHeight, int dilationWidth,
+	float* outputRow, int outputWidth, float alpha, float beta) {
+
+	if ((fastFilter == 3 || fastFilter == 5) && strideWidth == 1 && (dilationWidth == 2 || dilationWidth == 4)) {
+		if (fastFilter == 3 && dilationWidth == 2) {
+			cpuDepthwiseRow<3, 1, 2>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+		}
+		else if (fastFilter == 3) {
+			cpuDepthwiseRow<3, 1, 4>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+		}
+		else if (dilationWidth == 2) {
+			cpuDepthwiseRow<5, 1, 2>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+		}
+		else {
+			cpuDepthwiseRow<5, 1, 4>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+		}
+	}
+	else if (fastFilter == 3 && strideWidth == 1) {
+		cpuDepthwiseRow<3, 1>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+	}
+	else if (fastFilter == 3 && strideWidth == 2) {
+		cpuDepthwiseRow<3, 2>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+	}
+	else if (fastFilter == 5 && strideWidth == 1) {
+		cpuDepthwiseRow<5, 1>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+	}
+	else if (fastFilter == 5 && strideWidth == 2) {
+		cpuDepthwiseRow<5, 2>(paddedInput, paddedPitch, filter, outputRow, outputWidth, alpha, beta);
+	}
+	else {
+		cpuDepthwiseRowGeneric(paddedInput, paddedPitch, filter, filterHeight, filterWidth,
+			strideWidth, dilationHeight, dilationWidth, outputRow, outputWidth, alpha, beta);
+	}
+}
+
+/*
+cpuDepthwiseFastFilter():
+	The fastFilter of cpuDepthwiseComputeRow(): the filter size when a SIMD row kernel handles the filter, stride
+	and dilation (3 x 3 or 5 x 5, the same on both axes; stride 1 or 2 without dilation, stride 1 with dilation
+	2 or 4), 0 otherwise.
+*/
+inline int cpuDepthwiseFastFilter(int filterHeight, int filterWidth, int strideHeight, int strideWidth,
+	int dilationHeight, int dilationWidth) {
+
+	if (filterHeight != filterWidth || (filterHeight != 3 && filterHeight != 5) ||
+		strideHeight != strideWidth || dilationHeight != dilationWidth) {
+		return 0;
+	}
+	if (dilationHeight == 1 && (strideHeight == 1 || strideHeight == 2)) {
+		return filterHeight;
+	}
+	return strideHeight == 1 && (dilationHeight == 2 || dilationHeight == 4) ? filterHeight : 0;
+}
+
+/*
+cpuDepthwisePadRows():
+	Copy padded rows [firstRow, firstRow + rowNumber) of one input plane into the scratch rows.
+	Rows and columns outside the input are zeros.
+	The scratch rows are CPU_VECTOR_WIDTH * 2 floats wider than needed, so a stride 2 vector load
+	at the end of a row stays inside the plane.
+*/
+template <typename scalar_t>
+inline void cpuDepthwisePadRows(const scalar_t* inputPlane, int inputHeight, int inputWidth, int paddingHeight, int paddingWidth,
+	int firstRow, int rowNumber, float* paddedRows, int paddedPitch) {
+
+	for (int row = 0; row < rowNumber; row++) {
+		float* dstRow = paddedRows + (size_t)row * paddedPitch;
+		int y = firstRow + row - paddingHeight;
+		if (y < 0 || y >= inputHeight) {
+			std::fill(dstRow, dstRow + paddedPitch, 0.0f);
+			continue;
+		}
+		std::fill(dstRow, dstRow + paddingWidth, 0.0f);
+		cpuDepthwiseLoad(inputPlane + (size_t)y * inputWidth, dstRow + paddingWidth, inputWidth);
+		std::fill(dstRow + paddingWidth + inputWidth, dstRow + paddedPitch, 0.0f);
+	}
+}
+
+/*
+cpuDepthwisePadPlane():
+	Copy one input plane into the scratch plane, surrounded by zeros.
+*/
+template <typename scalar_t>
+inline void cpuDepthwisePadPlane(const scalar_t* inputPlane, int inputHeight, int inputWidth, int paddingHeight, int paddingWidth,
+	float* paddedPlane, int paddedHeight, int paddedPitch) {
+
+	cpuDepthwisePadRows(inputPlane, inputHeight, inputWidth, paddingHeight, paddingWidth,
+		0, paddedHeight, paddedPlane, paddedPitch);
+}
+
+/*
+DepthwiseCpuSchedule:
+	How CPU_Depthwise_Scheduled() splits the work.
+	rowTile      - output rows per task, 0 for whole planes. A task pads only the input rows its band reads,
+	               so small batch / channel numbers still give every core work
+	threadNumber - OpenMP threads, 0 for the OpenMP default
+*/
+struct DepthwiseCpuSchedule {
+	int rowTile;
+	int threadNumber;
+};
+
+const DepthwiseCpuSchedule depthwiseDefaultCpuSchedule = { 0, 0 };
+
+inline int cpuDepthwiseThreadNumber(int threadNumber) {
+#ifdef _OPENMP
+	return threadNumber > 0 ? threadNumber : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+/*
+CPU_Depthwise_Scheduled():
+	CPU_Depthwise_Generic() with an explicit schedule (tile height and thread number), see DepthwiseCpuSchedule.
+	The result does not depend on the schedule.
+	The scratch rows and the float filter live in workspace, nullptr for a workspace of this call only.
+*/
+template <typename scalar_t>
+inline void CPU_Depthwise_Scheduled(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, DepthwiseCpuSchedule schedule,
+	DepthwiseCpuWorkspace* workspace = nullptr) {
+
+	DepthwiseCpuWorkspace callWorkspace;
+	if (workspace == nullptr) {
+		workspace = &callWorkspace;
+	}
+
+	bool hasEpilogue = epilogue.scale != nullptr || epilogue.shift != nullptr || epilogue.activation != DepthwiseActivationNone;
+
+	int rowTile = schedule.rowTile > 0 && schedule.rowTile < outputHeight ? schedule.rowTile : outputHeight;
+	int tileNumber = (outputHeight + rowTile - 1) / rowTile;
+
+	// padded rows must cover every input row / column the filter window of a tile touches
+	int paddedHeight = (rowTile - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+	int paddedWidth = std::max(inputWidth + 2 * paddingWidth, (outputWidth - 1) * strideWidth + (filterWidth - 1) * dilationWidth + 1);
+	int paddedPitch = paddedWidth + 2 * CPU_VECTOR_WIDTH;
+	int filterSize = filterHeight * filterWidth;
+
+	int fastFilter = cpuDepthwiseFastFilter(filterHeight, filterWidth, strideHeight, strideWidth, dilationHeight, dilationWidth);
+
+	const float* filterData = cpuDepthwiseFloatData(filter, (size_t)outputChannel * filterSize, workspace->filter);
+
+	int threadNumber = cpuDepthwiseThreadNumber(schedule.threadNumber);
+	depthwiseWorkspaceThreads(*workspace, threadNumber);
+
+#pragma omp parallel num_threads(threadNumber)
+	{
+#ifdef _OPENMP
+		int thread = omp_get_thread_num();
+#else
+		int thread = 0;
+#endif
+		// the padded rows, then the float row of a 16-bit output
+		size_t paddedSize = (size_t)paddedHeight * paddedPitch;
+		float* paddedRows = depthwiseWorkspaceBuffer(workspace->threadBuffers[thread], paddedSize + outputWidth);
+		float* scratchRow = paddedRows + paddedSize;
+
+#pragma omp for collapse(3) schedule(static)
+		for (int n = 0; n < outputBatchNumber; n++) {
+			for (int c = 0; c < outputChannel; c++) {
+				for (int tile = 0; tile < tileNumber; tile++) {
+					const scalar_t* inputPlane = input + ((size_t)n * inputChannel + c) * inputHeight * inputWidth;
+					const float* channelFilter = filterData + (size_t)c * filterSize;
+					scalar_t* outputPlane = output + ((size_t)n * outputChannel + c) * outputHeight * outputWidth;
+					DepthwiseChannelEpilogue channelEpilogue(epilogue, c);
+
+					int firstRow = tile * rowTile;
+					int rowNumber = std::min(rowTile, outputHeight - firstRow);
+					cpuDepthwisePadRows(inputPlane, inputHeight, inputWidth, paddingHeight, paddingWidth,
+						firstRow * strideHeight, (rowNumber - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1,
+						paddedRows, paddedPitch);
+
+					for (int y = 0; y < rowNumber; y++) {
+						const float* paddedInput = paddedRows + (size_t)y * strideHeight * paddedPitch;
+						scalar_t* outputRow = outputPlane + (size_t)(firstRow + y) * outputWidth;
+						float* rowData = cpuDepthwiseRowData(outputRow, scratchRow);
+
+						cpuDepthwiseComputeRow(paddedInput, paddedPitch, channelFilter,
+							fastFilter, filterHeight, filterWidth, strideWidth, dilationHeight, dilationWidth,
+							rowData, outputWidth, alpha, beta);
+
+						if (hasEpilogue) {
+							cpuDepthwiseEpilogueRow(rowData, outputWidth, channelEpilogue);
+						}
+						cpuDepthwiseStore(rowData, outputRow, outputWidth);
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+CPU_Depthwise_Generic():
+	Depthwise convolution of a whole NCHW tensor on the host, for any filter size, padding, stride and dilation.
+	3 x 3 and 5 x 5 filters with stride 1 or 2 and no dilation, or stride 1 and dilation 2 or 4, use the SIMD
+	row kernels.
+	scalar_t is float, DepthwiseHalf or DepthwiseBFloat16. Whole planes per task, every OpenMP thread.
+*/
+template <typename scalar_t>
+inline void CPU_Depthwise_Generic(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	CPU_Depthwise_Scheduled(input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		alpha, beta, epilogue, depthwiseDefaultCpuSchedule);
+}
+
+/*
+CPU_Depthwise():
+	Depthwise convolution of a whole NCHW tensor on the host.
+	Arguments are the same as the DCU kernels. padding and stride are used on both height and width.
+*/
+template <typename scalar_t>
+inline void CPU_Depthwise(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	CPU_Depthwise_Generic(input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		padding, padding, stride, stride, 1, 1,
+		alpha, beta, epilogue);
+}
@@ -0,0 +1,155 @@
+#pragma once
+/*
+Depthwise Convolution Backward on CPU.
+
+grad_input and / or grad_weight of the depthwise convolution (channel multiplier 1) on the host,
+in one pass over grad_output. Work is split across cores by (batch, channel) with OpenMP.
+
+	1)	grad_input: the grad_output plane is scattered into a zero padded scratch plane at stride spacing,
+		then convolved at stride 1 with the flipped filter by the forward row kernels (cpuDepthwiseComputeRow),
+		so 3 x 3 and 5 x 5 filters get the SIMD path
+	2)	grad_weight: every (batch, channel) task reduces its plane to one partial per filter tap
+		(vectorized dot products of grad_output rows with the padded input rows), the partials are then summed
+		over the batch per channel, in a fixed order so the result does not depend on the thread count
+*/
+#include "CPU_Depthwise.h"
+
+/*
+cpuDepthwiseDotRow():
+	Dot product of one grad_output row with the input row under it (every stride-th float).
+*/
+inline float cpuDepthwiseDotRow(const float* gradRow, const float* paddedRow, int outputWidth, int stride) {
+	int x = 0;
+	float sum = 0.0f;
+	if (stride == 1 || stride == 2) {
+		cpuVector sumVector = cpuVectorZero();
+		for (; x + CPU_VECTOR_WIDTH <= outputWidth; x += CPU_VECTOR_WIDTH) {
+			cpuVector inputVector = stride == 1 ? cpuVectorLoad(paddedRow + x) : cpuVectorLoadStride2(paddedRow + 2 * x);
+			sumVector = cpuVectorFmadd(cpuVectorLoad(gradRow + x), inputVector, sumVector);
+		}
+		float lanes[CPU_VECTOR_WIDTH];
+		cpuVectorStore(lanes, sumVector);
+		for (int i = 0; i < CPU_VECTOR_WIDTH; i++) {
+			sum += lanes[i];
+		}
+	}
+	for (; x < outputWidth; x++) {
+		sum += gradRow[x] * paddedRow[x * stride];
+	}
+	return sum;
+}
+
+/*
+CPU_DepthwiseBackward():
+	grad_input and / or grad_weight of a whole NCHW tensor on the host. Pass nullptr as gradInput or
+	gradFilter to skip that gradient. padding must be smaller than the filter extent.
+*/
+inline void CPU_DepthwiseBackward(const float* gradOutput, const float* input, const float* filter,
+	float* gradInput, float* gradFilter,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth,
+	int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth) {
+
+	int filterSize = filterHeight * filterWidth;
+	int extentHeight = (filterHeight - 1) * dilationHeight + 1;
+	int extentWidth = (filterWidth - 1) * dilationWidth + 1;
+
+	// grad_input: grad_output scattered at stride spacing, (extent - 1 - padding) zeros in front
+	int scatterHeight = inputHeight + extentHeight - 1;
+	int scatterPitch = inputWidth + extentWidth - 1 + 2 * CPU_VECTOR_WIDTH;
+	int scatterTop = extentHeight - 1 - paddingHeight;
+	int scatterLeft = extentWidth - 1 - paddingWidth;
+	// a stride 1 correlation with the dilation of the forward pass
+	int fastFilter = cpuDepthwiseFastFilter(filterHeight, filterWidth, 1, 1, dilationHeight, dilationWidth);
+
+	// grad_weight: input plane padded as in the forward pass
+	int paddedHeight = std::max(inputHeight + 2 * paddingHeight, (outputHeight - 1) * strideHeight + extentHeight);
+	int paddedWidth = std::max(inputWidth + 2 * paddingWidth, (outputWidth - 1) * strideWidth + extentWidth);
+	int paddedPitch = paddedWidth + 2 * CPU_VECTOR_WIDTH;
+
+	std::vector<float> filterPartial;
+	if (gradFilter != nullptr) {
+		filterPartial.resize((size_t)inputBatchNumber * inputChannel * filterSize);
+	}
+
+#pragma omp parallel
+	{
+		std::vector<float> scatterPlane;
+		std::vector<float> flippedFilter(filterSize);
+		std::vector<float> paddedPlane;
+		if (gradInput != nullptr) {
+			scatterPlane.resize((size_t)scatterHeight * scatterPitch);
+		}
+		if (gradFilter != nullptr) {
+			paddedPlane.resize((size_t)paddedHeight * paddedPitch);
+		}
+
+#pragma omp for collapse(2) schedule(static)
+		for (int n = 0; n < inputBatchNumber; n++) {
+			for (int c = 0; c < inputChannel; c++) {
+				size_t planeIdx = (size_t)n * inputChannel + c;
+				const float* gradPlane = gradOutput + planeIdx * outputHeight * outputWidth;
+				const float* channelFilter = filter + (size_t)c * filterSize;
+
+				if (gradInput != nullptr) {
+					std::fill(scatterPlane.begin(), scatterPlane.end(), 0.0f);
+					for (int y = 0; y < outputHeight; y++) {
+						float* scatterRow = scatterPlane.data() + (size_t)(scatterTop + y * strideHeight) * scatterPitch + scatterLeft;
+						const float* gradRow = gradPlane + (size_t)y * outputWidth;
+						if (strideWidth == 1) {
+							std::memcpy(scatterRow, gradRow, outputWidth * sizeof(float));
+						}
+						else {
+							for (int x = 0; x < outputWidth; x++) {
+								scatterRow[x * strideWidth] = gradRow[x];
+							}
+						}
+					}
+					for (int i = 0; i < filterSize; i++) {
+						flippedFilter[i] = channelFilter[filterSize - 1 - i];
+					}
+
+					float* gradInputPlane = gradInput + planeIdx * inputHeight * inputWidth;
+					for (int y = 0; y < inputHeight; y++) {
+						cpuDepthwiseComputeRow(scatterPlane.data() + (size_t)y * scatterPitch, scatterPitch, flippedFilter.data(),
+							fastFilter, filterHeight, filterWidth, 1, dilationHeight, dilationWidth,
+							gradInputPlane + (size_t)y * inputWidth, inputWidth, 1.0f, 0.0f);
+					}
+				}
+
+				if (gradFilter != nullptr) {
+					const float* inputPlane = input + planeIdx * inputHeight * inputWidth;
+					cpuDepthwisePadPlane(inputPlane, inputHeight, inputWidth, paddingHeight, paddingWidth,
+						paddedPlane.data(), paddedHeight, paddedPitch);
+
+					float* partial = filterPartial.data() + planeIdx * filterSize;
+					for (int ky = 0; ky < filterHeight; ky++) {
+						for (int kx = 0; kx < filterWidth; kx++) {
+							float sum = 0.0f;
+							for (int y = 0; y < outputHeight; y++) {
+								const float* paddedRow = paddedPlane.data() + (size_t)(y * strideHeight + ky * dilationHeight) * paddedPitch + kx * dilationWidth;
+								sum += cpuDepthwiseDotRow(gradPlane + (size_t)y * outputWidth, paddedRow, outputWidth, strideWidth);
+							}
+							partial[ky * filterWidth + kx] = sum;
+						}
+					}
+				}
+			}
+		}
+
+		// sum the grad_weight partials over the batch
+		if (gradFilter != nullptr) {
+#pragma omp for schedule(static)
+			for (int c = 0; c < inputChannel; c++) {
+				for (int i = 0; i < filterSize; i++) {
+					float sum = 0.0f;
+					for (int n = 0; n < inputBatchNumber; n++) {
+						sum += filterPartial[((size_t)n * inputChannel + c) * filterSize + i];
+					}
+					gradFilter[(size_t)c * filterSize + i] = sum;
+				}
+			}
+		}
+	}
+}
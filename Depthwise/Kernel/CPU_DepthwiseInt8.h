@@ -0,0 +1,365 @@
+#pragma once
+/*
+Quantized (int8) Depthwise Convolution on CPU.
+
+Depthwise convolution of quantized MobileNet V2 on the host. Activations and filters are int8, products are
+summed in int32 and the epilogue requantizes the sum back to int8, so the activations move a quarter of the
+bytes of the fp32 path.
+
+	real input  = inputScale * (input - inputZeroPoint)			(per tensor, asymmetric)
+	real filter = filterScale[c] * filter					(per channel, symmetric)
+	real output = outputScale * (output - outputZeroPoint)		(per tensor, asymmetric)
+
+	sum[c]    = sum over the window of (input - inputZeroPoint) * filter + bias[c]
+	output[c] = clamp(round(sum[c] * inputScale * filterScale[c] / outputScale) + outputZeroPoint)
+
+bias is int32 in units of inputScale * filterScale[c] (optional). The rounding is to nearest even. The clamp is
+[-128, 127], ReLU clamps the low end at outputZeroPoint (real 0) and ReLU6 also clamps the high end at real 6.
+
+	1)	filter 3 x 3 and 5 x 5, stride 1 and 2 use SIMD row kernels: input values are widened to int16 when the
+		plane is padded, two neighbouring taps are packed into one 32-bit lane and multiplied by a packed pair of
+		filter taps with vpmaddwd (AVX-512BW / AVX2), or accumulated in one instruction with vpdpwssd when the
+		build has AVX-512 VNNI / AVX-VNNI
+	2)	every other filter size / stride / padding goes through a scalar row kernel
+	3)	work is split across cores by (batch, channel) with OpenMP, the same as CPU_Depthwise()
+
+Padding is inputZeroPoint (real 0): the scratch plane holds input - inputZeroPoint, so it is padded with zeros.
+*/
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "DepthwiseEpilogue.h"
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+DepthwiseQuantization:
+	Quantization parameters of one quantized depthwise layer. filterScale (and bias) have one value per channel.
+	activation is DepthwiseActivationNone, DepthwiseActivationReLU or DepthwiseActivationReLU6.
+*/
+struct DepthwiseQuantization {
+	float inputScale;
+	int inputZeroPoint;
+	const float* filterScale;
+	const int32_t* bias;
+	float outputScale;
+	int outputZeroPoint;
+	int activation;
+};
+
+/*
+Integer SIMD helpers.
+cpuIntVector holds CPU_INT_VECTOR_WIDTH int32 lanes. cpuIntVectorLoadPairs() loads CPU_INT_VECTOR_WIDTH int16
+pairs, one per lane; cpuIntVectorDot() adds pair . filterPair to every lane. cpuIntVectorStoreInterleaved() writes
+two vectors as even / odd outputs.
+*/
+#if defined(__AVX512BW__)
+#define CPU_INT_VECTOR_WIDTH 16
+typedef __m512i cpuIntVector;
+
+inline cpuIntVector cpuIntVectorSet(int32_t value) { return _mm512_set1_epi32(value); }
+inline cpuIntVector cpuIntVectorLoadPairs(const int16_t* src) { return _mm512_loadu_si512((const void*)src); }
+inline void cpuIntVectorStore(int32_t* dst, cpuIntVector value) { _mm512_storeu_si512((void*)dst, value); }
+inline void cpuIntVectorStoreInterleaved(int32_t* dst, cpuIntVector even, cpuIntVector odd) {
+	const __m512i lowIdx = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+	const __m512i highIdx = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+	_mm512_storeu_si512((void*)dst, _mm512_permutex2var_epi32(even, lowIdx, odd));
+	_mm512_storeu_si512((void*)(dst + 16), _mm512_permutex2var_epi32(even, highIdx, odd));
+}
+inline cpuIntVector cpuIntVectorDot(cpuIntVector sum, cpuIntVector pairs, cpuIntVector filterPair) {
+#if defined(__AVX512VNNI__)
+	return _mm512_dpwssd_epi32(sum, pairs, filterPair);
+#else
+	return _mm512_add_epi32(sum, _mm512_madd_epi16(pairs, filterPair));
+#endif
+}
+#elif defined(__AVX2__)
+#define CPU_INT_VECTOR_WIDTH 8
+typedef __m256i cpuIntVector;
+
+inline cpuIntVector cpuIntVectorSet(int32_t value) { return _mm256_set1_epi32(value); }
+inline cpuIntVector cpuIntVectorLoadPairs(const int16_t* src) { return _mm256_loadu_si256((const __m256i*)src); }
+inline void cpuIntVectorStore(int32_t* dst, cpuIntVector value) { _mm256_storeu_si256((__m256i*)dst, value); }
+inline void cpuIntVectorStoreInterleaved(int32_t* dst, cpuIntVector even, cpuIntVector odd) {
+	// unpack gives e0 o0 e1 o1 | e4 o4 e5 o5 and e2 o2 e3 o3 | e6 o6 e7 o7, the 128-bit halves are put back in order
+	__m256i low = _mm256_unpacklo_epi32(even, odd);
+	__m256i high = _mm256_unpackhi_epi32(even, odd);
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(low, high, 0x20));
+	_mm256_storeu_si256((__m256i*)(dst + 8), _mm256_permute2x128_si256(low, high, 0x31));
+}
+inline cpuIntVector cpuIntVectorDot(cpuIntVector sum, cpuIntVector pairs, cpuIntVector filterPair) {
+#if defined(__AVXVNNI__)
+	return _mm256_dpwssd_avx_epi32(sum, pairs, filterPair);
+#else
+	return _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, filterPair));
+#endif
+}
+#else
+#define CPU_INT_VECTOR_WIDTH 1
+#endif
+
+// Filter taps kx and kx + 1 packed as the int16 pair of a 32-bit lane, the tap past the filter width is zero
+inline int32_t cpuDepthwiseFilterPair(const int8_t* filterRow, int kx, int filterWidth) {
+	uint32_t low = (uint16_t)(int16_t)filterRow[kx];
+	uint32_t high = kx + 1 < filterWidth ? (uint16_t)(int16_t)filterRow[kx + 1] : 0u;
+	return (int32_t)(low | (high << 16));
+}
+
+/*
+cpuDepthwiseInt8Row():
+	Int32 sums of one output row with a FilterSize x FilterSize filter, vectorized along the output width.
+	A lane sums two neighbouring taps at once: with stride 2 the two input values of a lane are adjacent in the
+	padded row, so one load gives every pair. With stride 1 the pairs of neighbouring outputs overlap, so the even
+	and the odd outputs are summed in two vectors (loads one value apart) and interleaved when they are stored.
+	The vector loop runs past outputWidth to the next full vector, sumRow must have room for it
+	(cpuDepthwiseInt8SumWidth()); the padded rows are wide enough for the extra loads.
+Input:
+	paddedInput  - first padded input row under the filter window (input - inputZeroPoint, int16)
+	paddedPitch  - distance between two padded input rows
+	filter       - FilterSize x FilterSize int8 filter of this channel
+	sumRow       - int32 sums to write
+	outputWidth  - number of outputs in the row
+*/
+template <int FilterSize, int Stride>
+inline void cpuDepthwiseInt8Row(const int16_t* paddedInput, int paddedPitch, const int8_t* filter,
+	int32_t* sumRow, int outputWidth, int32_t bias) {
+
+#if CPU_INT_VECTOR_WIDTH > 1
+	const int pairNumber = (FilterSize + 1) / 2;
+	cpuIntVector filterPair[FilterSize * pairNumber];
+	for (int ky = 0; ky < FilterSize; ky++) {
+		for (int p = 0; p < pairNumber; p++) {
+			filterPair[ky * pairNumber + p] = cpuIntVectorSet(cpuDepthwiseFilterPair(filter + ky * FilterSize, 2 * p, FilterSize));
+		}
+	}
+	cpuIntVector biasVector = cpuIntVectorSet(bias);
+
+	if (Stride == 1) {
+		for (int x = 0; x < outputWidth; x += 2 * CPU_INT_VECTOR_WIDTH) {
+			cpuIntVector even = biasVector;
+			cpuIntVector odd = biasVector;
+			for (int ky = 0; ky < FilterSize; ky++) {
+				const int16_t* inputRow = paddedInput + ky * paddedPitch + x;
+				for (int p = 0; p < pairNumber; p++) {
+					even = cpuIntVectorDot(even, cpuIntVectorLoadPairs(inputRow + 2 * p), filterPair[ky * pairNumber + p]);
+					odd = cpuIntVectorDot(odd, cpuIntVectorLoadPairs(inputRow + 2 * p + 1), filterPair[ky * pairNumber + p]);
+				}
+			}
+			cpuIntVectorStoreInterleaved(sumRow + x, even, odd);
+		}
+	}
+	else {
+		for (int x = 0; x < outputWidth; x += CPU_INT_VECTOR_WIDTH) {
+			cpuIntVector sum = biasVector;
+			for (int ky = 0; ky < FilterSize; ky++) {
+				const int16_t* inputRow = paddedInput + ky * paddedPitch + 2 * x;
+				for (int p = 0; p < pairNumber; p++) {
+					sum = cpuIntVectorDot(sum, cpuIntVectorLoadPairs(inputRow + 2 * p), filterPair[ky * pairNumber + p]);
+				}
+			}
+			cpuIntVectorStore(sumRow + x, sum);
+		}
+	}
+#else
+	for (int x = 0; x < outputWidth; x++) {
+		int32_t sum = bias;
+		for (int ky = 0; ky < FilterSize; ky++) {
+			const int16_t* inputRow = paddedInput + ky * paddedPitch + x * Stride;
+			for (int kx = 0; kx < FilterSize; kx++) {
+				sum += (int32_t)filter[ky * FilterSize + kx] * inputRow[kx];
+			}
+		}
+		sumRow[x] = sum;
+	}
+#endif
+}
+
+// Room for the int32 sums of a row, the vector loop of cpuDepthwiseInt8Row() stores whole (pairs of) vectors
+inline int cpuDepthwiseInt8SumWidth(int outputWidth) {
+	return (outputWidth + 2 * CPU_INT_VECTOR_WIDTH - 1) / (2 * CPU_INT_VECTOR_WIDTH) * (2 * CPU_INT_VECTOR_WIDTH);
+}
+
+/*
+cpuDepthwiseInt8RowGeneric():
+	Scalar version of cpuDepthwiseInt8Row() for any filter size and stride.
+*/
+inline void cpuDepthwiseInt8RowGeneric(const int16_t* paddedInput, int paddedPitch, const int8_t* filter,
+	int filterHeight, int filterWidth, int strideWidth, int32_t* sumRow, int outputWidth, int32_t bias) {
+
+	for (int x = 0; x < outputWidth; x++) {
+		int32_t sum = bias;
+		for (int ky = 0; ky < filterHeight; ky++) {
+			const int16_t* inputRow = paddedInput + ky * paddedPitch + x * strideWidth;
+			for (int kx = 0; kx < filterWidth; kx++) {
+				sum += (int32_t)filter[ky * filterWidth + kx] * inputRow[kx];
+			}
+		}
+		sumRow[x] = sum;
+	}
+}
+
+/*
+cpuDepthwiseRequantizeRow():
+	int32 sums of one channel to int8: scale by multiplier (inputScale * filterScale[c] / outputScale), round to
+	nearest even, add outputZeroPoint and clamp to [low, high].
+*/
+inline void cpuDepthwiseRequantizeRow(const int32_t* sumRow, int8_t* outputRow, int outputWidth,
+	float multiplier, int outputZeroPoint, int low, int high) {
+
+	int x = 0;
+#if defined(__AVX512BW__)
+	__m512 multiplierVector = _mm512_set1_ps(multiplier);
+	__m512i zeroPointVector = _mm512_set1_epi32(outputZeroPoint);
+	__m512i lowVector = _mm512_set1_epi32(low);
+	__m512i highVector = _mm512_set1_epi32(high);
+	for (; x + 16 <= outputWidth; x += 16) {
+		__m512 scaled = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_loadu_si512((const void*)(sumRow + x))), multiplierVector);
+		__m512i value = _mm512_add_epi32(_mm512_cvt_roundps_epi32(scaled, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), zeroPointVector);
+		value = _mm512_min_epi32(_mm512_max_epi32(value, lowVector), highVector);
+		_mm_storeu_si128((__m128i*)(outputRow + x), _mm512_cvtepi32_epi8(value));
+	}
+	if (x < outputWidth) {
+		__mmask16 mask = (__mmask16)((1u << (outputWidth - x)) - 1u);
+		__m512 scaled = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_maskz_loadu_epi32(mask, sumRow + x)), multiplierVector);
+		__m512i value = _mm512_add_epi32(_mm512_cvt_roundps_epi32(scaled, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), zeroPointVector);
+		value = _mm512_min_epi32(_mm512_max_epi32(value, lowVector), highVector);
+		_mm512_mask_cvtepi32_storeu_epi8(outputRow + x, mask, value);
+		x = outputWidth;
+	}
+#elif defined(__AVX2__)
+	__m256 multiplierVector = _mm256_set1_ps(multiplier);
+	__m256i zeroPointVector = _mm256_set1_epi32(outputZeroPoint);
+	__m256i lowVector = _mm256_set1_epi32(low);
+	__m256i highVector = _mm256_set1_epi32(high);
+	for (; x + 8 <= outputWidth; x += 8) {
+		__m256 scaled = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(sumRow + x))), multiplierVector);
+		__m256i value = _mm256_add_epi32(_mm256_cvtps_epi32(_mm256_round_ps(scaled, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)), zeroPointVector);
+		value = _mm256_min_epi32(_mm256_max_epi32(value, lowVector), highVector);
+		// values are in [-128, 127], the saturating packs only narrow them
+		__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+		_mm_storel_epi64((__m128i*)(outputRow + x), _mm_packs_epi16(packed, packed));
+	}
+#endif
+
+	// remaining outputs of the row
+	for (; x < outputWidth; x++) {
+		int value = (int)std::nearbyint((float)sumRow[x] * multiplier) + outputZeroPoint;
+		outputRow[x] = (int8_t)std::min(std::max(value, low), high);
+	}
+}
+
+/*
+cpuDepthwiseQuantizedRange():
+	int8 clamp range of the output for the activation of the layer.
+*/
+inline void cpuDepthwiseQuantizedRange(const DepthwiseQuantization& quantization, int& low, int& high) {
+	low = -128;
+	high = 127;
+	if (quantization.activation == DepthwiseActivationReLU || quantization.activation == DepthwiseActivationReLU6) {
+		low = std::max(low, quantization.outputZeroPoint);
+	}
+	if (quantization.activation == DepthwiseActivationReLU6) {
+		int six = (int)std::nearbyint(6.0f / quantization.outputScale) + quantization.outputZeroPoint;
+		high = std::min(high, six);
+	}
+}
+
+/*
+cpuDepthwiseInt8PadPlane():
+	Copy one input plane into the int16 scratch plane as input - inputZeroPoint, surrounded by zeros.
+	The scratch rows are CPU_INT_VECTOR_WIDTH * 4 values wider than needed, so the vector loads past the end of
+	a row (see cpuDepthwiseInt8Row()) stay inside the plane.
+*/
+inline void cpuDepthwiseInt8PadPlane(const int8_t* inputPlane, int inputHeight, int inputWidth, int paddingHeight, int paddingWidth,
+	int inputZeroPoint, int16_t* paddedPlane, int paddedHeight, int paddedPitch) {
+
+	for (int row = 0; row < paddedHeight; row++) {
+		int16_t* dstRow = paddedPlane + (size_t)row * paddedPitch;
+		int y = row - paddingHeight;
+		if (y < 0 || y >= inputHeight) {
+			std::fill(dstRow, dstRow + paddedPitch, (int16_t)0);
+			continue;
+		}
+		const int8_t* srcRow = inputPlane + (size_t)y * inputWidth;
+		std::fill(dstRow, dstRow + paddingWidth, (int16_t)0);
+		for (int x = 0; x < inputWidth; x++) {
+			dstRow[paddingWidth + x] = (int16_t)(srcRow[x] - inputZeroPoint);
+		}
+		std::fill(dstRow + paddingWidth + inputWidth, dstRow + paddedPitch, (int16_t)0);
+	}
+}
+
+/*
+CPU_Depthwise_Int8():
+	Quantized depthwise convolution of a whole NCHW int8 tensor on the host.
+	Arguments are the same as CPU_Depthwise() with int8 input / filter / output, plus the quantization parameters
+	instead of alpha / beta / epilogue.
+*/
+inline void CPU_Depthwise_Int8(const int8_t* input, const int8_t* filter, int8_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride, DepthwiseQuantization quantization) {
+
+	// padded plane must cover every input row / column the filter window touches
+	int paddedHeight = std::max(inputHeight + 2 * padding, (outputHeight - 1) * stride + filterHeight);
+	int paddedWidth = std::max(inputWidth + 2 * padding, (outputWidth - 1) * stride + filterWidth);
+	int paddedPitch = paddedWidth + 4 * CPU_INT_VECTOR_WIDTH;
+	int filterSize = filterHeight * filterWidth;
+
+	int fastFilter = filterHeight == filterWidth ? filterHeight : 0;
+	int low, high;
+	cpuDepthwiseQuantizedRange(quantization, low, high);
+
+#pragma omp parallel
+	{
+		std::vector<int16_t> paddedPlane((size_t)paddedHeight * paddedPitch);
+		std::vector<int32_t> sumRow(cpuDepthwiseInt8SumWidth(outputWidth));
+
+#pragma omp for collapse(2) schedule(static)
+		for (int n = 0; n < outputBatchNumber; n++) {
+			for (int c = 0; c < outputChannel; c++) {
+				const int8_t* inputPlane = input + ((size_t)n * inputChannel + c) * inputHeight * inputWidth;
+				const int8_t* channelFilter = filter + (size_t)c * filterSize;
+				int8_t* outputPlane = output + ((size_t)n * outputChannel + c) * outputHeight * outputWidth;
+				int32_t bias = quantization.bias ? quantization.bias[c] : 0;
+				float multiplier = quantization.inputScale * quantization.filterScale[c] / quantization.outputScale;
+
+				cpuDepthwiseInt8PadPlane(inputPlane, inputHeight, inputWidth, padding, padding,
+					quantization.inputZeroPoint, paddedPlane.data(), paddedHeight, paddedPitch);
+
+				for (int y = 0; y < outputHeight; y++) {
+					const int16_t* paddedInput = paddedPlane.data() + (size_t)y * stride * paddedPitch;
+
+					if (fastFilter == 3 && stride == 1) {
+						cpuDepthwiseInt8Row<3, 1>(paddedInput, paddedPitch, channelFilter, sumRow.data(), outputWidth, bias);
+					}
+					else if (fastFilter == 3 && stride == 2) {
+						cpuDepthwiseInt8Row<3, 2>(paddedInput, paddedPitch, channelFilter, sumRow.data(), outputWidth, bias);
+					}
+					else if (fastFilter == 5 && stride == 1) {
+						cpuDepthwiseInt8Row<5, 1>(paddedInput, paddedPitch, channelFilter, sumRow.data(), outputWidth, bias);
+					}
+					else if (fastFilter == 5 && stride == 2) {
+						cpuDepthwiseInt8Row<5, 2>(paddedInput, paddedPitch, channelFilter, sumRow.data(), outputWidth, bias);
+					}
+					else {
+						cpuDepthwiseInt8RowGeneric(paddedInput, paddedPitch, channelFilter, filterHeight, filterWidth,
+							stride, sumRow.data(), outputWidth, bias);
+					}
+
+					cpuDepthwiseRequantizeRow(sumRow.data(), outputPlane + (size_t)y * outputWidth, outputWidth,
+						multiplier, quantization.outputZeroPoint, low, high);
+				}
+			}
+		}
+	}
+}
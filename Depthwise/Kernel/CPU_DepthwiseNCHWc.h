@@ -0,0 +1,138 @@
+#pragma once
+/*
+Depthwise Convolution on CPU, blocked channels (NCHWc).
+
+nChw8c / nChw16c activations: the channels are split into blocks of channelBlock (8 or 16) and the channels of
+a block are interleaved per pixel, (batch, channel / channelBlock, height, width, channelBlock). This is the
+channel group structure of the DCU kernels (channelGroupSize 8 / 16 / 32) brought to the host: a channel block
+is one AVX2 (8) or AVX-512 (16) vector, so every filter tap is one full width FMA and no gather is needed,
+for any filter size, stride and dilation.
+
+One channel block of one image is a NHWC image with channelBlock channels, so the row kernels of
+CPU_DepthwiseNHWC.h are reused. The last block is padded with zero channels when channel is not a multiple of
+channelBlock; padded channels of the output are written as zero, so a chain of layers can stay in NCHWc.
+
+The filter is reordered once with cpuReorderDepthwiseFilterNCHWc() to (channel / channelBlock, filterHeight,
+filterWidth, channelBlock) and reused by every call.
+*/
+#include "CPU_DepthwiseNHWC.h"
+
+/*
+cpuDepthwiseNCHWcBlock():
+	Channel block matching the SIMD width of the build, 16 with AVX-512, 8 otherwise.
+*/
+inline int cpuDepthwiseNCHWcBlock() {
+	return CPU_VECTOR_WIDTH >= 16 ? 16 : 8;
+}
+
+inline int cpuDepthwiseNCHWcBlockNumber(int channel, int channelBlock) {
+	return (channel + channelBlock - 1) / channelBlock;
+}
+
+// Number of floats of a (batch, channel, height, width) tensor in NCHWc
+inline size_t cpuDepthwiseNCHWcSize(int batch, int channel, int height, int width, int channelBlock) {
+	return (size_t)batch * cpuDepthwiseNCHWcBlockNumber(channel, channelBlock) * height * width * channelBlock;
+}
+
+/*
+cpuReorderNCHWToNCHWc():
+	NCHW to NCHWc, padded channels are zero.
+*/
+inline void cpuReorderNCHWToNCHWc(const float* input, float* output, int batch, int channel, int height, int width, int channelBlock) {
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(channel, channelBlock);
+	int planeSize = height * width;
+
+#pragma omp parallel for collapse(2) schedule(static)
+	for (int n = 0; n < batch; n++) {
+		for (int cb = 0; cb < blockNumber; cb++) {
+			float* outputBlock = output + ((size_t)n * blockNumber + cb) * planeSize * channelBlock;
+			for (int b = 0; b < channelBlock; b++) {
+				int c = cb * channelBlock + b;
+				const float* inputPlane = input + ((size_t)n * channel + c) * planeSize;
+				for (int p = 0; p < planeSize; p++) {
+					outputBlock[(size_t)p * channelBlock + b] = c < channel ? inputPlane[p] : 0.0f;
+				}
+			}
+		}
+	}
+}
+
+/*
+cpuReorderNCHWcToNCHW():
+	NCHWc back to NCHW, padded channels are dropped.
+*/
+inline void cpuReorderNCHWcToNCHW(const float* input, float* output, int batch, int channel, int height, int width, int channelBlock) {
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(channel, channelBlock);
+	int planeSize = height * width;
+
+#pragma omp parallel for collapse(2) schedule(static)
+	for (int n = 0; n < batch; n++) {
+		for (int c = 0; c < channel; c++) {
+			const float* inputBlock = input + ((size_t)n * blockNumber + c / channelBlock) * planeSize * channelBlock + c % channelBlock;
+			float* outputPlane = output + ((size_t)n * channel + c) * planeSize;
+			for (int p = 0; p < planeSize; p++) {
+				outputPlane[p] = inputBlock[(size_t)p * channelBlock];
+			}
+		}
+	}
+}
+
+/*
+cpuReorderDepthwiseFilterNCHWc():
+	(channel, filterHeight, filterWidth) filter to (channel / channelBlock, filterHeight, filterWidth, channelBlock),
+	padded channels are zero. Size is cpuDepthwiseNCHWcSize(1, channel, filterHeight, filterWidth, channelBlock).
+*/
+inline void cpuReorderDepthwiseFilterNCHWc(const float* filter, float* blockedFilter, int channel, int filterHeight, int filterWidth, int channelBlock) {
+	cpuReorderNCHWToNCHWc(filter, blockedFilter, 1, channel, filterHeight, filterWidth, channelBlock);
+}
+
+/*
+CPU_Depthwise_NCHWc():
+	Depthwise convolution of a whole NCHWc tensor on the host, for any filter size, padding, stride and dilation.
+	Same arguments as CPU_Depthwise_Generic() plus channelBlock (8 or 16); input / output are NCHWc and
+	blockedFilter comes from cpuReorderDepthwiseFilterNCHWc(). The epilogue scale / shift stay per channel.
+*/
+inline void CPU_Depthwise_NCHWc(const float* input, const float* blockedFilter, float* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	int channelBlock, float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	bool hasEpilogue = epilogue.scale != nullptr || epilogue.shift != nullptr || epilogue.activation != DepthwiseActivationNone;
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(outputChannel, channelBlock);
+	size_t inputBlockSize = (size_t)inputHeight * inputWidth * channelBlock;
+	size_t outputRowSize = (size_t)outputWidth * channelBlock;
+	size_t filterBlockSize = (size_t)filterHeight * filterWidth * channelBlock;
+
+#pragma omp parallel for collapse(3) schedule(static)
+	for (int n = 0; n < outputBatchNumber; n++) {
+		for (int cb = 0; cb < blockNumber; cb++) {
+			for (int y = 0; y < outputHeight; y++) {
+				size_t blockIndex = (size_t)n * blockNumber + cb;
+				float* outputRow = output + (blockIndex * outputHeight + y) * outputRowSize;
+
+				cpuDepthwiseNHWCOutputRow(input + blockIndex * inputBlockSize, blockedFilter + cb * filterBlockSize, outputRow,
+					channelBlock, inputHeight, inputWidth, filterHeight, filterWidth, outputWidth, y,
+					paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+					alpha, beta);
+
+				int firstChannel = cb * channelBlock;
+				int channelNumber = std::min(channelBlock, outputChannel - firstChannel);
+				if (hasEpilogue) {
+					DepthwiseEpilogue blockEpilogue = epilogue;
+					blockEpilogue.scale = epilogue.scale ? epilogue.scale + firstChannel : nullptr;
+					blockEpilogue.shift = epilogue.shift ? epilogue.shift + firstChannel : nullptr;
+					for (int x = 0; x < outputWidth; x++) {
+						cpuDepthwiseEpilogueChannels(outputRow + (size_t)x * channelBlock, channelNumber, blockEpilogue);
+					}
+				}
+				if (channelNumber < channelBlock) {
+					for (int x = 0; x < outputWidth; x++) {
+						std::fill(outputRow + (size_t)x * channelBlock + channelNumber, outputRow + (size_t)(x + 1) * channelBlock, 0.0f);
+					}
+				}
+			}
+		}
+	}
+}
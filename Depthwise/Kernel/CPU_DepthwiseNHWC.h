@@ -0,0 +1,275 @@
+#pragma once
+/*
+Depthwise Convolution on CPU, channels last.
+
+NHWC version of CPU_Depthwise_Generic() for torch.channels_last tensors. The channels of a pixel are contiguous,
+so the SIMD vectors run across channels instead of across the output width, and any filter size / stride gets
+full vectors as long as there are CPU_VECTOR_WIDTH channels.
+
+	1)	the filter is transposed once to [tap][channel]
+	2)	work is split across cores by (batch, output row) with OpenMP
+	3)	output rows whose whole window is inside the input use row kernels that keep the filter of a channel vector
+		in registers (3 x 3 and 5 x 5) and walk along the row; border pixels check every tap
+	4)	the epilogue is applied per pixel, vectorized across channels (scale / shift are per channel vectors too)
+	5)	fp16 / bf16 tensors are widened one filter window of input rows at a time, into per thread workspace rows
+*/
+#include <type_traits>
+#include "CPU_Depthwise.h"
+
+/*
+cpuDepthwiseNHWCPixel():
+	All channels of one output pixel, taps outside the input are skipped.
+*/
+inline void cpuDepthwiseNHWCPixel(const float* inputImage, const float* filterT, float* outputPixel,
+	int channel, int inputHeight, int inputWidth, int filterHeight, int filterWidth,
+	int firstInputY, int firstInputX, int dilationHeight, int dilationWidth, float alpha, float beta) {
+
+	int c = 0;
+	for (; c + CPU_VECTOR_WIDTH <= channel; c += CPU_VECTOR_WIDTH) {
+		cpuVector sum = cpuVectorZero();
+		for (int ky = 0; ky < filterHeight; ky++) {
+			int inputY = firstInputY + ky * dilationHeight;
+			if (inputY < 0 || inputY >= inputHeight) {
+				continue;
+			}
+			for (int kx = 0; kx < filterWidth; kx++) {
+				int inputX = firstInputX + kx * dilationWidth;
+				if (inputX < 0 || inputX >= inputWidth) {
+					continue;
+				}
+				const float* inputPixel = inputImage + ((size_t)inputY * inputWidth + inputX) * channel;
+				sum = cpuVectorFmadd(cpuVectorLoad(inputPixel + c), cpuVectorLoad(filterT + (size_t)(ky * filterWidth + kx) * channel + c), sum);
+			}
+		}
+		cpuVectorStore(outputPixel + c, cpuVectorFmadd(sum, cpuVectorSet(alpha), cpuVectorSet(beta)));
+	}
+	for (; c < channel; c++) {
+		float sum = 0.0f;
+		for (int ky = 0; ky < filterHeight; ky++) {
+			int inputY = firstInputY + ky * dilationHeight;
+			if (inputY < 0 || inputY >= inputHeight) {
+				continue;
+			}
+			for (int kx = 0; kx < filterWidth; kx++) {
+				int inputX = firstInputX + kx * dilationWidth;
+				if (inputX >= 0 && inputX < inputWidth) {
+					sum += inputImage[((size_t)inputY * inputWidth + inputX) * channel + c] * filterT[(size_t)(ky * filterWidth + kx) * channel + c];
+				}
+			}
+		}
+		outputPixel[c] = sum * alpha + beta;
+	}
+}
+
+/*
+cpuDepthwiseNHWCRow():
+	Output pixels [firstX, lastX) of one row whose whole FilterSize x FilterSize window is inside the input.
+	The filter of a channel vector stays in registers while the row is walked.
+*/
+template <int FilterSize>
+inline void cpuDepthwiseNHWCRow(const float* inputImage, const float* filterT, float* outputRow,
+	int channel, int inputWidth, int firstInputY, int firstX, int lastX, int strideWidth, int paddingWidth,
+	float alpha, float beta) {
+
+	cpuVector alphaVector = cpuVectorSet(alpha);
+	cpuVector betaVector = cpuVectorSet(beta);
+	size_t rowPitch = (size_t)inputWidth * channel;
+	const float* inputRows = inputImage + (size_t)firstInputY * rowPitch;
+
+	int c = 0;
+	for (; c + CPU_VECTOR_WIDTH <= channel; c += CPU_VECTOR_WIDTH) {
+		cpuVector weights[FilterSize * FilterSize];
+		for (int tap = 0; tap < FilterSize * FilterSize; tap++) {
+			weights[tap] = cpuVectorLoad(filterT + (size_t)tap * channel + c);
+		}
+		for (int x = firstX; x < lastX; x++) {
+			const float* window = inputRows + (size_t)(x * strideWidth - paddingWidth) * channel + c;
+			cpuVector sum = cpuVectorZero();
+			for (int ky = 0; ky < FilterSize; ky++) {
+				for (int kx = 0; kx < FilterSize; kx++) {
+					sum = cpuVectorFmadd(cpuVectorLoad(window + ky * rowPitch + (size_t)kx * channel), weights[ky * FilterSize + kx], sum);
+				}
+			}
+			cpuVectorStore(outputRow + (size_t)x * channel + c, cpuVectorFmadd(sum, alphaVector, betaVector));
+		}
+	}
+	for (; c < channel; c++) {
+		for (int x = firstX; x < lastX; x++) {
+			const float* window = inputRows + (size_t)(x * strideWidth - paddingWidth) * channel + c;
+			float sum = 0.0f;
+			for (int ky = 0; ky < FilterSize; ky++) {
+				for (int kx = 0; kx < FilterSize; kx++) {
+					sum += window[ky * rowPitch + (size_t)kx * channel] * filterT[(size_t)(ky * FilterSize + kx) * channel + c];
+				}
+			}
+			outputRow[(size_t)x * channel + c] = sum * alpha + beta;
+		}
+	}
+}
+
+/*
+cpuDepthwiseNHWCOutputRow():
+	One output row (all channels, no epilogue). Pixels whose window is inside the input use the row kernels
+	(3 x 3 and 5 x 5 without dilation), the rest check every tap.
+	inputImage / outputRow have channel values per pixel, filterT is [tap][channel].
+*/
+inline void cpuDepthwiseNHWCOutputRow(const float* inputImage, const float* filterT, float* outputRow,
+	int channel, int inputHeight, int inputWidth, int filterHeight, int filterWidth, int outputWidth, int outputY,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta) {
+
+	int firstInputY = outputY * strideHeight - paddingHeight;
+	bool insideRow = firstInputY >= 0 && firstInputY + (filterHeight - 1) * dilationHeight < inputHeight;
+
+	// output columns whose window is inside the input
+	int fastFilter = 0;
+	if (insideRow && filterHeight == filterWidth && dilationHeight == 1 && dilationWidth == 1 && (filterHeight == 3 || filterHeight == 5)) {
+		fastFilter = filterHeight;
+	}
+	int firstX = std::min(outputWidth, (paddingWidth + strideWidth - 1) / strideWidth);
+	int lastX = std::max(firstX, std::min(outputWidth, (inputWidth + paddingWidth - filterWidth) / strideWidth + 1));
+
+	if (fastFilter == 3) {
+		cpuDepthwiseNHWCRow<3>(inputImage, filterT, outputRow, channel, inputWidth, firstInputY,
+			firstX, lastX, strideWidth, paddingWidth, alpha, beta);
+	}
+	else if (fastFilter == 5) {
+		cpuDepthwiseNHWCRow<5>(inputImage, filterT, outputRow, channel, inputWidth, firstInputY,
+			firstX, lastX, strideWidth, paddingWidth, alpha, beta);
+	}
+	else {
+		firstX = lastX = 0;
+	}
+
+	for (int x = 0; x < outputWidth; x++) {
+		if (x == firstX && lastX > firstX) {
+			x = lastX - 1;
+			continue;
+		}
+		cpuDepthwiseNHWCPixel(inputImage, filterT, outputRow + (size_t)x * channel,
+			channel, inputHeight, inputWidth, filterHeight, filterWidth,
+			firstInputY, x * strideWidth - paddingWidth, dilationHeight, dilationWidth, alpha, beta);
+	}
+}
+
+/*
+cpuDepthwiseEpilogueChannels():
+	Apply the epilogue to all channels of one output pixel. Vectorized except SiLU.
+*/
+inline void cpuDepthwiseEpilogueChannels(float* outputPixel, int channel, const DepthwiseEpilogue& epilogue) {
+	int c = 0;
+	if (epilogue.activation != DepthwiseActivationSiLU) {
+		for (; c + CPU_VECTOR_WIDTH <= channel; c += CPU_VECTOR_WIDTH) {
+			cpuVector scaleVector = epilogue.scale ? cpuVectorLoad(epilogue.scale + c) : cpuVectorSet(1.0f);
+			cpuVector shiftVector = epilogue.shift ? cpuVectorLoad(epilogue.shift + c) : cpuVectorZero();
+			cpuVector value = cpuVectorFmadd(cpuVectorLoad(outputPixel + c), scaleVector, shiftVector);
+			cpuVectorStore(outputPixel + c, cpuVectorActivate(value, epilogue.activation));
+		}
+	}
+	for (; c < channel; c++) {
+		outputPixel[c] = DepthwiseChannelEpilogue(epilogue, c).apply(outputPixel[c]);
+	}
+}
+
+/*
+cpuDepthwiseNHWCWindow():
+	16-bit input: widen the input rows under the filter window of output row outputY into window and return the
+	paddingHeight / inputHeight of that window, so cpuDepthwiseNHWCOutputRow() can run on it as on a whole image.
+	Rows outside the input are left out, the taps on them are skipped as usual.
+*/
+template <typename scalar_t>
+inline void cpuDepthwiseNHWCWindow(const scalar_t* inputImage, float* window, int channel, int inputHeight, int inputWidth,
+	int filterHeight, int outputY, int paddingHeight, int strideHeight, int dilationHeight,
+	int& windowPadding, int& windowHeight) {
+
+	int firstInputY = outputY * strideHeight - paddingHeight;
+	int firstRow = std::max(0, firstInputY);
+	int lastRow = std::min(inputHeight, firstInputY + (filterHeight - 1) * dilationHeight + 1);
+	size_t rowPitch = (size_t)inputWidth * channel;
+
+	windowHeight = std::max(0, lastRow - firstRow);
+	windowPadding = firstRow - firstInputY;
+	cpuDepthwiseLoad(inputImage + (size_t)firstRow * rowPitch, window, (int)(windowHeight * rowPitch));
+}
+
+/*
+CPU_Depthwise_NHWC():
+	Depthwise convolution of a whole NHWC tensor on the host, for any filter size, padding, stride and dilation.
+	Same arguments as CPU_Depthwise_Generic(), filter is (channel, filterHeight, filterWidth).
+	scalar_t is float, DepthwiseHalf or DepthwiseBFloat16: a 16-bit tensor is widened one filter window of input
+	rows at a time and each output row is rounded back as it is done, no float copy of the tensors is made.
+	The transposed filter and the per thread rows live in workspace, nullptr for a workspace of this call only.
+*/
+template <typename scalar_t>
+inline void CPU_Depthwise_NHWC(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, DepthwiseCpuWorkspace* workspace = nullptr) {
+
+	DepthwiseCpuWorkspace callWorkspace;
+	if (workspace == nullptr) {
+		workspace = &callWorkspace;
+	}
+
+	bool hasEpilogue = epilogue.scale != nullptr || epilogue.shift != nullptr || epilogue.activation != DepthwiseActivationNone;
+	bool floatStorage = std::is_same<scalar_t, float>::value;
+	int filterSize = filterHeight * filterWidth;
+
+	float* filterT = depthwiseWorkspaceBuffer(workspace->filter, (size_t)filterSize * inputChannel);
+	for (int c = 0; c < inputChannel; c++) {
+		for (int tap = 0; tap < filterSize; tap++) {
+			filterT[(size_t)tap * inputChannel + c] = depthwiseToFloat(filter[(size_t)c * filterSize + tap]);
+		}
+	}
+
+	// 16-bit storage: the input rows of one filter window, then the float output row
+	size_t windowSize = floatStorage ? 0 : (size_t)((filterHeight - 1) * dilationHeight + 1) * inputWidth * inputChannel;
+	size_t rowSize = floatStorage ? 0 : (size_t)outputWidth * outputChannel;
+	int threadNumber = cpuDepthwiseThreadNumber(0);
+	depthwiseWorkspaceThreads(*workspace, threadNumber);
+
+#pragma omp parallel num_threads(threadNumber)
+	{
+#ifdef _OPENMP
+		int thread = omp_get_thread_num();
+#else
+		int thread = 0;
+#endif
+		float* window = depthwiseWorkspaceBuffer(workspace->threadBuffers[thread], windowSize + rowSize);
+		float* scratchRow = window + windowSize;
+
+#pragma omp for collapse(2) schedule(static)
+		for (int n = 0; n < outputBatchNumber; n++) {
+			for (int y = 0; y < outputHeight; y++) {
+				const scalar_t* inputImage = input + (size_t)n * inputHeight * inputWidth * inputChannel;
+				scalar_t* outputRow = output + ((size_t)n * outputHeight + y) * outputWidth * outputChannel;
+				float* rowData = cpuDepthwiseRowData(outputRow, scratchRow);
+
+				if (floatStorage) {
+					cpuDepthwiseNHWCOutputRow(reinterpret_cast<const float*>(inputImage), filterT, rowData,
+						inputChannel, inputHeight, inputWidth, filterHeight, filterWidth, outputWidth, y,
+						paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+						alpha, beta);
+				}
+				else {
+					int windowPadding, windowHeight;
+					cpuDepthwiseNHWCWindow(inputImage, window, inputChannel, inputHeight, inputWidth,
+						filterHeight, y, paddingHeight, strideHeight, dilationHeight, windowPadding, windowHeight);
+					cpuDepthwiseNHWCOutputRow(window, filterT, rowData,
+						inputChannel, windowHeight, inputWidth, filterHeight, filterWidth, outputWidth, 0,
+						windowPadding, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+						alpha, beta);
+				}
+
+				if (hasEpilogue) {
+					for (int x = 0; x < outputWidth; x++) {
+						cpuDepthwiseEpilogueChannels(rowData + (size_t)x * outputChannel, outputChannel, epilogue);
+					}
+				}
+				cpuDepthwiseStore(rowData, outputRow, outputWidth * outputChannel);
+			}
+		}
+	}
+}
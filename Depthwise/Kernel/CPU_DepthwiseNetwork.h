@@ -0,0 +1,140 @@
+#pragma once
+/*
+Depthwise Separable Network on CPU.
+
+Runs a DepthwiseNetworkPlan (DepthwiseNetwork.h) on the host: depthwise steps through CPU_Depthwise_Tuned(),
+pointwise steps through CPU_Pointwise(), fused steps through CPU_DepthwisePointwise(), all of them with one
+DepthwiseCpuWorkspace. The activations live in the planned buffers, the residuals are added in place.
+
+Before a step starts, the weights of the next step are prefetched into L2 (up to cpuNetworkPrefetchBytes), so the
+first tiles of the next layer do not wait for its filter.
+*/
+#include <vector>
+
+#include "DepthwiseNetwork.h"
+#include "CPU_DepthwiseTuning.h"
+#include "CPU_DepthwisePointwise.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+const size_t cpuNetworkPrefetchBytes = 512 * 1024;
+
+/*
+cpuPrefetchL2():
+	Prefetch bytes from data into L2, one request per 64 byte line.
+*/
+inline void cpuPrefetchL2(const void* data, size_t bytes) {
+#if defined(__SSE__)
+	const char* begin = static_cast<const char*>(data);
+	for (size_t offset = 0; offset < bytes; offset += 64) {
+		_mm_prefetch(begin + offset, _MM_HINT_T1);
+	}
+#endif
+}
+
+/*
+DepthwiseCpuNetworkBackend:
+	The backend of runDepthwiseNetwork() on the host, float activations and weights.
+*/
+struct DepthwiseCpuNetworkBackend {
+	int batch;
+	const float* input;
+	float* output;
+	float* const* buffers;
+	DepthwiseCpuWorkspace* workspace;
+
+	const float* source(int buffer) const {
+		return buffer == DepthwiseNetworkInput ? input : buffers[buffer];
+	}
+
+	float* destination(int buffer) const {
+		return buffer == DepthwiseNetworkOutput ? output : buffers[buffer];
+	}
+
+	void prefetch(const DepthwiseNetworkLayer& layer, size_t weights) {
+		if (layer.filter != nullptr) {
+			cpuPrefetchL2(layer.filter, std::min(weights * sizeof(float), cpuNetworkPrefetchBytes));
+		}
+	}
+
+	void depthwise(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& layer) {
+		CPU_Depthwise_Tuned(source(step.inputBuffer), static_cast<const float*>(layer.filter), destination(step.outputBuffer),
+			batch, step.inputChannel, step.inputHeight, step.inputWidth,
+			step.inputChannel, step.filterSize, step.filterSize,
+			batch, step.outputChannel, step.outputHeight, step.outputWidth,
+			step.padding, step.padding, step.stride, step.stride, 1, 1,
+			1.0f, 0.0f, layer.epilogue, workspace);
+	}
+
+	void pointwise(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& layer) {
+		CPU_Pointwise(source(step.inputBuffer), static_cast<const float*>(layer.filter), destination(step.outputBuffer),
+			batch, step.inputChannel, step.inputHeight, step.inputWidth,
+			step.outputChannel,
+			1.0f, 0.0f, layer.epilogue);
+	}
+
+	void fused(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& depthwise, const DepthwiseNetworkLayer& pointwise) {
+		CPU_DepthwisePointwise(source(step.inputBuffer), static_cast<const float*>(depthwise.filter),
+			static_cast<const float*>(pointwise.filter), destination(step.outputBuffer),
+			batch, step.inputChannel, step.inputHeight, step.inputWidth,
+			step.filterSize, step.filterSize,
+			step.outputChannel, step.outputHeight, step.outputWidth,
+			step.padding, step.stride,
+			depthwise.epilogue, pointwise.epilogue, workspace);
+	}
+
+	void addResidual(const DepthwiseNetworkStep& step) {
+		const float* residual = source(step.residualBuffer);
+		float* data = destination(step.outputBuffer);
+		long size = (long)step.outputSize(batch);
+#pragma omp parallel for schedule(static)
+		for (long i = 0; i < size; i++) {
+			data[i] += residual[i];
+		}
+	}
+};
+
+/*
+CPU_DepthwiseNetwork():
+	Run plan on input (plan.batch x plan.inputChannel x plan.inputHeight x plan.inputWidth) into output. layers hold
+	float weights (filter) and epilogues. buffers has plan.bufferSizes.size() arrays of plan.bufferSizes[i] floats,
+	workspace is the scratch memory of the depthwise and fused steps (nullptr: allocated per layer).
+*/
+inline void CPU_DepthwiseNetwork(const DepthwiseNetworkPlan& plan, const std::vector<DepthwiseNetworkLayer>& layers,
+	const float* input, float* output, float* const* buffers, DepthwiseCpuWorkspace* workspace) {
+
+	DepthwiseCpuNetworkBackend backend = { plan.batch, input, output, buffers, workspace };
+	runDepthwiseNetwork(plan, layers, backend);
+}
+
+/*
+DepthwiseCpuNetwork:
+	A network planned for one input shape, with its buffers and workspace: run() allocates nothing once the first
+	call has grown the workspace.
+*/
+struct DepthwiseCpuNetwork {
+	std::vector<DepthwiseNetworkLayer> layers;
+	DepthwiseNetworkPlan plan;
+	std::vector<std::vector<float> > bufferStorage;
+	std::vector<float*> buffers;
+	DepthwiseCpuWorkspace workspace;
+
+	bool prepare(int batch, int channel, int height, int width, bool fuse = true) {
+		if (!planDepthwiseNetwork(layers, batch, channel, height, width, fuse, plan)) {
+			return false;
+		}
+		bufferStorage.resize(plan.bufferSizes.size());
+		buffers.resize(plan.bufferSizes.size());
+		for (size_t i = 0; i < plan.bufferSizes.size(); i++) {
+			bufferStorage[i].resize(plan.bufferSizes[i]);
+			buffers[i] = bufferStorage[i].data();
+		}
+		return true;
+	}
+
+	void run(const float* input, float* output) {
+		CPU_DepthwiseNetwork(plan, layers, input, output, buffers.data(), &workspace);
+	}
+};
@@ -0,0 +1,126 @@
+#pragma once
+/*
+Depthwise Separable Block on CPU.
+
+Depthwise convolution (with its epilogue, e.g. BatchNorm + ReLU6) followed by a pointwise (1 x 1) convolution
+(with its epilogue), without writing the depthwise output to memory.
+Each task takes a band of output rows of one image, computes the depthwise output of the band for every
+channel into a thread local tile that stays in cache, and immediately multiplies it with the pointwise filter.
+The band is sized so the tile is about 128 KB.
+
+	input				N x inputChannel x inputHeight x inputWidth
+	depthwiseFilter		inputChannel x filterHeight x filterWidth
+	pointwiseFilter		outputChannel x inputChannel
+	output				N x outputChannel x outputHeight x outputWidth
+*/
+#include <type_traits>
+#include "CPU_Depthwise.h"
+#include "CPU_Pointwise.h"
+
+/*
+CPU_DepthwisePointwise():
+	Fused depthwise separable block of a whole NCHW tensor on the host.
+	padding and stride are used on both height and width, the depthwise channel multiplier is 1.
+	The padded band and the tile of every thread live in workspace, nullptr for a workspace of this call only.
+	scalar_t is float, DepthwiseHalf or DepthwiseBFloat16: a 16-bit input is widened as the band is padded and the
+	pointwise output of a band is rounded back from a per thread float tile.
+*/
+template <typename scalar_t>
+inline void CPU_DepthwisePointwise(const scalar_t* input, const scalar_t* depthwiseFilter, const scalar_t* pointwiseFilter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth,
+	int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	DepthwiseEpilogue depthwiseEpilogue, DepthwiseEpilogue pointwiseEpilogue, DepthwiseCpuWorkspace* workspace = nullptr) {
+
+	DepthwiseCpuWorkspace callWorkspace;
+	if (workspace == nullptr) {
+		workspace = &callWorkspace;
+	}
+
+	const size_t tileBytes = 128 * 1024;
+
+	bool hasDepthwiseEpilogue = depthwiseEpilogue.scale != nullptr || depthwiseEpilogue.shift != nullptr ||
+		depthwiseEpilogue.activation != DepthwiseActivationNone;
+	bool hasPointwiseEpilogue = pointwiseEpilogue.scale != nullptr || pointwiseEpilogue.shift != nullptr ||
+		pointwiseEpilogue.activation != DepthwiseActivationNone;
+
+	int bandHeight = (int)(tileBytes / ((size_t)inputChannel * outputWidth * sizeof(float)));
+	bandHeight = std::max(1, std::min(bandHeight, outputHeight));
+	int bandNumber = (outputHeight + bandHeight - 1) / bandHeight;
+
+	int paddedRows = (bandHeight - 1) * stride + filterHeight;
+	int paddedWidth = std::max(inputWidth + 2 * padding, (outputWidth - 1) * stride + filterWidth);
+	int paddedPitch = paddedWidth + 2 * CPU_VECTOR_WIDTH;
+	int fastFilter = filterHeight == filterWidth ? filterHeight : 0;
+	int tilePitch = bandHeight * outputWidth;
+	int outputPlaneSize = outputHeight * outputWidth;
+
+	const float* depthwiseFilterData = cpuDepthwiseFloatData(depthwiseFilter, (size_t)inputChannel * filterHeight * filterWidth, workspace->filter);
+	const float* pointwiseFilterData = cpuDepthwiseFloatData(pointwiseFilter, (size_t)outputChannel * inputChannel, workspace->blockedFilter);
+
+	// 16-bit storage: the pointwise output of the band before it is rounded
+	bool floatStorage = std::is_same<scalar_t, float>::value;
+	size_t outputTileSize = floatStorage ? 0 : (size_t)outputChannel * tilePitch;
+
+	int threadNumber = cpuDepthwiseThreadNumber(0);
+	depthwiseWorkspaceThreads(*workspace, threadNumber);
+
+#pragma omp parallel num_threads(threadNumber)
+	{
+#ifdef _OPENMP
+		int thread = omp_get_thread_num();
+#else
+		int thread = 0;
+#endif
+		size_t paddedSize = (size_t)paddedRows * paddedPitch;
+		size_t tileSize = (size_t)inputChannel * tilePitch;
+		float* paddedBand = depthwiseWorkspaceBuffer(workspace->threadBuffers[thread], paddedSize + tileSize + outputTileSize);
+		float* tile = paddedBand + paddedSize;
+		float* outputTile = tile + tileSize;
+
+#pragma omp for collapse(2) schedule(static)
+		for (int n = 0; n < inputBatchNumber; n++) {
+			for (int band = 0; band < bandNumber; band++) {
+				int firstOutputRow = band * bandHeight;
+				int outputRows = std::min(bandHeight, outputHeight - firstOutputRow);
+				int bandRows = (outputRows - 1) * stride + filterHeight;
+
+				// depthwise output of the band, every channel
+				for (int c = 0; c < inputChannel; c++) {
+					const scalar_t* inputPlane = input + ((size_t)n * inputChannel + c) * inputHeight * inputWidth;
+					const float* channelFilter = depthwiseFilterData + (size_t)c * filterHeight * filterWidth;
+					DepthwiseChannelEpilogue channelEpilogue(depthwiseEpilogue, c);
+
+					cpuDepthwisePadRows(inputPlane, inputHeight, inputWidth, padding, padding,
+						firstOutputRow * stride, bandRows, paddedBand, paddedPitch);
+
+					for (int y = 0; y < outputRows; y++) {
+						float* tileRow = tile + (size_t)c * tilePitch + (size_t)y * outputWidth;
+						cpuDepthwiseComputeRow(paddedBand + (size_t)y * stride * paddedPitch, paddedPitch, channelFilter,
+							fastFilter, filterHeight, filterWidth, stride, 1, 1,
+							tileRow, outputWidth, 1.0f, 0.0f);
+						if (hasDepthwiseEpilogue) {
+							cpuDepthwiseEpilogueRow(tileRow, outputWidth, channelEpilogue);
+						}
+					}
+				}
+
+				// pointwise straight from the tile, into the output (float) or the output tile (16-bit)
+				int pixelNumber = outputRows * outputWidth;
+				scalar_t* outputBand = output + (size_t)n * outputChannel * outputPlaneSize + (size_t)firstOutputRow * outputWidth;
+				float* bandData = cpuDepthwiseRowData(outputBand, outputTile);
+				int bandPitch = floatStorage ? outputPlaneSize : tilePitch;
+				cpuPointwiseTile(pointwiseFilterData, inputChannel, inputChannel, outputChannel,
+					tile, tilePitch, pixelNumber, bandData, bandPitch, false);
+
+				for (int co = 0; co < outputChannel; co++) {
+					if (hasPointwiseEpilogue) {
+						cpuDepthwiseEpilogueRow(bandData + (size_t)co * bandPitch, pixelNumber, DepthwiseChannelEpilogue(pointwiseEpilogue, co));
+					}
+					cpuDepthwiseStore(bandData + (size_t)co * bandPitch, outputBand + (size_t)co * outputPlaneSize, pixelNumber);
+				}
+			}
+		}
+	}
+}
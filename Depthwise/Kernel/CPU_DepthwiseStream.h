@@ -0,0 +1,351 @@
+#pragma once
+/*
+Out-of-core Depthwise Convolution on CPU.
+
+CPU_Depthwise_Stream() convolves inputs too large to hold in memory (gigapixel scans, satellite tiles): the input
+is read in bands of rows, every band is convolved and its output rows are written out before the next band is
+read. Only one band of input rows (with its halo) and one band of output rows are in memory, so the peak memory
+depends on the band height and the image width, not on the image height or the channel number
+(depthwiseStreamBytes()).
+
+	1)	the planes are streamed one after the other, top to bottom: a source and a sink backed by a file are
+		accessed sequentially
+	2)	the halo rows a band shares with the previous one ((filter - 1) * dilation + 1 - stride rows) are kept
+		in the band buffer, so every input row is read once
+	3)	the output rows of a band are computed by every OpenMP thread with the row kernels of CPU_Depthwise.h
+		(SIMD for 3 x 3 / 5 x 5), the epilogue is applied before the band is written. Reads and writes are
+		done by the calling thread only, so sources and sinks need not be thread safe
+
+The result is the same as CPU_Depthwise_Generic() on the whole tensor.
+
+The source and the sink are any objects with
+	bool read(int n, int c, int firstRow, int rowNumber, float* rows, size_t pitch)
+		input rows [firstRow, firstRow + rowNumber) of plane (n, c), row i to rows + i * pitch
+	bool write(int n, int c, int firstRow, int rowNumber, const float* rows)
+		output rows [firstRow, firstRow + rowNumber) of plane (n, c), outputWidth floats apart
+DepthwiseMappedSource reads a raw NCHW float file through mmap, DepthwiseFileSink writes one.
+*/
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "CPU_Depthwise.h"
+
+/*
+DepthwiseStreamSchedule:
+	bandRows     - output rows per band, 0 for depthwiseStreamBandRows
+	threadNumber - OpenMP threads computing the rows of a band, 0 for the OpenMP default
+*/
+struct DepthwiseStreamSchedule {
+	int bandRows;
+	int threadNumber;
+};
+
+const int depthwiseStreamBandRows = 64;
+
+const DepthwiseStreamSchedule depthwiseDefaultStreamSchedule = { 0, 0 };
+
+/*
+DepthwiseStreamBand:
+	Sizes of the band buffers of one problem.
+*/
+struct DepthwiseStreamBand {
+	int bandRows;
+	int inputRows;
+	int paddedPitch;
+
+	DepthwiseStreamBand(int inputWidth, int filterHeight, int filterWidth, int outputHeight, int outputWidth,
+		int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth, int scheduleRows) {
+
+		bandRows = scheduleRows > 0 ? scheduleRows : depthwiseStreamBandRows;
+		bandRows = std::max(1, std::min(bandRows, outputHeight));
+		inputRows = (bandRows - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+		int paddedWidth = std::max(inputWidth + 2 * paddingWidth, (outputWidth - 1) * strideWidth + (filterWidth - 1) * dilationWidth + 1);
+		paddedPitch = paddedWidth + 2 * CPU_VECTOR_WIDTH;
+	}
+
+	size_t floats(int outputWidth) const {
+		return (size_t)inputRows * paddedPitch + (size_t)bandRows * outputWidth;
+	}
+};
+
+/*
+depthwiseStreamBytes():
+	The memory CPU_Depthwise_Stream() allocates for a problem: the padded input band and the output band.
+*/
+inline size_t depthwiseStreamBytes(int inputWidth, int filterHeight, int filterWidth, int outputHeight, int outputWidth,
+	int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	DepthwiseStreamSchedule schedule) {
+
+	DepthwiseStreamBand band(inputWidth, filterHeight, filterWidth, outputHeight, outputWidth,
+		paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth, schedule.bandRows);
+	return band.floats(outputWidth) * sizeof(float);
+}
+
+/*
+cpuDepthwiseStreamRows():
+	Read padded rows [firstRow, firstRow + rowNumber) of plane (n, c) from source into the band buffer, the rows
+	and columns outside the input are zeros (the same rows as cpuDepthwisePadRows()).
+*/
+template <typename Source>
+inline bool cpuDepthwiseStreamRows(Source& source, int n, int c, int inputHeight, int inputWidth,
+	int paddingHeight, int paddingWidth, int firstRow, int rowNumber, float* paddedRows, int paddedPitch) {
+
+	// rows of the input inside [firstRow, firstRow + rowNumber) of the padded plane
+	int firstInput = std::max(firstRow, paddingHeight);
+	int lastInput = std::min(firstRow + rowNumber, paddingHeight + inputHeight);
+
+	for (int row = 0; row < rowNumber; row++) {
+		float* dstRow = paddedRows + (size_t)row * paddedPitch;
+		int y = firstRow + row;
+		if (y < firstInput || y >= lastInput) {
+			std::fill(dstRow, dstRow + paddedPitch, 0.0f);
+			continue;
+		}
+		std::fill(dstRow, dstRow + paddingWidth, 0.0f);
+		std::fill(dstRow + paddingWidth + inputWidth, dstRow + paddedPitch, 0.0f);
+	}
+	if (firstInput >= lastInput) {
+		return true;
+	}
+	return source.read(n, c, firstInput - paddingHeight, lastInput - firstInput,
+		paddedRows + (size_t)(firstInput - firstRow) * paddedPitch + paddingWidth, (size_t)paddedPitch);
+}
+
+/*
+CPU_Depthwise_Stream():
+	Depthwise convolution of a batchNumber x channel x inputHeight x inputWidth input read from source, written to
+	sink, band by band (see the top of the file). filter is channel x filterHeight x filterWidth floats.
+	Returns false as soon as a read or a write fails; the rows written before that are left in the sink.
+	The band buffers live in workspace (its first thread buffer), nullptr for a workspace of this call only.
+*/
+template <typename Source, typename Sink>
+inline bool CPU_Depthwise_Stream(Source& source, const float* filter, Sink& sink,
+	int batchNumber, int channel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, DepthwiseStreamSchedule schedule,
+	DepthwiseCpuWorkspace* workspace = nullptr) {
+
+	DepthwiseCpuWorkspace callWorkspace;
+	if (workspace == nullptr) {
+		workspace = &callWorkspace;
+	}
+
+	bool hasEpilogue = epilogue.scale != nullptr || epilogue.shift != nullptr || epilogue.activation != DepthwiseActivationNone;
+
+	DepthwiseStreamBand band(inputWidth, filterHeight, filterWidth, outputHeight, outputWidth,
+		paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth, schedule.bandRows);
+	int paddedPitch = band.paddedPitch;
+	int filterSize = filterHeight * filterWidth;
+	int span = (filterHeight - 1) * dilationHeight + 1;
+
+	int fastFilter = cpuDepthwiseFastFilter(filterHeight, filterWidth, strideHeight, strideWidth, dilationHeight, dilationWidth);
+	int threadNumber = cpuDepthwiseThreadNumber(schedule.threadNumber);
+
+	depthwiseWorkspaceThreads(*workspace, 1);
+	float* paddedRows = depthwiseWorkspaceBuffer(workspace->threadBuffers[0], band.floats(outputWidth));
+	float* outputRows = paddedRows + (size_t)band.inputRows * paddedPitch;
+
+	for (int n = 0; n < batchNumber; n++) {
+		for (int c = 0; c < channel; c++) {
+			const float* channelFilter = filter + (size_t)c * filterSize;
+			DepthwiseChannelEpilogue channelEpilogue(epilogue, c);
+
+			// padded rows [bufferedRow, bufferedRow + bufferedNumber) are in the band buffer
+			int bufferedRow = 0;
+			int bufferedNumber = 0;
+			for (int firstRow = 0; firstRow < outputHeight; firstRow += band.bandRows) {
+				int rowNumber = std::min(band.bandRows, outputHeight - firstRow);
+				int neededRow = firstRow * strideHeight;
+				int neededNumber = (rowNumber - 1) * strideHeight + span;
+
+				// the halo of the previous band moves to the top of the buffer
+				int kept = std::max(0, std::min(bufferedRow + bufferedNumber - neededRow, neededNumber));
+				if (kept > 0 && neededRow != bufferedRow) {
+					memmove(paddedRows, paddedRows + (size_t)(neededRow - bufferedRow) * paddedPitch,
+						(size_t)kept * paddedPitch * sizeof(float));
+				}
+				if (!cpuDepthwiseStreamRows(source, n, c, inputHeight, inputWidth, paddingHeight, paddingWidth,
+					neededRow + kept, neededNumber - kept, paddedRows + (size_t)kept * paddedPitch, paddedPitch)) {
+					return false;
+				}
+				bufferedRow = neededRow;
+				bufferedNumber = neededNumber;
+
+#pragma omp parallel for num_threads(threadNumber) schedule(static)
+				for (int y = 0; y < rowNumber; y++) {
+					float* outputRow = outputRows + (size_t)y * outputWidth;
+					cpuDepthwiseComputeRow(paddedRows + (size_t)y * strideHeight * paddedPitch, paddedPitch, channelFilter,
+						fastFilter, filterHeight, filterWidth, strideWidth, dilationHeight, dilationWidth,
+						outputRow, outputWidth, alpha, beta);
+					if (hasEpilogue) {
+						cpuDepthwiseEpilogueRow(outputRow, outputWidth, channelEpilogue);
+					}
+				}
+
+				if (!sink.write(n, c, firstRow, rowNumber, outputRows)) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/*
+DepthwiseMappedSource:
+	Source of CPU_Depthwise_Stream() reading a raw batch x channel x height x width float file (no header) through
+	mmap. The pages of the rows read are dropped from the resident set once they are copied, so reading a file
+	larger than the memory does not evict everything else.
+*/
+struct DepthwiseMappedSource {
+	int channel;
+	int height;
+	int width;
+	const float* data;
+	size_t bytes;
+	std::string error;
+
+	DepthwiseMappedSource() : channel(0), height(0), width(0), data(nullptr), bytes(0) {}
+
+	~DepthwiseMappedSource() {
+		close();
+	}
+
+	/*
+	open():
+		Map path, which must hold exactly batch x channel x height x width floats. Returns false, with error set,
+		otherwise.
+	*/
+	bool open(const std::string& path, int batch, int channel, int height, int width) {
+		close();
+		this->channel = channel;
+		this->height = height;
+		this->width = width;
+
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			error = "cannot open " + path + ": " + strerror(errno);
+			return false;
+		}
+		struct stat status;
+		size_t expected = (size_t)batch * channel * height * width * sizeof(float);
+		if (fstat(file, &status) != 0 || (size_t)status.st_size != expected) {
+			error = path + ": expected " + std::to_string(expected) + " bytes";
+			::close(file);
+			return false;
+		}
+		void* mapped = expected > 0 ? mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, file, 0) : nullptr;
+		::close(file);
+		if (mapped == MAP_FAILED) {
+			error = "cannot map " + path + ": " + strerror(errno);
+			return false;
+		}
+		if (mapped != nullptr) {
+			madvise(mapped, expected, MADV_SEQUENTIAL);
+		}
+		data = static_cast<const float*>(mapped);
+		bytes = expected;
+		return true;
+	}
+
+	void close() {
+		if (data != nullptr) {
+			munmap(const_cast<float*>(data), bytes);
+		}
+		data = nullptr;
+		bytes = 0;
+	}
+
+	bool read(int n, int c, int firstRow, int rowNumber, float* rows, size_t pitch) {
+		const float* src = data + (((size_t)n * channel + c) * height + firstRow) * width;
+		for (int row = 0; row < rowNumber; row++) {
+			memcpy(rows + (size_t)row * pitch, src + (size_t)row * width, (size_t)width * sizeof(float));
+		}
+
+		// whole pages before the end of the rows just read
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		size_t begin = (size_t)(reinterpret_cast<const char*>(src) - reinterpret_cast<const char*>(data)) / page * page;
+		size_t end = (size_t)(reinterpret_cast<const char*>(src + (size_t)rowNumber * width) - reinterpret_cast<const char*>(data)) / page * page;
+		if (end > begin) {
+			madvise(const_cast<char*>(reinterpret_cast<const char*>(data)) + begin, end - begin, MADV_DONTNEED);
+		}
+		return true;
+	}
+};
+
+/*
+DepthwiseFileSink:
+	Sink of CPU_Depthwise_Stream() writing a raw batch x channel x height x width float file with pwrite.
+*/
+struct DepthwiseFileSink {
+	int channel;
+	int height;
+	int width;
+	int file;
+	std::string error;
+
+	DepthwiseFileSink() : channel(0), height(0), width(0), file(-1) {}
+
+	~DepthwiseFileSink() {
+		close();
+	}
+
+	/*
+	open():
+		Create (or truncate) path and size it for batch x channel x height x width floats. Returns false, with
+		error set, when it cannot.
+	*/
+	bool open(const std::string& path, int batch, int channel, int height, int width) {
+		close();
+		this->channel = channel;
+		this->height = height;
+		this->width = width;
+
+		file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (file < 0 || ftruncate(file, (off_t)((size_t)batch * channel * height * width * sizeof(float))) != 0) {
+			error = "cannot create " + path + ": " + strerror(errno);
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	/*
+	close():
+		Close the file. Returns false, with error set, when the last writes could not be flushed.
+	*/
+	bool close() {
+		bool closed = file < 0 || ::close(file) == 0;
+		if (!closed) {
+			error = std::string("cannot close the output: ") + strerror(errno);
+		}
+		file = -1;
+		return closed;
+	}
+
+	bool write(int n, int c, int firstRow, int rowNumber, const float* rows) {
+		const char* src = reinterpret_cast<const char*>(rows);
+		size_t size = (size_t)rowNumber * width * sizeof(float);
+		off_t offset = (off_t)((((size_t)n * channel + c) * height + firstRow) * width * sizeof(float));
+		while (size > 0) {
+			ssize_t written = pwrite(file, src, size, offset);
+			if (written <= 0) {
+				error = std::string("cannot write the output: ") + strerror(errno);
+				return false;
+			}
+			src += written;
+			size -= (size_t)written;
+			offset += written;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,275 @@
+#pragma once
+/*
+Autotuned Depthwise Convolution on CPU.
+
+CPU_Depthwise_Tuned() takes the arguments of CPU_Depthwise_Generic() and runs the fastest CPU variant of the
+problem, picked by the autotuner (DepthwiseTuning.h) the first time the problem is seen and read from the
+tuning file after that. Candidates:
+	1)	whole planes per task, every thread (CPU_Depthwise_Generic(), the default)
+	2)	bands of 16 (or 4, when there are fewer planes than threads) output rows per task
+	3)	half the threads, on hosts with 4 or more (memory bound layers often do not scale to every core)
+	4)	float only: NCHWc (CPU_DepthwiseNCHWc.h) with the input / filter / output reorders, so it only wins when
+		the blocked kernel pays for them
+	5)	float 3 x 3 stride 1 only: Winograd F(2 x 2, 3 x 3) and F(4 x 4, 3 x 3) (CPU_DepthwiseWinograd.h), also
+		through NCHWc. Its output is compared with the one of the direct default the first time it runs, a tile
+		whose error is above depthwiseWinogradTolerance is not a candidate
+
+The host fingerprint is the CPU model, the thread number and the SIMD width of the build, so a record is not
+reused by another machine or by a build with another instruction set.
+*/
+#include <chrono>
+
+#include "CPU_Depthwise.h"
+#include "CPU_DepthwiseNCHWc.h"
+#include "CPU_DepthwiseWinograd.h"
+#include "DepthwiseTuning.h"
+
+/*
+depthwiseCpuFingerprint():
+	"cpu:<model name>:t<threads>:v<CPU_VECTOR_WIDTH>", spaces replaced with '_'.
+*/
+inline const std::string& depthwiseCpuFingerprint() {
+	static const std::string fingerprint = [] {
+		std::string model = "unknown";
+		FILE* file = fopen("/proc/cpuinfo", "r");
+		if (file != nullptr) {
+			char line[512];
+			while (fgets(line, sizeof(line), file) != nullptr) {
+				if (strncmp(line, "model name", 10) == 0 && strchr(line, ':') != nullptr) {
+					model = strchr(line, ':') + 1;
+					break;
+				}
+			}
+			fclose(file);
+		}
+		size_t first = model.find_first_not_of(" \t");
+		size_t last = model.find_last_not_of(" \t\r\n");
+		model = first == std::string::npos ? std::string("unknown") : model.substr(first, last - first + 1);
+
+		char text[640];
+		snprintf(text, sizeof(text), "cpu:%s:t%d:v%d", model.c_str(), cpuDepthwiseThreadNumber(0), CPU_VECTOR_WIDTH);
+		return depthwiseFingerprintToken(text);
+	}();
+	return fingerprint;
+}
+
+/*
+cpuDepthwiseTuningCandidates():
+	Candidate variants of a problem, the default first.
+*/
+inline std::vector<DepthwiseTuningConfig> cpuDepthwiseTuningCandidates(bool floatData, int batch, int channel, int outputHeight,
+	bool winograd = false) {
+	int threadNumber = cpuDepthwiseThreadNumber(0);
+	std::vector<DepthwiseTuningConfig> candidates;
+	candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 0, 0));
+	if (outputHeight > 16) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 16, 0));
+	}
+	if (outputHeight > 4 && batch * channel < 2 * threadNumber) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 4, 0));
+	}
+	if (threadNumber >= 4) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 0, threadNumber / 2));
+	}
+	if (floatData && CPU_VECTOR_WIDTH > 1) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuNCHWc, cpuDepthwiseNCHWcBlock(), 0, 0));
+	}
+	if (floatData && winograd) {
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuWinograd, 2, 0, 0));
+		candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuWinograd, 4, 0, 0));
+	}
+	return candidates;
+}
+
+/*
+cpuDepthwiseRunNCHWc():
+	NCHW in and out through the blocked layout, the blocked copies live in workspace. Float only, the tuner
+	never offers it for 16-bit data.
+*/
+inline void cpuDepthwiseRunNCHWc(const float* input, const float* filter, float* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, int channelBlock, DepthwiseCpuWorkspace& workspace) {
+
+	float* blockedInput = depthwiseWorkspaceBuffer(workspace.blockedInput,
+		cpuDepthwiseNCHWcSize(inputBatchNumber, inputChannel, inputHeight, inputWidth, channelBlock));
+	float* blockedFilter = depthwiseWorkspaceBuffer(workspace.blockedFilter,
+		cpuDepthwiseNCHWcSize(1, outputChannel, filterHeight, filterWidth, channelBlock));
+	float* blockedOutput = depthwiseWorkspaceBuffer(workspace.blockedOutput,
+		cpuDepthwiseNCHWcSize(outputBatchNumber, outputChannel, outputHeight, outputWidth, channelBlock));
+	cpuReorderNCHWToNCHWc(input, blockedInput, inputBatchNumber, inputChannel, inputHeight, inputWidth, channelBlock);
+	cpuReorderDepthwiseFilterNCHWc(filter, blockedFilter, outputChannel, filterHeight, filterWidth, channelBlock);
+
+	CPU_Depthwise_NCHWc(blockedInput, blockedFilter, blockedOutput,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		channelBlock, alpha, beta, epilogue);
+
+	cpuReorderNCHWcToNCHW(blockedOutput, output, outputBatchNumber, outputChannel, outputHeight, outputWidth, channelBlock);
+}
+
+template <typename scalar_t>
+inline void cpuDepthwiseRunNCHWc(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, int channelBlock, DepthwiseCpuWorkspace& workspace) {
+
+	CPU_Depthwise_Scheduled(input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		alpha, beta, epilogue, depthwiseDefaultCpuSchedule, &workspace);
+}
+
+/*
+cpuDepthwiseRunWinograd():
+	CPU_Depthwise_Winograd() with F(tile x tile, 3 x 3). Float only, the tuner never offers it for 16-bit data.
+*/
+inline void cpuDepthwiseRunWinograd(const float* input, const float* filter, float* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, int tile, DepthwiseCpuWorkspace& workspace) {
+
+	CPU_Depthwise_Winograd(input, filter, output,
+		outputBatchNumber, outputChannel, inputHeight, inputWidth, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, alpha, beta, epilogue, tile, &workspace);
+}
+
+template <typename scalar_t>
+inline void cpuDepthwiseRunWinograd(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, int tile, DepthwiseCpuWorkspace& workspace) {
+
+	CPU_Depthwise_Scheduled(input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		alpha, beta, epilogue, depthwiseDefaultCpuSchedule, &workspace);
+}
+
+/*
+CPU_Depthwise_Config():
+	Run one tuning candidate, scratch memory from workspace.
+*/
+template <typename scalar_t>
+inline void CPU_Depthwise_Config(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, const DepthwiseTuningConfig& config,
+	DepthwiseCpuWorkspace& workspace) {
+
+	if (config.variant == DepthwiseVariantCpuNCHWc) {
+		cpuDepthwiseRunNCHWc(input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterWidth,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+			alpha, beta, epilogue, config.tileWidth, workspace);
+		return;
+	}
+	if (config.variant == DepthwiseVariantCpuWinograd) {
+		cpuDepthwiseRunWinograd(input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterWidth,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+			alpha, beta, epilogue, config.tileWidth, workspace);
+		return;
+	}
+
+	DepthwiseCpuSchedule schedule = { config.tileHeight, config.threadNumber };
+	CPU_Depthwise_Scheduled(input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		alpha, beta, epilogue, schedule, &workspace);
+}
+
+/*
+CPU_Depthwise_Tuned():
+	CPU_Depthwise_Generic() through the autotuner. The first call of a problem times every candidate (each of them
+	writes the output), later calls, also of later processes, run the stored winner straight away.
+	With DEPTHWISE_TUNING=0 this is CPU_Depthwise_Generic().
+	Scratch memory comes from workspace (CPU_DepthwiseWorkspace.h), nullptr for a workspace of this call only.
+*/
+template <typename scalar_t>
+inline void CPU_Depthwise_Tuned(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, DepthwiseCpuWorkspace* workspace = nullptr) {
+
+	DepthwiseCpuWorkspace callWorkspace;
+	if (workspace == nullptr) {
+		workspace = &callWorkspace;
+	}
+
+	DepthwiseTuningConfig config = depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 0, 0);
+	if (depthwiseTuningEnabled()) {
+		ConvShape shape(inputHeight, inputWidth, filterHeight, filterWidth,
+			paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth);
+		std::string key = depthwiseTuningKey("cpu", (int)sizeof(scalar_t), outputBatchNumber, outputChannel, shape);
+		std::vector<DepthwiseTuningConfig> candidates = cpuDepthwiseTuningCandidates(
+			sizeof(scalar_t) == sizeof(float), outputBatchNumber, outputChannel, outputHeight,
+			depthwiseWinogradSupported(filterHeight, filterWidth, strideHeight, strideWidth, dilationHeight, dilationWidth));
+
+		// the output of the direct default, and the Winograd tiles already compared with it (1 accepted, -1 not)
+		size_t outputSize = (size_t)outputBatchNumber * outputChannel * outputHeight * outputWidth;
+		std::vector<float> direct;
+		int winogradChecked[5] = { 0, 0, 0, 0, 0 };
+		config = depthwiseTune(depthwiseTuningDatabase(), depthwiseCpuFingerprint(), key, candidates,
+			[&](const DepthwiseTuningConfig& candidate) {
+				bool winograd = candidate.variant == DepthwiseVariantCpuWinograd;
+				if (winograd && winogradChecked[candidate.tileWidth] < 0) {
+					return -1.0f;
+				}
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				CPU_Depthwise_Config(input, filter, output,
+					inputBatchNumber, inputChannel, inputHeight, inputWidth,
+					filterLayerNumber, filterHeight, filterWidth,
+					outputBatchNumber, outputChannel, outputHeight, outputWidth,
+					paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+					alpha, beta, epilogue, candidate, *workspace);
+				float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				if (direct.empty() && candidate.sameSchedule(candidates[0])) {
+					direct.resize(outputSize);
+					cpuDepthwiseLoad(output, direct.data(), (int)outputSize);
+				}
+				else if (winograd && winogradChecked[candidate.tileWidth] == 0) {
+					std::vector<float> result(outputSize);
+					cpuDepthwiseLoad(output, result.data(), (int)outputSize);
+					bool accurate = depthwiseWinogradError(result.data(), direct.data(), outputSize) <= depthwiseWinogradTolerance;
+					winogradChecked[candidate.tileWidth] = accurate ? 1 : -1;
+					if (!accurate) {
+						return -1.0f;
+					}
+				}
+				return milliseconds;
+			});
+	}
+
+	CPU_Depthwise_Config(input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		alpha, beta, epilogue, config, *workspace);
+}
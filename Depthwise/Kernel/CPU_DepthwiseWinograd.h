@@ -0,0 +1,432 @@
+#pragma once
+/*
+Winograd Depthwise Convolution on CPU.
+
+3 x 3, stride 1, no dilation (the Filter3x3_Input*_Stride1 family and every other 3 x 3 stride 1 layer) with the
+Winograd minimal filtering algorithms F(2 x 2, 3 x 3) and F(4 x 4, 3 x 3): a tile of m x m outputs is computed
+from the (m + 2) x (m + 2) input tile around it as
+	Y = A^T [(G g G^T) . (B^T d B)] A
+so the 9 multiplies per output of the direct convolution become 16 / 4 = 4 (F(2 x 2), 2.25x fewer) or
+36 / 16 = 2.25 (F(4 x 4), 4x fewer), plus the additions of the input and output transforms.
+
+	1)	the transforms run on channel blocks (CPU_DepthwiseNCHWc.h), one SIMD lane per channel, the transforms
+		are the same for every channel. CPU_Depthwise_WinogradNCHWc() reads and writes blocked tensors,
+		CPU_Depthwise_Winograd() gathers the tiles of a block straight from the NCHW planes and scatters the
+		output tiles back, so there is no reorder pass over the tensors
+	2)	the filter transform U = G g G^T is computed once per weight tensor, in double, and kept in the workspace
+		(DepthwiseWinogradFilter) with the address and a checksum of the weights it came from
+	3)	padding is any; input taps outside the image are zeros, outputs of the last tiles that fall outside
+		the output are dropped
+	4)	alpha / beta and the epilogue are applied to the output tile before it is stored
+
+Winograd trades multiplies for rounding: F(4 x 4) amplifies the rounding of the transforms more than F(2 x 2).
+depthwiseWinogradError() measures it against the direct path; CPU_Depthwise_Tuned() only offers a Winograd
+candidate whose error is below depthwiseWinogradTolerance and keeps it only when it is faster.
+*/
+#include <cmath>
+
+#include "CPU_DepthwiseNCHWc.h"
+
+// largest max |winograd - direct| / (1 + |direct|) the autotuner accepts
+const double depthwiseWinogradTolerance = 1e-5;
+
+/*
+depthwiseWinogradSupported():
+	Whether the Winograd path handles the filter, stride and dilation.
+*/
+inline bool depthwiseWinogradSupported(int filterHeight, int filterWidth, int strideHeight, int strideWidth,
+	int dilationHeight, int dilationWidth) {
+
+	return filterHeight == 3 && filterWidth == 3 && strideHeight == 1 && strideWidth == 1 &&
+		dilationHeight == 1 && dilationWidth == 1;
+}
+
+/*
+CpuWinograd<Tile>:
+	F(Tile x Tile, 3 x 3). Alpha x Alpha input tiles, the filter transform matrix G (Alpha x 3) and the 1D input
+	(B^T, Alpha -> Alpha) and output (A^T, Alpha -> Tile) transforms on channel vectors.
+*/
+template <int Tile>
+struct CpuWinograd;
+
+template <>
+struct CpuWinograd<2> {
+	static const int Alpha = 4;
+
+	static double g(int i, int k) {
+		static const double G[4][3] = {
+			{ 1.0, 0.0, 0.0 },
+			{ 0.5, 0.5, 0.5 },
+			{ 0.5, -0.5, 0.5 },
+			{ 0.0, 0.0, 1.0 } };
+		return G[i][k];
+	}
+
+	static void input(const cpuVector* d, cpuVector* t) {
+		t[0] = cpuVectorSub(d[0], d[2]);
+		t[1] = cpuVectorAdd(d[1], d[2]);
+		t[2] = cpuVectorSub(d[2], d[1]);
+		t[3] = cpuVectorSub(d[1], d[3]);
+	}
+
+	static void output(const cpuVector* m, cpuVector* y) {
+		cpuVector sum = cpuVectorAdd(m[1], m[2]);
+		y[0] = cpuVectorAdd(m[0], sum);
+		y[1] = cpuVectorSub(cpuVectorSub(m[1], m[2]), m[3]);
+	}
+};
+
+template <>
+struct CpuWinograd<4> {
+	static const int Alpha = 6;
+
+	static double g(int i, int k) {
+		static const double G[6][3] = {
+			{ 1.0 / 4, 0.0, 0.0 },
+			{ -1.0 / 6, -1.0 / 6, -1.0 / 6 },
+			{ -1.0 / 6, 1.0 / 6, -1.0 / 6 },
+			{ 1.0 / 24, 1.0 / 12, 1.0 / 6 },
+			{ 1.0 / 24, -1.0 / 12, 1.0 / 6 },
+			{ 0.0, 0.0, 1.0 } };
+		return G[i][k];
+	}
+
+	static void input(const cpuVector* d, cpuVector* t) {
+		cpuVector four = cpuVectorSet(4.0f);
+		cpuVector minusFour = cpuVectorSet(-4.0f);
+		cpuVector minusFive = cpuVectorSet(-5.0f);
+		cpuVector two = cpuVectorSet(2.0f);
+		cpuVector d4MinusD2 = cpuVectorSub(d[4], d[2]);
+		t[0] = cpuVectorFmadd(four, d[0], cpuVectorFmadd(minusFive, d[2], d[4]));
+		t[1] = cpuVectorFmadd(minusFour, cpuVectorAdd(d[1], d[2]), cpuVectorAdd(d[3], d[4]));
+		t[2] = cpuVectorFmadd(four, cpuVectorSub(d[1], d[2]), cpuVectorSub(d[4], d[3]));
+		t[3] = cpuVectorFmadd(two, cpuVectorSub(d[3], d[1]), d4MinusD2);
+		t[4] = cpuVectorFmadd(two, cpuVectorSub(d[1], d[3]), d4MinusD2);
+		t[5] = cpuVectorFmadd(four, d[1], cpuVectorFmadd(minusFive, d[3], d[5]));
+	}
+
+	static void output(const cpuVector* m, cpuVector* y) {
+		cpuVector sum12 = cpuVectorAdd(m[1], m[2]);
+		cpuVector difference12 = cpuVectorSub(m[1], m[2]);
+		cpuVector sum34 = cpuVectorAdd(m[3], m[4]);
+		cpuVector difference34 = cpuVectorSub(m[3], m[4]);
+		y[0] = cpuVectorAdd(cpuVectorAdd(m[0], sum12), sum34);
+		y[1] = cpuVectorFmadd(cpuVectorSet(2.0f), difference34, difference12);
+		y[2] = cpuVectorFmadd(cpuVectorSet(4.0f), sum34, sum12);
+		y[3] = cpuVectorAdd(cpuVectorFmadd(cpuVectorSet(8.0f), difference34, difference12), m[5]);
+	}
+};
+
+/*
+depthwiseWinogradFilterChecksum():
+	FNV-1a over the bits of the weights.
+*/
+inline uint64_t depthwiseWinogradFilterChecksum(const float* filter, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		uint32_t bits;
+		memcpy(&bits, filter + i, sizeof(bits));
+		hash = (hash ^ bits) * 1099511628211ull;
+	}
+	return hash;
+}
+
+/*
+cpuDepthwiseWinogradFilter():
+	U = G g G^T of every channel, blocked as (channel / channelBlock, Alpha, Alpha, channelBlock), padded channels
+	zero. Reuses winogradFilter when it already holds the transform of these weights.
+*/
+template <int Tile>
+inline const float* cpuDepthwiseWinogradFilter(const float* filter, int channel, int channelBlock,
+	DepthwiseWinogradFilter& winogradFilter) {
+
+	const int Alpha = CpuWinograd<Tile>::Alpha;
+	uint64_t checksum = depthwiseWinogradFilterChecksum(filter, (size_t)channel * 9);
+	if (winogradFilter.source == filter && winogradFilter.checksum == checksum && winogradFilter.channel == channel &&
+		winogradFilter.tile == Tile && winogradFilter.channelBlock == channelBlock) {
+		return winogradFilter.data.data();
+	}
+
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(channel, channelBlock);
+	winogradFilter.data.assign((size_t)blockNumber * Alpha * Alpha * channelBlock, 0.0f);
+	for (int c = 0; c < channel; c++) {
+		const float* g = filter + (size_t)c * 9;
+		float* u = winogradFilter.data.data() + (size_t)(c / channelBlock) * Alpha * Alpha * channelBlock + c % channelBlock;
+		// G g, then (G g) G^T
+		double gg[Alpha][3];
+		for (int i = 0; i < Alpha; i++) {
+			for (int k = 0; k < 3; k++) {
+				gg[i][k] = 0.0;
+				for (int j = 0; j < 3; j++) {
+					gg[i][k] += CpuWinograd<Tile>::g(i, j) * g[j * 3 + k];
+				}
+			}
+		}
+		for (int i = 0; i < Alpha; i++) {
+			for (int j = 0; j < Alpha; j++) {
+				double value = 0.0;
+				for (int k = 0; k < 3; k++) {
+					value += gg[i][k] * CpuWinograd<Tile>::g(j, k);
+				}
+				u[(size_t)(i * Alpha + j) * channelBlock] = (float)value;
+			}
+		}
+	}
+	winogradFilter.source = filter;
+	winogradFilter.checksum = checksum;
+	winogradFilter.channel = channel;
+	winogradFilter.tile = Tile;
+	winogradFilter.channelBlock = channelBlock;
+	return winogradFilter.data.data();
+}
+
+/*
+cpuDepthwiseWinogradTile():
+	One Tile x Tile output tile of one channel block from its input tile (Alpha x Alpha x channelBlock): transform,
+	multiply by U, transform back into outputTile (Tile x Tile x channelBlock), times alpha plus beta.
+*/
+template <int Tile>
+inline void cpuDepthwiseWinogradTile(const float* inputTile, const float* blockFilter, float* outputTile,
+	int channelBlock, float alpha, float beta) {
+
+	const int Alpha = CpuWinograd<Tile>::Alpha;
+	cpuVector alphaVector = cpuVectorSet(alpha);
+	cpuVector betaVector = cpuVectorSet(beta);
+	for (int v = 0; v < channelBlock; v += CPU_VECTOR_WIDTH) {
+		// B^T d down the columns, then along the rows
+		cpuVector column[Alpha], transformed[Alpha];
+		cpuVector t[Alpha][Alpha];
+		for (int j = 0; j < Alpha; j++) {
+			for (int i = 0; i < Alpha; i++) {
+				column[i] = cpuVectorLoad(inputTile + (size_t)(i * Alpha + j) * channelBlock + v);
+			}
+			CpuWinograd<Tile>::input(column, transformed);
+			for (int i = 0; i < Alpha; i++) {
+				t[i][j] = transformed[i];
+			}
+		}
+		// (B^T d B) . U, then A^T along the rows
+		cpuVector s[Alpha][Tile];
+		for (int i = 0; i < Alpha; i++) {
+			CpuWinograd<Tile>::input(t[i], transformed);
+			for (int j = 0; j < Alpha; j++) {
+				transformed[j] = cpuVectorMul(transformed[j], cpuVectorLoad(blockFilter + (size_t)(i * Alpha + j) * channelBlock + v));
+			}
+			CpuWinograd<Tile>::output(transformed, s[i]);
+		}
+		// A^T down the columns
+		cpuVector y[Tile];
+		for (int l = 0; l < Tile; l++) {
+			for (int i = 0; i < Alpha; i++) {
+				column[i] = s[i][l];
+			}
+			CpuWinograd<Tile>::output(column, y);
+			for (int k = 0; k < Tile; k++) {
+				cpuVectorStore(outputTile + (size_t)(k * Tile + l) * channelBlock + v, cpuVectorFmadd(y[k], alphaVector, betaVector));
+			}
+		}
+	}
+}
+
+/*
+CPU_Depthwise_WinogradNCHWc():
+	3 x 3 stride 1 depthwise convolution of a whole NCHWc tensor with F(Tile x Tile, 3 x 3), Tile 2 or 4.
+	Same arguments as CPU_Depthwise_NCHWc() without the filter size, stride and dilation; winogradFilter comes
+	from cpuDepthwiseWinogradFilter<Tile>(). Padded channels of the output are zero.
+*/
+template <int Tile>
+inline void CPU_Depthwise_WinogradNCHWc(const float* input, const float* winogradFilter, float* output,
+	int batchNumber, int channel, int inputHeight, int inputWidth, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int channelBlock, float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	const int Alpha = CpuWinograd<Tile>::Alpha;
+	bool hasEpilogue = epilogue.scale != nullptr || epilogue.shift != nullptr || epilogue.activation != DepthwiseActivationNone;
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(channel, channelBlock);
+	int tileRows = (outputHeight + Tile - 1) / Tile;
+	int tileColumns = (outputWidth + Tile - 1) / Tile;
+	size_t inputBlockSize = (size_t)inputHeight * inputWidth * channelBlock;
+	size_t outputBlockSize = (size_t)outputHeight * outputWidth * channelBlock;
+
+#pragma omp parallel
+	{
+		std::vector<float> tiles((size_t)(Alpha * Alpha + Tile * Tile) * channelBlock);
+		float* inputTile = tiles.data();
+		float* outputTile = inputTile + (size_t)Alpha * Alpha * channelBlock;
+
+#pragma omp for collapse(3) schedule(static)
+		for (int n = 0; n < batchNumber; n++) {
+			for (int cb = 0; cb < blockNumber; cb++) {
+				for (int tileRow = 0; tileRow < tileRows; tileRow++) {
+					size_t blockIndex = (size_t)n * blockNumber + cb;
+					const float* inputBlock = input + blockIndex * inputBlockSize;
+					const float* blockFilter = winogradFilter + (size_t)cb * Alpha * Alpha * channelBlock;
+					float* outputBlock = output + blockIndex * outputBlockSize;
+
+					int firstChannel = cb * channelBlock;
+					int channelNumber = std::min(channelBlock, channel - firstChannel);
+					DepthwiseEpilogue blockEpilogue = epilogue;
+					blockEpilogue.scale = epilogue.scale ? epilogue.scale + firstChannel : nullptr;
+					blockEpilogue.shift = epilogue.shift ? epilogue.shift + firstChannel : nullptr;
+
+					int y = tileRow * Tile;
+					int rowNumber = std::min(Tile, outputHeight - y);
+					for (int tileColumn = 0; tileColumn < tileColumns; tileColumn++) {
+						int x = tileColumn * Tile;
+						int columnNumber = std::min(Tile, outputWidth - x);
+						// the input tile, zeros outside the image
+						for (int i = 0; i < Alpha; i++) {
+							int inputY = y - paddingHeight + i;
+							for (int j = 0; j < Alpha; j++) {
+								int inputX = x - paddingWidth + j;
+								float* dst = inputTile + (size_t)(i * Alpha + j) * channelBlock;
+								if (inputY < 0 || inputY >= inputHeight || inputX < 0 || inputX >= inputWidth) {
+									std::fill(dst, dst + channelBlock, 0.0f);
+								}
+								else {
+									memcpy(dst, inputBlock + ((size_t)inputY * inputWidth + inputX) * channelBlock, channelBlock * sizeof(float));
+								}
+							}
+						}
+						cpuDepthwiseWinogradTile<Tile>(inputTile, blockFilter, outputTile, channelBlock, alpha, beta);
+
+						for (int k = 0; k < rowNumber; k++) {
+							for (int l = 0; l < columnNumber; l++) {
+								float* outputPixel = outputBlock + ((size_t)(y + k) * outputWidth + x + l) * channelBlock;
+								memcpy(outputPixel, outputTile + (size_t)(k * Tile + l) * channelBlock, channelBlock * sizeof(float));
+								if (hasEpilogue) {
+									cpuDepthwiseEpilogueChannels(outputPixel, channelNumber, blockEpilogue);
+								}
+								std::fill(outputPixel + channelNumber, outputPixel + channelBlock, 0.0f);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+CPU_Depthwise_WinogradNCHW():
+	CPU_Depthwise_WinogradNCHWc() on NCHW tensors: the channel blocks are gathered from channelBlock planes into
+	the input tile and the output tile is scattered back, so no blocked copy of the tensors is made. The channels
+	past the last one are zeros and are not stored.
+*/
+template <int Tile>
+inline void CPU_Depthwise_WinogradNCHW(const float* input, const float* winogradFilter, float* output,
+	int batchNumber, int channel, int inputHeight, int inputWidth, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int channelBlock, float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	const int Alpha = CpuWinograd<Tile>::Alpha;
+	bool hasEpilogue = epilogue.scale != nullptr || epilogue.shift != nullptr || epilogue.activation != DepthwiseActivationNone;
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(channel, channelBlock);
+	int tileRows = (outputHeight + Tile - 1) / Tile;
+	int tileColumns = (outputWidth + Tile - 1) / Tile;
+	size_t inputPlaneSize = (size_t)inputHeight * inputWidth;
+	size_t outputPlaneSize = (size_t)outputHeight * outputWidth;
+
+#pragma omp parallel
+	{
+		std::vector<float> tiles((size_t)(Alpha * Alpha + Tile * Tile) * channelBlock, 0.0f);
+		float* inputTile = tiles.data();
+		float* outputTile = inputTile + (size_t)Alpha * Alpha * channelBlock;
+
+#pragma omp for collapse(3) schedule(static)
+		for (int n = 0; n < batchNumber; n++) {
+			for (int cb = 0; cb < blockNumber; cb++) {
+				for (int tileRow = 0; tileRow < tileRows; tileRow++) {
+					int firstChannel = cb * channelBlock;
+					int channelNumber = std::min(channelBlock, channel - firstChannel);
+					const float* inputPlanes = input + ((size_t)n * channel + firstChannel) * inputPlaneSize;
+					const float* blockFilter = winogradFilter + (size_t)cb * Alpha * Alpha * channelBlock;
+					float* outputPlanes = output + ((size_t)n * channel + firstChannel) * outputPlaneSize;
+					DepthwiseEpilogue blockEpilogue = epilogue;
+					blockEpilogue.scale = epilogue.scale ? epilogue.scale + firstChannel : nullptr;
+					blockEpilogue.shift = epilogue.shift ? epilogue.shift + firstChannel : nullptr;
+
+					int y = tileRow * Tile;
+					int rowNumber = std::min(Tile, outputHeight - y);
+					for (int tileColumn = 0; tileColumn < tileColumns; tileColumn++) {
+						int x = tileColumn * Tile;
+						int columnNumber = std::min(Tile, outputWidth - x);
+
+						// the input tile of every channel of the block, zeros outside the image
+						for (int i = 0; i < Alpha; i++) {
+							int inputY = y - paddingHeight + i;
+							for (int j = 0; j < Alpha; j++) {
+								int inputX = x - paddingWidth + j;
+								float* dst = inputTile + (size_t)(i * Alpha + j) * channelBlock;
+								if (inputY < 0 || inputY >= inputHeight || inputX < 0 || inputX >= inputWidth) {
+									std::fill(dst, dst + channelNumber, 0.0f);
+									continue;
+								}
+								const float* src = inputPlanes + (size_t)inputY * inputWidth + inputX;
+								for (int b = 0; b < channelNumber; b++) {
+									dst[b] = src[b * inputPlaneSize];
+								}
+							}
+						}
+						cpuDepthwiseWinogradTile<Tile>(inputTile, blockFilter, outputTile, channelBlock, alpha, beta);
+
+						for (int k = 0; k < rowNumber; k++) {
+							for (int l = 0; l < columnNumber; l++) {
+								float* outputPixel = outputTile + (size_t)(k * Tile + l) * channelBlock;
+								if (hasEpilogue) {
+									cpuDepthwiseEpilogueChannels(outputPixel, channelNumber, blockEpilogue);
+								}
+								float* dst = outputPlanes + (size_t)(y + k) * outputWidth + x + l;
+								for (int b = 0; b < channelNumber; b++) {
+									dst[b * outputPlaneSize] = outputPixel[b];
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+CPU_Depthwise_Winograd():
+	CPU_Depthwise_Generic() of a 3 x 3 stride 1 float problem (depthwiseWinogradSupported()) through
+	F(tile x tile, 3 x 3), tile 2 or 4, on NCHW tensors. The transformed filter lives in workspace, nullptr for
+	a workspace of this call only.
+*/
+inline void CPU_Depthwise_Winograd(const float* input, const float* filter, float* output,
+	int batchNumber, int channel, int inputHeight, int inputWidth, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, float alpha, float beta, DepthwiseEpilogue epilogue, int tile,
+	DepthwiseCpuWorkspace* workspace = nullptr) {
+
+	DepthwiseCpuWorkspace callWorkspace;
+	if (workspace == nullptr) {
+		workspace = &callWorkspace;
+	}
+
+	int channelBlock = cpuDepthwiseNCHWcBlock();
+	if (tile == 4) {
+		const float* winogradFilter = cpuDepthwiseWinogradFilter<4>(filter, channel, channelBlock, workspace->winogradFilter);
+		CPU_Depthwise_WinogradNCHW<4>(input, winogradFilter, output,
+			batchNumber, channel, inputHeight, inputWidth, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, channelBlock, alpha, beta, epilogue);
+	}
+	else {
+		const float* winogradFilter = cpuDepthwiseWinogradFilter<2>(filter, channel, channelBlock, workspace->winogradFilter);
+		CPU_Depthwise_WinogradNCHW<2>(input, winogradFilter, output,
+			batchNumber, channel, inputHeight, inputWidth, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, channelBlock, alpha, beta, epilogue);
+	}
+}
+
+/*
+depthwiseWinogradError():
+	max |winograd - direct| / (1 + |direct|) over two outputs of the same problem.
+*/
+inline double depthwiseWinogradError(const float* winograd, const float* direct, size_t size) {
+	double maxError = 0.0;
+	for (size_t i = 0; i < size; i++) {
+		double error = std::fabs((double)winograd[i] - direct[i]) / (1.0 + std::fabs((double)direct[i]));
+		maxError = error > maxError || error != error ? error : maxError;
+	}
+	return maxError;
+}
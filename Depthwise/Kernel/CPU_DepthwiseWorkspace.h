@@ -0,0 +1,78 @@
+#pragma once
+/*
+Reusable scratch memory of the CPU depthwise convolution.
+
+CPU_Depthwise_Scheduled() pads the input rows of every task into a per thread scratch tile and widens a 16-bit
+filter to float, the NCHWc variant of the autotuner (CPU_DepthwiseTuning.h) reorders input, filter and output
+into blocked copies, CPU_DepthwisePointwise() keeps the padded band and the depthwise tile of every thread,
+CPU_Depthwise_NHWC() and CPU_Pointwise() keep the widened rows of 16-bit tensors, the Winograd variant
+(CPU_DepthwiseWinograd.h) keeps the transformed filter of the last weights it saw.
+Without a workspace this memory is allocated and freed by every call. A DepthwiseCpuWorkspace passed to every
+call of an inference loop keeps it: once the buffers have grown to the largest layer the loop does not allocate
+any more.
+
+The buffers only grow. A workspace must not be used by two calls at the same time.
+*/
+#include <stdint.h>
+#include <vector>
+#include <cstddef>
+
+/*
+DepthwiseWinogradFilter:
+	A filter transformed for the Winograd variant, with the weights it was transformed from (address and checksum
+	of the values), so it is transformed again only when they change.
+*/
+struct DepthwiseWinogradFilter {
+	const float* source;
+	uint64_t checksum;
+	int channel;
+	int tile;
+	int channelBlock;
+	std::vector<float> data;
+
+	DepthwiseWinogradFilter() : source(nullptr), checksum(0), channel(0), tile(0), channelBlock(0) {}
+};
+
+struct DepthwiseCpuWorkspace {
+	std::vector<float> filter;
+	std::vector<std::vector<float> > threadBuffers;
+	std::vector<float> blockedInput;
+	std::vector<float> blockedFilter;
+	std::vector<float> blockedOutput;
+	DepthwiseWinogradFilter winogradFilter;
+
+	size_t bytes() const {
+		size_t floats = filter.capacity() + blockedInput.capacity() + blockedFilter.capacity() + blockedOutput.capacity() +
+			winogradFilter.data.capacity();
+		for (size_t i = 0; i < threadBuffers.size(); i++) {
+			floats += threadBuffers[i].capacity();
+		}
+		return floats * sizeof(float);
+	}
+
+	void release() {
+		*this = DepthwiseCpuWorkspace();
+	}
+};
+
+/*
+depthwiseWorkspaceBuffer():
+	At least size floats of buffer, grown if it is smaller. The contents are not kept when it grows.
+*/
+inline float* depthwiseWorkspaceBuffer(std::vector<float>& buffer, size_t size) {
+	if (buffer.size() < size) {
+		buffer.resize(size);
+	}
+	return buffer.data();
+}
+
+/*
+depthwiseWorkspaceThreads():
+	Make room for the buffers of threadNumber threads. Call it before the parallel region, every thread then
+	grows only its own buffer.
+*/
+inline void depthwiseWorkspaceThreads(DepthwiseCpuWorkspace& workspace, int threadNumber) {
+	if ((int)workspace.threadBuffers.size() < threadNumber) {
+		workspace.threadBuffers.resize(threadNumber);
+	}
+}
@@ -0,0 +1,281 @@
+#pragma once
+/*
+Pointwise (1 x 1) Convolution on CPU.
+
+Host backend for the pointwise convolution layers of MobileNet V2, EfficientNet B0, MNasNet and ShuffleNet V2
+(pointwiseLayerConfigs of the Ablation scripts). For every image it is the GEMM
+	output[outputChannel][H * W] = filter[outputChannel][inputChannel] x input[inputChannel][H * W]
+cache blocked on pixels and input channels, with a 4 output channel x 2 vector register block
+(same SIMD width selection as CPU_Depthwise.h).
+
+The blocking is picked from the layer shape (cpuPointwiseBlocking()):
+	1)	large planes (56 x 56, 112 x 112) have few channels: tasks are (image, pixel block) and every task
+		does all the output channels, the input block stays in L1 / L2 for the whole task
+	2)	small planes (7 x 7, 14 x 14, 28 x 28) have many channels: the whole plane is one pixel block and tasks
+		are split on output channels as well, so there is enough of them for every core
+The input channels are walked in blocks of at most 256, so the input block is at most 256 x pixel block floats.
+*/
+#include <type_traits>
+#include "CPU_Depthwise.h"
+
+/*
+cpuPointwiseTile():
+	output[co][x] (+)= sum over ci of filter[co][ci] * tile[ci][x], for co in [0, outputChannel), x in [0, pixelNumber).
+	Register blocked on 4 output channels x 2 vectors of pixels.
+Input:
+	filterPitch  - distance between two output channel rows of the filter
+	tilePitch    - distance between two input channel rows of the tile
+	outputPitch  - distance between two output channel rows of the output
+	accumulate   - add to the output instead of overwriting it
+*/
+inline void cpuPointwiseTile(const float* filter, int filterPitch, int inputChannel, int outputChannel,
+	const float* tile, int tilePitch, int pixelNumber, float* output, int outputPitch, bool accumulate) {
+
+	const int pixelStep = 2 * CPU_VECTOR_WIDTH;
+
+	int co = 0;
+	for (; co + 4 <= outputChannel; co += 4) {
+		const float* filter0 = filter + (size_t)co * filterPitch;
+		const float* filter1 = filter0 + filterPitch;
+		const float* filter2 = filter1 + filterPitch;
+		const float* filter3 = filter2 + filterPitch;
+		float* output0 = output + (size_t)co * outputPitch;
+		float* output1 = output0 + outputPitch;
+		float* output2 = output1 + outputPitch;
+		float* output3 = output2 + outputPitch;
+
+		int x = 0;
+		for (; x + pixelStep <= pixelNumber; x += pixelStep) {
+			cpuVector sum00 = cpuVectorZero(), sum01 = cpuVectorZero();
+			cpuVector sum10 = cpuVectorZero(), sum11 = cpuVectorZero();
+			cpuVector sum20 = cpuVectorZero(), sum21 = cpuVectorZero();
+			cpuVector sum30 = cpuVectorZero(), sum31 = cpuVectorZero();
+			if (accumulate) {
+				sum00 = cpuVectorLoad(output0 + x);
+				sum01 = cpuVectorLoad(output0 + x + CPU_VECTOR_WIDTH);
+				sum10 = cpuVectorLoad(output1 + x);
+				sum11 = cpuVectorLoad(output1 + x + CPU_VECTOR_WIDTH);
+				sum20 = cpuVectorLoad(output2 + x);
+				sum21 = cpuVectorLoad(output2 + x + CPU_VECTOR_WIDTH);
+				sum30 = cpuVectorLoad(output3 + x);
+				sum31 = cpuVectorLoad(output3 + x + CPU_VECTOR_WIDTH);
+			}
+			for (int ci = 0; ci < inputChannel; ci++) {
+				const float* tileRow = tile + (size_t)ci * tilePitch + x;
+				cpuVector in0 = cpuVectorLoad(tileRow);
+				cpuVector in1 = cpuVectorLoad(tileRow + CPU_VECTOR_WIDTH);
+				cpuVector weight = cpuVectorSet(filter0[ci]);
+				sum00 = cpuVectorFmadd(weight, in0, sum00);
+				sum01 = cpuVectorFmadd(weight, in1, sum01);
+				weight = cpuVectorSet(filter1[ci]);
+				sum10 = cpuVectorFmadd(weight, in0, sum10);
+				sum11 = cpuVectorFmadd(weight, in1, sum11);
+				weight = cpuVectorSet(filter2[ci]);
+				sum20 = cpuVectorFmadd(weight, in0, sum20);
+				sum21 = cpuVectorFmadd(weight, in1, sum21);
+				weight = cpuVectorSet(filter3[ci]);
+				sum30 = cpuVectorFmadd(weight, in0, sum30);
+				sum31 = cpuVectorFmadd(weight, in1, sum31);
+			}
+			cpuVectorStore(output0 + x, sum00);
+			cpuVectorStore(output0 + x + CPU_VECTOR_WIDTH, sum01);
+			cpuVectorStore(output1 + x, sum10);
+			cpuVectorStore(output1 + x + CPU_VECTOR_WIDTH, sum11);
+			cpuVectorStore(output2 + x, sum20);
+			cpuVectorStore(output2 + x + CPU_VECTOR_WIDTH, sum21);
+			cpuVectorStore(output3 + x, sum30);
+			cpuVectorStore(output3 + x + CPU_VECTOR_WIDTH, sum31);
+		}
+
+		// one vector of pixels
+		for (; x + CPU_VECTOR_WIDTH <= pixelNumber; x += CPU_VECTOR_WIDTH) {
+			cpuVector sum0 = accumulate ? cpuVectorLoad(output0 + x) : cpuVectorZero();
+			cpuVector sum1 = accumulate ? cpuVectorLoad(output1 + x) : cpuVectorZero();
+			cpuVector sum2 = accumulate ? cpuVectorLoad(output2 + x) : cpuVectorZero();
+			cpuVector sum3 = accumulate ? cpuVectorLoad(output3 + x) : cpuVectorZero();
+			for (int ci = 0; ci < inputChannel; ci++) {
+				cpuVector in = cpuVectorLoad(tile + (size_t)ci * tilePitch + x);
+				sum0 = cpuVectorFmadd(cpuVectorSet(filter0[ci]), in, sum0);
+				sum1 = cpuVectorFmadd(cpuVectorSet(filter1[ci]), in, sum1);
+				sum2 = cpuVectorFmadd(cpuVectorSet(filter2[ci]), in, sum2);
+				sum3 = cpuVectorFmadd(cpuVectorSet(filter3[ci]), in, sum3);
+			}
+			cpuVectorStore(output0 + x, sum0);
+			cpuVectorStore(output1 + x, sum1);
+			cpuVectorStore(output2 + x, sum2);
+			cpuVectorStore(output3 + x, sum3);
+		}
+
+		// remaining pixels
+		for (; x < pixelNumber; x++) {
+			float sum0 = accumulate ? output0[x] : 0.0f;
+			float sum1 = accumulate ? output1[x] : 0.0f;
+			float sum2 = accumulate ? output2[x] : 0.0f;
+			float sum3 = accumulate ? output3[x] : 0.0f;
+			for (int ci = 0; ci < inputChannel; ci++) {
+				float in = tile[(size_t)ci * tilePitch + x];
+				sum0 += filter0[ci] * in;
+				sum1 += filter1[ci] * in;
+				sum2 += filter2[ci] * in;
+				sum3 += filter3[ci] * in;
+			}
+			output0[x] = sum0;
+			output1[x] = sum1;
+			output2[x] = sum2;
+			output3[x] = sum3;
+		}
+	}
+
+	// remaining output channels
+	for (; co < outputChannel; co++) {
+		const float* channelFilter = filter + (size_t)co * filterPitch;
+		float* outputRow = output + (size_t)co * outputPitch;
+		int x = 0;
+		for (; x + CPU_VECTOR_WIDTH <= pixelNumber; x += CPU_VECTOR_WIDTH) {
+			cpuVector sum = accumulate ? cpuVectorLoad(outputRow + x) : cpuVectorZero();
+			for (int ci = 0; ci < inputChannel; ci++) {
+				sum = cpuVectorFmadd(cpuVectorSet(channelFilter[ci]), cpuVectorLoad(tile + (size_t)ci * tilePitch + x), sum);
+			}
+			cpuVectorStore(outputRow + x, sum);
+		}
+		for (; x < pixelNumber; x++) {
+			float sum = accumulate ? outputRow[x] : 0.0f;
+			for (int ci = 0; ci < inputChannel; ci++) {
+				sum += channelFilter[ci] * tile[(size_t)ci * tilePitch + x];
+			}
+			outputRow[x] = sum;
+		}
+	}
+}
+
+/*
+CpuPointwiseBlocking
+	Pixel, input channel and output channel block sizes of one layer.
+*/
+struct CpuPointwiseBlocking {
+	int pixelBlock;
+	int inputChannelBlock;
+	int outputChannelBlock;
+};
+
+/*
+cpuPointwiseBlocking():
+	Blocking for a layer, see the top of the file. taskTarget is the number of tasks wanted (a few per core).
+*/
+inline CpuPointwiseBlocking cpuPointwiseBlocking(int batchNumber, int inputChannel, int pixelNumber, int outputChannel, int taskTarget) {
+	CpuPointwiseBlocking blocking;
+	blocking.inputChannelBlock = std::min(inputChannel, 256);
+
+	if (pixelNumber >= 56 * 56) {
+		// large plane: 256 pixels (4 KB per input channel row of the block) and every output channel
+		blocking.pixelBlock = 256;
+		blocking.outputChannelBlock = outputChannel;
+	}
+	else {
+		// small plane: the whole plane, split the output channels until there are enough tasks
+		blocking.pixelBlock = pixelNumber;
+		blocking.outputChannelBlock = outputChannel;
+		while (blocking.outputChannelBlock > 16 &&
+			batchNumber * ((outputChannel + blocking.outputChannelBlock - 1) / blocking.outputChannelBlock) < taskTarget) {
+			blocking.outputChannelBlock = (blocking.outputChannelBlock / 2 + 3) / 4 * 4;
+		}
+	}
+	return blocking;
+}
+
+/*
+CPU_Pointwise():
+	Pointwise convolution of a whole NCHW tensor on the host.
+	filter is outputChannel x inputChannel, output = epilogue(sum * alpha + beta) as in the depthwise kernels.
+	scalar_t is float, DepthwiseHalf or DepthwiseBFloat16: a 16-bit tensor is widened one input channel block of a
+	task at a time into per thread workspace rows, and the output block is rounded back once it is done.
+	workspace is nullptr for a workspace of this call only.
+*/
+template <typename scalar_t>
+inline void CPU_Pointwise(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int outputChannel,
+	float alpha, float beta, DepthwiseEpilogue epilogue, DepthwiseCpuWorkspace* workspace = nullptr) {
+
+	DepthwiseCpuWorkspace callWorkspace;
+	if (workspace == nullptr) {
+		workspace = &callWorkspace;
+	}
+
+	bool hasEpilogue = epilogue.scale != nullptr || epilogue.shift != nullptr || epilogue.activation != DepthwiseActivationNone;
+	bool hasAlphaBeta = alpha != 1.0f || beta != 0.0f;
+	bool floatStorage = std::is_same<scalar_t, float>::value;
+
+	int pixelNumber = inputHeight * inputWidth;
+	int threadNumber = cpuDepthwiseThreadNumber(0);
+	CpuPointwiseBlocking blocking = cpuPointwiseBlocking(inputBatchNumber, inputChannel, pixelNumber, outputChannel, 4 * threadNumber);
+	int pixelBlockNumber = (pixelNumber + blocking.pixelBlock - 1) / blocking.pixelBlock;
+	int outputChannelBlockNumber = (outputChannel + blocking.outputChannelBlock - 1) / blocking.outputChannelBlock;
+
+	const float* filterData = cpuDepthwiseFloatData(filter, (size_t)outputChannel * inputChannel, workspace->filter);
+
+	// 16-bit storage: the widened input channel block, then the float output block, both blocking.pixelBlock wide
+	size_t inputBlockSize = floatStorage ? 0 : (size_t)blocking.inputChannelBlock * blocking.pixelBlock;
+	size_t outputBlockSize = floatStorage ? 0 : (size_t)blocking.outputChannelBlock * blocking.pixelBlock;
+	depthwiseWorkspaceThreads(*workspace, threadNumber);
+
+#pragma omp parallel num_threads(threadNumber)
+	{
+#ifdef _OPENMP
+		int thread = omp_get_thread_num();
+#else
+		int thread = 0;
+#endif
+		float* inputScratch = depthwiseWorkspaceBuffer(workspace->threadBuffers[thread], inputBlockSize + outputBlockSize);
+		float* outputScratch = inputScratch + inputBlockSize;
+
+#pragma omp for collapse(3) schedule(static)
+		for (int n = 0; n < inputBatchNumber; n++) {
+			for (int pixelBlock = 0; pixelBlock < pixelBlockNumber; pixelBlock++) {
+				for (int outputChannelBlock = 0; outputChannelBlock < outputChannelBlockNumber; outputChannelBlock++) {
+					int firstPixel = pixelBlock * blocking.pixelBlock;
+					int pixels = std::min(blocking.pixelBlock, pixelNumber - firstPixel);
+					int firstOutputChannel = outputChannelBlock * blocking.outputChannelBlock;
+					int outputChannels = std::min(blocking.outputChannelBlock, outputChannel - firstOutputChannel);
+
+					const scalar_t* inputBlock = input + (size_t)n * inputChannel * pixelNumber + firstPixel;
+					scalar_t* outputBlock = output + ((size_t)n * outputChannel + firstOutputChannel) * pixelNumber + firstPixel;
+					const float* filterBlock = filterData + (size_t)firstOutputChannel * inputChannel;
+
+					// float storage is read and written in place, 16-bit goes through the scratch blocks
+					float* outputData = cpuDepthwiseRowData(outputBlock, outputScratch);
+					int outputPitch = floatStorage ? pixelNumber : pixels;
+
+					for (int firstInputChannel = 0; firstInputChannel < inputChannel; firstInputChannel += blocking.inputChannelBlock) {
+						int inputChannels = std::min(blocking.inputChannelBlock, inputChannel - firstInputChannel);
+						const scalar_t* inputRows = inputBlock + (size_t)firstInputChannel * pixelNumber;
+						const float* tile = reinterpret_cast<const float*>(inputRows);
+						int tilePitch = pixelNumber;
+						if (!floatStorage) {
+							for (int ci = 0; ci < inputChannels; ci++) {
+								cpuDepthwiseLoad(inputRows + (size_t)ci * pixelNumber, inputScratch + (size_t)ci * pixels, pixels);
+							}
+							tile = inputScratch;
+							tilePitch = pixels;
+						}
+						cpuPointwiseTile(filterBlock + firstInputChannel, inputChannel, inputChannels, outputChannels,
+							tile, tilePitch, pixels, outputData, outputPitch, firstInputChannel != 0);
+					}
+
+					for (int co = 0; co < outputChannels; co++) {
+						float* outputRow = outputData + (size_t)co * outputPitch;
+						if (hasAlphaBeta) {
+							for (int x = 0; x < pixels; x++) {
+								outputRow[x] = outputRow[x] * alpha + beta;
+							}
+						}
+						if (hasEpilogue) {
+							cpuDepthwiseEpilogueRow(outputRow, pixels, DepthwiseChannelEpilogue(epilogue, firstOutputChannel + co));
+						}
+						cpuDepthwiseStore(outputRow, outputBlock + (size_t)co * pixelNumber, pixels);
+					}
+				}
+			}
+		}
+	}
+}
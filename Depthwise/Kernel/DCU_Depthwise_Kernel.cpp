@@ -3,17 +3,25 @@
 #include <cstdlib>
 #include <cmath>
 #include <stdlib.h>
+#include <string.h>
 #include <iomanip>
 #include <time.h>
 #include <random>
 #include <vector>
 #include <fstream>
+#include <chrono>
 #include <unistd.h>
 
+// AMD_PLATFORM is set by the DTK build, without it only the CPU backend is built
+#ifdef AMD_PLATFORM
 #include <hip/hip_runtime.h>
+// MIOpen is only timed next to the kernels, the results are checked on the host
+#ifdef DEPTHWISE_USE_MIOPEN
 #include <miopen/miopen.h>
+#endif
 
 #include "warmup.h"
+#include "DepthwiseEpilogue.h"
 #include "Filter3x3_Input7x7_Stride1.h"
 #include "Filter3x3_Input14x14_Stride1.h"
 #include "Filter3x3_Input14x14_Stride2.h"
@@ -28,9 +36,60 @@
 #include "Filter5x5_Input14x14_Stride2.h"
 #include "Filter5x5_Input28x28_Stride1.h"
 #include "Filter5x5_Input56x56_Stride2.h"
+#include "Depthwise_Generic.h"
+#include "Depthwise_RowRolling.h"
+#endif
+#include "DepthwiseRegistry.h"
+#include "DepthwiseBenchmark.h"
+#include "CPU_Depthwise.h"
+#include "CPU_DepthwiseWinograd.h"
 
 using namespace std;
 
+#ifdef AMD_PLATFORM
+/*
+Launch table for the specialised kernels, indexed by DepthwiseKernelId.
+*/
+typedef void (*DepthwiseKernelFunction)(const float* input, const float* filter, float* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	float alpha, float beta, DepthwiseEpilogue epilogue);
+
+static const DepthwiseKernelFunction depthwiseKernels[DepthwiseKernelNumber] = {
+#define DEPTHWISE_KERNEL(name, ...) name,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRolling<float, inputHeight, filterSize, stride, channelGroupSize>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+};
+
+/*
+Launch table of Depthwise_RowRollingRect for the rectangular inputs, [transposed][DepthwiseKernelId].
+*/
+static const DepthwiseKernelFunction depthwiseRectKernels[2][DepthwiseKernelNumber] = {
+	{
+#define DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, ...) \
+	Depthwise_RowRollingRect<float, inputHeight, filterSize, stride, channelGroupSize, false>,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRollingRect<float, inputHeight, filterSize, stride, channelGroupSize, false>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	},
+	{
+#define DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, ...) \
+	Depthwise_RowRollingRect<float, inputHeight, filterSize, stride, channelGroupSize, true>,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRollingRect<float, inputHeight, filterSize, stride, channelGroupSize, true>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	}
+};
+
 /*
 Hip and MIOpen Error Handling
 
@@ -54,24 +113,24 @@ inline void __checkKernel(const char* file, const int line) {
 		exit(-1);
 	}
 }
+#endif
 
 /*
 compareOutput():
-	Compare the result calculated by our kernel and that by the MIOpen library.
-	Use MIOpen library as a reference.
+	Compare the result calculated by our kernel and that by the host reference (referenceDepthwise()).
 Input:
 	n            - batch number
 	c            - channel number
 	h            - height
 	w            - width
 	kernelOutput - output data of our kernel
-	miopenOutput  - output data of the MIOpen
+	referenceOutput - output data of the reference
 	delta        - a small value. Allowed numerical differece between each element
 Output:
 	-1           - our kernel is wrong
 	0            - out kernel is correct
 */
-int compareOutput(int n, int c, int h, int w, const float* kernelOutput, const float* miopenOutput, float delta) {
+int compareOutput(int n, int c, int h, int w, const float* kernelOutput, const float* referenceOutput, float delta) {
 	int i, j, k, l;
 
 	// Loop over each element, and compare the value.
@@ -80,8 +139,8 @@ int compareOutput(int n, int c, int h, int w, const float* kernelOutput, const f
 		for (j = 0; j < c; j++) {
 			for (k = 0; k < h; k++) {
 				for (l = 0; l < w; l++) {
-					if (abs(kernelOutput[i * c * h * w + j * h * w + k * w + l] - miopenOutput[i * c * h * w + j * h * w + k * w + l]) > delta) {
-						printf("%f, %f\n", kernelOutput[i * c * h * w + j * h * w + k * w + l], miopenOutput[i * c * h * w + j * h * w + k * w + l]);
+					if (abs(kernelOutput[i * c * h * w + j * h * w + k * w + l] - referenceOutput[i * c * h * w + j * h * w + k * w + l]) > delta) {
+						printf("%f, %f\n", kernelOutput[i * c * h * w + j * h * w + k * w + l], referenceOutput[i * c * h * w + j * h * w + k * w + l]);
 						printf("Wrong! Output Batch Idx: %d, Channel Idx: %d, Row Idx: %d, Col Idx: %d\n", i, j, k, l);
 						return -1;
 					}
@@ -92,441 +151,483 @@ int compareOutput(int n, int c, int h, int w, const float* kernelOutput, const f
 	return 0;
 }
 
+
 /*
-To test depthwise convolution kernels.
+Benchmark options, see printUsage().
 */
-int main(int argc, char* argv[]) {
-	// Input dimension
-	int inputBatchNumber = 0;
-	int inputChannel = 0;
-	int inputHeight = 0;
-	int inputWidth = 0;
-
-	// Filter dimension
-	int filterLayerNumber = 0;
-	int filterChannel = 0;
-	int filterHeight = 0;
-	int filterWidth = 0;
-
-	// Output dimension
-	int outputBatchNumber = 0;
-	int outputChannel = 0;
-	int outputHeight = 0;
-	int outputWidth = 0;
-
-	// padding on height and width
-	int paddingHeight = 0;
-	int paddingWidth = 0;
-
-	// stride
-	int stride = 1;
+struct BenchmarkOptions {
+	bool cpu;
+	int winogradTile;
+	int warmup;
+	int iterations;
+	bool reference;
+	bool legacyOutput;
+	const char* jsonPath;
+	const char* csvPath;
+};
+
+/*
+fillRandom():
+	Same values on every backend and every run, so results can be compared across machines.
+*/
+static void fillRandom(std::vector<float>& data, unsigned int seed) {
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> distribution(0.0f, 5.0f);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = distribution(generator);
+	}
+}
+
+#ifdef AMD_PLATFORM
+#ifdef DEPTHWISE_USE_MIOPEN
+/*
+benchmarkMiopen():
+	Time the grouped convolution of MIOpen on the same device buffers, as the baseline of the kernel.
+	Its output is not checked, the kernel is checked against the host reference.
+*/
+static void benchmarkMiopen(const DepthwiseBenchmarkShape& shape, const BenchmarkOptions& options,
+	const float* deviceInput, const float* deviceFilter, DepthwiseBenchmarkResult& result) {
 
 	float alpha = 1.0;
 	float beta = 0.0;
+	float* deviceMiopenOutput;
+	checkHip(hipMalloc((void**)&deviceMiopenOutput, shape.outputSize() * sizeof(float)));
+
+	// Create miopen
+	miopenHandle_t miopen;
+	miopenCreate(&miopen);
+
+	miopenTensorDescriptor_t inputDesc;
+	miopenCreateTensorDescriptor(&inputDesc);
+	miopenSet4dTensorDescriptor(inputDesc, miopenFloat, shape.batch, shape.channel, shape.height, shape.width);
+
+	miopenTensorDescriptor_t filterDesc;
+	miopenCreateTensorDescriptor(&filterDesc);
+	miopenSet4dTensorDescriptor(filterDesc, miopenFloat, shape.channel, 1, shape.filter, shape.filter);
+
+	miopenTensorDescriptor_t outputDesc;
+	miopenCreateTensorDescriptor(&outputDesc);
+	miopenSet4dTensorDescriptor(outputDesc, miopenFloat, shape.batch, shape.channel, shape.outputHeight(), shape.outputWidth());
+
+	miopenConvolutionDescriptor_t convDesc;
+	miopenCreateConvolutionDescriptor(&convDesc);
+	miopenInitConvolutionDescriptor(convDesc, miopenConvolution, shape.padding(), shape.padding(), shape.stride, shape.stride, 1, 1);
+	miopenSetConvolutionGroupCount(convDesc, shape.channel);
+
+	// create workspace
+	size_t workspaceSize = 0;
+	void* workspaceData = nullptr;
+	miopenConvolutionForwardGetWorkSpaceSize(miopen, inputDesc, filterDesc, convDesc, outputDesc, &workspaceSize);
+	checkHip(hipMalloc(&workspaceData, workspaceSize));
+
+	// set algorithm
+	int returnedAlgoCount = 0;
+	miopenConvAlgoPerf_t miopenPerfResult;
+	miopenFindConvolutionForwardAlgorithm(
+		miopen, inputDesc, deviceInput,
+		filterDesc, deviceFilter,
+		convDesc,
+		outputDesc, deviceMiopenOutput, 1,
+		&returnedAlgoCount, &miopenPerfResult, workspaceData,
+		workspaceSize, false);
 
-	// Initialize all required parameters
-	// Input dimensions
-	inputBatchNumber = atoi(argv[1]);
-	inputChannel = atoi(argv[2]);
-	inputHeight = atoi(argv[3]);
-	inputWidth = inputHeight;           // Assume that inputs are square
-
-	// Filter dimensions
-	filterLayerNumber = inputChannel;
-	filterChannel = 1;
-	filterHeight = atoi(argv[4]);
-	filterWidth = filterHeight;         // Assume that filters are square
-
-	// Padding size
-	if (filterWidth == 3) {
-		paddingHeight = 1;
-		paddingWidth = 1;
-	}
-	else if (filterWidth == 5) {
-		paddingHeight = 2;
-		paddingWidth = 2;
+	hipEvent_t start, stop;
+	hipEventCreate(&start);
+	hipEventCreate(&stop);
+	std::vector<double> samples;
+	for (int i = 0; i < options.warmup + options.iterations; i++) {
+		hipEventRecord(start);
+		miopenConvolutionForward(
+			miopen, &alpha, inputDesc, deviceInput,
+			filterDesc, deviceFilter,
+			convDesc, miopenPerfResult.fwd_algo, &beta,
+			outputDesc, deviceMiopenOutput, workspaceData,
+			workspaceSize);
+		hipEventRecord(stop);
+		hipEventSynchronize(stop);
+		float elapsedTime = 0.0;
+		hipEventElapsedTime(&elapsedTime, start, stop);
+		if (i >= options.warmup) {
+			samples.push_back(elapsedTime * 1000.0);
+		}
 	}
+	result.hasReference = true;
+	result.referenceName = "MIOpen";
+	result.referenceTime = benchmarkStatistics(samples);
+
+	hipEventDestroy(start);
+	hipEventDestroy(stop);
+	hipFree(deviceMiopenOutput);
+	hipFree(workspaceData);
+
+	miopenDestroyTensorDescriptor(inputDesc);
+	miopenDestroyTensorDescriptor(outputDesc);
+	miopenDestroyConvolutionDescriptor(convDesc);
+	miopenDestroyTensorDescriptor(filterDesc);
+	miopenDestroy(miopen);
+}
+#endif
+
+/*
+benchmarkDcu():
+	Time the kernel of one shape (registry kernel, Depthwise_RowRollingRect of the registry kernel of its height or
+	width, or Depthwise_Generic), check it against the host reference and time MIOpen if options.reference.
+	Every measured iteration is one launch between its own pair of events.
+*/
+static void benchmarkDcu(const DepthwiseBenchmarkShape& shape, const BenchmarkOptions& options,
+	const std::vector<float>& hostInput, const std::vector<float>& hostFilter, DepthwiseBenchmarkResult& result) {
+
+	int inputBatchNumber = shape.batch;
+	int inputChannel = shape.channel;
+	int inputHeight = shape.height;
+	int inputWidth = shape.width;
+	int filterLayerNumber = inputChannel;
+	int filterHeight = shape.filter;
+	int filterWidth = shape.filter;
+	int outputBatchNumber = inputBatchNumber;
+	int outputChannel = inputChannel;
+	int outputHeight = shape.outputHeight();
+	int outputWidth = shape.outputWidth();
+	int paddingHeight = shape.padding();
+	int paddingWidth = shape.padding();
+	int stride = shape.stride;
+
+	float alpha = 1.0;
+	float beta = 0.0;
+
+	size_t inputSize = shape.inputSize();
+	size_t filterSize = shape.filterSize();
+	size_t outputSize = shape.outputSize();
 
-	// Stride
-	stride = atoi(argv[5]);
-
-	// Output dimensions
-	outputBatchNumber = inputBatchNumber;
-	outputChannel = inputChannel;
-	outputHeight = (inputHeight + paddingHeight * 2 - filterHeight) / stride + 1;
-	outputWidth = (inputWidth + paddingWidth * 2 - filterWidth) / stride + 1;
-
-	// Data size
-	int inputSize = inputBatchNumber * inputChannel * inputHeight * inputWidth;
-	int filterSize = filterLayerNumber * filterChannel * filterHeight * filterWidth;
-	int outputSize = outputBatchNumber * outputChannel * outputHeight * outputWidth;
-
-	// allocate host memory and device memory for input data, and copy it from host to device.
-	float* hostInput = (float*)malloc(inputSize * sizeof(float));
-	srand(time(NULL));
-	for (int i = 0; i < inputSize; i++) {
-		hostInput[i] = (float)(float(rand()) / float((RAND_MAX)) * 5.0);
-	}
 	float* deviceInput;
 	checkHip(hipMalloc((void**)&deviceInput, inputSize * sizeof(float)));
-	checkHip(hipMemcpy(deviceInput, hostInput, inputSize * sizeof(float), hipMemcpyHostToDevice));
-
-	// allocate host memory and device memory for filter data, and copy it from host to device.
-	float* hostFilter = (float*)malloc(filterSize * sizeof(float));
-	srand(time(NULL));
-	for (int i = 0; i < filterSize; i++) {
-		hostFilter[i] = (float)(float(rand()) / float((RAND_MAX)) * 5.0);
-	}
+	checkHip(hipMemcpy(deviceInput, hostInput.data(), inputSize * sizeof(float), hipMemcpyHostToDevice));
 	float* deviceFilter;
 	checkHip(hipMalloc((void**)&deviceFilter, filterSize * sizeof(float)));
-	checkHip(hipMemcpy(deviceFilter, hostFilter, filterSize * sizeof(float), hipMemcpyHostToDevice));
-
-	// allocate host memory and device memory for kernel output data
-	float* hostKernelOutput = (float*)malloc(outputSize * sizeof(float));
+	checkHip(hipMemcpy(deviceFilter, hostFilter.data(), filterSize * sizeof(float), hipMemcpyHostToDevice));
 	float* deviceKernelOutput;
 	checkHip(hipMalloc((void**)&deviceKernelOutput, outputSize * sizeof(float)));
 
-	// allocate host memory and device memory for MIOpen output data
-	float* hostMiopenOutput = (float*)malloc(outputSize * sizeof(float));
-	float* deviceMiopenOutput;
-	checkHip(hipMalloc((void**)&deviceMiopenOutput, outputSize * sizeof(float)));
-
-	// Use Hip event to measure running time
-	float elapsedTime = 0.0;
-	float kernelTime = 0.0;
-	float miopenTime = 0.0;
 	hipEvent_t start, stop;
 	hipEventCreate(&start);
 	hipEventCreate(&stop);
-
-	// GPU warm up for benchmarking
-	warmup<<<1024, 128>>>();
+	std::vector<double> samples;
 
 	// Kernel Invocation
-	if (stride == 1) {
-		if (filterHeight == 3) {
-			if (inputHeight == 7) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				hipEventRecord(start);
-				Filter3x3_Input7x7_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
-			else if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 16);
-				dim3 blockSize(14 * 16, 1);
-				hipEventRecord(start);
-				Filter3x3_Input14x14_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
-			else if (inputHeight == 28) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 8);
-				dim3 blockSize(28 * 8, 1);
-				hipEventRecord(start);
-				Filter3x3_Input28x28_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
-			else if (inputHeight == 56) {
-				dim3 gridSize(outputBatchNumber, outputChannel);
-				dim3 blockSize(4 * 56, 1);
-				hipEventRecord(start);
-				Filter3x3_Input56x56_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
-			else if (inputHeight == 112) {
-				dim3 gridSize(outputBatchNumber, outputChannel * 4);
-				dim3 blockSize(2 * 112, 1);
-				hipEventRecord(start);
-				Filter3x3_Input112x112_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
+	const DepthwiseKernelEntry* kernelEntry = findDepthwiseKernel(
+		ConvShape(inputHeight, inputWidth, filterHeight, filterWidth, paddingWidth, stride), inputChannel);
+	DepthwiseRectKernel rect;
+	bool rectangular = kernelEntry == nullptr && findDepthwiseRectKernel(
+		ConvShape(inputHeight, inputWidth, filterHeight, filterWidth, paddingWidth, stride), inputChannel, rect);
+	result.kernel = kernelEntry ? kernelEntry->name : "Depthwise_Generic";
+	if (rectangular) {
+		result.kernel = std::string("Depthwise_RowRollingRect ") + rect.entry->name + (rect.transposed ? " transposed" : "");
+	}
+
+	for (int i = 0; i < options.warmup + options.iterations; i++) {
+		hipEventRecord(start);
+		if (kernelEntry) {
+			dim3 gridSize(outputBatchNumber, kernelEntry->gridHeight(outputChannel));
+			dim3 blockSize(kernelEntry->blockSize, 1);
+			depthwiseKernels[kernelEntry->id]<<<gridSize, blockSize>>> (
+				deviceInput, deviceFilter, deviceKernelOutput,
+				inputBatchNumber, inputChannel, inputHeight, inputWidth,
+				filterLayerNumber, filterHeight, filterWidth,
+				outputBatchNumber, outputChannel, outputHeight, outputWidth,
+				paddingWidth, stride,
+				alpha, beta, depthwiseNoEpilogue);
 		}
-		else if (filterHeight == 5) {
-			if (inputHeight == 7) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				hipEventRecord(start);
-				Filter5x5_Input7x7_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
-			else if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 16);
-				dim3 blockSize(14 * 16, 1);
-				hipEventRecord(start);
-				Filter5x5_Input14x14_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
-			else if (inputHeight == 28) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 8);
-				dim3 blockSize(28 * 8, 1);
-				hipEventRecord(start);
-				Filter5x5_Input28x28_Stride1<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
+		else if (rectangular) {
+			// the specialised kernel of one dimension, tiled along the other one
+			dim3 gridSize(outputBatchNumber, outputChannel / rect.entry->channelGroupSize, rect.tileNumber);
+			dim3 blockSize(rect.blockSize, 1);
+			depthwiseRectKernels[rect.transposed][rect.entry->id]<<<gridSize, blockSize>>> (
+				deviceInput, deviceFilter, deviceKernelOutput,
+				inputBatchNumber, inputChannel, inputHeight, inputWidth,
+				filterLayerNumber, filterHeight, filterWidth,
+				outputBatchNumber, outputChannel, outputHeight, outputWidth,
+				paddingWidth, stride,
+				alpha, beta, depthwiseNoEpilogue);
+		}
+		else {
+			// no specialised kernel for this shape, use the generic one
+			launchDepthwiseGeneric(
+				deviceInput, deviceFilter, deviceKernelOutput,
+				inputBatchNumber, inputChannel, inputHeight, inputWidth,
+				filterLayerNumber, filterHeight, filterWidth,
+				outputBatchNumber, outputChannel, outputHeight, outputWidth,
+				paddingHeight, paddingWidth, stride, stride, 1, 1,
+				alpha, beta, depthwiseNoEpilogue);
+		}
+		hipEventRecord(stop);
+		hipEventSynchronize(stop);
+		checkKernel();
+		float elapsedTime = 0.0;
+		hipEventElapsedTime(&elapsedTime, start, stop);
+		if (i >= options.warmup) {
+			samples.push_back(elapsedTime * 1000.0);
 		}
 	}
-	else if (stride == 2) {
-		if (filterHeight == 3) {
-			if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				hipEventRecord(start);
-				Filter3x3_Input14x14_Stride2<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
-			}
-			else if (inputHeight == 28) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 8);
-				dim3 blockSize(14 * 8, 1);
-				hipEventRecord(start);
-				Filter3x3_Input28x28_Stride2<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
+	result.time = benchmarkStatistics(samples);
+
+	// Copy kernel output from device to host
+	std::vector<float> hostKernelOutput(outputSize);
+	checkHip(hipMemcpy(hostKernelOutput.data(), deviceKernelOutput, outputSize * sizeof(float), hipMemcpyDeviceToHost));
+
+	// Check against the host reference
+	std::vector<float> referenceOutput(outputSize);
+	referenceDepthwise(shape, hostInput.data(), hostFilter.data(), referenceOutput.data());
+	result.correct = compareOutput(outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		hostKernelOutput.data(), referenceOutput.data(), 1) == 0;
+	result.maxError = depthwiseBenchmarkError(hostKernelOutput.data(), referenceOutput.data(), outputSize);
+
+#ifdef DEPTHWISE_USE_MIOPEN
+	if (options.reference) {
+		benchmarkMiopen(shape, options, deviceInput, deviceFilter, result);
+	}
+#endif
+
+	hipEventDestroy(start);
+	hipEventDestroy(stop);
+
+	hipFree(deviceInput);
+	hipFree(deviceFilter);
+	hipFree(deviceKernelOutput);
+}
+#endif
+
+/*
+benchmarkCpu():
+	Time CPU_Depthwise, or CPU_Depthwise_Winograd() with options.winogradTile, on one shape, check it against the
+	host reference. The Winograd filter transform is kept in one workspace across the iterations, as in inference.
+*/
+static void benchmarkCpu(const DepthwiseBenchmarkShape& shape, const BenchmarkOptions& options,
+	const std::vector<float>& hostInput, const std::vector<float>& hostFilter, DepthwiseBenchmarkResult& result) {
+
+	std::vector<float> output(shape.outputSize());
+	std::vector<double> samples;
+	DepthwiseCpuWorkspace workspace;
+	result.kernel = options.winogradTile == 4 ? "CPU_Depthwise_Winograd_F4x4" :
+		options.winogradTile == 2 ? "CPU_Depthwise_Winograd_F2x2" : "CPU_Depthwise";
+
+	for (int i = 0; i < options.warmup + options.iterations; i++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (options.winogradTile != 0) {
+			CPU_Depthwise_Winograd(hostInput.data(), hostFilter.data(), output.data(),
+				shape.batch, shape.channel, shape.height, shape.width, shape.outputHeight(), shape.outputWidth(),
+				shape.padding(), shape.padding(), 1.0f, 0.0f, depthwiseNoEpilogue, options.winogradTile, &workspace);
+		}
+		else {
+			CPU_Depthwise(hostInput.data(), hostFilter.data(), output.data(),
+				shape.batch, shape.channel, shape.height, shape.width,
+				shape.channel, shape.filter, shape.filter,
+				shape.batch, shape.channel, shape.outputHeight(), shape.outputWidth(),
+				shape.padding(), shape.stride,
+				1.0f, 0.0f, depthwiseNoEpilogue);
+		}
+		std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+		if (i >= options.warmup) {
+			samples.push_back(std::chrono::duration<double, std::micro>(stop - start).count());
+		}
+	}
+	result.time = benchmarkStatistics(samples);
+	result.hasReference = false;
+
+	std::vector<float> referenceOutput(shape.outputSize());
+	referenceDepthwise(shape, hostInput.data(), hostFilter.data(), referenceOutput.data());
+	result.correct = compareOutput(shape.batch, shape.channel, shape.outputHeight(), shape.outputWidth(),
+		output.data(), referenceOutput.data(), 1) == 0;
+	result.maxError = depthwiseBenchmarkError(output.data(), referenceOutput.data(), shape.outputSize());
+}
+
+static void printUsage(const char* program) {
+	fprintf(stderr,
+		"Usage: %s [options] [N C H K S]\n"
+		"  --shape N,C,H,K,S | N,C,H,W,K,S  shape to run, can be repeated\n"
+		"  --shapes FILE                     one shape per line\n"
+		"  --backend dcu|cpu|winograd        default dcu when built with DTK, cpu otherwise; winograd is the CPU\n"
+		"                                    Winograd path (3 x 3 stride 1 shapes only), see its max error\n"
+		"  --winograd-tile 2|4               F(2x2, 3x3) or F(4x4, 3x3) for --backend winograd (default 4)\n"
+		"  --warmup N                        untimed iterations per shape (default 10)\n"
+		"  --iterations N                    timed iterations per shape (default 100)\n"
+		"  --no-reference                    do not time MIOpen (results are always checked on the host)\n"
+		"  --json FILE, --csv FILE           write the results\n"
+		"Five plain numbers run a single shape and print the summary the result scripts parse.\n",
+		program);
+}
+
+/*
+To benchmark depthwise convolution kernels.
+*/
+int main(int argc, char* argv[]) {
+	BenchmarkOptions options;
+#ifdef AMD_PLATFORM
+	options.cpu = false;
+#else
+	options.cpu = true;
+#endif
+	bool winograd = false;
+	int winogradTile = 4;
+	options.warmup = 10;
+	options.iterations = 100;
+#ifdef DEPTHWISE_USE_MIOPEN
+	options.reference = true;
+#else
+	options.reference = false;
+#endif
+	options.legacyOutput = false;
+	options.jsonPath = nullptr;
+	options.csvPath = nullptr;
+
+	std::vector<DepthwiseBenchmarkShape> shapes;
+	std::string legacyShape;
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--shape") == 0 && hasValue) {
+			DepthwiseBenchmarkShape shape;
+			if (!parseDepthwiseBenchmarkShape(argv[++i], shape)) {
+				fprintf(stderr, "Not a shape: %s\n", argv[i]);
+				return 1;
 			}
-			else if (inputHeight == 56) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 2);
-				dim3 blockSize(28 * 2, 1);
-				hipEventRecord(start);
-				Filter3x3_Input56x56_Stride2<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
+			shapes.push_back(shape);
+		}
+		else if (strcmp(argv[i], "--shapes") == 0 && hasValue) {
+			if (!readDepthwiseBenchmarkShapes(argv[++i], shapes)) {
+				return 1;
 			}
-			else if (inputHeight == 112) {
-				dim3 gridSize(outputBatchNumber, outputChannel * 2);
-				dim3 blockSize(56 * 4, 1);
-				hipEventRecord(start);
-				Filter3x3_Input112x112_Stride2<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
+		}
+		else if (strcmp(argv[i], "--backend") == 0 && hasValue) {
+			i++;
+			winograd = strcmp(argv[i], "winograd") == 0;
+			options.cpu = winograd || strcmp(argv[i], "cpu") == 0;
+			if (!options.cpu && strcmp(argv[i], "dcu") != 0) {
+				printUsage(argv[0]);
+				return 1;
 			}
 		}
-		else if (filterHeight == 5) {
-			if (inputHeight == 14) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 32);
-				dim3 blockSize(7 * 32, 1);
-				hipEventRecord(start);
-				Filter5x5_Input14x14_Stride2<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
+		else if (strcmp(argv[i], "--winograd-tile") == 0 && hasValue) {
+			winogradTile = atoi(argv[++i]);
+			if (winogradTile != 2 && winogradTile != 4) {
+				printUsage(argv[0]);
+				return 1;
 			}
-			else if (inputHeight == 56) {
-				dim3 gridSize(outputBatchNumber, outputChannel / 2);
-				dim3 blockSize(28 * 2, 1);
-				hipEventRecord(start);
-				Filter5x5_Input56x56_Stride2<<<gridSize, blockSize>>> (
-					deviceInput, deviceFilter, deviceKernelOutput,
-					inputBatchNumber, inputChannel, inputHeight, inputWidth,
-					filterLayerNumber, filterHeight, filterWidth,
-					outputBatchNumber, outputChannel, outputHeight, outputWidth,
-					paddingWidth, stride,
-					alpha, beta);
-				hipEventRecord(stop);
-				hipEventSynchronize(stop);
-				hipEventElapsedTime(&elapsedTime, start, stop);
-				kernelTime = elapsedTime;
+		}
+		else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+			options.warmup = std::max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--iterations") == 0 && hasValue) {
+			options.iterations = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--no-reference") == 0) {
+			options.reference = false;
+		}
+		else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+			options.jsonPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--csv") == 0 && hasValue) {
+			options.csvPath = argv[++i];
+		}
+		else if (argv[i][0] != '-') {
+			// N C H K S, the original command line
+			legacyShape += argv[i];
+			legacyShape += " ";
+		}
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (!legacyShape.empty()) {
+		DepthwiseBenchmarkShape shape;
+		if (!parseDepthwiseBenchmarkShape(legacyShape.c_str(), shape)) {
+			printUsage(argv[0]);
+			return 1;
+		}
+		shapes.push_back(shape);
+		options.legacyOutput = shapes.size() == 1;
+	}
+	if (shapes.empty()) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	options.winogradTile = winograd ? winogradTile : 0;
+#ifndef AMD_PLATFORM
+	if (!options.cpu) {
+		fprintf(stderr, "Built without DTK, only --backend cpu is available\n");
+		return 1;
+	}
+#else
+	if (!options.cpu) {
+		// GPU warm up for benchmarking
+		warmup<<<1024, 128>>>();
+	}
+#endif
+
+	std::vector<DepthwiseBenchmarkResult> results;
+	bool allCorrect = true;
+	for (size_t i = 0; i < shapes.size(); i++) {
+		const DepthwiseBenchmarkShape& shape = shapes[i];
+		if (options.winogradTile != 0 && !depthwiseWinogradSupported(shape.filter, shape.filter, shape.stride, shape.stride, 1, 1)) {
+			fprintf(stderr, "Winograd needs a 3 x 3 stride 1 shape, skipped N=%d C=%d H=%d W=%d K=%d S=%d\n",
+				shape.batch, shape.channel, shape.height, shape.width, shape.filter, shape.stride);
+			continue;
+		}
+		std::vector<float> hostInput(shape.inputSize());
+		std::vector<float> hostFilter(shape.filterSize());
+		fillRandom(hostInput, 1);
+		fillRandom(hostFilter, 2);
+
+		DepthwiseBenchmarkResult result;
+		result.shape = shape;
+		result.backend = options.winogradTile != 0 ? "winograd" : options.cpu ? "cpu" : "dcu";
+		result.hasReference = false;
+		if (options.cpu) {
+			benchmarkCpu(shape, options, hostInput, hostFilter, result);
+		}
+#ifdef AMD_PLATFORM
+		else {
+			benchmarkDcu(shape, options, hostInput, hostFilter, result);
+		}
+#endif
+		allCorrect = allCorrect && result.correct;
+		results.push_back(result);
+
+		if (options.legacyOutput) {
+			// median times, in the format TestDepthwiseKernel.py reads; nan when MIOpen was not timed
+			if (result.correct) {
+				printf("Kernel Calculation Correct.\n");
+				printf("MIOpen time : %f ms.\n", result.hasReference ? result.referenceTime.median / 1000.0 : NAN);
+				printf("Kernel time : %f ms.\n", result.time.median / 1000.0);
 			}
 		}
+		else {
+			printDepthwiseBenchmarkResult(stdout, result);
+		}
 	}
-	
-	// Copy kernel output from device to host
-	checkHip(hipMemcpy(hostKernelOutput, deviceKernelOutput, outputSize * sizeof(float), hipMemcpyDeviceToHost));
-	
-    // Create miopen
-    miopenHandle_t miopen;
-    miopenCreate(&miopen);
-    
-    // input descriptor
-    miopenTensorDescriptor_t inputDesc;
-    miopenCreateTensorDescriptor(&inputDesc);
-    miopenSet4dTensorDescriptor(inputDesc, miopenFloat, inputBatchNumber, inputChannel, inputHeight, inputWidth);
-    
-    // filter descriptor
-    miopenTensorDescriptor_t filterDesc;
-    miopenCreateTensorDescriptor(&filterDesc);
-    miopenSet4dTensorDescriptor(filterDesc, miopenFloat, filterLayerNumber, filterChannel, filterHeight, filterWidth);
-
-    // output descriptor
-    miopenTensorDescriptor_t outputDesc;
-    miopenCreateTensorDescriptor(&outputDesc);
-    miopenSet4dTensorDescriptor(outputDesc, miopenFloat, outputBatchNumber, outputChannel, outputHeight, outputWidth);
-    
-    // convolution descriptor
-    miopenConvolutionDescriptor_t convDesc;
-    miopenCreateConvolutionDescriptor(&convDesc);
-    
-    miopenInitConvolutionDescriptor(convDesc,miopenConvolution, paddingHeight, paddingWidth, stride, stride, 1, 1);
-    miopenSetConvolutionGroupCount(convDesc, inputChannel);
-
- 	// create workspace
-    size_t workspaceSize = 0;
-    void* workspaceData = nullptr;
-    miopenConvolutionForwardGetWorkSpaceSize(miopen, inputDesc, filterDesc, convDesc, outputDesc, &workspaceSize);
-    checkHip(hipMalloc(&workspaceData, workspaceSize));
-
-    // set algorithm
-    int returnedAlgoCount = 0;
-    miopenConvAlgoPerf_t *miopenPerfResults = new miopenConvAlgoPerf_t[1];
-
-    miopenFindConvolutionForwardAlgorithm(
-        miopen, inputDesc, deviceInput,
-        filterDesc, deviceFilter,
-        convDesc,
-        outputDesc, deviceMiopenOutput, 1,
-        &returnedAlgoCount, miopenPerfResults, workspaceData,
-        workspaceSize, false);
-
-    // Use MIOpen to check kernel result and measure running time
-    hipEventRecord(start);
-    miopenConvolutionForward(
-	    miopen, &alpha, inputDesc, deviceInput,
-        filterDesc, deviceFilter,
-        convDesc, miopenPerfResults->fwd_algo, &beta,
-        outputDesc, deviceMiopenOutput, workspaceData,
-        workspaceSize);
-    hipEventRecord(stop);
-    hipEventSynchronize(stop);
-    hipEventElapsedTime(&elapsedTime, start, stop);\
-    miopenTime = elapsedTime;
-
-    // Copy MIOpen result from device to host
-    checkHip(hipMemcpy(hostMiopenOutput, deviceMiopenOutput, outputSize * sizeof(float), hipMemcpyDeviceToHost));
-
-    // Compare Kernel result and MIOpen result
-    if (compareOutput(outputBatchNumber, outputChannel, outputHeight, outputWidth, hostKernelOutput, hostMiopenOutput, 1) == 0) {
-		printf("Kernel Calculation Correct.\n");
-		printf("MIOpen time : %f ms.\n", miopenTime);
-		printf("Kernel time : %f ms.\n", kernelTime);
-    }
-
-	free(hostInput);
-	free(hostFilter);
-	free(hostKernelOutput);
-	free(hostMiopenOutput);
 
-	hipFree(deviceInput);
-	hipFree(deviceFilter);
-	hipFree(deviceKernelOutput);
-	hipFree(deviceMiopenOutput);
-
-	miopenDestroy(miopen);
-    miopenDestroyTensorDescriptor(inputDesc);
-    miopenDestroyTensorDescriptor(outputDesc);
-    miopenDestroyConvolutionDescriptor(convDesc);
-    miopenDestroyTensorDescriptor(filterDesc);
-    hipFree(workspaceData);
+	const char* paths[] = { options.jsonPath, options.csvPath };
+	for (int i = 0; i < 2; i++) {
+		if (paths[i] == nullptr) {
+			continue;
+		}
+		FILE* file = fopen(paths[i], "w");
+		if (file == nullptr) {
+			fprintf(stderr, "Cannot write %s\n", paths[i]);
+			return 1;
+		}
+		if (i == 0) {
+			writeDepthwiseBenchmarkJson(file, results, options.warmup, options.iterations);
+		}
+		else {
+			writeDepthwiseBenchmarkCsv(file, results);
+		}
+		fclose(file);
+	}
 
-	checkHip(hipDeviceReset());
-	return 0;
-}
\ No newline at end of file
+#ifdef AMD_PLATFORM
+	if (!options.cpu) {
+		checkHip(hipDeviceReset());
+	}
+#endif
+	return allCorrect ? 0 : 2;
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include "EmulatedDepthwiseKernels.h"
+
+#define float emu::Float
+#include "Depthwise_NHWC.h"
+#undef float
+
+#include "SharedBankConflicts.h"
+
+/*
+LDS bank conflicts of the depthwise kernels, from the shared memory accesses they make on the host emulator.
+
+	DepthwiseBankConflicts [--shape H,K,S]... [--kernel name]... [--blocks n] [-i]
+
+	--shape		input size, filter size and stride; without it the shapes of the registry kernels
+	--kernel	only the kernels whose name contains this text (e.g. Filter3x3, Generic, NHWC)
+	--blocks	blocks to record per launch (default 1, the blocks of a kernel all access shared memory alike)
+	-i			every instruction: file:line (the tool is built with -g), load / store, array, degree
+
+For every shape: the registry kernel, Depthwise_Generic and Depthwise_NHWC, each with its conflict degree
+(LDS cycles over conflict free cycles) and, for the staged input tile, the row padding with the fewest cycles.
+*/
+
+struct ConflictOptions {
+	std::vector<std::string> kernels;
+	int blocks;
+	bool perInstruction;
+};
+
+static bool selected(const ConflictOptions& options, const std::string& name) {
+	if (options.kernels.empty()) {
+		return true;
+	}
+	for (size_t i = 0; i < options.kernels.size(); i++) {
+		if (name.find(options.kernels[i]) != std::string::npos) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+printReport():
+	Conflicts of the last launch. pitch > 0: search the row padding of the input tile, pitch words per row from
+	baseOffset on in array (-1: the largest array the kernel accessed).
+*/
+static void printReport(const ConflictOptions& options, const std::string& name, int array, uint32_t baseOffset, int pitch) {
+	const emu::LaunchStatistics& launch = emu::lastLaunchStatistics();
+	emu::BankConflictReport report = emu::analyzeBankConflicts(launch);
+	printf("%s\n\t", name.c_str());
+	emu::printBankConflicts(stdout, launch, report, options.perInstruction);
+
+	if (pitch <= 0 || report.instructions.empty()) {
+		return;
+	}
+	if (array < 0) {
+		size_t largest = 0;
+		for (size_t i = 0; i < report.instructions.size(); i++) {
+			const emu::AddressRange& range = launch.sharedArrays[report.instructions[i].array];
+			if (range.end - range.begin > largest) {
+				largest = range.end - range.begin;
+				array = report.instructions[i].array;
+			}
+		}
+	}
+	emu::PaddingSuggestion suggestion = emu::suggestPadding(launch, array, baseOffset, pitch);
+	double degree = suggestion.idealCycles > 0 ? (double)suggestion.cycles / suggestion.idealCycles : 1.0;
+	double paddedDegree = suggestion.idealCycles > 0 ? (double)suggestion.paddedCycles / suggestion.idealCycles : 1.0;
+	if (suggestion.padding == 0) {
+		printf("\tinput tile, pitch %d: %.2f x, no padding does better\n", pitch, degree);
+	}
+	else {
+		printf("\tinput tile, pitch %d: %.2f x, pitch %d (+%d): %.2f x\n", pitch, degree,
+			pitch + suggestion.padding, suggestion.padding, paddedDegree);
+	}
+}
+
+// Registry kernel, Depthwise_Generic and Depthwise_NHWC on one shape; the first block is the one analyzed
+static void analyzeShape(const ConflictOptions& options, const ConvShape& shape) {
+	int outputHeight = shape.outputHeight();
+	int outputWidth = shape.outputWidth();
+	int padding = shape.paddingHeight;
+	int stride = shape.strideHeight;
+	printf("\ninput %d x %d, filter %d x %d, stride %d\n", shape.inputHeight, shape.inputWidth,
+		shape.filterHeight, shape.filterWidth, stride);
+
+	// enough channels for every kernel: the largest channel group, and the NHWC tile of 64 channels
+	const int channel = 64;
+	std::vector<float> input((size_t)channel * shape.inputHeight * shape.inputWidth, 1.0f);
+	std::vector<float> filter((size_t)channel * shape.filterHeight * shape.filterWidth, 1.0f);
+	std::vector<float> output((size_t)channel * outputHeight * outputWidth);
+
+	emu::recordSharedAccesses(options.blocks);
+	const DepthwiseKernelEntry* entry = nullptr;
+	const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].shape == shape) {
+			entry = &entries[i];
+		}
+	}
+	if (entry != nullptr && selected(options, entry->name)) {
+		int group = entry->channelGroupSize;
+		dim3 gridSize(1, entry->gridHeight(group));
+		hipLaunchKernelGGL(emulatedDepthwiseKernels[entry->id], gridSize, dim3(entry->blockSize, 1), 0, 0,
+			input.data(), filter.data(), output.data(),
+			1, group, shape.inputHeight, shape.inputWidth,
+			group, shape.filterHeight, shape.filterWidth,
+			1, group, outputHeight, outputWidth,
+			padding, stride,
+			1.0f, 0.0f, depthwiseNoEpilogue);
+		// the input planes are stored in rows of inputWidth + 2 * padding
+		printReport(options, entry->name, -1, 0, shape.inputWidth + 2 * padding);
+	}
+
+	if (selected(options, "Depthwise_Generic")) {
+		int tileWidth, tileHeight;
+		depthwiseGenericTile(outputHeight, outputWidth, tileWidth, tileHeight);
+		launchDepthwiseGeneric(
+			reinterpret_cast<const emu::Float*>(input.data()), reinterpret_cast<const emu::Float*>(filter.data()),
+			reinterpret_cast<emu::Float*>(output.data()),
+			1, 1, shape.inputHeight, shape.inputWidth,
+			1, shape.filterHeight, shape.filterWidth,
+			1, 1, outputHeight, outputWidth,
+			padding, padding, stride, stride, 1, 1,
+			1.0f, 0.0f, depthwiseNoEpilogue);
+		// dynamic shared memory: the filter, then the input tile with its halo
+		int inputTileWidth = (tileWidth - 1) * stride + shape.filterWidth;
+		char name[64];
+		snprintf(name, sizeof(name), "Depthwise_Generic %dx%d", tileWidth, tileHeight);
+		bool staged = depthwiseGenericSharedBytes(tileWidth, tileHeight, shape.filterHeight, shape.filterWidth,
+			stride, stride, 1, 1) <= (size_t)depthwiseMaxSharedBytes;
+		printReport(options, name, 0, (uint32_t)(shape.filterHeight * shape.filterWidth * sizeof(float)), staged ? inputTileWidth : 0);
+	}
+
+	if (selected(options, "Depthwise_NHWC")) {
+		launchDepthwiseNHWC(
+			reinterpret_cast<const emu::Float*>(input.data()), reinterpret_cast<const emu::Float*>(filter.data()),
+			reinterpret_cast<emu::Float*>(output.data()),
+			1, channel, shape.inputHeight, shape.inputWidth,
+			channel, shape.filterHeight, shape.filterWidth,
+			1, channel, outputHeight, outputWidth,
+			padding, padding, stride, stride, 1, 1,
+			1.0f, 0.0f, depthwiseNoEpilogue);
+		// only the filter is staged, [tap][channel]
+		printReport(options, "Depthwise_NHWC", 0, 0, 0);
+	}
+	emu::recordSharedAccesses(0);
+}
+
+int main(int argc, char* argv[]) {
+	ConflictOptions options;
+	options.blocks = 1;
+	options.perInstruction = false;
+	std::vector<ConvShape> shapes;
+
+	for (int i = 1; i < argc; i++) {
+		const char* option = argv[i];
+		if (strcmp(option, "-i") == 0) {
+			options.perInstruction = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			printf("Usage: %s [--shape H,K,S] [--kernel name] [--blocks n] [-i]\n", argv[0]);
+			return 1;
+		}
+		const char* value = argv[++i];
+		if (strcmp(option, "--shape") == 0) {
+			int h, k, s;
+			if (sscanf(value, "%d,%d,%d", &h, &k, &s) != 3 || h <= 0 || k <= 0 || s <= 0) {
+				printf("Invalid --shape %s, expected H,K,S.\n", value);
+				return 1;
+			}
+			shapes.push_back(ConvShape(h, h, k, k, (k - 1) / 2, s));
+		}
+		else if (strcmp(option, "--kernel") == 0) {
+			options.kernels.push_back(value);
+		}
+		else if (strcmp(option, "--blocks") == 0) {
+			options.blocks = atoi(value);
+			if (options.blocks <= 0) {
+				printf("--blocks must be positive.\n");
+				return 1;
+			}
+		}
+		else {
+			printf("Unknown option %s.\n", option);
+			return 1;
+		}
+	}
+
+	if (shapes.empty()) {
+		const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+		for (size_t i = 0; i < entries.size(); i++) {
+			shapes.push_back(entries[i].shape);
+		}
+	}
+	for (size_t i = 0; i < shapes.size(); i++) {
+		analyzeShape(options, shapes[i]);
+	}
+	return 0;
+}
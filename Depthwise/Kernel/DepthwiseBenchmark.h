@@ -0,0 +1,373 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+/*
+Depthwise Benchmark Harness
+
+Host side part of the benchmark (DCU_Depthwise_Kernel.cpp), no DCU needed: shape lists, statistics over the
+measured iterations and the JSON / CSV reports.
+
+Shape syntax, one shape per argument or per line of a shape file ('#' starts a comment):
+	N,C,H,K,S      batch, channel, input height (= width), filter height (= width), stride
+	N,C,H,W,K,S    the same with a separate input width
+Spaces work as separators as well.
+Padding is (K - 1) / 2, as in the extension.
+*/
+
+struct DepthwiseBenchmarkShape {
+	int batch;
+	int channel;
+	int height;
+	int width;
+	int filter;
+	int stride;
+
+	int padding() const {
+		return (filter - 1) / 2;
+	}
+	int outputHeight() const {
+		return (height + 2 * padding() - filter) / stride + 1;
+	}
+	int outputWidth() const {
+		return (width + 2 * padding() - filter) / stride + 1;
+	}
+	size_t inputSize() const {
+		return (size_t)batch * channel * height * width;
+	}
+	size_t filterSize() const {
+		return (size_t)channel * filter * filter;
+	}
+	size_t outputSize() const {
+		return (size_t)batch * channel * outputHeight() * outputWidth();
+	}
+	// one multiply and one add per filter tap
+	double flops() const {
+		return 2.0 * outputSize() * filter * filter;
+	}
+	// every input, filter and output float moved once
+	double bytes() const {
+		return (double)(inputSize() + filterSize() + outputSize()) * sizeof(float);
+	}
+};
+
+/*
+parseDepthwiseBenchmarkShape():
+	Parse "N,C,H,K,S" or "N,C,H,W,K,S" (commas or spaces). Return false on anything else.
+*/
+inline bool parseDepthwiseBenchmarkShape(const char* text, DepthwiseBenchmarkShape& shape) {
+	int values[7];
+	int count = 0;
+	const char* p = text;
+	while (*p != '\0' && count < 7) {
+		while (*p == ' ' || *p == '\t' || *p == ',') {
+			p++;
+		}
+		if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') {
+			break;
+		}
+		char* end = nullptr;
+		long value = strtol(p, &end, 10);
+		if (end == p || value <= 0 || value > (1 << 24)) {
+			return false;
+		}
+		values[count++] = (int)value;
+		p = end;
+	}
+	if (count == 5) {
+		shape.batch = values[0];
+		shape.channel = values[1];
+		shape.height = shape.width = values[2];
+		shape.filter = values[3];
+		shape.stride = values[4];
+	}
+	else if (count == 6) {
+		shape.batch = values[0];
+		shape.channel = values[1];
+		shape.height = values[2];
+		shape.width = values[3];
+		shape.filter = values[4];
+		shape.stride = values[5];
+	}
+	else {
+		return false;
+	}
+	return shape.height + 2 * shape.padding() >= shape.filter && shape.width + 2 * shape.padding() >= shape.filter;
+}
+
+/*
+readDepthwiseBenchmarkShapes():
+	Append the shapes of a shape file. Empty and comment lines are skipped.
+	Return false (and print the line) if the file cannot be read or a line is not a shape.
+*/
+inline bool readDepthwiseBenchmarkShapes(const char* path, std::vector<DepthwiseBenchmarkShape>& shapes) {
+	FILE* file = fopen(path, "r");
+	if (file == nullptr) {
+		fprintf(stderr, "Cannot open shape file %s\n", path);
+		return false;
+	}
+	char line[256];
+	int lineNumber = 0;
+	bool ok = true;
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		lineNumber++;
+		const char* p = line;
+		while (*p == ' ' || *p == '\t') {
+			p++;
+		}
+		if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') {
+			continue;
+		}
+		DepthwiseBenchmarkShape shape;
+		if (!parseDepthwiseBenchmarkShape(p, shape)) {
+			fprintf(stderr, "%s:%d: not a shape: %s", path, lineNumber, line);
+			ok = false;
+			break;
+		}
+		shapes.push_back(shape);
+	}
+	fclose(file);
+	return ok;
+}
+
+/*
+BenchmarkStatistics
+	Summary of the measured iterations, in microseconds.
+	Percentiles are nearest rank, so p99 of 100 samples is the second slowest one.
+*/
+struct BenchmarkStatistics {
+	int samples;
+	double min;
+	double median;
+	double mean;
+	double p95;
+	double p99;
+	double max;
+};
+
+inline BenchmarkStatistics benchmarkStatistics(std::vector<double> samples) {
+	BenchmarkStatistics statistics;
+	memset(&statistics, 0, sizeof(statistics));
+	statistics.samples = (int)samples.size();
+	if (samples.empty()) {
+		return statistics;
+	}
+	std::sort(samples.begin(), samples.end());
+	size_t n = samples.size();
+
+	double sum = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		sum += samples[i];
+	}
+	statistics.min = samples[0];
+	statistics.max = samples[n - 1];
+	statistics.mean = sum / n;
+	statistics.median = n % 2 == 1 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+
+	const double percentiles[] = { 95.0, 99.0 };
+	double* values[] = { &statistics.p95, &statistics.p99 };
+	for (int i = 0; i < 2; i++) {
+		size_t rank = (size_t)std::ceil(percentiles[i] / 100.0 * n);
+		*values[i] = samples[std::min(n, std::max<size_t>(rank, 1)) - 1];
+	}
+	return statistics;
+}
+
+/*
+DepthwiseBenchmarkResult
+	One shape on one backend. GFLOP/s and GB/s are computed from the median time.
+	reference is the library the kernel was timed against (MIOpen), if any. Every backend is checked against
+	referenceDepthwise().
+*/
+struct DepthwiseBenchmarkResult {
+	DepthwiseBenchmarkShape shape;
+	std::string backend;
+	std::string kernel;
+	BenchmarkStatistics time;
+	bool hasReference;
+	std::string referenceName;
+	BenchmarkStatistics referenceTime;
+	bool correct;
+	double maxError;
+
+	double gflops() const {
+		return time.median > 0.0 ? shape.flops() / (time.median * 1e3) : 0.0;
+	}
+	double gbps() const {
+		return time.median > 0.0 ? shape.bytes() / (time.median * 1e3) : 0.0;
+	}
+};
+
+/*
+depthwiseBenchmarkError():
+	max |output - reference| / (1 + |reference|), the measure the autotuner accepts a Winograd variant with
+	(depthwiseWinogradError()). NaN if an output is NaN.
+*/
+inline double depthwiseBenchmarkError(const float* output, const float* reference, size_t size) {
+	double maxError = 0.0;
+	for (size_t i = 0; i < size; i++) {
+		double error = std::fabs((double)output[i] - reference[i]) / (1.0 + std::fabs((double)reference[i]));
+		maxError = error > maxError || error != error ? error : maxError;
+	}
+	return maxError;
+}
+
+/*
+printDepthwiseBenchmarkResult():
+	One human readable line per shape.
+*/
+inline void printDepthwiseBenchmarkResult(FILE* file, const DepthwiseBenchmarkResult& result) {
+	const DepthwiseBenchmarkShape& s = result.shape;
+	fprintf(file, "%s N=%d C=%d H=%d W=%d K=%d S=%d %s: min %.3f median %.3f p95 %.3f p99 %.3f us, %.2f GFLOP/s, %.2f GB/s, "
+		"max error %.2e%s",
+		result.backend.c_str(), s.batch, s.channel, s.height, s.width, s.filter, s.stride, result.kernel.c_str(),
+		result.time.min, result.time.median, result.time.p95, result.time.p99, result.gflops(), result.gbps(),
+		result.maxError, result.correct ? "" : " WRONG");
+	if (result.hasReference) {
+		fprintf(file, " | %s median %.3f us, speed up %.3f", result.referenceName.c_str(), result.referenceTime.median,
+			result.time.median > 0.0 ? result.referenceTime.median / result.time.median : 0.0);
+	}
+	fprintf(file, "\n");
+}
+
+inline void writeBenchmarkStatisticsJson(FILE* file, const char* name, const BenchmarkStatistics& statistics) {
+	fprintf(file, "\"%s\": {\"samples\": %d, \"min_us\": %.3f, \"median_us\": %.3f, \"mean_us\": %.3f, \"p95_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}",
+		name, statistics.samples, statistics.min, statistics.median, statistics.mean, statistics.p95, statistics.p99, statistics.max);
+}
+
+/*
+writeDepthwiseBenchmarkJson():
+	{"warmup": .., "iterations": .., "results": [{shape, backend, kernel, time, gflops, gbps, correct, max_error, reference}, ..]}
+*/
+inline void writeDepthwiseBenchmarkJson(FILE* file, const std::vector<DepthwiseBenchmarkResult>& results, int warmup, int iterations) {
+	fprintf(file, "{\n  \"warmup\": %d,\n  \"iterations\": %d,\n  \"results\": [", warmup, iterations);
+	for (size_t i = 0; i < results.size(); i++) {
+		const DepthwiseBenchmarkResult& result = results[i];
+		const DepthwiseBenchmarkShape& s = result.shape;
+		fprintf(file, "%s\n    {\"batch\": %d, \"channel\": %d, \"height\": %d, \"width\": %d, \"filter\": %d, \"stride\": %d, "
+			"\"backend\": \"%s\", \"kernel\": \"%s\", ",
+			i == 0 ? "" : ",", s.batch, s.channel, s.height, s.width, s.filter, s.stride,
+			result.backend.c_str(), result.kernel.c_str());
+		writeBenchmarkStatisticsJson(file, "time", result.time);
+		fprintf(file, ", \"gflops\": %.3f, \"gbps\": %.3f, \"correct\": %s, \"max_error\": %.3e", result.gflops(), result.gbps(),
+			result.correct ? "true" : "false", result.maxError);
+		if (result.hasReference) {
+			fprintf(file, ", \"reference\": \"%s\", ", result.referenceName.c_str());
+			writeBenchmarkStatisticsJson(file, "referenceTime", result.referenceTime);
+		}
+		fprintf(file, "}");
+	}
+	fprintf(file, "\n  ]\n}\n");
+}
+
+/*
+writeDepthwiseBenchmarkCsv():
+	One row per shape, reference columns are empty without a reference, max_error is the last column.
+*/
+inline void writeDepthwiseBenchmarkCsv(FILE* file, const std::vector<DepthwiseBenchmarkResult>& results) {
+	fprintf(file, "batch,channel,height,width,filter,stride,backend,kernel,samples,min_us,median_us,mean_us,p95_us,p99_us,max_us,"
+		"gflops,gbps,correct,reference,reference_median_us,reference_p95_us,max_error\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const DepthwiseBenchmarkResult& result = results[i];
+		const DepthwiseBenchmarkShape& s = result.shape;
+		const BenchmarkStatistics& t = result.time;
+		fprintf(file, "%d,%d,%d,%d,%d,%d,%s,%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,",
+			s.batch, s.channel, s.height, s.width, s.filter, s.stride, result.backend.c_str(), result.kernel.c_str(),
+			t.samples, t.min, t.median, t.mean, t.p95, t.p99, t.max, result.gflops(), result.gbps(), result.correct ? 1 : 0);
+		if (result.hasReference) {
+			fprintf(file, "%s,%.3f,%.3f,", result.referenceName.c_str(), result.referenceTime.median, result.referenceTime.p95);
+		}
+		else {
+			fprintf(file, ",,,");
+		}
+		fprintf(file, "%.3e\n", result.maxError);
+	}
+}
+
+/*
+depthwiseReferenceRange():
+	Output positions [begin, end) of one filter tap whose input position (position * stride + offset) lies in
+	[0, inputSize).
+*/
+inline void depthwiseReferenceRange(int offset, int stride, int inputSize, int outputSize, int& begin, int& end) {
+	begin = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+	end = inputSize - 1 - offset < 0 ? 0 : std::min(outputSize, (inputSize - 1 - offset) / stride + 1);
+	begin = std::min(begin, end);
+}
+
+/*
+referenceDepthwiseConvolution():
+	Host reference of the depthwise convolution (NCHW, one filter per channel, no epilogue), accumulated in double.
+	The (batch, channel) planes are split over the OpenMP threads. Every output row is accumulated tap by tap into a
+	row of doubles over the output range that tap keeps inside the input, so the inner loop has no bounds check and
+	vectorises. The sum of every output runs over the taps in the order of the plain loop, hence the result does not
+	depend on the thread number.
+*/
+inline void referenceDepthwiseConvolution(const float* input, const float* filter, float* output,
+	int batch, int channel, int inputHeight, int inputWidth, int filterHeight, int filterWidth,
+	int outputHeight, int outputWidth, int paddingHeight, int paddingWidth,
+	int strideHeight, int strideWidth, int dilationHeight, int dilationWidth) {
+
+	std::vector<int> columnBegin(filterWidth), columnEnd(filterWidth);
+	for (int kx = 0; kx < filterWidth; kx++) {
+		depthwiseReferenceRange(kx * dilationWidth - paddingWidth, strideWidth, inputWidth, outputWidth,
+			columnBegin[kx], columnEnd[kx]);
+	}
+
+#pragma omp parallel
+	{
+		std::vector<double> sum(outputWidth);
+#pragma omp for collapse(2) schedule(static)
+		for (int n = 0; n < batch; n++) {
+			for (int c = 0; c < channel; c++) {
+				const float* inputPlane = input + ((size_t)n * channel + c) * inputHeight * inputWidth;
+				const float* channelFilter = filter + (size_t)c * filterHeight * filterWidth;
+				float* outputPlane = output + ((size_t)n * channel + c) * outputHeight * outputWidth;
+				for (int y = 0; y < outputHeight; y++) {
+					std::fill(sum.begin(), sum.end(), 0.0);
+					for (int ky = 0; ky < filterHeight; ky++) {
+						int inputY = y * strideHeight - paddingHeight + ky * dilationHeight;
+						if (inputY < 0 || inputY >= inputHeight) {
+							continue;
+						}
+						const float* inputRow = inputPlane + (size_t)inputY * inputWidth;
+						for (int kx = 0; kx < filterWidth; kx++) {
+							double weight = channelFilter[ky * filterWidth + kx];
+							int offset = kx * dilationWidth - paddingWidth;
+							double* row = sum.data();
+							if (strideWidth == 1) {
+								for (int x = columnBegin[kx]; x < columnEnd[kx]; x++) {
+									row[x] += weight * inputRow[x + offset];
+								}
+							}
+							else {
+								for (int x = columnBegin[kx]; x < columnEnd[kx]; x++) {
+									row[x] += weight * inputRow[x * strideWidth + offset];
+								}
+							}
+						}
+					}
+					float* outputRow = outputPlane + (size_t)y * outputWidth;
+					for (int x = 0; x < outputWidth; x++) {
+						outputRow[x] = (float)sum[x];
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+referenceDepthwise():
+	referenceDepthwiseConvolution() of a benchmark shape, the check of every backend.
+*/
+inline void referenceDepthwise(const DepthwiseBenchmarkShape& shape, const float* input, const float* filter, float* output) {
+	referenceDepthwiseConvolution(input, filter, output,
+		shape.batch, shape.channel, shape.height, shape.width, shape.filter, shape.filter,
+		shape.outputHeight(), shape.outputWidth(), shape.padding(), shape.padding(),
+		shape.stride, shape.stride, 1, 1);
+}
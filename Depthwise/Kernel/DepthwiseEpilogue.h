@@ -0,0 +1,92 @@
+#pragma once
+/*
+Depthwise Convolution Epilogue.
+
+Per output channel work fused into the store of every depthwise kernel (and of the CPU backend),
+so a depthwise + bias + BatchNorm + activation block writes its output once:
+
+	output = activation((sum * alpha + beta) * scale[c] + shift[c])
+
+	scale	per output channel multiplier, nullptr for 1
+	shift	per output channel offset, nullptr for 0
+
+BatchNorm (gamma, beta, mean, var) and a convolution bias fold into scale / shift on the host
+(depthwiseFoldBatchNorm()):
+	scale = gamma / sqrt(var + eps)
+	shift = (bias - mean) * scale + beta
+*/
+#include <math.h>
+
+#if defined(__HIPCC__) || defined(__CUDACC__)
+#define DEPTHWISE_EPILOGUE_FUNCTION __host__ __device__ inline
+#else
+#define DEPTHWISE_EPILOGUE_FUNCTION inline
+#endif
+
+enum DepthwiseActivation {
+	DepthwiseActivationNone = 0,
+	DepthwiseActivationReLU,		// max(x, 0)
+	DepthwiseActivationReLU6,		// min(max(x, 0), 6)
+	DepthwiseActivationSiLU,		// x * sigmoid(x), a.k.a. Swish
+	DepthwiseActivationHardSwish	// x * relu6(x + 3) / 6
+};
+
+struct DepthwiseEpilogue {
+	const float* scale;
+	const float* shift;
+	int activation;
+};
+
+// plain convolution, output = sum * alpha + beta
+const DepthwiseEpilogue depthwiseNoEpilogue = { nullptr, nullptr, DepthwiseActivationNone };
+
+DEPTHWISE_EPILOGUE_FUNCTION float depthwiseActivate(float value, int activation) {
+	switch (activation) {
+	case DepthwiseActivationReLU:
+		return value > 0.0f ? value : 0.0f;
+	case DepthwiseActivationReLU6:
+		return value > 0.0f ? (value < 6.0f ? value : 6.0f) : 0.0f;
+	case DepthwiseActivationSiLU:
+		return value / (1.0f + expf(-value));
+	case DepthwiseActivationHardSwish: {
+		float gate = value + 3.0f;
+		gate = gate > 0.0f ? (gate < 6.0f ? gate : 6.0f) : 0.0f;
+		return value * gate / 6.0f;
+	}
+	default:
+		return value;
+	}
+}
+
+/*
+DepthwiseChannelEpilogue:
+	The epilogue of one output channel. Every thread of the kernels works on one channel only,
+	so scale and shift are loaded once, right after the thread knows its output index.
+*/
+struct DepthwiseChannelEpilogue {
+	float scale;
+	float shift;
+	int activation;
+
+	DEPTHWISE_EPILOGUE_FUNCTION DepthwiseChannelEpilogue(const DepthwiseEpilogue& epilogue, int channel)
+		: scale(epilogue.scale ? epilogue.scale[channel] : 1.0f),
+		shift(epilogue.shift ? epilogue.shift[channel] : 0.0f),
+		activation(epilogue.activation) {}
+
+	DEPTHWISE_EPILOGUE_FUNCTION float apply(float value) const {
+		return depthwiseActivate(value * scale + shift, activation);
+	}
+};
+
+/*
+depthwiseFoldBatchNorm():
+	Fold an optional convolution bias and an inference mode BatchNorm into scale / shift (host side).
+	bias may be nullptr.
+*/
+inline void depthwiseFoldBatchNorm(const float* bias, const float* gamma, const float* beta,
+	const float* mean, const float* var, float eps, int channel, float* scale, float* shift) {
+	for (int c = 0; c < channel; c++) {
+		scale[c] = gamma[c] / sqrtf(var[c] + eps);
+		shift[c] = ((bias ? bias[c] : 0.0f) - mean[c]) * scale[c] + beta[c];
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+/*
+16-bit Storage Types.
+
+fp16 (IEEE binary16) and bf16 (upper half of a float) storage for the CPU backend. Values are converted to
+float when they are loaded and rounded back (to nearest even) when they are stored, every product and sum is
+computed in float, the same as the DCU kernels do with at::Half / at::BFloat16.
+
+DepthwiseHalf and DepthwiseBFloat16 have the layout of at::Half and at::BFloat16, so tensor data can be
+passed with a reinterpret_cast.
+*/
+#include <stdint.h>
+#include <string.h>
+
+struct DepthwiseHalf {
+	uint16_t bits;
+};
+
+struct DepthwiseBFloat16 {
+	uint16_t bits;
+};
+
+inline float depthwiseFloatFromBits(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline uint32_t depthwiseBitsFromFloat(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline float depthwiseToFloat(float value) {
+	return value;
+}
+
+inline float depthwiseToFloat(DepthwiseBFloat16 value) {
+	return depthwiseFloatFromBits((uint32_t)value.bits << 16);
+}
+
+// exact, subnormals / inf / NaN included: normal values are rebiased by a float multiply, subnormals
+// are built with a magic number subtraction
+inline float depthwiseToFloat(DepthwiseHalf value) {
+	uint32_t w = (uint32_t)value.bits << 16;
+	uint32_t sign = w & 0x80000000u;
+	uint32_t twoW = w + w;
+
+	float normalized = depthwiseFloatFromBits((twoW >> 4) + (0xE0u << 23)) * depthwiseFloatFromBits(0x07800000u);	// 2^-112
+	float denormalized = depthwiseFloatFromBits((twoW >> 17) | (126u << 23)) - 0.5f;
+	uint32_t result = twoW < (1u << 27) ? depthwiseBitsFromFloat(denormalized) : depthwiseBitsFromFloat(normalized);
+	return depthwiseFloatFromBits(sign | result);
+}
+
+/*
+depthwiseFromFloat<scalar_t>():
+	Round a float to the storage type, to nearest even. NaN stays NaN.
+*/
+template <typename scalar_t>
+inline scalar_t depthwiseFromFloat(float value);
+
+template <>
+inline float depthwiseFromFloat<float>(float value) {
+	return value;
+}
+
+template <>
+inline DepthwiseBFloat16 depthwiseFromFloat<DepthwiseBFloat16>(float value) {
+	uint32_t bits = depthwiseBitsFromFloat(value);
+	DepthwiseBFloat16 result;
+	if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+		result.bits = (uint16_t)((bits >> 16) | 0x0040u);
+	}
+	else {
+		result.bits = (uint16_t)((bits + 0x7FFFu + ((bits >> 16) & 1u)) >> 16);
+	}
+	return result;
+}
+
+// the float add rounds the mantissa to 10 bits (and handles overflow to inf and subnormal results)
+template <>
+inline DepthwiseHalf depthwiseFromFloat<DepthwiseHalf>(float value) {
+	uint32_t w = depthwiseBitsFromFloat(value);
+	uint32_t shiftedW = w + w;
+	uint32_t sign = w & 0x80000000u;
+
+	float base = (depthwiseFloatFromBits(w & 0x7FFFFFFFu) * depthwiseFloatFromBits(0x77800000u)) * depthwiseFloatFromBits(0x08800000u);	// * 2^112 * 2^-110
+	uint32_t bias = shiftedW & 0xFF000000u;
+	if (bias < 0x71000000u) {
+		bias = 0x71000000u;
+	}
+	base = depthwiseFloatFromBits((bias >> 1) + 0x07800000u) + base;
+	uint32_t baseBits = depthwiseBitsFromFloat(base);
+	uint32_t nonSign = ((baseBits >> 13) & 0x00007C00u) + (baseBits & 0x00000FFFu);
+
+	DepthwiseHalf result;
+	result.bits = (uint16_t)((sign >> 16) | (shiftedW > 0xFF000000u ? 0x7E00u : nonSign));
+	return result;
+}
@@ -0,0 +1,54 @@
+/*
+Specialised depthwise convolution kernels.
+
+One line per kernel. This file is included several times with different definitions of DEPTHWISE_KERNEL:
+the registry (DepthwiseRegistry.h) builds its shape table from it, and the benchmark and the extension
+build their launch tables from it, so every consumer defines both macros below.
+Adding a kernel means adding its header and one line here.
+
+DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, blocksPerChannelGroup, blockSize, sharedMemoryFloats)
+	inputHeight           - square input, inputWidth = inputHeight. padding = (filterSize - 1) / 2
+	channelGroupSize      - channels handled together; the channel number must be multiple of it
+	blocksPerChannelGroup - blocks along gridDim.y for one channel group
+	                        gridSize = (batch, channel / channelGroupSize * blocksPerChannelGroup)
+	blockSize             - threads per block, blockSize = (blockSize, 1)
+	sharedMemoryFloats    - static __shared__ footprint of the kernel, in floats
+
+DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize)
+	Instantiation of Depthwise_RowRolling (Depthwise_RowRolling.h), no hand-written code.
+	gridSize = (batch, channel / channelGroupSize), blockSize = (outputSize * channelGroupSize, 1)
+
+Every line also stands for Depthwise_RowRollingRect with the same inputHeight, filterSize, stride and
+channelGroupSize, which runs rectangular inputs with one dimension inputHeight (findDepthwiseRectKernel()).
+*/
+// stride 1
+DEPTHWISE_KERNEL(Filter3x3_Input7x7_Stride1, 7, 3, 1, 32, 1, 7 * 32, 32 * 9 + 32 * 7 * 9)
+DEPTHWISE_KERNEL(Filter3x3_Input14x14_Stride1, 14, 3, 1, 16, 1, 14 * 16, 16 * 9 + 16 * 14 * 16)
+DEPTHWISE_KERNEL(Filter3x3_Input28x28_Stride1, 28, 3, 1, 8, 1, 28 * 8, 8 * 9 + 8 * 28 * 30)
+DEPTHWISE_KERNEL(Filter3x3_Input56x56_Stride1, 56, 3, 1, 1, 1, 4 * 56, 9 + 58 * 58)
+DEPTHWISE_KERNEL(Filter3x3_Input112x112_Stride1, 112, 3, 1, 1, 4, 2 * 112, 9 + 31 * 114)
+DEPTHWISE_KERNEL(Filter5x5_Input7x7_Stride1, 7, 5, 1, 32, 1, 7 * 32, 32 * 25 + 32 * 7 * 11)
+DEPTHWISE_KERNEL(Filter5x5_Input14x14_Stride1, 14, 5, 1, 16, 1, 14 * 16, 16 * 25 + 16 * 14 * 18)
+DEPTHWISE_KERNEL(Filter5x5_Input28x28_Stride1, 28, 5, 1, 8, 1, 28 * 8, 8 * 25 + 8 * 28 * 32)
+
+// stride 2
+DEPTHWISE_KERNEL(Filter3x3_Input14x14_Stride2, 14, 3, 2, 32, 1, 7 * 32, 32 * 9 + 32 * 14 * 16)
+DEPTHWISE_KERNEL(Filter3x3_Input28x28_Stride2, 28, 3, 2, 8, 1, 14 * 8, 8 * 9 + 8 * 28 * 30)
+DEPTHWISE_KERNEL(Filter3x3_Input56x56_Stride2, 56, 3, 2, 2, 1, 28 * 2, 2 * 9 + 2 * 56 * 58)
+DEPTHWISE_KERNEL(Filter3x3_Input112x112_Stride2, 112, 3, 2, 1, 2, 56 * 4, 9 + 59 * 114)
+DEPTHWISE_KERNEL(Filter5x5_Input14x14_Stride2, 14, 5, 2, 32, 1, 7 * 32, 32 * 25 + 32 * 14 * 18)
+DEPTHWISE_KERNEL(Filter5x5_Input56x56_Stride2, 56, 5, 2, 2, 1, 28 * 2, 2 * 25 + 2 * 56 * 60)
+
+// generated, for the resolutions without a hand-written kernel
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter3x3_Input10x10_Stride1, 10, 3, 1, 16)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter3x3_Input20x20_Stride1, 20, 3, 1, 8)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter3x3_Input40x40_Stride1, 40, 3, 1, 4)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter5x5_Input10x10_Stride1, 10, 5, 1, 16)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter5x5_Input20x20_Stride1, 20, 5, 1, 8)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter5x5_Input40x40_Stride1, 40, 5, 1, 4)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter3x3_Input10x10_Stride2, 10, 3, 2, 32)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter3x3_Input20x20_Stride2, 20, 3, 2, 16)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter3x3_Input40x40_Stride2, 40, 3, 2, 4)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter5x5_Input10x10_Stride2, 10, 5, 2, 32)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter5x5_Input20x20_Stride2, 20, 5, 2, 16)
+DEPTHWISE_ROW_ROLLING_KERNEL(Filter5x5_Input40x40_Stride2, 40, 5, 2, 4)
@@ -0,0 +1,324 @@
+#pragma once
+/*
+Depthwise Separable Network Plan.
+
+A network is an ordered list of depthwise and pointwise layers, e.g. the MobileNet V2 backbone after its stem
+(depthwiseMobileNetV2Layers()). planDepthwiseNetwork() plans the whole sequence once for an input shape:
+
+	1)	the shape of every activation, checked against the layers (residual shapes, filter sizes)
+	2)	steps: a depthwise layer followed by a pointwise one runs as one fused step (DepthwisePointwise_Fused.h,
+		CPU_DepthwisePointwise.h) unless its output is needed by a residual
+	3)	buffers: every intermediate activation gets one of a few reusable buffers, a buffer is handed to the next
+		step once the activation in it has been read for the last time (the step input, or a residual source).
+		A plain chain needs 2 buffers (ping-pong), MobileNet V2 with its inverted residuals 3.
+
+runDepthwiseNetwork() walks the steps with a backend that runs them (CPU_DepthwiseNetwork.h on the host, the
+extension on the DCU), so a whole backbone is one call with no allocation and no per layer dispatch overhead.
+The backend is told the layers of the next step before a step starts, to prefetch their weights.
+*/
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <algorithm>
+
+#include "DepthwiseEpilogue.h"
+
+enum DepthwiseNetworkLayerKind {
+	DepthwiseNetworkDepthwise,
+	DepthwiseNetworkPointwise
+};
+
+/*
+DepthwiseNetworkLayer:
+	kind          - depthwise (channel multiplier 1, "same" padding (filterSize - 1) / 2) or pointwise (1 x 1)
+	outputChannel - pointwise output channels, ignored by depthwise layers
+	filterSize    - depthwise filter height and width
+	stride        - depthwise stride
+	residual      - -1, or the index of a layer whose input is added to the output of this one (after the epilogue)
+	filter        - weights, channel x filterSize x filterSize (depthwise) or outputChannel x inputChannel (pointwise);
+	                only used by the backend, the plan does not need them
+	epilogue      - per output channel scale / shift / activation
+*/
+struct DepthwiseNetworkLayer {
+	int kind;
+	int outputChannel;
+	int filterSize;
+	int stride;
+	int residual;
+	const void* filter;
+	DepthwiseEpilogue epilogue;
+};
+
+inline DepthwiseNetworkLayer depthwiseNetworkDepthwiseLayer(int filterSize, int stride, int activation) {
+	DepthwiseNetworkLayer layer = { DepthwiseNetworkDepthwise, 0, filterSize, stride, -1, nullptr, depthwiseNoEpilogue };
+	layer.epilogue.activation = activation;
+	return layer;
+}
+
+inline DepthwiseNetworkLayer depthwiseNetworkPointwiseLayer(int outputChannel, int activation, int residual) {
+	DepthwiseNetworkLayer layer = { DepthwiseNetworkPointwise, outputChannel, 1, 1, residual, nullptr, depthwiseNoEpilogue };
+	layer.epilogue.activation = activation;
+	return layer;
+}
+
+// Buffer indices of a step besides the planned buffers
+const int DepthwiseNetworkInput = -1;
+const int DepthwiseNetworkOutput = -2;
+const int DepthwiseNetworkNone = -3;
+
+/*
+DepthwiseNetworkStep:
+	One kernel launch: layer (and layer + 1 when fused), its buffers and shapes. residualBuffer is the activation
+	added to the output, DepthwiseNetworkNone without one.
+*/
+struct DepthwiseNetworkStep {
+	int layer;
+	bool fused;
+	int inputBuffer;
+	int outputBuffer;
+	int residualBuffer;
+	int inputChannel, inputHeight, inputWidth;
+	int outputChannel, outputHeight, outputWidth;
+	int padding, stride, filterSize;
+
+	size_t outputSize(int batch) const {
+		return (size_t)batch * outputChannel * outputHeight * outputWidth;
+	}
+};
+
+struct DepthwiseNetworkPlan {
+	int batch;
+	int inputChannel, inputHeight, inputWidth;
+	int outputChannel, outputHeight, outputWidth;
+	std::vector<DepthwiseNetworkStep> steps;
+	std::vector<size_t> bufferSizes;	// elements
+	std::string error;
+};
+
+/*
+planDepthwiseNetwork():
+	Plan layers for a batch x channel x height x width input. Returns false, with plan.error set, when the layers do
+	not fit the input (an empty list, a residual of another shape or from a later layer, an output of size 0).
+	fuse = false keeps every layer a step of its own.
+*/
+inline bool planDepthwiseNetwork(const std::vector<DepthwiseNetworkLayer>& layers, int batch, int channel, int height, int width,
+	bool fuse, DepthwiseNetworkPlan& plan) {
+
+	plan = DepthwiseNetworkPlan();
+	plan.batch = batch;
+	plan.inputChannel = channel;
+	plan.inputHeight = height;
+	plan.inputWidth = width;
+	if (layers.empty() || batch <= 0 || channel <= 0 || height <= 0 || width <= 0) {
+		plan.error = "an empty network or input";
+		return false;
+	}
+
+	// shape of the input of every layer, then of the network output
+	int layerNumber = (int)layers.size();
+	std::vector<int> shapes(3 * (layerNumber + 1));
+	shapes[0] = channel;
+	shapes[1] = height;
+	shapes[2] = width;
+	for (int i = 0; i < layerNumber; i++) {
+		const DepthwiseNetworkLayer& layer = layers[i];
+		int c = shapes[3 * i], h = shapes[3 * i + 1], w = shapes[3 * i + 2];
+		if (layer.kind == DepthwiseNetworkDepthwise) {
+			int padding = (layer.filterSize - 1) / 2;
+			if (layer.filterSize <= 0 || layer.stride <= 0 || h + 2 * padding < layer.filterSize || w + 2 * padding < layer.filterSize) {
+				plan.error = "layer " + std::to_string(i) + ": the depthwise filter does not fit its input";
+				return false;
+			}
+			h = (h + 2 * padding - layer.filterSize) / layer.stride + 1;
+			w = (w + 2 * padding - layer.filterSize) / layer.stride + 1;
+		}
+		else {
+			if (layer.outputChannel <= 0) {
+				plan.error = "layer " + std::to_string(i) + ": no pointwise output channels";
+				return false;
+			}
+			c = layer.outputChannel;
+		}
+		shapes[3 * (i + 1)] = c;
+		shapes[3 * (i + 1) + 1] = h;
+		shapes[3 * (i + 1) + 2] = w;
+
+		if (layer.residual >= 0) {
+			int r = layer.residual;
+			if (r > i || shapes[3 * r] != c || shapes[3 * r + 1] != h || shapes[3 * r + 2] != w) {
+				plan.error = "layer " + std::to_string(i) + ": the residual of layer " + std::to_string(r) + " has another shape";
+				return false;
+			}
+		}
+	}
+	plan.outputChannel = shapes[3 * layerNumber];
+	plan.outputHeight = shapes[3 * layerNumber + 1];
+	plan.outputWidth = shapes[3 * layerNumber + 2];
+
+	// layers whose input is a residual source must start a step
+	std::vector<bool> residualSource(layerNumber, false);
+	for (int i = 0; i < layerNumber; i++) {
+		if (layers[i].residual >= 0) {
+			residualSource[layers[i].residual] = true;
+		}
+	}
+
+	// steps, and the step whose output is the input of every layer (-1: the network input)
+	std::vector<int> inputStep(layerNumber + 1, -1);
+	for (int i = 0; i < layerNumber; ) {
+		DepthwiseNetworkStep step;
+		step.layer = i;
+		step.fused = fuse && i + 1 < layerNumber && layers[i].kind == DepthwiseNetworkDepthwise &&
+			layers[i + 1].kind == DepthwiseNetworkPointwise && layers[i].residual < 0 && !residualSource[i + 1];
+		int last = step.fused ? i + 1 : i;
+		step.inputChannel = shapes[3 * i];
+		step.inputHeight = shapes[3 * i + 1];
+		step.inputWidth = shapes[3 * i + 2];
+		step.outputChannel = shapes[3 * (last + 1)];
+		step.outputHeight = shapes[3 * (last + 1) + 1];
+		step.outputWidth = shapes[3 * (last + 1) + 2];
+		step.filterSize = layers[i].filterSize;
+		step.stride = layers[i].kind == DepthwiseNetworkDepthwise ? layers[i].stride : 1;
+		step.padding = layers[i].kind == DepthwiseNetworkDepthwise ? (layers[i].filterSize - 1) / 2 : 0;
+		step.inputBuffer = step.outputBuffer = step.residualBuffer = DepthwiseNetworkNone;
+		plan.steps.push_back(step);
+		inputStep[last + 1] = (int)plan.steps.size() - 1;
+		i = last + 1;
+	}
+
+	// last step reading the output of every step: the next step, and the steps adding it as a residual
+	int stepNumber = (int)plan.steps.size();
+	std::vector<int> lastUse(stepNumber, -1);
+	for (int s = 0; s + 1 < stepNumber; s++) {
+		lastUse[s] = s + 1;
+	}
+	for (int s = 0; s < stepNumber; s++) {
+		const DepthwiseNetworkStep& step = plan.steps[s];
+		int r = layers[step.fused ? step.layer + 1 : step.layer].residual;
+		if (r >= 0 && inputStep[r] >= 0) {
+			lastUse[inputStep[r]] = std::max(lastUse[inputStep[r]], s);
+		}
+	}
+
+	// buffers: a step takes a buffer whose activation nobody reads any more, the smallest that is large enough,
+	// else the largest one (grown), else a new one
+	std::vector<int> busyUntil;
+	std::vector<int> stepBuffer(stepNumber, DepthwiseNetworkOutput);
+	for (int s = 0; s < stepNumber; s++) {
+		DepthwiseNetworkStep& step = plan.steps[s];
+		int source = s == 0 ? -1 : s - 1;
+		step.inputBuffer = source < 0 ? DepthwiseNetworkInput : stepBuffer[source];
+		int r = layers[step.fused ? step.layer + 1 : step.layer].residual;
+		if (r >= 0) {
+			step.residualBuffer = inputStep[r] < 0 ? DepthwiseNetworkInput : stepBuffer[inputStep[r]];
+		}
+		if (s == stepNumber - 1) {
+			step.outputBuffer = DepthwiseNetworkOutput;
+			break;
+		}
+
+		size_t size = step.outputSize(batch);
+		int chosen = -1;
+		for (int b = 0; b < (int)busyUntil.size(); b++) {
+			if (busyUntil[b] >= s) {
+				continue;
+			}
+			bool fits = plan.bufferSizes[b] >= size;
+			if (chosen < 0) {
+				chosen = b;
+			}
+			else if (fits && (plan.bufferSizes[chosen] < size || plan.bufferSizes[b] < plan.bufferSizes[chosen])) {
+				chosen = b;
+			}
+			else if (!fits && plan.bufferSizes[chosen] < size && plan.bufferSizes[b] > plan.bufferSizes[chosen]) {
+				chosen = b;
+			}
+		}
+		if (chosen < 0) {
+			chosen = (int)busyUntil.size();
+			busyUntil.push_back(-1);
+			plan.bufferSizes.push_back(0);
+		}
+		plan.bufferSizes[chosen] = std::max(plan.bufferSizes[chosen], size);
+		busyUntil[chosen] = lastUse[s];
+		stepBuffer[s] = chosen;
+		step.outputBuffer = chosen;
+	}
+	return true;
+}
+
+/*
+runDepthwiseNetwork():
+	Run the steps of plan in order. Backend has
+		void prefetch(const DepthwiseNetworkLayer& layer, size_t weights)	(weights: elements of layer.filter)
+		void depthwise(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& layer)
+		void pointwise(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& layer)
+		void fused(const DepthwiseNetworkStep& step, const DepthwiseNetworkLayer& depthwise, const DepthwiseNetworkLayer& pointwise)
+		void addResidual(const DepthwiseNetworkStep& step)
+	and maps the buffer indices of a step (DepthwiseNetworkInput, DepthwiseNetworkOutput, 0 .. bufferSizes.size() - 1)
+	to its memory.
+*/
+template <typename Backend>
+inline void runDepthwiseNetwork(const DepthwiseNetworkPlan& plan, const std::vector<DepthwiseNetworkLayer>& layers, Backend& backend) {
+	for (size_t s = 0; s < plan.steps.size(); s++) {
+		const DepthwiseNetworkStep& step = plan.steps[s];
+		if (s + 1 < plan.steps.size()) {
+			// depthwise: channel x filterSize x filterSize, pointwise (also fused): outputChannel x inputChannel
+			const DepthwiseNetworkStep& next = plan.steps[s + 1];
+			const DepthwiseNetworkLayer& nextLayer = layers[next.layer];
+			size_t pointwiseWeights = (size_t)next.outputChannel * next.inputChannel;
+			if (nextLayer.kind == DepthwiseNetworkDepthwise) {
+				backend.prefetch(nextLayer, (size_t)next.inputChannel * next.filterSize * next.filterSize);
+			}
+			else {
+				backend.prefetch(nextLayer, pointwiseWeights);
+			}
+			if (next.fused) {
+				backend.prefetch(layers[next.layer + 1], pointwiseWeights);
+			}
+		}
+
+		const DepthwiseNetworkLayer& layer = layers[step.layer];
+		if (step.fused) {
+			backend.fused(step, layer, layers[step.layer + 1]);
+		}
+		else if (layer.kind == DepthwiseNetworkDepthwise) {
+			backend.depthwise(step, layer);
+		}
+		else {
+			backend.pointwise(step, layer);
+		}
+		if (step.residualBuffer != DepthwiseNetworkNone) {
+			backend.addResidual(step);
+		}
+	}
+}
+
+/*
+depthwiseMobileNetV2Layers():
+	The MobileNet V2 backbone between the stem (32 x 112 x 112 for a 224 x 224 image) and the pooling: the inverted
+	residual blocks and the final 1 x 1 convolution to 1280 channels, 17 depthwise and 34 pointwise layers. ReLU6 after
+	the expansion and the depthwise layers, none after the projection, residuals where the block keeps its shape.
+	No weights, the caller sets filter (and the BatchNorm scale / shift of the epilogues).
+*/
+inline std::vector<DepthwiseNetworkLayer> depthwiseMobileNetV2Layers() {
+	// expansion, output channels, repeats, stride
+	const int blocks[][4] = { {1, 16, 1, 1}, {6, 24, 2, 2}, {6, 32, 3, 2}, {6, 64, 4, 2}, {6, 96, 3, 1}, {6, 160, 3, 2}, {6, 320, 1, 1} };
+	std::vector<DepthwiseNetworkLayer> layers;
+	int channel = 32;
+	for (int b = 0; b < 7; b++) {
+		for (int r = 0; r < blocks[b][2]; r++) {
+			int stride = r == 0 ? blocks[b][3] : 1;
+			int first = (int)layers.size();
+			if (blocks[b][0] != 1) {
+				layers.push_back(depthwiseNetworkPointwiseLayer(channel * blocks[b][0], DepthwiseActivationReLU6, -1));
+			}
+			layers.push_back(depthwiseNetworkDepthwiseLayer(3, stride, DepthwiseActivationReLU6));
+			bool residual = stride == 1 && channel == blocks[b][1];
+			layers.push_back(depthwiseNetworkPointwiseLayer(blocks[b][1], DepthwiseActivationNone, residual ? first : -1));
+			channel = blocks[b][1];
+		}
+	}
+	layers.push_back(depthwiseNetworkPointwiseLayer(1280, DepthwiseActivationReLU6, -1));
+	return layers;
+}
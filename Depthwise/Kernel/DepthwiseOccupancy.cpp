@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "DepthwiseOccupancy.h"
+
+/*
+Offline occupancy of the depthwise kernels on a DCU / GCN class target (DepthwiseOccupancy.h), no DCU needed.
+
+	DepthwiseOccupancy [--target name] [--set field=value]... [--batch N] [--channel C]
+		[--shape N,C,H,K,S | N,C,H,W,K,S]... [--tile WxH]... [--vgprs N] [--sgprs N] [--targets]
+
+	--target	dcu (default), gfx906, gfx908 or gfx90a
+	--set		override a resource of the target, e.g. --set cu=60 --set waves=8 (see setDcuTargetField())
+	--shape		report the kernels of this problem only; without it every registry kernel is reported on its shape.
+			A rectangular input also reports the registry kernel of its height or width (Depthwise_RowRollingRect)
+	--batch / --channel	problem size of the registry shapes (default 1 and 576, rounded up to the channel group)
+	--tile		also report Depthwise_Generic with this tile (the default tile is always reported)
+	--vgprs / --sgprs	register counts from the compiler instead of the estimates, applied to every row
+	--targets	print the targets and exit
+*/
+
+struct OccupancyOptions {
+	DcuTarget target;
+	int batch;
+	int channel;
+	int vgprs;
+	int sgprs;
+	std::vector<int> shapes;		// N, C, H, W, K, S per shape
+	std::vector<int> tiles;			// W, H per tile
+};
+
+static void printTargets() {
+	printf("%-8s %5s %6s %10s %11s %11s %9s %10s %11s\n",
+		"target", "CUs", "SIMDs", "wavefront", "waves/SIMD", "VGPRs/lane", "SGPRs", "LDS/CU", "blocks/CU");
+	const std::vector<DcuTarget>& targets = dcuTargets();
+	for (size_t i = 0; i < targets.size(); i++) {
+		const DcuTarget& t = targets[i];
+		printf("%-8s %5d %6d %10d %11d %11d %9d %10d %11d\n", t.name, t.computeUnits, t.simdsPerComputeUnit,
+			t.wavefrontSize, t.maxWavesPerSimd, t.vgprsPerSimd, t.sgprsPerSimd, t.ldsBytesPerComputeUnit,
+			t.maxBlocksPerComputeUnit);
+	}
+}
+
+static void printHeader(const DcuTarget& target) {
+	printf("target %s: %d CUs x %d SIMDs, %d waves per SIMD, %d VGPRs, %d SGPRs, %d bytes LDS per CU\n",
+		target.name, target.computeUnits, target.simdsPerComputeUnit, target.maxWavesPerSimd,
+		target.vgprsPerSimd, target.sgprsPerSimd, target.ldsBytesPerComputeUnit);
+	printf("%-34s %6s %7s %5s %5s %9s %8s %9s %-12s %9s %9s %9s\n", "kernel", "block", "LDS", "VGPR", "SGPR",
+		"blocks/CU", "waves/CU", "occupancy", "limiter", "grid", "dispatch", "last");
+}
+
+static void printRow(const OccupancyOptions& options, KernelResources resources) {
+	if (options.vgprs > 0) {
+		resources.vgprs = options.vgprs;
+	}
+	if (options.sgprs > 0) {
+		resources.sgprs = options.sgprs;
+	}
+	OccupancyReport report = computeOccupancy(options.target, resources);
+	printf("%-34s %6d %7d %5d %5d %9d %8d %8.1f%% %-12s %9lld %9.2f %8.1f%%\n", resources.name.c_str(),
+		resources.blockSize, resources.sharedMemoryBytes, resources.vgprs, resources.sgprs,
+		report.blocksPerCU, report.wavesPerCU, report.occupancy * 100.0f, occupancyLimiterName(report.limiter),
+		(long long)resources.gridBlocks, report.dispatchWaves, report.lastWaveUtilization * 100.0f);
+}
+
+// Every kernel that can run the problem: the registry kernel (or the one of its height or width for a rectangular input),
+// Depthwise_Generic with its default and the given tiles, Depthwise_NHWC
+static void printShape(const OccupancyOptions& options, int batch, int channel, const ConvShape& shape,
+	const DepthwiseKernelEntry* entry) {
+	printf("\nN = %d, C = %d, H = %d x %d, filter %d x %d, stride %d\n", batch, channel,
+		shape.inputHeight, shape.inputWidth, shape.filterHeight, shape.filterWidth, shape.strideHeight);
+	if (entry != nullptr) {
+		printRow(options, depthwiseKernelResources(*entry, batch, channel));
+	}
+	DepthwiseRectKernel rect;
+	if (entry == nullptr && findDepthwiseRectKernel(shape, channel, rect)) {
+		printRow(options, depthwiseRectResources(rect, batch, channel));
+	}
+	printRow(options, depthwiseGenericResources(shape, batch, channel));
+	for (size_t i = 0; i + 1 < options.tiles.size(); i += 2) {
+		printRow(options, depthwiseGenericResources(shape, batch, channel, options.tiles[i], options.tiles[i + 1]));
+	}
+	printRow(options, depthwiseNHWCResources(shape, batch, channel));
+}
+
+int main(int argc, char* argv[]) {
+	OccupancyOptions options;
+	options.target = dcuTargets()[0];
+	options.batch = 1;
+	options.channel = 576;
+	options.vgprs = 0;
+	options.sgprs = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const char* option = argv[i];
+		if (strcmp(option, "--targets") == 0) {
+			printTargets();
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			printf("Usage: %s [--target name] [--set field=value] [--batch N] [--channel C] [--shape N,C,H[,W],K,S] "
+				"[--tile WxH] [--vgprs N] [--sgprs N] [--targets]\n", argv[0]);
+			return 1;
+		}
+		const char* value = argv[++i];
+		if (strcmp(option, "--target") == 0) {
+			const DcuTarget* target = findDcuTarget(value);
+			if (target == nullptr) {
+				printf("Unknown target %s, see --targets.\n", value);
+				return 1;
+			}
+			options.target = *target;
+		}
+		else if (strcmp(option, "--set") == 0) {
+			const char* equal = strchr(value, '=');
+			if (equal == nullptr || !setDcuTargetField(options.target, std::string(value, equal - value), atoi(equal + 1))) {
+				printf("Invalid --set %s.\n", value);
+				return 1;
+			}
+		}
+		else if (strcmp(option, "--shape") == 0) {
+			int n, c, h, w, k, s;
+			int count = sscanf(value, "%d,%d,%d,%d,%d,%d", &n, &c, &h, &w, &k, &s);
+			if (count == 5) {
+				// square: the fourth and fifth numbers are K and S
+				s = k;
+				k = w;
+				w = h;
+			}
+			if ((count != 5 && count != 6) || n <= 0 || c <= 0 || h <= 0 || w <= 0 || k <= 0 || s <= 0) {
+				printf("Invalid --shape %s, expected N,C,H,K,S or N,C,H,W,K,S.\n", value);
+				return 1;
+			}
+			int shape[6] = { n, c, h, w, k, s };
+			options.shapes.insert(options.shapes.end(), shape, shape + 6);
+		}
+		else if (strcmp(option, "--tile") == 0) {
+			int w, h;
+			if (sscanf(value, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+				printf("Invalid --tile %s, expected WxH.\n", value);
+				return 1;
+			}
+			options.tiles.push_back(w);
+			options.tiles.push_back(h);
+		}
+		else if (strcmp(option, "--batch") == 0) {
+			options.batch = atoi(value);
+		}
+		else if (strcmp(option, "--channel") == 0) {
+			options.channel = atoi(value);
+		}
+		else if (strcmp(option, "--vgprs") == 0) {
+			options.vgprs = atoi(value);
+		}
+		else if (strcmp(option, "--sgprs") == 0) {
+			options.sgprs = atoi(value);
+		}
+		else {
+			printf("Unknown option %s.\n", option);
+			return 1;
+		}
+	}
+	if (options.batch <= 0 || options.channel <= 0) {
+		printf("--batch and --channel must be positive.\n");
+		return 1;
+	}
+
+	printHeader(options.target);
+	if (!options.shapes.empty()) {
+		for (size_t i = 0; i < options.shapes.size(); i += 6) {
+			const int* s = &options.shapes[i];
+			int padding = (s[4] - 1) / 2;
+			ConvShape shape(s[2], s[3], s[4], s[4], padding, s[5]);
+			printShape(options, s[0], s[1], shape, findDepthwiseKernel(shape, s[1]));
+		}
+		return 0;
+	}
+
+	const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+	for (size_t i = 0; i < entries.size(); i++) {
+		int group = entries[i].channelGroupSize;
+		int channel = (options.channel + group - 1) / group * group;
+		printShape(options, options.batch, channel, entries[i].shape, &entries[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,320 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "DepthwiseRegistry.h"
+/*
+Depthwise Occupancy Calculator
+
+Offline occupancy of a kernel on a DCU / GCN class target: from the shared memory footprint, the block size and
+the register counts of a kernel, how many of its blocks a compute unit (CU) holds at once, which resource limits
+that, the resulting occupancy (resident waves / wave slots) and how many rounds ("dispatch waves") of resident
+blocks a grid needs. Plain data and arithmetic, no DCU needed, so tile choices can be compared on any host.
+
+Model, per CU:
+	waves of a block     = ceil(blockSize / wavefrontSize)
+	wave slots           = simdsPerComputeUnit * min(maxWavesPerSimd,
+	                           vgprsPerSimd / roundUp(vgprs, vgprGranule), sgprsPerSimd / roundUp(sgprs, sgprGranule))
+	blocks               = min(wave slots / waves of a block, ldsBytesPerComputeUnit / roundUp(shared, ldsGranule),
+	                           maxBlocksPerComputeUnit)
+The waves of a block are spread over the SIMDs of the CU, so the slots are counted per CU.
+
+The register counts of the kernels are estimates (estimateDepthwiseVgprs()); the real ones are in the code
+object (.vgpr_count / .sgpr_count in the -save-temps assembly) and can be passed in instead.
+*/
+
+/*
+DcuTarget
+	Resources of one compute unit, and the number of compute units. Registers are counted per lane.
+*/
+struct DcuTarget {
+	const char* name;
+	int computeUnits;
+	int simdsPerComputeUnit;
+	int wavefrontSize;
+	int maxWavesPerSimd;
+	int vgprsPerSimd;
+	int vgprGranule;
+	int maxVgprsPerWave;
+	int sgprsPerSimd;
+	int sgprGranule;
+	int maxSgprsPerWave;
+	int ldsBytesPerComputeUnit;
+	int ldsGranule;
+	int maxBlocksPerComputeUnit;
+	int maxBlockSize;
+};
+
+/*
+dcuTargets():
+	Built in targets. The first one is the default.
+	dcu     - Hygon DCU (gfx906 class, 64 CUs), the card the benchmarks run on
+	gfx906  - Vega 20 (MI50 / MI60), 60 CUs
+	gfx908  - MI100, 120 CUs, architectural VGPRs only
+	gfx90a  - MI210 / one MI250X die, 104 CUs, 8 waves per SIMD, unified 512 VGPR file in granules of 8
+	Blocks of more than one wave are limited to 16 per CU by the barrier resources.
+*/
+inline const std::vector<DcuTarget>& dcuTargets() {
+	static const std::vector<DcuTarget> targets = {
+		{"dcu", 64, 4, 64, 10, 256, 4, 256, 800, 16, 102, 64 * 1024, 512, 16, 1024},
+		{"gfx906", 60, 4, 64, 10, 256, 4, 256, 800, 16, 102, 64 * 1024, 512, 16, 1024},
+		{"gfx908", 120, 4, 64, 10, 256, 4, 256, 800, 16, 102, 64 * 1024, 512, 16, 1024},
+		{"gfx90a", 104, 4, 64, 8, 512, 8, 512, 800, 16, 102, 64 * 1024, 512, 16, 1024},
+	};
+	return targets;
+}
+
+inline const DcuTarget* findDcuTarget(const char* name) {
+	const std::vector<DcuTarget>& targets = dcuTargets();
+	for (size_t i = 0; i < targets.size(); i++) {
+		if (strcmp(targets[i].name, name) == 0) {
+			return &targets[i];
+		}
+	}
+	return nullptr;
+}
+
+/*
+setDcuTargetField():
+	Override one resource of a target by name ("cu", "simds", "wavefront", "waves", "vgprs", "vgpr-granule",
+	"max-vgprs", "sgprs", "sgpr-granule", "max-sgprs", "lds", "lds-granule", "blocks", "block-size").
+	Return false for an unknown name or a value that is not positive.
+*/
+inline bool setDcuTargetField(DcuTarget& target, const std::string& field, int value) {
+	if (value <= 0) {
+		return false;
+	}
+	struct {
+		const char* name;
+		int DcuTarget::*member;
+	} fields[] = {
+		{"cu", &DcuTarget::computeUnits}, {"simds", &DcuTarget::simdsPerComputeUnit},
+		{"wavefront", &DcuTarget::wavefrontSize}, {"waves", &DcuTarget::maxWavesPerSimd},
+		{"vgprs", &DcuTarget::vgprsPerSimd}, {"vgpr-granule", &DcuTarget::vgprGranule},
+		{"max-vgprs", &DcuTarget::maxVgprsPerWave}, {"sgprs", &DcuTarget::sgprsPerSimd},
+		{"sgpr-granule", &DcuTarget::sgprGranule}, {"max-sgprs", &DcuTarget::maxSgprsPerWave},
+		{"lds", &DcuTarget::ldsBytesPerComputeUnit}, {"lds-granule", &DcuTarget::ldsGranule},
+		{"blocks", &DcuTarget::maxBlocksPerComputeUnit}, {"block-size", &DcuTarget::maxBlockSize},
+	};
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		if (field == fields[i].name) {
+			target.*fields[i].member = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+KernelResources
+	What one launch of a kernel asks for.
+	sharedMemoryBytes - static and dynamic __shared__ of one block
+	vgprs / sgprs     - registers of one thread (VGPR) and one wave (SGPR)
+	gridBlocks        - blocks of the launch
+*/
+struct KernelResources {
+	std::string name;
+	int blockSize;
+	int sharedMemoryBytes;
+	int vgprs;
+	int sgprs;
+	int64_t gridBlocks;
+};
+
+enum OccupancyLimiter {
+	OccupancyLimitedByWaves = 0,	// wave slots of the SIMDs
+	OccupancyLimitedByVgprs,
+	OccupancyLimitedBySgprs,
+	OccupancyLimitedBySharedMemory,
+	OccupancyLimitedByBlocks,		// blocks per CU
+	OccupancyDoesNotFit				// the block exceeds a per block limit, it cannot be launched
+};
+
+inline const char* occupancyLimiterName(int limiter) {
+	static const char* names[] = { "waves", "VGPRs", "SGPRs", "LDS", "blocks", "does not fit" };
+	return limiter >= 0 && limiter <= OccupancyDoesNotFit ? names[limiter] : "?";
+}
+
+/*
+OccupancyReport
+	wavesPerBlock        - waves of one block
+	blocksPerCU          - blocks resident on one CU at the same time, 0 if the block does not fit
+	wavesPerCU           - waves resident on one CU
+	limiter              - OccupancyLimiter of blocksPerCU
+	occupancy            - wavesPerCU / (simdsPerComputeUnit * maxWavesPerSimd)
+	dispatchWaves        - gridBlocks / (blocksPerCU * computeUnits), rounds of resident blocks the grid needs
+	lastWaveUtilization  - fraction of the slots of the last round that have a block
+*/
+struct OccupancyReport {
+	int wavesPerBlock;
+	int blocksPerCU;
+	int wavesPerCU;
+	int limiter;
+	float occupancy;
+	double dispatchWaves;
+	float lastWaveUtilization;
+};
+
+inline int occupancyRoundUp(int value, int granule) {
+	return (value + granule - 1) / granule * granule;
+}
+
+/*
+computeOccupancy():
+	Occupancy of a launch on a target, see the model at the top of the file.
+*/
+inline OccupancyReport computeOccupancy(const DcuTarget& target, const KernelResources& kernel) {
+	OccupancyReport report;
+	report.wavesPerBlock = (kernel.blockSize + target.wavefrontSize - 1) / target.wavefrontSize;
+	report.blocksPerCU = 0;
+	report.wavesPerCU = 0;
+	report.limiter = OccupancyDoesNotFit;
+	report.occupancy = 0.0f;
+	report.dispatchWaves = 0.0;
+	report.lastWaveUtilization = 0.0f;
+
+	int vgprs = occupancyRoundUp(kernel.vgprs > 0 ? kernel.vgprs : 1, target.vgprGranule);
+	int sgprs = occupancyRoundUp(kernel.sgprs > 0 ? kernel.sgprs : 1, target.sgprGranule);
+	int shared = kernel.sharedMemoryBytes > 0 ? occupancyRoundUp(kernel.sharedMemoryBytes, target.ldsGranule) : 0;
+	if (kernel.blockSize <= 0 || kernel.blockSize > target.maxBlockSize || kernel.vgprs > target.maxVgprsPerWave ||
+		kernel.sgprs > target.maxSgprsPerWave || shared > target.ldsBytesPerComputeUnit) {
+		return report;
+	}
+
+	// waves per SIMD each resource allows
+	int simdWaves[3] = { target.maxWavesPerSimd, target.vgprsPerSimd / vgprs, target.sgprsPerSimd / sgprs };
+	int waveLimiter = OccupancyLimitedByWaves;
+	int wavesPerSimd = simdWaves[0];
+	for (int i = 1; i < 3; i++) {
+		if (simdWaves[i] < wavesPerSimd) {
+			wavesPerSimd = simdWaves[i];
+			waveLimiter = i == 1 ? OccupancyLimitedByVgprs : OccupancyLimitedBySgprs;
+		}
+	}
+
+	report.blocksPerCU = target.simdsPerComputeUnit * wavesPerSimd / report.wavesPerBlock;
+	report.limiter = waveLimiter;
+	if (shared > 0 && target.ldsBytesPerComputeUnit / shared < report.blocksPerCU) {
+		report.blocksPerCU = target.ldsBytesPerComputeUnit / shared;
+		report.limiter = OccupancyLimitedBySharedMemory;
+	}
+	if (target.maxBlocksPerComputeUnit < report.blocksPerCU) {
+		report.blocksPerCU = target.maxBlocksPerComputeUnit;
+		report.limiter = OccupancyLimitedByBlocks;
+	}
+	if (report.blocksPerCU == 0) {
+		// more waves than a CU has slots for (e.g. a 1024 thread block with 8 waves per SIMD and many VGPRs)
+		report.limiter = OccupancyDoesNotFit;
+		return report;
+	}
+
+	report.wavesPerCU = report.blocksPerCU * report.wavesPerBlock;
+	report.occupancy = (float)report.wavesPerCU / (target.simdsPerComputeUnit * target.maxWavesPerSimd);
+
+	int64_t slots = (int64_t)report.blocksPerCU * target.computeUnits;
+	if (kernel.gridBlocks > 0) {
+		report.dispatchWaves = (double)kernel.gridBlocks / slots;
+		int64_t lastBlocks = kernel.gridBlocks % slots;
+		report.lastWaveUtilization = lastBlocks == 0 ? 1.0f : (float)lastBlocks / slots;
+	}
+	return report;
+}
+
+/*
+estimateDepthwiseVgprs():
+	VGPRs of a depthwise kernel thread: the filter taps of its channel (the unrolled loops keep them in registers),
+	a row of filterWidth inputs, ceil(filterHeight / stride) rolling row sums, plus about 24 for indices, pointers
+	and the epilogue.
+*/
+inline int estimateDepthwiseVgprs(int filterHeight, int filterWidth, int stride) {
+	return 24 + filterHeight * filterWidth + filterWidth + (filterHeight + stride - 1) / stride;
+}
+
+// Kernel arguments, block / grid ids and the uniform loop bounds
+const int depthwiseEstimatedSgprs = 40;
+
+/*
+depthwiseKernelResources():
+	Resources of a registry kernel launched on batch x channel (channel must be a multiple of its group size).
+*/
+inline KernelResources depthwiseKernelResources(const DepthwiseKernelEntry& entry, int batch, int channel) {
+	KernelResources resources;
+	resources.name = entry.name;
+	resources.blockSize = entry.blockSize;
+	resources.sharedMemoryBytes = entry.sharedMemoryBytes;
+	resources.vgprs = estimateDepthwiseVgprs(entry.shape.filterHeight, entry.shape.filterWidth, entry.shape.strideHeight);
+	resources.sgprs = depthwiseEstimatedSgprs;
+	resources.gridBlocks = (int64_t)batch * entry.gridHeight(channel);
+	return resources;
+}
+
+/*
+depthwiseRectResources():
+	Resources of Depthwise_RowRollingRect (findDepthwiseRectKernel()) launched on batch x channel.
+*/
+inline KernelResources depthwiseRectResources(const DepthwiseRectKernel& kernel, int batch, int channel) {
+	const DepthwiseKernelEntry& entry = *kernel.entry;
+	KernelResources resources;
+	resources.name = std::string("RowRollingRect ") + entry.name + (kernel.transposed ? " T" : "");
+	resources.blockSize = kernel.blockSize;
+	resources.sharedMemoryBytes = kernel.sharedMemoryBytes;
+	resources.vgprs = estimateDepthwiseVgprs(entry.shape.filterHeight, entry.shape.filterWidth, entry.shape.strideHeight);
+	resources.sgprs = depthwiseEstimatedSgprs;
+	resources.gridBlocks = (int64_t)batch * (channel / entry.channelGroupSize) * kernel.tileNumber;
+	return resources;
+}
+
+/*
+depthwiseGenericResources():
+	Resources of Depthwise_Generic on a shape, with its default tile (tileWidth / tileHeight 0) or a given one.
+	Blocks whose staged input would not fit read the input from global memory and stage only the filter.
+*/
+inline KernelResources depthwiseGenericResources(const ConvShape& shape, int batch, int channel, int tileWidth = 0, int tileHeight = 0) {
+	int outputHeight = shape.outputHeight();
+	int outputWidth = shape.outputWidth();
+	if (tileWidth <= 0 || tileHeight <= 0) {
+		depthwiseGenericTile(outputHeight, outputWidth, tileWidth, tileHeight);
+	}
+	size_t sharedBytes = depthwiseGenericSharedBytes(tileWidth, tileHeight, shape.filterHeight, shape.filterWidth,
+		shape.strideHeight, shape.strideWidth, shape.dilationHeight, shape.dilationWidth);
+	if (sharedBytes > (size_t)depthwiseMaxSharedBytes) {
+		sharedBytes = (size_t)shape.filterHeight * shape.filterWidth * sizeof(float);
+	}
+
+	KernelResources resources;
+	resources.name = "Depthwise_Generic " + std::to_string(tileWidth) + "x" + std::to_string(tileHeight);
+	resources.blockSize = tileWidth * tileHeight;
+	resources.sharedMemoryBytes = (int)sharedBytes;
+	// one output per thread, the filter is read from shared memory
+	resources.vgprs = 24;
+	resources.sgprs = depthwiseEstimatedSgprs;
+	int64_t tileNumber = (int64_t)((outputWidth + tileWidth - 1) / tileWidth) * ((outputHeight + tileHeight - 1) / tileHeight);
+	resources.gridBlocks = tileNumber * channel * batch;
+	return resources;
+}
+
+/*
+depthwiseNHWCResources():
+	Resources of Depthwise_NHWC (launchDepthwiseNHWC) on a shape: 256 threads, 4 channels per thread, the filter
+	of the channel tile in shared memory.
+*/
+inline KernelResources depthwiseNHWCResources(const ConvShape& shape, int batch, int channel) {
+	const int channelsPerThread = 4;
+	const int threadNumber = 256;
+	int channelThreads = depthwiseNHWCChannelThreads(channel);
+	int channelTile = channelThreads * channelsPerThread;
+	int pixelsPerBlock = threadNumber / channelThreads;
+	int64_t pixelNumber = (int64_t)batch * shape.outputHeight() * shape.outputWidth();
+
+	KernelResources resources;
+	resources.name = "Depthwise_NHWC";
+	resources.blockSize = threadNumber;
+	resources.sharedMemoryBytes = (int)((size_t)shape.filterHeight * shape.filterWidth * channelTile * sizeof(float));
+	// 4 channel sums and 4 inputs per tap
+	resources.vgprs = 24 + 2 * channelsPerThread;
+	resources.sgprs = depthwiseEstimatedSgprs;
+	resources.gridBlocks = ((pixelNumber + pixelsPerBlock - 1) / pixelsPerBlock) * ((channel + channelTile - 1) / channelTile);
+	return resources;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+/*
+Depthwise Separable Block Kernel.
+
+Case: any input size, filter size, stride and padding. Any channel number.
+
+Depthwise convolution (with its epilogue) and pointwise convolution (with its epilogue) in one kernel.
+The depthwise output never goes to global memory: each block takes TilePixels output pixels of one image and
+OutputChannelTile output channels, and walks over the input channels InputChannelTile at a time:
+	1)	the depthwise output of InputChannelTile channels x TilePixels pixels is computed into shared memory,
+		with the pointwise filter block of InputChannelTile x OutputChannelTile next to it
+	2)	every thread accumulates its OutputChannelTile / 4 output channels of one pixel from shared memory
+The depthwise part is recomputed by every block along gridDim.y, which is cheap next to the pointwise part
+(filter area vs outputChannel multiply-adds per depthwise output).
+
+Grid:
+	gridDim.x - output tiles of TilePixels pixels (output plane flattened)
+	gridDim.y - output channel / OutputChannelTile
+	gridDim.z - batch
+	blockDim.x - TilePixels * 4
+*/
+template <typename scalar_t, int TilePixels, int OutputChannelTile, int InputChannelTile>
+__global__ void DepthwisePointwise_Fused(const scalar_t* __restrict__ input, const scalar_t* __restrict__ depthwiseFilter,
+	const scalar_t* __restrict__ pointwiseFilter, scalar_t* __restrict__ output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth,
+	int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	DepthwiseEpilogue depthwiseEpilogue, DepthwiseEpilogue pointwiseEpilogue) {
+
+	const int threadNumber = TilePixels * 4;
+	const int channelsPerThread = OutputChannelTile / 4;
+
+	__shared__ float depthwiseTile[InputChannelTile * TilePixels];
+	__shared__ float pointwiseTile[OutputChannelTile * InputChannelTile];
+
+	int batch = blockIdx.z;
+	int outputPlaneSize = outputHeight * outputWidth;
+	int pixel = threadIdx.x % TilePixels;
+	int outputPixel = blockIdx.x * TilePixels + pixel;
+	// one wavefront per output channel group, the pointwise filter reads are broadcasts
+	int channelGroup = threadIdx.x / TilePixels;
+	int firstOutputChannel = blockIdx.y * OutputChannelTile;
+
+	int outputY = outputPixel / outputWidth;
+	int outputX = outputPixel % outputWidth;
+	int inputTileY = outputY * stride - padding;
+	int inputTileX = outputX * stride - padding;
+
+	float sum[channelsPerThread];
+	#pragma unroll
+	for (int i = 0; i < channelsPerThread; i++) {
+		sum[i] = 0.0f;
+	}
+
+	for (int firstInputChannel = 0; firstInputChannel < inputChannel; firstInputChannel += InputChannelTile) {
+		// depthwise output of the tile, same pixel for every channel a thread computes
+		for (int i = threadIdx.x; i < InputChannelTile * TilePixels; i += threadNumber) {
+			int channel = firstInputChannel + i / TilePixels;
+			float value = 0.0f;
+			if (channel < inputChannel && outputPixel < outputPlaneSize) {
+				const scalar_t* inputPlane = input + ((size_t)batch * inputChannel + channel) * inputHeight * inputWidth;
+				const scalar_t* channelFilter = depthwiseFilter + channel * filterHeight * filterWidth;
+				for (int ky = 0; ky < filterHeight; ky++) {
+					int y = inputTileY + ky;
+					if (y < 0 || y >= inputHeight) {
+						continue;
+					}
+					for (int kx = 0; kx < filterWidth; kx++) {
+						int x = inputTileX + kx;
+						if (x >= 0 && x < inputWidth) {
+							value += (float)channelFilter[ky * filterWidth + kx] * (float)inputPlane[y * inputWidth + x];
+						}
+					}
+				}
+				value = DepthwiseChannelEpilogue(depthwiseEpilogue, channel).apply(value);
+			}
+			depthwiseTile[i] = value;
+		}
+
+		// pointwise filter block, InputChannelTile consecutive weights per output channel
+		for (int i = threadIdx.x; i < OutputChannelTile * InputChannelTile; i += threadNumber) {
+			int outputChannelIdx = firstOutputChannel + i / InputChannelTile;
+			int inputChannelIdx = firstInputChannel + i % InputChannelTile;
+			float weight = 0.0f;
+			if (outputChannelIdx < outputChannel && inputChannelIdx < inputChannel) {
+				weight = pointwiseFilter[(size_t)outputChannelIdx * inputChannel + inputChannelIdx];
+			}
+			pointwiseTile[i] = weight;
+		}
+		__syncthreads();
+
+		#pragma unroll
+		for (int ci = 0; ci < InputChannelTile; ci++) {
+			float inTemp = depthwiseTile[ci * TilePixels + pixel];
+			#pragma unroll
+			for (int i = 0; i < channelsPerThread; i++) {
+				sum[i] = sum[i] + pointwiseTile[(channelGroup * channelsPerThread + i) * InputChannelTile + ci] * inTemp;
+			}
+		}
+		__syncthreads();
+	}
+
+	if (outputPixel < outputPlaneSize) {
+		#pragma unroll
+		for (int i = 0; i < channelsPerThread; i++) {
+			int outputChannelIdx = firstOutputChannel + channelGroup * channelsPerThread + i;
+			if (outputChannelIdx < outputChannel) {
+				size_t outputIdx = ((size_t)batch * outputChannel + outputChannelIdx) * outputPlaneSize + outputPixel;
+				output[outputIdx] = DepthwiseChannelEpilogue(pointwiseEpilogue, outputChannelIdx).apply(sum[i]);
+			}
+		}
+	}
+}
+
+/*
+launchDepthwisePointwise():
+	Launch DepthwisePointwise_Fused with 64 pixel tiles (one wavefront per output channel group),
+	64 output channels and 16 input channels per step.
+*/
+template <typename scalar_t>
+void launchDepthwisePointwise(const scalar_t* input, const scalar_t* depthwiseFilter, const scalar_t* pointwiseFilter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth,
+	int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	DepthwiseEpilogue depthwiseEpilogue, DepthwiseEpilogue pointwiseEpilogue, hipStream_t stream = 0) {
+
+	const int tilePixels = 64;
+	const int outputChannelTile = 64;
+	const int inputChannelTile = 16;
+
+	dim3 gridSize((outputHeight * outputWidth + tilePixels - 1) / tilePixels,
+		(outputChannel + outputChannelTile - 1) / outputChannelTile, inputBatchNumber);
+	dim3 blockSize(tilePixels * 4);
+
+	hipLaunchKernelGGL(HIP_KERNEL_NAME(DepthwisePointwise_Fused<scalar_t, tilePixels, outputChannelTile, inputChannelTile>),
+		gridSize, blockSize, 0, stream,
+		input, depthwiseFilter, pointwiseFilter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterWidth,
+		outputChannel, outputHeight, outputWidth,
+		padding, stride,
+		depthwiseEpilogue, pointwiseEpilogue);
+}
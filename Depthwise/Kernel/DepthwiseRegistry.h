@@ -0,0 +1,313 @@
+#pragma once
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+/*
+Depthwise Kernel Registry
+
+Maps a convolution shape to the specialised kernel that handles it, together with the launch geometry
+of that kernel. The kernels themselves are listed in DepthwiseKernelList.h; this header only holds
+plain data, so it can be used (and tested) on a host without a DCU.
+
+Usage:
+	ConvShape shape(inputHeight, inputWidth, filterHeight, filterWidth, padding, stride);
+	const DepthwiseKernelEntry* entry = findDepthwiseKernel(shape, inputChannel);
+	if (entry) {
+		gridSize = (batch, entry->gridHeight(inputChannel)), blockSize = (entry->blockSize, 1)
+		launch kernel number entry->id
+	}
+	else if (findDepthwiseRectKernel(shape, inputChannel, rect)) {
+		gridSize = (batch, inputChannel / rect.entry->channelGroupSize, rect.tileNumber), blockSize = (rect.blockSize, 1)
+		launch Depthwise_RowRollingRect number rect.entry->id, transposed if rect.transposed
+	}
+	else {
+		use Depthwise_Generic
+	}
+*/
+
+/*
+ConvShape
+	Everything except batch and channel that decides which kernel can run a depthwise convolution.
+	Channel is checked separately against the channel group size of the kernel.
+*/
+struct ConvShape {
+	int inputHeight;
+	int inputWidth;
+	int filterHeight;
+	int filterWidth;
+	int paddingHeight;
+	int paddingWidth;
+	int strideHeight;
+	int strideWidth;
+	int dilationHeight;
+	int dilationWidth;
+
+	ConvShape(int inputHeight, int inputWidth, int filterHeight, int filterWidth, int padding, int stride)
+		: inputHeight(inputHeight), inputWidth(inputWidth), filterHeight(filterHeight), filterWidth(filterWidth),
+		paddingHeight(padding), paddingWidth(padding), strideHeight(stride), strideWidth(stride),
+		dilationHeight(1), dilationWidth(1) {}
+
+	ConvShape(int inputHeight, int inputWidth, int filterHeight, int filterWidth,
+		int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth)
+		: inputHeight(inputHeight), inputWidth(inputWidth), filterHeight(filterHeight), filterWidth(filterWidth),
+		paddingHeight(paddingHeight), paddingWidth(paddingWidth), strideHeight(strideHeight), strideWidth(strideWidth),
+		dilationHeight(dilationHeight), dilationWidth(dilationWidth) {}
+
+	int outputHeight() const {
+		return (inputHeight + 2 * paddingHeight - dilationHeight * (filterHeight - 1) - 1) / strideHeight + 1;
+	}
+	int outputWidth() const {
+		return (inputWidth + 2 * paddingWidth - dilationWidth * (filterWidth - 1) - 1) / strideWidth + 1;
+	}
+
+	/*
+	key():
+		Pack the shape into 64 bits for the hash table.
+		input 12 bits each, filter / padding / dilation 5 bits each, stride 4 bits each.
+		Shapes that do not fit get the key 0, which no kernel is registered under.
+	*/
+	uint64_t key() const {
+		if (inputHeight <= 0 || inputHeight >= (1 << 12) || inputWidth <= 0 || inputWidth >= (1 << 12) ||
+			filterHeight <= 0 || filterHeight >= 32 || filterWidth <= 0 || filterWidth >= 32 ||
+			paddingHeight < 0 || paddingHeight >= 32 || paddingWidth < 0 || paddingWidth >= 32 ||
+			strideHeight <= 0 || strideHeight >= 16 || strideWidth <= 0 || strideWidth >= 16 ||
+			dilationHeight <= 0 || dilationHeight >= 32 || dilationWidth <= 0 || dilationWidth >= 32) {
+			return 0;
+		}
+		uint64_t packed = (uint64_t)inputHeight;
+		packed = (packed << 12) | (uint64_t)inputWidth;
+		packed = (packed << 5) | (uint64_t)filterHeight;
+		packed = (packed << 5) | (uint64_t)filterWidth;
+		packed = (packed << 5) | (uint64_t)paddingHeight;
+		packed = (packed << 5) | (uint64_t)paddingWidth;
+		packed = (packed << 4) | (uint64_t)strideHeight;
+		packed = (packed << 4) | (uint64_t)strideWidth;
+		packed = (packed << 5) | (uint64_t)dilationHeight;
+		packed = (packed << 5) | (uint64_t)dilationWidth;
+		return packed;
+	}
+
+	bool operator==(const ConvShape& other) const {
+		return key() == other.key();
+	}
+};
+
+/*
+Kernel ids, in the order of DepthwiseKernelList.h.
+Launch tables built from the same list can be indexed with them.
+*/
+enum DepthwiseKernelId {
+#define DEPTHWISE_KERNEL(name, ...) DepthwiseKernel_##name,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, ...) DepthwiseKernel_##name,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	DepthwiseKernelNumber
+};
+
+/*
+DepthwiseKernelEntry
+	id                    - index into the launch tables
+	name                  - kernel name, for printing
+	shape                 - the only shape the kernel handles
+	channelGroupSize      - the channel number must be multiple of it
+	blocksPerChannelGroup - blocks along gridDim.y for one channel group
+	blockSize             - threads per block
+	sharedMemoryBytes     - static __shared__ footprint of one block
+*/
+struct DepthwiseKernelEntry {
+	int id;
+	const char* name;
+	ConvShape shape;
+	int channelGroupSize;
+	int blocksPerChannelGroup;
+	int blockSize;
+	int sharedMemoryBytes;
+
+	bool supportsChannel(int channel) const {
+		return channel > 0 && channel % channelGroupSize == 0;
+	}
+	int gridHeight(int channel) const {
+		return channel / channelGroupSize * blocksPerChannelGroup;
+	}
+};
+
+/*
+depthwiseKernelEntries():
+	All registered kernels, indexed by DepthwiseKernelId.
+*/
+inline const std::vector<DepthwiseKernelEntry>& depthwiseKernelEntries() {
+	static const std::vector<DepthwiseKernelEntry> entries = {
+#define DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, blocksPerChannelGroup, blockSize, sharedMemoryFloats) \
+		{DepthwiseKernel_##name, #name, \
+		ConvShape(inputHeight, inputHeight, filterSize, filterSize, (filterSize - 1) / 2, stride), \
+		channelGroupSize, blocksPerChannelGroup, blockSize, (int)((sharedMemoryFloats) * sizeof(float))},
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+		DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, 1, \
+			((inputHeight - 1) / stride + 1) * channelGroupSize, \
+			channelGroupSize * filterSize * filterSize + channelGroupSize * inputHeight * (inputHeight + filterSize - 1))
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	};
+	return entries;
+}
+
+/*
+findDepthwiseKernel():
+	Look up the specialised kernel for a shape and a channel number.
+	Return nullptr if there is none, the caller then falls back to Depthwise_Generic.
+*/
+inline const DepthwiseKernelEntry* findDepthwiseKernel(const ConvShape& shape, int channel) {
+	static const std::unordered_map<uint64_t, int> index = [] {
+		std::unordered_map<uint64_t, int> table;
+		const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+		for (size_t i = 0; i < entries.size(); i++) {
+			table.emplace(entries[i].shape.key(), (int)i);
+		}
+		return table;
+	}();
+
+	std::unordered_map<uint64_t, int>::const_iterator it = index.find(shape.key());
+	if (it == index.end()) {
+		return nullptr;
+	}
+	const DepthwiseKernelEntry& entry = depthwiseKernelEntries()[it->second];
+	return entry.supportsChannel(channel) ? &entry : nullptr;
+}
+
+/*
+DepthwiseRectKernel
+	A registered kernel run on an input that is not square, through Depthwise_RowRollingRect (Depthwise_RowRolling.h)
+	with the input size, filter size, stride and channel group size of the kernel. The rows are rolled along the
+	dimension that matches the input size of the kernel, the other one is cut into tiles of its output size.
+	entry             - the kernel, entry->id also indexes the launch tables of Depthwise_RowRollingRect
+	transposed        - the width matches (the height does not), the kernel runs transposed
+	tileNumber        - tiles along the other dimension
+	blockSize         - threads per block
+	sharedMemoryBytes - static __shared__ footprint of one block
+
+	gridSize = (batch, channel / entry->channelGroupSize, tileNumber), blockSize = (blockSize, 1)
+*/
+struct DepthwiseRectKernel {
+	const DepthwiseKernelEntry* entry;
+	bool transposed;
+	int tileNumber;
+	int blockSize;
+	int sharedMemoryBytes;
+};
+
+/*
+findDepthwiseRectKernel():
+	Look up the kernel of a rectangular shape: the registered kernel whose input size is the height, or else the
+	width, with the same filter, "same" padding, stride and channel group. Square filter, the same padding and
+	stride on both axes, no dilation. Return false for a square input (findDepthwiseKernel() covers it) and
+	when neither dimension has a kernel, the caller then falls back to Depthwise_Generic.
+*/
+inline bool findDepthwiseRectKernel(const ConvShape& shape, int channel, DepthwiseRectKernel& kernel) {
+	if (shape.inputHeight == shape.inputWidth || shape.filterHeight != shape.filterWidth ||
+		shape.paddingHeight != shape.paddingWidth || shape.strideHeight != shape.strideWidth ||
+		shape.dilationHeight != 1 || shape.dilationWidth != 1) {
+		return false;
+	}
+	for (int transposed = 0; transposed < 2; transposed++) {
+		int size = transposed ? shape.inputWidth : shape.inputHeight;
+		const DepthwiseKernelEntry* entry = findDepthwiseKernel(
+			ConvShape(size, size, shape.filterHeight, shape.filterWidth, shape.paddingHeight, shape.strideHeight), channel);
+		if (entry == nullptr) {
+			continue;
+		}
+		int tileSize = entry->shape.outputHeight();
+		int tiledOutputSize = transposed ? shape.outputHeight() : shape.outputWidth();
+		int paddedSize = size + 2 * entry->shape.paddingHeight;
+		kernel.entry = entry;
+		kernel.transposed = transposed != 0;
+		kernel.tileNumber = (tiledOutputSize + tileSize - 1) / tileSize;
+		kernel.blockSize = tileSize * entry->channelGroupSize;
+		kernel.sharedMemoryBytes = (int)(((size_t)entry->channelGroupSize * shape.filterHeight * shape.filterWidth +
+			(size_t)entry->channelGroupSize * size * paddedSize) * sizeof(float));
+		return true;
+	}
+	return false;
+}
+
+/*
+Launch geometry of the kernels that are not in the list: Depthwise_Generic (launchDepthwiseGeneric),
+Depthwise_Dilated (launchDepthwiseDilated) and Depthwise_NHWC (launchDepthwiseNHWC). Kept here, as plain functions, so host tools such as the occupancy
+calculator (DepthwiseOccupancy.h) see the same geometry as the launches.
+*/
+const int depthwiseMaxSharedBytes = 64 * 1024;
+
+/*
+depthwiseGenericTile():
+	Default tile of Depthwise_Generic: 32 outputs wide (or narrower for small outputs) and 256 threads in total.
+*/
+inline void depthwiseGenericTile(int outputHeight, int outputWidth, int& tileWidth, int& tileHeight) {
+	tileWidth = 1;
+	while (tileWidth < outputWidth && tileWidth < 32) {
+		tileWidth *= 2;
+	}
+	tileHeight = 1;
+	while (tileHeight < outputHeight && tileWidth * tileHeight < 256) {
+		tileHeight *= 2;
+	}
+}
+
+/*
+depthwiseGenericSharedBytes():
+	Dynamic shared memory of a Depthwise_Generic block that stages its input tile: the filter and the input tile
+	with its halo. Above depthwiseMaxSharedBytes the kernel reads the input from global memory and only the
+	filter is staged.
+*/
+inline size_t depthwiseGenericSharedBytes(int tileWidth, int tileHeight, int filterHeight, int filterWidth,
+	int strideHeight, int strideWidth, int dilationHeight, int dilationWidth) {
+
+	int inputTileWidth = (tileWidth - 1) * strideWidth + (filterWidth - 1) * dilationWidth + 1;
+	int inputTileHeight = (tileHeight - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+	return ((size_t)filterHeight * filterWidth + (size_t)inputTileWidth * inputTileHeight) * sizeof(float);
+}
+
+/*
+Depthwise_Dilated: 32 x 32 output tiles, 32 x 8 threads, every thread computes 4 outputs of one column.
+*/
+const int depthwiseDilatedTileWidth = 32;
+const int depthwiseDilatedTileHeight = 32;
+const int depthwiseDilatedBlockHeight = 8;
+
+/*
+depthwiseDilatedSupported():
+	Whether Depthwise_Dilated runs a shape: 3 x 3 or 5 x 5 filter, dilation 2 or 4 on both axes, stride 1 and the
+	"same" padding dilation * (filterSize - 1) / 2. Any input size.
+*/
+inline bool depthwiseDilatedSupported(const ConvShape& shape) {
+	int filterSize = shape.filterHeight;
+	int dilation = shape.dilationHeight;
+	return (filterSize == 3 || filterSize == 5) && shape.filterWidth == filterSize &&
+		(dilation == 2 || dilation == 4) && shape.dilationWidth == dilation &&
+		shape.strideHeight == 1 && shape.strideWidth == 1 &&
+		shape.paddingHeight == dilation * (filterSize - 1) / 2 && shape.paddingWidth == shape.paddingHeight;
+}
+
+/*
+depthwiseDilatedSharedBytes():
+	Static shared memory of a Depthwise_Dilated block: the filter and the dilated receptive field of its tile.
+*/
+inline size_t depthwiseDilatedSharedBytes(int filterSize, int dilation) {
+	int halo = (filterSize - 1) * dilation;
+	return ((size_t)filterSize * filterSize + (size_t)(depthwiseDilatedTileWidth + halo) * (depthwiseDilatedTileHeight + halo)) * sizeof(float);
+}
+
+/*
+depthwiseNHWCChannelThreads():
+	Threads across the channels of a Depthwise_NHWC block (4 channels each, 256 threads per block):
+	16, or 8 / 4 for narrower layers.
+*/
+inline int depthwiseNHWCChannelThreads(int outputChannel) {
+	const int channelsPerThread = 4;
+	int channelThreads = 16;
+	while (channelThreads > 4 && channelThreads * channelsPerThread / 2 >= outputChannel) {
+		channelThreads /= 2;
+	}
+	return channelThreads;
+}
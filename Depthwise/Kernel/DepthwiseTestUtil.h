@@ -0,0 +1,44 @@
+#pragma once
+#include <stdio.h>
+#include <random>
+#include <vector>
+/*
+Depthwise Test Utilities
+
+Shared by the host side tests (one Test*.cpp per test program): the failure counter and EXPECT(), random data and the
+line a test ends with.
+*/
+
+static int failures = 0;
+
+#define EXPECT(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("Wrong! %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+randomFill():
+	Uniform values in [-range, range), drawn from generator in index order.
+*/
+static inline void randomFill(std::vector<float>& data, std::mt19937& generator, float range = 1.0f) {
+	std::uniform_real_distribution<float> distribution(-range, range);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = distribution(generator);
+	}
+}
+
+/*
+testResult():
+	Print "<n> check(s) failed." or "<name> correct." and return the exit code of the test.
+*/
+static inline int testResult(const char* name) {
+	if (failures != 0) {
+		printf("%d check(s) failed.\n", failures);
+		return 1;
+	}
+	printf("%s correct.\n", name);
+	return 0;
+}
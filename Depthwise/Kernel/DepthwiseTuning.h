@@ -0,0 +1,318 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+#include "DepthwiseRegistry.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+/*
+Depthwise Autotuner
+
+The registry (DepthwiseRegistry.h) fixes one launch geometry per shape. The autotuner instead times every
+candidate variant of a shape (kernel, tile size, thread number, layout) the first time the shape is seen, keeps
+the fastest one and writes it to a tuning file, so later processes on the same host reuse it without timing.
+Shapes that have no hand-picked default get tuned the same way.
+
+Tuning file, plain text, one record per line after the version line:
+	depthwise-tuning <version>
+	<host fingerprint> <shape key> <variant> <tileWidth> <tileHeight> <threadNumber> <milliseconds>
+A file of another version is ignored (and replaced on the next write). Records of other hosts are kept, so one
+file can be shared by several machines. Every write takes an flock on <file>.lock, merges the records other
+processes wrote since, and renames a temporary file of its own into place, so concurrent tuners keep each other's
+records.
+
+The file is DEPTHWISE_TUNING_FILE, or $HOME/.cache/depthwise_tuning.txt. DEPTHWISE_TUNING=0 disables tuning,
+the callers then use their defaults (the first candidate).
+
+This header is backend independent: the candidates and the function that times one of them come from the
+caller (CPU_DepthwiseTuning.h on the host, the extension on the DCU).
+*/
+
+#define DEPTHWISE_TUNING_VERSION 1
+
+/*
+Variants a tuning record can name. The fields of DepthwiseTuningConfig a variant uses:
+	DepthwiseVariantSpecialised - the registry kernel, nothing else
+	DepthwiseVariantGeneric     - Depthwise_Generic, tileWidth x tileHeight threads per block
+	DepthwiseVariantCpuPlanes   - CPU_Depthwise_Scheduled(), tileHeight output rows per task, threadNumber
+	DepthwiseVariantCpuNCHWc    - CPU_Depthwise_NCHWc() with the reorders, tileWidth is the channel block
+	DepthwiseVariantDilated     - Depthwise_Dilated, nothing else
+	DepthwiseVariantRectangular - Depthwise_RowRollingRect of the registry kernel of the height or width, nothing else
+	DepthwiseVariantCpuWinograd - CPU_Depthwise_Winograd(), tileWidth is the output tile (2 or 4)
+*/
+enum DepthwiseTuningVariant {
+	DepthwiseVariantSpecialised = 0,
+	DepthwiseVariantGeneric,
+	DepthwiseVariantCpuPlanes,
+	DepthwiseVariantCpuNCHWc,
+	DepthwiseVariantDilated,
+	DepthwiseVariantRectangular,
+	DepthwiseVariantCpuWinograd
+};
+
+struct DepthwiseTuningConfig {
+	int variant;
+	int tileWidth;
+	int tileHeight;
+	int threadNumber;
+	float milliseconds;
+
+	bool sameSchedule(const DepthwiseTuningConfig& other) const {
+		return variant == other.variant && tileWidth == other.tileWidth && tileHeight == other.tileHeight &&
+			threadNumber == other.threadNumber;
+	}
+};
+
+inline DepthwiseTuningConfig depthwiseTuningConfig(int variant, int tileWidth, int tileHeight, int threadNumber) {
+	DepthwiseTuningConfig config = { variant, tileWidth, tileHeight, threadNumber, 0.0f };
+	return config;
+}
+
+/*
+depthwiseTuningKey():
+	Text key of a problem: backend, element size, batch, channel and the whole ConvShape. No spaces.
+*/
+inline std::string depthwiseTuningKey(const char* backend, int elementBytes, int batch, int channel, const ConvShape& shape) {
+	char key[160];
+	snprintf(key, sizeof(key), "%s/b%d/n%d/c%d/%dx%d/k%dx%d/p%dx%d/s%dx%d/d%dx%d", backend, elementBytes, batch, channel,
+		shape.inputHeight, shape.inputWidth, shape.filterHeight, shape.filterWidth,
+		shape.paddingHeight, shape.paddingWidth, shape.strideHeight, shape.strideWidth,
+		shape.dilationHeight, shape.dilationWidth);
+	return key;
+}
+
+// Fingerprint text as one token: spaces and control characters become '_'
+inline std::string depthwiseFingerprintToken(const std::string& text) {
+	std::string token;
+	for (size_t i = 0; i < text.size(); i++) {
+		char c = text[i];
+		token += (c <= ' ' || c == 127) ? '_' : c;
+	}
+	return token.empty() ? std::string("unknown") : token;
+}
+
+/*
+DepthwiseTuningDatabase
+	The records of one tuning file, loaded when it is opened. store() adds (or replaces) a record: under an exclusive
+	lock on <file>.lock it reads the file again, keeps the records other processes added or replaced, and rewrites it
+	through a temporary file of its own (mkstemp), so a reader never sees half a file and no writer loses another
+	one's records. Thread safe. Without file locks (Windows) the merge still happens, only unserialised.
+*/
+class DepthwiseTuningDatabase {
+public:
+	explicit DepthwiseTuningDatabase(const std::string& path) : path(path) {
+		load();
+	}
+
+	const std::string& filePath() const {
+		return path;
+	}
+
+	bool find(const std::string& fingerprint, const std::string& key, DepthwiseTuningConfig& config) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, DepthwiseTuningConfig>::const_iterator it = records.find(fingerprint + " " + key);
+		if (it == records.end()) {
+			return false;
+		}
+		config = it->second;
+		return true;
+	}
+
+	// Return false if the file cannot be written, the record is still kept for this process
+	bool store(const std::string& fingerprint, const std::string& key, const DepthwiseTuningConfig& config) {
+		std::lock_guard<std::mutex> lock(mutex);
+		makeDirectory();
+		FileLock fileLock(path + ".lock");
+		// records other processes wrote since this one loaded the file
+		load();
+		records[fingerprint + " " + key] = config;
+		return save();
+	}
+
+private:
+	std::string path;
+	std::map<std::string, DepthwiseTuningConfig> records;
+	mutable std::mutex mutex;
+
+	// Exclusive flock on a file next to the database, held for one read - merge - write
+	class FileLock {
+	public:
+		explicit FileLock(const std::string& lockPath) : descriptor(-1) {
+#ifndef _WIN32
+			descriptor = ::open(lockPath.c_str(), O_RDWR | O_CREAT, 0666);
+			if (descriptor >= 0 && flock(descriptor, LOCK_EX) != 0) {
+				::close(descriptor);
+				descriptor = -1;
+			}
+#endif
+		}
+		~FileLock() {
+#ifndef _WIN32
+			if (descriptor >= 0) {
+				flock(descriptor, LOCK_UN);
+				::close(descriptor);
+			}
+#endif
+		}
+
+	private:
+		int descriptor;
+
+		FileLock(const FileLock&);
+		FileLock& operator=(const FileLock&);
+	};
+
+	// First write, e.g. $HOME/.cache does not exist yet
+	void makeDirectory() const {
+#ifndef _WIN32
+		size_t slash = path.rfind('/');
+		if (slash != std::string::npos && slash > 0) {
+			mkdir(path.substr(0, slash).c_str(), 0755);
+		}
+#endif
+	}
+
+	void load() {
+		FILE* file = fopen(path.c_str(), "r");
+		if (file == nullptr) {
+			return;
+		}
+		char line[512];
+		int version = 0;
+		if (fgets(line, sizeof(line), file) == nullptr || sscanf(line, "depthwise-tuning %d", &version) != 1 ||
+			version != DEPTHWISE_TUNING_VERSION) {
+			fclose(file);
+			return;
+		}
+		while (fgets(line, sizeof(line), file) != nullptr) {
+			char fingerprint[256];
+			char key[160];
+			DepthwiseTuningConfig config;
+			if (sscanf(line, "%255s %159s %d %d %d %d %f", fingerprint, key, &config.variant,
+				&config.tileWidth, &config.tileHeight, &config.threadNumber, &config.milliseconds) == 7) {
+				records[std::string(fingerprint) + " " + key] = config;
+			}
+		}
+		fclose(file);
+	}
+
+	bool save() const {
+#ifndef _WIN32
+		std::vector<char> name(path.begin(), path.end());
+		const char suffix[] = ".XXXXXX";
+		name.insert(name.end(), suffix, suffix + sizeof(suffix));
+		int descriptor = mkstemp(name.data());
+		if (descriptor < 0) {
+			return false;
+		}
+		// mkstemp creates 0600, the file is meant to be shared
+		fchmod(descriptor, 0644);
+		std::string temporaryPath = name.data();
+		FILE* file = fdopen(descriptor, "w");
+		if (file == nullptr) {
+			::close(descriptor);
+			remove(temporaryPath.c_str());
+			return false;
+		}
+#else
+		std::string temporaryPath = path + ".tmp";
+		FILE* file = fopen(temporaryPath.c_str(), "w");
+		if (file == nullptr) {
+			return false;
+		}
+#endif
+		fprintf(file, "depthwise-tuning %d\n", DEPTHWISE_TUNING_VERSION);
+		for (std::map<std::string, DepthwiseTuningConfig>::const_iterator it = records.begin(); it != records.end(); ++it) {
+			const DepthwiseTuningConfig& config = it->second;
+			fprintf(file, "%s %d %d %d %d %.6f\n", it->first.c_str(), config.variant,
+				config.tileWidth, config.tileHeight, config.threadNumber, config.milliseconds);
+		}
+		bool ok = fclose(file) == 0 && rename(temporaryPath.c_str(), path.c_str()) == 0;
+		if (!ok) {
+			remove(temporaryPath.c_str());
+		}
+		return ok;
+	}
+};
+
+/*
+depthwiseTuningEnabled():
+	False when the environment sets DEPTHWISE_TUNING=0.
+*/
+inline bool depthwiseTuningEnabled() {
+	const char* value = getenv("DEPTHWISE_TUNING");
+	return value == nullptr || strcmp(value, "0") != 0;
+}
+
+/*
+depthwiseTuningDatabase():
+	The process wide database of DEPTHWISE_TUNING_FILE (or $HOME/.cache/depthwise_tuning.txt).
+*/
+inline DepthwiseTuningDatabase& depthwiseTuningDatabase() {
+	static DepthwiseTuningDatabase database([] {
+		const char* path = getenv("DEPTHWISE_TUNING_FILE");
+		if (path != nullptr && path[0] != '\0') {
+			return std::string(path);
+		}
+		const char* home = getenv("HOME");
+		return std::string(home != nullptr ? home : ".") + "/.cache/depthwise_tuning.txt";
+	}());
+	return database;
+}
+
+/*
+depthwiseTune():
+	Return the tuned config of a problem. A record of this host that names one of the candidates is used as it is.
+	Otherwise every candidate is run warmup times and then timed iterations times (run(config) returns the
+	milliseconds of one run), the one with the lowest minimum is stored and returned. Candidates that cannot run
+	return a negative time and are skipped. The first candidate is the default.
+*/
+template <typename Run>
+inline DepthwiseTuningConfig depthwiseTune(DepthwiseTuningDatabase& database, const std::string& fingerprint,
+	const std::string& key, const std::vector<DepthwiseTuningConfig>& candidates, Run run,
+	int warmup = 2, int iterations = 5) {
+
+	DepthwiseTuningConfig stored;
+	if (database.find(fingerprint, key, stored)) {
+		for (size_t i = 0; i < candidates.size(); i++) {
+			if (candidates[i].sameSchedule(stored)) {
+				return stored;
+			}
+		}
+	}
+
+	DepthwiseTuningConfig best = candidates[0];
+	best.milliseconds = -1.0f;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		float fastest = -1.0f;
+		for (int r = 0; r < warmup + iterations; r++) {
+			float milliseconds = run(candidates[i]);
+			if (milliseconds < 0.0f) {
+				fastest = -1.0f;
+				break;
+			}
+			if (r >= warmup && (fastest < 0.0f || milliseconds < fastest)) {
+				fastest = milliseconds;
+			}
+		}
+		if (fastest >= 0.0f && (best.milliseconds < 0.0f || fastest < best.milliseconds)) {
+			best = candidates[i];
+			best.milliseconds = fastest;
+		}
+	}
+	if (best.milliseconds >= 0.0f) {
+		database.store(fingerprint, key, best);
+	}
+	return best;
+}
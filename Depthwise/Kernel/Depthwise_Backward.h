@@ -0,0 +1,391 @@
+#pragma once
+#include <algorithm>
+#include <hip/hip_runtime.h>
+/*
+Depthwise Convolution Backward Kernel.
+
+Case: any input size, filter size, stride, padding and dilation. Any channel number.
+
+Computes grad_input and / or grad_weight of the depthwise convolution in one pass over grad_output.
+Each block takes a band of bandHeight output rows of one (batch, channel) plane:
+	1)	grad_output rows of the band (plus the halo rows the input gradient of the band needs), the filter and,
+		for grad_weight, the input rows under the band are staged in dynamic shared memory
+		(or read straight from global memory when they do not fit, StageRows = false)
+	2)	grad_input: every input row of the band is computed by gathering the grad_output values it fed, so
+		no two blocks write the same input value and no atomics are needed
+	3)	grad_weight: the block reduces its band to one partial sum per filter tap and writes it to the workspace.
+		Depthwise_BackwardFilterReduce then sums the partials of every (batch, band) of a channel,
+		so the reduction is spread over the whole grid instead of being serialised over the batch.
+
+Grid:
+	gridDim.x - band
+	gridDim.y - channel
+	gridDim.z - batch
+*/
+
+#if defined(__HIPCC__) || defined(__CUDACC__)
+#define DEPTHWISE_BACKWARD_FUNCTION __host__ __device__ inline
+#else
+#define DEPTHWISE_BACKWARD_FUNCTION inline
+#endif
+
+/*
+DepthwiseBackwardBand:
+	Rows of one band. Output rows [firstOutputRow, lastOutputRow) are reduced into grad_weight,
+	input rows [firstInputRow, lastInputRow) get their gradient, grad_output rows [firstGradRow, lastGradRow) are read.
+*/
+struct DepthwiseBackwardBand {
+	int firstOutputRow, lastOutputRow;
+	int firstInputRow, lastInputRow;
+	int firstGradRow, lastGradRow;
+};
+
+DEPTHWISE_BACKWARD_FUNCTION DepthwiseBackwardBand depthwiseBackwardBand(int band, int bandHeight,
+	int inputHeight, int outputHeight, int filterHeight, int paddingHeight, int strideHeight, int dilationHeight) {
+
+	DepthwiseBackwardBand rows;
+	rows.firstOutputRow = band * bandHeight;
+	rows.lastOutputRow = rows.firstOutputRow + bandHeight < outputHeight ? rows.firstOutputRow + bandHeight : outputHeight;
+
+	// the last band also takes the input rows below the last output row
+	rows.firstInputRow = rows.firstOutputRow * strideHeight < inputHeight ? rows.firstOutputRow * strideHeight : inputHeight;
+	rows.lastInputRow = rows.lastOutputRow * strideHeight < inputHeight ? rows.lastOutputRow * strideHeight : inputHeight;
+	if (rows.lastOutputRow == outputHeight) {
+		rows.lastInputRow = inputHeight;
+	}
+
+	// grad_output rows oy with oy * stride - padding + ky * dilation inside the input rows
+	int lowest = rows.firstInputRow + paddingHeight - (filterHeight - 1) * dilationHeight;
+	int firstGradRow = lowest <= 0 ? 0 : (lowest + strideHeight - 1) / strideHeight;
+	int lastGradRow = (rows.lastInputRow - 1 + paddingHeight) / strideHeight + 1;
+	if (lastGradRow > outputHeight) {
+		lastGradRow = outputHeight;
+	}
+	rows.firstGradRow = firstGradRow < rows.firstOutputRow ? firstGradRow : rows.firstOutputRow;
+	rows.lastGradRow = lastGradRow > rows.lastOutputRow ? lastGradRow : rows.lastOutputRow;
+	return rows;
+}
+
+template <typename scalar_t, bool ComputeInput, bool ComputeFilter, bool StageRows>
+__global__ void Depthwise_Backward(const scalar_t* __restrict__ gradOutput, const scalar_t* __restrict__ input, const scalar_t* __restrict__ filter,
+	scalar_t* __restrict__ gradInput, float* __restrict__ filterPartial,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth,
+	int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	int bandHeight, int gradRowNumber) {
+
+	HIP_DYNAMIC_SHARED(float, sharedData)
+
+	int band = blockIdx.x;
+	int channel = blockIdx.y;
+	int batch = blockIdx.z;
+	int bandNumber = gridDim.x;
+
+	int threadId = threadIdx.x;
+	int blockSize = blockDim.x;
+	int filterSize = filterHeight * filterWidth;
+
+	DepthwiseBackwardBand rows = depthwiseBackwardBand(band, bandHeight,
+		inputHeight, outputHeight, filterHeight, paddingHeight, strideHeight, dilationHeight);
+
+	size_t planeIdx = (size_t)batch * inputChannel + channel;
+	const scalar_t* gradPlane = gradOutput + planeIdx * outputHeight * outputWidth;
+	const scalar_t* inputPlane = input + planeIdx * inputHeight * inputWidth;
+
+	// input window of the band for grad_weight, including the padding
+	int inputTileY = rows.firstOutputRow * strideHeight - paddingHeight;
+	int inputTileWidth = (outputWidth - 1) * strideWidth + (filterWidth - 1) * dilationWidth + 1;
+	int inputTileHeight = (bandHeight - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+
+	float* filterData = sharedData;
+	float* gradData = filterData + filterSize;
+	float* inputData = gradData + (StageRows ? gradRowNumber * outputWidth : 0);
+	float* reduceData = inputData + (StageRows && ComputeFilter ? inputTileHeight * inputTileWidth : 0);
+
+	// load filter
+	for (int i = threadId; i < filterSize; i += blockSize) {
+		filterData[i] = filter[channel * filterSize + i];
+	}
+
+	if (StageRows) {
+		int gradSize = (rows.lastGradRow - rows.firstGradRow) * outputWidth;
+		for (int i = threadId; i < gradSize; i += blockSize) {
+			gradData[i] = gradPlane[(size_t)rows.firstGradRow * outputWidth + i];
+		}
+		if (ComputeFilter) {
+			int inputRows = (rows.lastOutputRow - rows.firstOutputRow - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+			for (int i = threadId; i < inputRows * inputTileWidth; i += blockSize) {
+				int y = inputTileY + i / inputTileWidth;
+				int x = i % inputTileWidth - paddingWidth;
+				if (y >= 0 && y < inputHeight && x >= 0 && x < inputWidth) {
+					inputData[i] = inputPlane[y * inputWidth + x];
+				}
+				else {
+					inputData[i] = 0.0f;
+				}
+			}
+		}
+	}
+	__syncthreads();
+
+	if (ComputeInput) {
+		int bandInputSize = (rows.lastInputRow - rows.firstInputRow) * inputWidth;
+		for (int i = threadId; i < bandInputSize; i += blockSize) {
+			int inputY = rows.firstInputRow + i / inputWidth;
+			int inputX = i % inputWidth;
+
+			float sum = 0.0f;
+			for (int ky = 0; ky < filterHeight; ky++) {
+				int gradY = inputY + paddingHeight - ky * dilationHeight;
+				if (gradY < 0 || gradY % strideHeight != 0 || gradY / strideHeight >= outputHeight) {
+					continue;
+				}
+				gradY /= strideHeight;
+				for (int kx = 0; kx < filterWidth; kx++) {
+					int gradX = inputX + paddingWidth - kx * dilationWidth;
+					if (gradX < 0 || gradX % strideWidth != 0 || gradX / strideWidth >= outputWidth) {
+						continue;
+					}
+					gradX /= strideWidth;
+					if (StageRows) {
+						sum += filterData[ky * filterWidth + kx] * gradData[(gradY - rows.firstGradRow) * outputWidth + gradX];
+					}
+					else {
+						sum += filterData[ky * filterWidth + kx] * (float)gradPlane[gradY * outputWidth + gradX];
+					}
+				}
+			}
+			gradInput[(planeIdx * inputHeight + inputY) * inputWidth + inputX] = sum;
+		}
+	}
+
+	if (ComputeFilter) {
+		// lanes threads per filter tap, each one sums every lanes-th output of the band
+		int lanes = filterSize < blockSize ? blockSize / filterSize : 1;
+		int tapSlots = blockSize / lanes;
+		int lane = threadId % lanes;
+		int bandOutputSize = (rows.lastOutputRow - rows.firstOutputRow) * outputWidth;
+
+		for (int tap = threadId / lanes; tap < filterSize; tap += tapSlots) {
+			int ky = tap / filterWidth;
+			int kx = tap % filterWidth;
+			float sum = 0.0f;
+			for (int i = lane; i < bandOutputSize; i += lanes) {
+				int y = i / outputWidth;
+				int x = i % outputWidth;
+				int tileY = y * strideHeight + ky * dilationHeight;
+				int tileX = x * strideWidth + kx * dilationWidth;
+				if (StageRows) {
+					sum += gradData[(rows.firstOutputRow - rows.firstGradRow + y) * outputWidth + x] * inputData[tileY * inputTileWidth + tileX];
+				}
+				else {
+					int inputY = inputTileY + tileY;
+					int inputX = tileX - paddingWidth;
+					if (inputY >= 0 && inputY < inputHeight && inputX >= 0 && inputX < inputWidth) {
+						sum += (float)gradPlane[(rows.firstOutputRow + y) * outputWidth + x] * (float)inputPlane[inputY * inputWidth + inputX];
+					}
+				}
+			}
+			reduceData[tap * lanes + lane] = sum;
+		}
+		__syncthreads();
+
+		// partials are laid out [channel][batch * bandNumber + band][tap]
+		size_t partialIdx = ((size_t)channel * inputBatchNumber * bandNumber + (size_t)batch * bandNumber + band) * filterSize;
+		for (int tap = threadId; tap < filterSize; tap += blockSize) {
+			float sum = 0.0f;
+			for (int i = 0; i < lanes; i++) {
+				sum += reduceData[tap * lanes + i];
+			}
+			filterPartial[partialIdx + tap] = sum;
+		}
+	}
+}
+
+/*
+Depthwise_BackwardFilterReduce():
+	Sum the partialNumber grad_weight partials of each channel.
+
+Grid:
+	gridDim.x - channel
+*/
+template <typename scalar_t>
+__global__ void Depthwise_BackwardFilterReduce(const float* __restrict__ filterPartial, scalar_t* __restrict__ gradFilter,
+	int partialNumber, int filterSize) {
+
+	HIP_DYNAMIC_SHARED(float, reduceData)
+
+	int channel = blockIdx.x;
+	int threadId = threadIdx.x;
+	int blockSize = blockDim.x;
+
+	int lanes = filterSize < blockSize ? blockSize / filterSize : 1;
+	int tapSlots = blockSize / lanes;
+	int lane = threadId % lanes;
+	const float* channelPartial = filterPartial + (size_t)channel * partialNumber * filterSize;
+
+	for (int tap = threadId / lanes; tap < filterSize; tap += tapSlots) {
+		float sum = 0.0f;
+		for (int i = lane; i < partialNumber; i += lanes) {
+			sum += channelPartial[(size_t)i * filterSize + tap];
+		}
+		reduceData[tap * lanes + lane] = sum;
+	}
+	__syncthreads();
+
+	for (int tap = threadId; tap < filterSize; tap += blockSize) {
+		float sum = 0.0f;
+		for (int i = 0; i < lanes; i++) {
+			sum += reduceData[tap * lanes + i];
+		}
+		gradFilter[channel * filterSize + tap] = sum;
+	}
+}
+
+/*
+depthwiseBackwardBandHeight():
+	Output rows per band: about 1024 outputs per block, fewer if the staged rows do not fit in 64 KB.
+	Returns 0 if even a single row band does not fit, then the rows are read from global memory.
+*/
+inline int depthwiseBackwardBandHeight(int inputHeight, int inputWidth, int filterHeight, int filterWidth,
+	int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	int* gradRowNumber = nullptr) {
+
+	const int blockSize = 256;
+	const size_t maxSharedBytes = 64 * 1024;
+
+	int filterSize = filterHeight * filterWidth;
+	int inputTileWidth = (outputWidth - 1) * strideWidth + (filterWidth - 1) * dilationWidth + 1;
+
+	for (int bandHeight = std::min(outputHeight, (1024 + outputWidth - 1) / outputWidth); bandHeight >= 1; bandHeight--) {
+		int bandNumber = (outputHeight + bandHeight - 1) / bandHeight;
+		int rowNumber = 0;
+		for (int band = 0; band < bandNumber; band++) {
+			DepthwiseBackwardBand rows = depthwiseBackwardBand(band, bandHeight,
+				inputHeight, outputHeight, filterHeight, paddingHeight, strideHeight, dilationHeight);
+			rowNumber = std::max(rowNumber, rows.lastGradRow - rows.firstGradRow);
+		}
+		int inputTileHeight = (bandHeight - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+		size_t sharedBytes = (filterSize + (size_t)rowNumber * outputWidth + (size_t)inputTileHeight * inputTileWidth +
+			std::max(blockSize, filterSize)) * sizeof(float);
+		if (sharedBytes <= maxSharedBytes) {
+			if (gradRowNumber != nullptr) {
+				*gradRowNumber = rowNumber;
+			}
+			return bandHeight;
+		}
+	}
+	return 0;
+}
+
+/*
+depthwiseBackwardWorkspaceSize():
+	Number of floats of grad_weight partials launchDepthwiseBackward() needs.
+*/
+inline size_t depthwiseBackwardWorkspaceSize(int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth,
+	int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth) {
+
+	int bandHeight = depthwiseBackwardBandHeight(inputHeight, inputWidth, filterHeight, filterWidth,
+		outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth);
+	if (bandHeight == 0) {
+		bandHeight = std::min(outputHeight, (1024 + outputWidth - 1) / outputWidth);
+	}
+	int bandNumber = (outputHeight + bandHeight - 1) / bandHeight;
+	return (size_t)inputChannel * inputBatchNumber * bandNumber * filterHeight * filterWidth;
+}
+
+/*
+launchDepthwiseBackward():
+	grad_input and / or grad_weight of the depthwise convolution (channel multiplier 1).
+	Pass nullptr as gradInput or gradFilter to skip that gradient. workspace holds
+	depthwiseBackwardWorkspaceSize() floats, it is only used when gradFilter is requested.
+*/
+template <typename scalar_t>
+void launchDepthwiseBackward(const scalar_t* gradOutput, const scalar_t* input, const scalar_t* filter,
+	scalar_t* gradInput, scalar_t* gradFilter, float* workspace,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth,
+	int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	hipStream_t stream = 0) {
+
+	const int blockSize = 256;
+
+	if (gradInput == nullptr && gradFilter == nullptr) {
+		return;
+	}
+
+	int filterSize = filterHeight * filterWidth;
+	int gradRowNumber = 0;
+	int bandHeight = depthwiseBackwardBandHeight(inputHeight, inputWidth, filterHeight, filterWidth,
+		outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth, &gradRowNumber);
+	bool stageRows = bandHeight != 0;
+	if (!stageRows) {
+		bandHeight = std::min(outputHeight, (1024 + outputWidth - 1) / outputWidth);
+	}
+	int bandNumber = (outputHeight + bandHeight - 1) / bandHeight;
+
+	int inputTileWidth = (outputWidth - 1) * strideWidth + (filterWidth - 1) * dilationWidth + 1;
+	int inputTileHeight = (bandHeight - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+	size_t reduceBytes = std::max(blockSize, filterSize) * sizeof(float);
+	size_t sharedBytes = filterSize * sizeof(float);
+	if (stageRows) {
+		sharedBytes += (size_t)gradRowNumber * outputWidth * sizeof(float);
+		if (gradFilter != nullptr) {
+			sharedBytes += (size_t)inputTileHeight * inputTileWidth * sizeof(float);
+		}
+	}
+	if (gradFilter != nullptr) {
+		sharedBytes += reduceBytes;
+	}
+
+	dim3 gridSize(bandNumber, inputChannel, inputBatchNumber);
+
+#define DEPTHWISE_BACKWARD_LAUNCH(computeInput, computeFilter, stage) \
+	hipLaunchKernelGGL(HIP_KERNEL_NAME(Depthwise_Backward<scalar_t, computeInput, computeFilter, stage>), \
+		gridSize, dim3(blockSize), sharedBytes, stream, \
+		gradOutput, input, filter, gradInput, workspace, \
+		inputBatchNumber, inputChannel, inputHeight, inputWidth, \
+		filterHeight, filterWidth, \
+		outputHeight, outputWidth, \
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth, \
+		bandHeight, gradRowNumber)
+
+	if (gradInput != nullptr && gradFilter != nullptr) {
+		if (stageRows) {
+			DEPTHWISE_BACKWARD_LAUNCH(true, true, true);
+		}
+		else {
+			DEPTHWISE_BACKWARD_LAUNCH(true, true, false);
+		}
+	}
+	else if (gradInput != nullptr) {
+		if (stageRows) {
+			DEPTHWISE_BACKWARD_LAUNCH(true, false, true);
+		}
+		else {
+			DEPTHWISE_BACKWARD_LAUNCH(true, false, false);
+		}
+	}
+	else {
+		if (stageRows) {
+			DEPTHWISE_BACKWARD_LAUNCH(false, true, true);
+		}
+		else {
+			DEPTHWISE_BACKWARD_LAUNCH(false, true, false);
+		}
+	}
+#undef DEPTHWISE_BACKWARD_LAUNCH
+
+	if (gradFilter != nullptr) {
+		hipLaunchKernelGGL(HIP_KERNEL_NAME(Depthwise_BackwardFilterReduce<scalar_t>),
+			dim3(inputChannel), dim3(blockSize), reduceBytes, stream,
+			workspace, gradFilter, inputBatchNumber * bandNumber, filterSize);
+	}
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+#include "DepthwiseRegistry.h"
+/*
+Dilated (Atrous) Depthwise Convolution Kernel.
+
+Case: filter FilterSize x FilterSize (3 or 5), dilation Dilation (2 or 4) on both axes, stride 1,
+padding Dilation * (FilterSize - 1) / 2. Any input size, any channel number.
+
+The last stages of DeepLab style backbones (output stride 8 or 16) run at 33 x 33, 65 x 65 and larger with
+these filters. Each block computes a 32 x 32 output tile of one (batch, channel) plane:
+	1)	the whole dilated receptive field of the tile, (32 + (FilterSize - 1) * Dilation) squared inputs, is
+		loaded into shared memory once, zeros outside the input, next to the filter, which every thread then
+		keeps in registers
+	2)	a thread computes RowsPerThread outputs of one column that are Dilation rows apart. Their filter windows
+		share all but one of their rows, so the thread reads FilterSize + RowsPerThread - 1 receptive field rows
+		instead of FilterSize * RowsPerThread, each one added to every output whose window covers it
+	3)	the threads of a row of the block read consecutive columns, so the reads do not conflict
+
+Grid:
+	gridDim.x - output tile
+	gridDim.y - channel
+	gridDim.z - batch
+Block:
+	(32, 8). Thread row ty computes the output rows (ty / Dilation) * Dilation * RowsPerThread + ty % Dilation
+	+ i * Dilation of the tile, i < RowsPerThread.
+*/
+template <typename scalar_t, int FilterSize, int Dilation>
+__global__ void Depthwise_Dilated(const scalar_t* __restrict__ input, const scalar_t* __restrict__ filter, scalar_t* __restrict__ output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	const int tileWidth = depthwiseDilatedTileWidth;
+	const int tileHeight = depthwiseDilatedTileHeight;
+	const int blockSize = depthwiseDilatedTileWidth * depthwiseDilatedBlockHeight;
+	const int rowsPerThread = depthwiseDilatedTileHeight / depthwiseDilatedBlockHeight;
+	const int padding = Dilation * (FilterSize - 1) / 2;
+	const int fieldWidth = tileWidth + (FilterSize - 1) * Dilation;
+	const int fieldHeight = tileHeight + (FilterSize - 1) * Dilation;
+
+	__shared__ float filterShared[FilterSize * FilterSize];
+	__shared__ float inputData[fieldHeight * fieldWidth];
+
+	int tileColumnNumber = (outputWidth + tileWidth - 1) / tileWidth;
+	int outputTileX = (blockIdx.x % tileColumnNumber) * tileWidth;
+	int outputTileY = (blockIdx.x / tileColumnNumber) * tileHeight;
+	int channel = blockIdx.y;
+	int batch = blockIdx.z;
+	int threadId = threadIdx.y * blockDim.x + threadIdx.x;
+
+	// load filter
+	if (threadId < FilterSize * FilterSize) {
+		filterShared[threadId] = filter[channel * FilterSize * FilterSize + threadId];
+	}
+
+	// load the receptive field of the tile, zero outside the input
+	const scalar_t* inputPlane = input + ((size_t)batch * inputChannel + channel) * inputHeight * inputWidth;
+	int inputTileX = outputTileX - padding;
+	int inputTileY = outputTileY - padding;
+	for (int i = threadId; i < fieldHeight * fieldWidth; i += blockSize) {
+		int y = inputTileY + i / fieldWidth;
+		int x = inputTileX + i % fieldWidth;
+		if (y >= 0 && y < inputHeight && x >= 0 && x < inputWidth) {
+			inputData[i] = inputPlane[y * inputWidth + x];
+		}
+		else {
+			inputData[i] = 0.0f;
+		}
+	}
+
+	__syncthreads();
+
+	float filterData[FilterSize * FilterSize];
+	#pragma unroll
+	for (int i = 0; i < FilterSize * FilterSize; i++) {
+		filterData[i] = filterShared[i];
+	}
+
+	int column = threadIdx.x;
+	int firstRow = (threadIdx.y / Dilation) * Dilation * rowsPerThread + threadIdx.y % Dilation;
+
+	float sum[rowsPerThread];
+	#pragma unroll
+	for (int r = 0; r < rowsPerThread; r++) {
+		sum[r] = 0.0f;
+	}
+
+	// field row i is filter row i - r of output r
+	#pragma unroll
+	for (int i = 0; i < FilterSize + rowsPerThread - 1; i++) {
+		int fieldRow = (firstRow + i * Dilation) * fieldWidth + column;
+		#pragma unroll
+		for (int kx = 0; kx < FilterSize; kx++) {
+			float value = inputData[fieldRow + kx * Dilation];
+			#pragma unroll
+			for (int r = 0; r < rowsPerThread; r++) {
+				if (i - r >= 0 && i - r < FilterSize) {
+					sum[r] = sum[r] + filterData[(i - r) * FilterSize + kx] * value;
+				}
+			}
+		}
+	}
+
+	int outputX = outputTileX + column;
+	if (outputX >= outputWidth) {
+		return;
+	}
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, channel);
+	scalar_t* outputPlane = output + ((size_t)batch * outputChannel + channel) * outputHeight * outputWidth;
+	#pragma unroll
+	for (int r = 0; r < rowsPerThread; r++) {
+		int outputY = outputTileY + firstRow + r * Dilation;
+		if (outputY < outputHeight) {
+			outputPlane[(size_t)outputY * outputWidth + outputX] = channelEpilogue.apply(sum[r] * alpha + beta);
+		}
+	}
+}
+
+/*
+launchDepthwiseDilated():
+	Launch Depthwise_Dilated for a shape depthwiseDilatedSupported() accepts. Same arguments as launchDepthwiseGeneric().
+*/
+template <typename scalar_t>
+void launchDepthwiseDilated(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, hipStream_t stream = 0) {
+
+	typedef void (*Kernel)(const scalar_t*, const scalar_t*, scalar_t*,
+		int, int, int, int,
+		int, int, int,
+		int, int, int, int,
+		int, int, int, int, int, int,
+		float, float, DepthwiseEpilogue);
+	Kernel kernel = filterHeight == 3 ?
+		(dilationHeight == 2 ? Depthwise_Dilated<scalar_t, 3, 2> : Depthwise_Dilated<scalar_t, 3, 4>) :
+		(dilationHeight == 2 ? Depthwise_Dilated<scalar_t, 5, 2> : Depthwise_Dilated<scalar_t, 5, 4>);
+
+	int tileNumber = ((outputWidth + depthwiseDilatedTileWidth - 1) / depthwiseDilatedTileWidth) *
+		((outputHeight + depthwiseDilatedTileHeight - 1) / depthwiseDilatedTileHeight);
+	dim3 gridSize(tileNumber, outputChannel, outputBatchNumber);
+	dim3 blockSize(depthwiseDilatedTileWidth, depthwiseDilatedBlockHeight);
+
+	hipLaunchKernelGGL(kernel, gridSize, blockSize, 0, stream,
+		input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		alpha, beta, epilogue);
+}
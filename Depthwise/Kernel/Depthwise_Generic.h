@@ -0,0 +1,147 @@
+#pragma once
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+#include "DepthwiseRegistry.h"
+/*
+Depthwise Convolution Kernel.
+
+Case: any input size, filter size, stride, padding and dilation. Any channel number.
+
+Fallback for every shape that has no specialised kernel (e.g. 150 x 150 or 96 x 96 crops, channel numbers
+that are not multiple of the channel group size).
+Each block computes a blockDim.x x blockDim.y tile of output for one (batch, channel) pair.
+The input tile it needs (tile plus halo) is staged in dynamic shared memory, or read straight from global
+memory when the halo is too large to fit (StageInput = false).
+
+Grid:
+	gridDim.x - number of output tiles
+	gridDim.y - channel
+	gridDim.z - batch
+*/
+template <typename scalar_t, bool StageInput>
+__global__ void Depthwise_Generic(const scalar_t* __restrict__ input, const scalar_t* __restrict__ filter, scalar_t* __restrict__ output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	HIP_DYNAMIC_SHARED(float, sharedData)
+
+	int tileWidth = blockDim.x;
+	int tileHeight = blockDim.y;
+	int tileColumnNumber = (outputWidth + tileWidth - 1) / tileWidth;
+
+	int outputTileX = (blockIdx.x % tileColumnNumber) * tileWidth;
+	int outputTileY = (blockIdx.x / tileColumnNumber) * tileHeight;
+	int channel = blockIdx.y;
+	int batch = blockIdx.z;
+
+	int threadId = threadIdx.y * blockDim.x + threadIdx.x;
+	int blockSize = blockDim.x * blockDim.y;
+	int filterSize = filterHeight * filterWidth;
+
+	// input window covered by the tile, including the halo
+	int inputTileX = outputTileX * strideWidth - paddingWidth;
+	int inputTileY = outputTileY * strideHeight - paddingHeight;
+	int inputTileWidth = (tileWidth - 1) * strideWidth + (filterWidth - 1) * dilationWidth + 1;
+	int inputTileHeight = (tileHeight - 1) * strideHeight + (filterHeight - 1) * dilationHeight + 1;
+
+	const scalar_t* inputPlane = input + ((size_t)batch * inputChannel + channel) * inputHeight * inputWidth;
+
+	// load filter
+	float* filterData = sharedData;
+	for (int i = threadId; i < filterSize; i += blockSize) {
+		filterData[i] = filter[channel * filterSize + i];
+	}
+
+	// load input tile, zero outside the input
+	float* inputData = sharedData + filterSize;
+	if (StageInput) {
+		for (int i = threadId; i < inputTileHeight * inputTileWidth; i += blockSize) {
+			int y = inputTileY + i / inputTileWidth;
+			int x = inputTileX + i % inputTileWidth;
+			if (y >= 0 && y < inputHeight && x >= 0 && x < inputWidth) {
+				inputData[i] = inputPlane[y * inputWidth + x];
+			}
+			else {
+				inputData[i] = 0.0f;
+			}
+		}
+	}
+	__syncthreads();
+
+	int outputX = outputTileX + threadIdx.x;
+	int outputY = outputTileY + threadIdx.y;
+	if (outputX >= outputWidth || outputY >= outputHeight) {
+		return;
+	}
+
+	float sum = 0.0f;
+	for (int ky = 0; ky < filterHeight; ky++) {
+		for (int kx = 0; kx < filterWidth; kx++) {
+			int tileY = threadIdx.y * strideHeight + ky * dilationHeight;
+			int tileX = threadIdx.x * strideWidth + kx * dilationWidth;
+			if (StageInput) {
+				sum += filterData[ky * filterWidth + kx] * inputData[tileY * inputTileWidth + tileX];
+			}
+			else {
+				int y = inputTileY + tileY;
+				int x = inputTileX + tileX;
+				if (y >= 0 && y < inputHeight && x >= 0 && x < inputWidth) {
+					sum += filterData[ky * filterWidth + kx] * (float)inputPlane[y * inputWidth + x];
+				}
+			}
+		}
+	}
+
+	size_t outputIdx = (((size_t)batch * outputChannel + channel) * outputHeight + outputY) * outputWidth + outputX;
+	output[outputIdx] = DepthwiseChannelEpilogue(epilogue, channel).apply(sum * alpha + beta);
+}
+
+/*
+launchDepthwiseGeneric():
+	Pick the tile shape and the shared memory size for Depthwise_Generic, and launch it.
+	The tile is 32 outputs wide (or narrower for small outputs) and 256 threads in total, unless the caller
+	gives one (tileWidth x tileHeight threads, e.g. from the autotuner, DepthwiseTuning.h).
+*/
+template <typename scalar_t>
+void launchDepthwiseGeneric(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, hipStream_t stream = 0, int tileWidth = 0, int tileHeight = 0) {
+
+	if (tileWidth <= 0 || tileHeight <= 0) {
+		depthwiseGenericTile(outputHeight, outputWidth, tileWidth, tileHeight);
+	}
+
+	size_t filterBytes = (size_t)filterHeight * filterWidth * sizeof(float);
+	size_t sharedBytes = depthwiseGenericSharedBytes(tileWidth, tileHeight, filterHeight, filterWidth,
+		strideHeight, strideWidth, dilationHeight, dilationWidth);
+
+	int tileNumber = ((outputWidth + tileWidth - 1) / tileWidth) * ((outputHeight + tileHeight - 1) / tileHeight);
+	dim3 gridSize(tileNumber, outputChannel, outputBatchNumber);
+	dim3 blockSize(tileWidth, tileHeight);
+
+	if (sharedBytes <= depthwiseMaxSharedBytes) {
+		hipLaunchKernelGGL(HIP_KERNEL_NAME(Depthwise_Generic<scalar_t, true>), gridSize, blockSize, sharedBytes, stream,
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterWidth,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+			alpha, beta, epilogue);
+	}
+	else {
+		hipLaunchKernelGGL(HIP_KERNEL_NAME(Depthwise_Generic<scalar_t, false>), gridSize, blockSize, filterBytes, stream,
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			filterLayerNumber, filterHeight, filterWidth,
+			outputBatchNumber, outputChannel, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+			alpha, beta, epilogue);
+	}
+}
+
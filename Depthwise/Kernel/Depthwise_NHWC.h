@@ -0,0 +1,129 @@
+#pragma once
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+#include "DepthwiseRegistry.h"
+/*
+Depthwise Convolution Kernel.
+
+Case: channels last (NHWC) input and output, any input size, filter size, stride, padding and dilation.
+Any channel number.
+
+For torch.channels_last tensors, so the caller does not transpose to NCHW and back.
+The channels of one pixel are contiguous, so the threads of a block run across the channels:
+threadIdx.x picks the channel, threadIdx.y the output pixel, and every load and store of neighbouring threads
+is consecutive. Each thread computes ChannelsPerThread channels of one output pixel, blockDim.x channels apart.
+The filter of the channel tile of the block is staged in dynamic shared memory as [tap][channel].
+
+filter is (channel, filterHeight, filterWidth), the same as the NCHW kernels.
+
+Grid:
+	gridDim.x - output pixels (batch * outputHeight * outputWidth) / blockDim.y
+	gridDim.y - channel / (blockDim.x * ChannelsPerThread)
+*/
+template <typename scalar_t, int ChannelsPerThread>
+__global__ void Depthwise_NHWC(const scalar_t* __restrict__ input, const scalar_t* __restrict__ filter, scalar_t* __restrict__ output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	HIP_DYNAMIC_SHARED(float, filterData)
+
+	int channelTile = blockDim.x * ChannelsPerThread;
+	int firstChannel = blockIdx.y * channelTile;
+	int filterSize = filterHeight * filterWidth;
+	int threadId = threadIdx.y * blockDim.x + threadIdx.x;
+	int blockSize = blockDim.x * blockDim.y;
+
+	// load filter, transposed to [tap][channel]
+	for (int i = threadId; i < filterSize * channelTile; i += blockSize) {
+		int channel = firstChannel + i % channelTile;
+		int tap = i / channelTile;
+		float weight = 0.0f;
+		if (channel < outputChannel) {
+			weight = filter[channel * filterSize + tap];
+		}
+		filterData[i] = weight;
+	}
+	__syncthreads();
+
+	int pixel = blockIdx.x * blockDim.y + threadIdx.y;
+	if (pixel >= outputBatchNumber * outputHeight * outputWidth) {
+		return;
+	}
+	int outputX = pixel % outputWidth;
+	int outputY = pixel / outputWidth % outputHeight;
+	int batch = pixel / (outputWidth * outputHeight);
+
+	float sum[ChannelsPerThread];
+	#pragma unroll
+	for (int j = 0; j < ChannelsPerThread; j++) {
+		sum[j] = 0.0f;
+	}
+
+	for (int ky = 0; ky < filterHeight; ky++) {
+		int inputY = outputY * strideHeight - paddingHeight + ky * dilationHeight;
+		if (inputY < 0 || inputY >= inputHeight) {
+			continue;
+		}
+		for (int kx = 0; kx < filterWidth; kx++) {
+			int inputX = outputX * strideWidth - paddingWidth + kx * dilationWidth;
+			if (inputX < 0 || inputX >= inputWidth) {
+				continue;
+			}
+			const scalar_t* inputPixel = input + (((size_t)batch * inputHeight + inputY) * inputWidth + inputX) * inputChannel;
+			const float* tapFilter = filterData + (ky * filterWidth + kx) * channelTile;
+			#pragma unroll
+			for (int j = 0; j < ChannelsPerThread; j++) {
+				int channelInTile = j * blockDim.x + threadIdx.x;
+				if (firstChannel + channelInTile < inputChannel) {
+					sum[j] += tapFilter[channelInTile] * (float)inputPixel[firstChannel + channelInTile];
+				}
+			}
+		}
+	}
+
+	size_t outputIdx = (((size_t)batch * outputHeight + outputY) * outputWidth + outputX) * outputChannel;
+	#pragma unroll
+	for (int j = 0; j < ChannelsPerThread; j++) {
+		int channel = firstChannel + j * blockDim.x + threadIdx.x;
+		if (channel < outputChannel) {
+			output[outputIdx + channel] = DepthwiseChannelEpilogue(epilogue, channel).apply(sum[j] * alpha + beta);
+		}
+	}
+}
+
+/*
+launchDepthwiseNHWC():
+	Launch Depthwise_NHWC with 256 threads, 4 channels per thread.
+	The channel tile is 64 channels (16 threads across), 32 or 16 for narrower layers.
+*/
+template <typename scalar_t>
+void launchDepthwiseNHWC(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth,
+	float alpha, float beta, DepthwiseEpilogue epilogue, hipStream_t stream = 0) {
+
+	const int channelsPerThread = 4;
+	const int threadNumber = 256;
+
+	int channelThreads = depthwiseNHWCChannelThreads(outputChannel);
+	int channelTile = channelThreads * channelsPerThread;
+	int pixelsPerBlock = threadNumber / channelThreads;
+	int pixelNumber = outputBatchNumber * outputHeight * outputWidth;
+
+	dim3 gridSize((pixelNumber + pixelsPerBlock - 1) / pixelsPerBlock, (outputChannel + channelTile - 1) / channelTile);
+	dim3 blockSize(channelThreads, pixelsPerBlock);
+	size_t sharedBytes = (size_t)filterHeight * filterWidth * channelTile * sizeof(float);
+
+	hipLaunchKernelGGL(HIP_KERNEL_NAME(Depthwise_NHWC<scalar_t, channelsPerThread>), gridSize, blockSize, sharedBytes, stream,
+		input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterLayerNumber, filterHeight, filterWidth,
+		outputBatchNumber, outputChannel, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, strideHeight, strideWidth, dilationHeight, dilationWidth,
+		alpha, beta, epilogue);
+}
@@ -0,0 +1,266 @@
+#pragma once
+/*
+Depthwise Convolution Kernel Generator.
+
+Case: input InputSize x InputSize, filter FilterSize x FilterSize, stride Stride, padding (FilterSize - 1) / 2
+
+Generates the kernels that are written out by hand in Filter3x3_Input14x14_Stride1.h, Filter5x5_Input28x28_Stride1.h
+and the other "one output column per thread" kernels. They only differ in the input size, the filter size, the stride
+and the channel group size, which are template parameters here.
+
+The number of channel must be multiple of ChannelGroupSize.
+Each block handles ChannelGroupSize channels of one image. The input of these channels is put in shared memory with
+left and right padding; up and bottom padding rows are skipped instead of being multiplied by zero.
+Each thread computes one output column of one channel. It walks down the input rows once and keeps
+ceil(FilterSize / Stride) row sums in registers (sum0, sum1, sum2 ... in the hand-written kernels):
+an input row is added to every output row whose filter window covers it, the first input row of an output row
+sets its sum, and after the last one the sum is written out and the register is reused for a later output row.
+The order of operations is the same as in the hand-written kernels, so the results are bit-exact with them.
+
+Grid:
+	gridSize = (batch, channel / ChannelGroupSize)
+	blockSize = (outputSize * ChannelGroupSize, 1)
+
+Depthwise_RowRollingRect runs the same schedule on a rectangular input of which only one dimension is InputSize.
+The rows are rolled along that dimension, the other one is cut into tiles of outputSize outputs; every tile puts
+its input columns with the halo of the filter (and zeros for the padding) in shared memory, so a block holds no
+more than the square kernel. With Transposed the width is InputSize: the kernel computes the transposed
+convolution, it loads the input and the filter transposed into shared memory and writes the output transposed.
+
+Grid of Depthwise_RowRollingRect:
+	gridSize = (batch, channel / ChannelGroupSize, ceil(tiled output size / outputSize))
+	blockSize = (outputSize * ChannelGroupSize, 1)
+*/
+#include "DepthwiseEpilogue.h"
+
+/*
+RowRollingSchedule
+	Compile-time description of which input rows go into which output row, and in which register.
+*/
+template <int InputSize, int FilterSize, int Stride>
+struct RowRollingSchedule {
+	static constexpr int padding = (FilterSize - 1) / 2;
+	static constexpr int paddedWidth = InputSize + 2 * padding;
+	static constexpr int outputSize = (InputSize + 2 * padding - FilterSize) / Stride + 1;
+	static constexpr int accumulatorNumber = (FilterSize + Stride - 1) / Stride;
+
+	// first and last input row (not counting padding rows) of output row o
+	__host__ __device__ static constexpr int firstRow(int o) {
+		return o * Stride - padding < 0 ? 0 : o * Stride - padding;
+	}
+	__host__ __device__ static constexpr int lastRow(int o) {
+		return o * Stride - padding + FilterSize - 1 > InputSize - 1 ? InputSize - 1 : o * Stride - padding + FilterSize - 1;
+	}
+
+	// first and last output row that input row r goes into
+	__host__ __device__ static constexpr int firstOutput(int r) {
+		return r + padding - FilterSize + 1 <= 0 ? 0 : (r + padding - FilterSize + Stride) / Stride;
+	}
+	__host__ __device__ static constexpr int lastOutput(int r) {
+		return (r + padding) / Stride > outputSize - 1 ? outputSize - 1 : (r + padding) / Stride;
+	}
+
+	// output row o is accumulated in register o % accumulatorNumber.
+	// return the output row that input row r adds to register slot, or -1 if r adds nothing to it.
+	__host__ __device__ static constexpr int slotOutput(int r, int slot) {
+		return firstOutput(r) + (slot - firstOutput(r) % accumulatorNumber + accumulatorNumber) % accumulatorNumber;
+	}
+	__host__ __device__ static constexpr int outputOfSlot(int r, int slot) {
+		return slotOutput(r, slot) <= lastOutput(r) ? slotOutput(r, slot) : -1;
+	}
+};
+
+template <typename scalar_t, int InputSize, int FilterSize, int Stride, int ChannelGroupSize>
+__global__ void Depthwise_RowRolling(const scalar_t* __restrict__ input, const scalar_t* __restrict__ filter, scalar_t* __restrict__ output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	typedef RowRollingSchedule<InputSize, FilterSize, Stride> Schedule;
+	const int filterArea = FilterSize * FilterSize;
+	const int paddedWidth = Schedule::paddedWidth;
+	const int outputSize = Schedule::outputSize;
+	const int blockSize = outputSize * ChannelGroupSize;
+
+	__shared__ float filterData[ChannelGroupSize * FilterSize * FilterSize];
+	__shared__ float inputData[ChannelGroupSize * InputSize * Schedule::paddedWidth]; // ignore up and bottom padding
+
+	float sum[Schedule::accumulatorNumber];  // to accumulate the row sum result. rolling recycle.
+
+	// load filter
+	int filterLoadSrcIdx = blockIdx.y * ChannelGroupSize * filterArea;
+	for (int i = threadIdx.x; i < ChannelGroupSize * filterArea; i += blockSize) {
+		filterData[i] = filter[filterLoadSrcIdx + i];
+	}
+
+	// set left and right padding
+	for (int row = threadIdx.x; row < ChannelGroupSize * InputSize; row += blockSize) {
+		#pragma unroll
+		for (int i = 0; i < Schedule::padding; i++) {
+			inputData[row * paddedWidth + i] = 0;
+			inputData[row * paddedWidth + Schedule::padding + InputSize + i] = 0;
+		}
+	}
+
+	// load input
+	// for all threads in the same block, use blockIdx.x to find correct batch index, use blockIdx.y to find correct input channel.
+	int inputLoadIdxBase = blockIdx.x * inputChannel * InputSize * InputSize + blockIdx.y * ChannelGroupSize * InputSize * InputSize;
+	for (int i = threadIdx.x; i < ChannelGroupSize * InputSize * InputSize; i += blockSize) {
+		inputData[(i / InputSize) * paddedWidth + Schedule::padding + i % InputSize] = input[inputLoadIdxBase + i];
+	}
+	__syncthreads();
+
+	// convolution
+	int channelInGroup = threadIdx.x / outputSize;
+	int column = threadIdx.x % outputSize;
+
+	int outputIdx = blockIdx.x * outputChannel * outputSize * outputSize +
+		(blockIdx.y * ChannelGroupSize + channelInGroup) * outputSize * outputSize +
+		column;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, blockIdx.y * ChannelGroupSize + channelInGroup);
+
+	int inputAccessBase = channelInGroup * InputSize * paddedWidth + column * Stride;
+	int filterAccessBase = channelInGroup * filterArea;
+
+	#pragma unroll
+	for (int row = 0; row < InputSize; row++) {
+		#pragma unroll
+		for (int kx = 0; kx < FilterSize; kx++) {
+			float inTemp = inputData[inputAccessBase + row * paddedWidth + kx];
+
+			#pragma unroll
+			for (int slot = 0; slot < Schedule::accumulatorNumber; slot++) {
+				int o = Schedule::outputOfSlot(row, slot);
+				if (o < 0) {
+					continue;
+				}
+				int filterRow = row + Schedule::padding - o * Stride;
+				if (row == Schedule::firstRow(o) && kx == 0) {
+					sum[slot] = filterData[filterAccessBase + filterRow * FilterSize + kx] * inTemp;
+				}
+				else {
+					sum[slot] = sum[slot] + filterData[filterAccessBase + filterRow * FilterSize + kx] * inTemp;
+				}
+			}
+		}
+
+		// write out the output rows that are complete
+		#pragma unroll
+		for (int slot = 0; slot < Schedule::accumulatorNumber; slot++) {
+			int o = Schedule::outputOfSlot(row, slot);
+			if (o >= 0 && row == Schedule::lastRow(o)) {
+				output[outputIdx + o * outputSize] = channelEpilogue.apply(sum[slot] * alpha + beta);
+			}
+		}
+	}
+}
+
+template <typename scalar_t, int InputSize, int FilterSize, int Stride, int ChannelGroupSize, bool Transposed>
+__global__ void Depthwise_RowRollingRect(const scalar_t* __restrict__ input, const scalar_t* __restrict__ filter, scalar_t* __restrict__ output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	typedef RowRollingSchedule<InputSize, FilterSize, Stride> Schedule;
+	const int filterArea = FilterSize * FilterSize;
+	const int paddedWidth = Schedule::paddedWidth;
+	const int outputSize = Schedule::outputSize;
+	const int blockSize = outputSize * ChannelGroupSize;
+	// input columns of a tile, halo included. Never more than paddedWidth.
+	const int tileInputWidth = (outputSize - 1) * Stride + FilterSize;
+
+	// the tiled dimension: width, height for Transposed
+	int tiledInputSize = Transposed ? inputHeight : inputWidth;
+	int tiledOutputSize = Transposed ? outputHeight : outputWidth;
+	int tileStart = blockIdx.z * outputSize;
+	int tileInputStart = tileStart * Stride - Schedule::padding;
+
+	__shared__ float filterData[ChannelGroupSize * FilterSize * FilterSize];
+	__shared__ float inputData[ChannelGroupSize * InputSize * Schedule::paddedWidth]; // ignore up and bottom padding
+
+	float sum[Schedule::accumulatorNumber];  // to accumulate the row sum result. rolling recycle.
+
+	// load filter, transposed for Transposed so that its first index runs along the rolled dimension
+	int filterLoadSrcIdx = blockIdx.y * ChannelGroupSize * filterArea;
+	for (int i = threadIdx.x; i < ChannelGroupSize * filterArea; i += blockSize) {
+		int tap = i % filterArea;
+		int filterStoreIdx = Transposed ? i - tap + (tap % FilterSize) * FilterSize + tap / FilterSize : i;
+		filterData[filterStoreIdx] = filter[filterLoadSrcIdx + i];
+	}
+
+	// load the input of the tile with its halo, zero outside the input.
+	// consecutive threads read consecutive addresses: along the tile row, or along the rolled dimension for Transposed.
+	int planeSize = inputHeight * inputWidth;
+	int inputLoadIdxBase = blockIdx.x * inputChannel * planeSize + blockIdx.y * ChannelGroupSize * planeSize;
+	for (int i = threadIdx.x; i < ChannelGroupSize * InputSize * tileInputWidth; i += blockSize) {
+		int channelInGroup = i / (InputSize * tileInputWidth);
+		int row = Transposed ? i % InputSize : i / tileInputWidth % InputSize;
+		int x = Transposed ? i / InputSize % tileInputWidth : i % tileInputWidth;
+		int tiled = tileInputStart + x;
+
+		float value = 0;
+		if (tiled >= 0 && tiled < tiledInputSize) {
+			if (Transposed) {
+				value = input[inputLoadIdxBase + channelInGroup * planeSize + tiled * inputWidth + row];
+			}
+			else {
+				value = input[inputLoadIdxBase + channelInGroup * planeSize + row * inputWidth + tiled];
+			}
+		}
+		inputData[(channelInGroup * InputSize + row) * paddedWidth + x] = value;
+	}
+	__syncthreads();
+
+	// convolution, as in Depthwise_RowRolling
+	int channelInGroup = threadIdx.x / outputSize;
+	int column = threadIdx.x % outputSize;
+	int tiledOutput = tileStart + column;
+
+	// output o of the rolled dimension is at outputIdx + o * outputStep
+	int outputPlane = blockIdx.x * outputChannel * outputHeight * outputWidth +
+		(blockIdx.y * ChannelGroupSize + channelInGroup) * outputHeight * outputWidth;
+	int outputIdx = Transposed ? outputPlane + tiledOutput * outputWidth : outputPlane + tiledOutput;
+	int outputStep = Transposed ? 1 : outputWidth;
+	// the threads past the last tile output compute on zeros and write nothing
+	bool active = tiledOutput < tiledOutputSize;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, blockIdx.y * ChannelGroupSize + channelInGroup);
+
+	int inputAccessBase = channelInGroup * InputSize * paddedWidth + column * Stride;
+	int filterAccessBase = channelInGroup * filterArea;
+
+	#pragma unroll
+	for (int row = 0; row < InputSize; row++) {
+		#pragma unroll
+		for (int kx = 0; kx < FilterSize; kx++) {
+			float inTemp = inputData[inputAccessBase + row * paddedWidth + kx];
+
+			#pragma unroll
+			for (int slot = 0; slot < Schedule::accumulatorNumber; slot++) {
+				int o = Schedule::outputOfSlot(row, slot);
+				if (o < 0) {
+					continue;
+				}
+				int filterRow = row + Schedule::padding - o * Stride;
+				if (row == Schedule::firstRow(o) && kx == 0) {
+					sum[slot] = filterData[filterAccessBase + filterRow * FilterSize + kx] * inTemp;
+				}
+				else {
+					sum[slot] = sum[slot] + filterData[filterAccessBase + filterRow * FilterSize + kx] * inTemp;
+				}
+			}
+		}
+
+		// write out the output rows that are complete
+		#pragma unroll
+		for (int slot = 0; slot < Schedule::accumulatorNumber; slot++) {
+			int o = Schedule::outputOfSlot(row, slot);
+			if (o >= 0 && row == Schedule::lastRow(o) && active) {
+				output[outputIdx + o * outputStep] = channelEpilogue.apply(sum[slot] * alpha + beta);
+			}
+		}
+	}
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include "EmulatedDepthwiseKernels.h"
+#include "CPU_Depthwise.h"
+
+/*
+Run a depthwise convolution kernel on the host emulator, check it against the CPU backend and print the
+shared memory and global memory accesses of its blocks.
+
+Same arguments as the benchmark (DCU_Depthwise_Kernel.cpp):
+	EmulateDepthwiseKernel batch channel inputSize filterSize stride [-b]
+	inputSize	H, or HxW for a rectangular input
+	-b	print every block, not only the total and the average per block
+*/
+int main(int argc, char* argv[]) {
+	if (argc < 6) {
+		printf("Usage: %s batch channel inputSize|HxW filterSize stride [-b]\n", argv[0]);
+		return 1;
+	}
+
+	int inputBatchNumber = atoi(argv[1]);
+	int inputChannel = atoi(argv[2]);
+	int inputHeight = 0;
+	int inputWidth = 0;
+	if (sscanf(argv[3], "%dx%d", &inputHeight, &inputWidth) < 2) {
+		inputWidth = inputHeight;
+	}
+	int filterHeight = atoi(argv[4]);
+	int filterWidth = filterHeight;
+	int stride = atoi(argv[5]);
+	bool perBlock = argc > 6 && strcmp(argv[6], "-b") == 0;
+
+	if (inputBatchNumber <= 0 || inputChannel <= 0 || inputHeight <= 0 || inputWidth <= 0 || filterHeight <= 0 || stride <= 0) {
+		printf("All arguments must be positive.\n");
+		return 1;
+	}
+
+	int paddingHeight = (filterHeight - 1) / 2;
+	int paddingWidth = (filterWidth - 1) / 2;
+	int outputHeight = (inputHeight + paddingHeight * 2 - filterHeight) / stride + 1;
+	int outputWidth = (inputWidth + paddingWidth * 2 - filterWidth) / stride + 1;
+
+	std::vector<float> input((size_t)inputBatchNumber * inputChannel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)inputChannel * filterHeight * filterWidth);
+	std::vector<float> output((size_t)inputBatchNumber * inputChannel * outputHeight * outputWidth);
+	std::vector<float> expected(output.size());
+
+	std::mt19937 generator(0);
+	std::uniform_real_distribution<float> distribution(0.0f, 5.0f);
+	for (size_t i = 0; i < input.size(); i++) {
+		input[i] = distribution(generator);
+	}
+	for (size_t i = 0; i < filter.size(); i++) {
+		filter[i] = distribution(generator);
+	}
+
+	const DepthwiseKernelEntry* entry = emulateDepthwise(input.data(), filter.data(), output.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterWidth, outputHeight, outputWidth,
+		paddingHeight, paddingWidth, stride,
+		1.0f, 0.0f);
+	bool rectangular = entry != nullptr && inputHeight != inputWidth;
+	printf("Kernel: %s%s\n", rectangular ? "Depthwise_RowRollingRect " : "", entry ? entry->name : "Depthwise_Generic");
+
+	CPU_Depthwise(input.data(), filter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterWidth,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		paddingWidth, stride,
+		1.0f, 0.0f, depthwiseNoEpilogue);
+
+	for (size_t i = 0; i < output.size(); i++) {
+		if (!(std::fabs(output[i] - expected[i]) <= 1e-3f * (1.0f + std::fabs(expected[i])))) {
+			printf("%f, %f\n", output[i], expected[i]);
+			printf("Wrong! Output Idx: %d\n", (int)i);
+			return 1;
+		}
+	}
+	printf("Kernel Calculation Correct.\n");
+
+	emu::printLaunchStatistics(stdout, perBlock);
+
+	// minimum traffic: every input, filter and output word once
+	emu::BlockStatistics total = emu::lastLaunchStatistics().total();
+	double minimumWords = (double)(input.size() + filter.size() + output.size());
+	printf("global memory traffic: %.2f x the minimum\n", (total.globalLoads + total.globalStores) / minimumWords);
+	return 0;
+}
@@ -0,0 +1,128 @@
+#pragma once
+/*
+All depthwise kernels built for the host emulator with memory access counting, and a launch table indexed by
+DepthwiseKernelId, like the one of the benchmark.
+*/
+#include <hip/hip_runtime.h>
+
+#include "DepthwiseRegistry.h"
+#include "DepthwiseEpilogue.h"
+
+#define float emu::Float
+#include "Filter3x3_Input7x7_Stride1.h"
+#include "Filter3x3_Input14x14_Stride1.h"
+#include "Filter3x3_Input14x14_Stride2.h"
+#include "Filter3x3_Input28x28_Stride1.h"
+#include "Filter3x3_Input28x28_Stride2.h"
+#include "Filter3x3_Input56x56_Stride1.h"
+#include "Filter3x3_Input56x56_Stride2.h"
+#include "Filter3x3_Input112x112_Stride1.h"
+#include "Filter3x3_Input112x112_Stride2.h"
+#include "Filter5x5_Input7x7_Stride1.h"
+#include "Filter5x5_Input14x14_Stride1.h"
+#include "Filter5x5_Input14x14_Stride2.h"
+#include "Filter5x5_Input28x28_Stride1.h"
+#include "Filter5x5_Input56x56_Stride2.h"
+#include "Depthwise_Generic.h"
+#include "Depthwise_Dilated.h"
+#include "Depthwise_RowRolling.h"
+#undef float
+
+typedef void (*EmulatedDepthwiseKernel)(const emu::Float* input, const emu::Float* filter, emu::Float* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	emu::Float alpha, emu::Float beta, DepthwiseEpilogue epilogue);
+
+static const EmulatedDepthwiseKernel emulatedDepthwiseKernels[DepthwiseKernelNumber] = {
+#define DEPTHWISE_KERNEL(name, ...) name,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRolling<emu::Float, inputHeight, filterSize, stride, channelGroupSize>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+};
+
+// Depthwise_RowRollingRect of every kernel, [transposed][DepthwiseKernelId]
+static const EmulatedDepthwiseKernel emulatedDepthwiseRectKernels[2][DepthwiseKernelNumber] = {
+	{
+#define DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, ...) \
+	Depthwise_RowRollingRect<emu::Float, inputHeight, filterSize, stride, channelGroupSize, false>,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRollingRect<emu::Float, inputHeight, filterSize, stride, channelGroupSize, false>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	},
+	{
+#define DEPTHWISE_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize, ...) \
+	Depthwise_RowRollingRect<emu::Float, inputHeight, filterSize, stride, channelGroupSize, true>,
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	Depthwise_RowRollingRect<emu::Float, inputHeight, filterSize, stride, channelGroupSize, true>,
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+	}
+};
+
+/*
+emulateDepthwise():
+	Run the kernel the registry picks for the shape (Depthwise_Generic if there is none) on float buffers.
+	A rectangular shape with a kernel for its height or width runs Depthwise_RowRollingRect of that kernel.
+	A dilated shape runs Depthwise_Dilated when it supports it, Depthwise_Generic otherwise.
+	Return the chosen kernel (also for Depthwise_RowRollingRect), nullptr for the others. Statistics are in
+	emu::lastLaunchStatistics().
+*/
+inline const DepthwiseKernelEntry* emulateDepthwise(const float* input, const float* filter, float* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int filterWidth, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int stride,
+	float alpha, float beta, DepthwiseEpilogue epilogue = depthwiseNoEpilogue, int dilation = 1) {
+
+	ConvShape shape(inputHeight, inputWidth, filterHeight, filterWidth, paddingHeight, paddingWidth, stride, stride, dilation, dilation);
+	const DepthwiseKernelEntry* entry = findDepthwiseKernel(shape, inputChannel);
+	DepthwiseRectKernel rect;
+	if (entry) {
+		dim3 gridSize(inputBatchNumber, entry->gridHeight(inputChannel));
+		dim3 blockSize(entry->blockSize, 1);
+		hipLaunchKernelGGL(emulatedDepthwiseKernels[entry->id], gridSize, blockSize, 0, 0,
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			inputChannel, filterHeight, filterWidth,
+			inputBatchNumber, inputChannel, outputHeight, outputWidth,
+			paddingWidth, stride,
+			alpha, beta, epilogue);
+	}
+	else if (findDepthwiseRectKernel(shape, inputChannel, rect)) {
+		entry = rect.entry;
+		dim3 gridSize(inputBatchNumber, inputChannel / entry->channelGroupSize, rect.tileNumber);
+		dim3 blockSize(rect.blockSize, 1);
+		hipLaunchKernelGGL(emulatedDepthwiseRectKernels[rect.transposed][entry->id], gridSize, blockSize, 0, 0,
+			input, filter, output,
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			inputChannel, filterHeight, filterWidth,
+			inputBatchNumber, inputChannel, outputHeight, outputWidth,
+			paddingWidth, stride,
+			alpha, beta, epilogue);
+	}
+	else if (depthwiseDilatedSupported(shape)) {
+		launchDepthwiseDilated(
+			reinterpret_cast<const emu::Float*>(input), reinterpret_cast<const emu::Float*>(filter), reinterpret_cast<emu::Float*>(output),
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			inputChannel, filterHeight, filterWidth,
+			inputBatchNumber, inputChannel, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, stride, stride, dilation, dilation,
+			alpha, beta, epilogue);
+	}
+	else {
+		launchDepthwiseGeneric(
+			reinterpret_cast<const emu::Float*>(input), reinterpret_cast<const emu::Float*>(filter), reinterpret_cast<emu::Float*>(output),
+			inputBatchNumber, inputChannel, inputHeight, inputWidth,
+			inputChannel, filterHeight, filterWidth,
+			inputBatchNumber, inputChannel, outputHeight, outputWidth,
+			paddingHeight, paddingWidth, stride, stride, dilation, dilation,
+			alpha, beta, epilogue);
+	}
+	return entry;
+}
@@ -0,0 +1,462 @@
+#pragma once
+#include <ucontext.h>
+#include <stdint.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <functional>
+#include <type_traits>
+/*
+Host Emulator for the DCU kernels
+
+Runs __global__ functions on the CPU without changing them, so the kernels can be tested and profiled on a machine
+without a DCU. Put this directory in front of the include path; hip/hip_runtime.h then resolves to the stub next to
+this file.
+
+	blockIdx, threadIdx, blockDim, gridDim - per thread variables, set by the emulator
+	__shared__                             - static thread_local, shared by all threads of the block that is running
+	                                         (with a SharedArrayMarker in front, so every array is its own range)
+	HIP_DYNAMIC_SHARED(type, var)          - dynamic shared memory of the size given at launch
+	__syncthreads()                        - barrier
+	hipLaunchKernelGGL(kernel, grid, block, sharedBytes, stream, args...) - runs the whole grid before it returns
+
+Every thread of a block is a fiber (ucontext) with its own stack. The blocks of the grid run one after another.
+A block runs its fibers in turn, each one until its next __syncthreads() or its end, so no thread passes a barrier
+before every thread of the block has reached it. Shared memory is filled with NaN before each block, so a kernel that
+reads shared memory it did not write in the same block gives NaN outputs.
+
+Memory access counting:
+	Include the kernel headers with float replaced by emu::Float,
+		#define float emu::Float
+		#include "Filter3x3_Input14x14_Stride1.h"
+		#undef float
+	Every load and store of a float that is not a local variable of the kernel is then counted, per block, as a shared
+	memory or a global memory access. Launching such a kernel with float buffers is fine, the pointers are converted.
+	After the launch, emu::lastLaunchStatistics() holds the counts of every block.
+
+Shared memory access recording:
+	emu::recordSharedAccesses(n) makes the following launches also log every shared memory access of their first n
+	blocks (emu::Float kernels only): block, thread, barrier phase, the array and the byte offset in it, and the
+	call site in the kernel (the return address of Float::load / Float::store, which are never inlined while the
+	other Float members always are). Threads of a block run one after another between barriers, so the accesses of
+	a thread are in program order and the n-th execution of a site by each thread of a wavefront in a phase is one
+	instruction of that wavefront. SharedBankConflicts.h turns the log into bank conflicts.
+*/
+
+#define EMU_NOINLINE __attribute__((noinline))
+#define EMU_ALWAYS_INLINE __attribute__((always_inline))
+
+struct dim3 {
+	unsigned int x, y, z;
+	dim3(unsigned int x = 1, unsigned int y = 1, unsigned int z = 1) : x(x), y(y), z(z) {}
+};
+
+struct uint3 {
+	unsigned int x, y, z;
+};
+
+static thread_local uint3 blockIdx;
+static thread_local uint3 threadIdx;
+static thread_local dim3 blockDim;
+static thread_local dim3 gridDim;
+
+namespace emu {
+
+const size_t fiberStackSize = 64 * 1024;
+
+/*
+BlockStatistics
+	Memory accesses of one block, in number of 4 byte words.
+*/
+struct BlockStatistics {
+	uint3 blockIdx;
+	long sharedLoads;
+	long sharedStores;
+	long globalLoads;
+	long globalStores;
+	long barriers;		// __syncthreads() passed by the block
+};
+
+struct AddressRange {
+	uintptr_t begin;
+	uintptr_t end;
+};
+
+/*
+SharedAccess
+	One shared memory access of a recorded block, see "Shared memory access recording" above.
+	array is an index into LaunchStatistics::sharedArrays, 0 is the dynamic shared memory.
+*/
+struct SharedAccess {
+	unsigned int block;
+	int thread;
+	int phase;
+	uintptr_t site;
+	int array;
+	uint32_t offset;
+	bool isStore;
+};
+
+struct LaunchStatistics {
+	dim3 gridSize;
+	dim3 blockSize;
+	size_t dynamicSharedBytes;
+	std::vector<BlockStatistics> blocks;
+	std::vector<SharedAccess> sharedAccesses;
+	std::vector<AddressRange> sharedArrays;		// dynamic shared memory, then the __shared__ arrays
+
+	BlockStatistics total() const {
+		BlockStatistics sum;
+		memset(&sum, 0, sizeof(sum));
+		for (size_t i = 0; i < blocks.size(); i++) {
+			sum.sharedLoads += blocks[i].sharedLoads;
+			sum.sharedStores += blocks[i].sharedStores;
+			sum.globalLoads += blocks[i].globalLoads;
+			sum.globalStores += blocks[i].globalStores;
+			sum.barriers += blocks[i].barriers;
+		}
+		return sum;
+	}
+};
+
+struct Fiber {
+	ucontext_t context;
+	std::vector<char> stack;
+	bool finished;
+};
+
+/*
+Block
+	State of the block that is running on this host thread.
+	current is the thread that is running, -1 while the scheduler runs.
+*/
+struct Block {
+	ucontext_t scheduler;
+	std::vector<Fiber> fibers;
+	int current;
+	const std::function<void()>* kernel;
+	BlockStatistics* statistics;
+	unsigned int blockId;
+	bool recordShared;
+};
+
+static thread_local Block* runningBlock = nullptr;
+static thread_local std::vector<AddressRange> staticSharedRanges;	// __shared__ arrays seen so far
+static thread_local std::vector<char> dynamicSharedMemory;
+static LaunchStatistics lastLaunch;
+static int recordedBlockNumber = 0;
+
+/*
+recordSharedAccesses():
+	Log the shared memory accesses of the first blockNumber blocks of every following launch, 0 to stop.
+*/
+inline void recordSharedAccesses(int blockNumber) {
+	recordedBlockNumber = blockNumber;
+}
+
+inline const LaunchStatistics& lastLaunchStatistics() {
+	return lastLaunch;
+}
+
+inline bool isKernelLocal(uintptr_t address) {
+	const Fiber& fiber = runningBlock->fibers[runningBlock->current];
+	return address - (uintptr_t)fiber.stack.data() < fiber.stack.size();
+}
+
+// Index of the shared array holding address, as in LaunchStatistics::sharedArrays: 0 dynamic, k + 1 static range k, -1 none
+inline int sharedArrayOf(uintptr_t address) {
+	if (address - (uintptr_t)dynamicSharedMemory.data() < dynamicSharedMemory.size()) {
+		return 0;
+	}
+	for (size_t i = 0; i < staticSharedRanges.size(); i++) {
+		if (address >= staticSharedRanges[i].begin && address < staticSharedRanges[i].end) {
+			return (int)i + 1;
+		}
+	}
+	return -1;
+}
+
+inline bool isShared(uintptr_t address) {
+	return sharedArrayOf(address) >= 0;
+}
+
+/*
+recordAccess():
+	Count a load or a store of the word at address, if a kernel is running and the word is not one of its locals.
+	site is the kernel code that made the access, used by the shared memory access log.
+*/
+inline void recordAccess(const void* address, bool isStore, uintptr_t site = 0) {
+	Block* block = runningBlock;
+	if (block == nullptr || block->current < 0 || isKernelLocal((uintptr_t)address)) {
+		return;
+	}
+	BlockStatistics* statistics = block->statistics;
+	int array = sharedArrayOf((uintptr_t)address);
+	if (array >= 0) {
+		isStore ? statistics->sharedStores++ : statistics->sharedLoads++;
+		if (block->recordShared) {
+			uintptr_t begin = array == 0 ? (uintptr_t)dynamicSharedMemory.data() : staticSharedRanges[array - 1].begin;
+			SharedAccess access = { block->blockId, block->current, (int)statistics->barriers, site, array,
+				(uint32_t)((uintptr_t)address - begin), isStore };
+			lastLaunch.sharedAccesses.push_back(access);
+		}
+	}
+	else {
+		isStore ? statistics->globalStores++ : statistics->globalLoads++;
+	}
+}
+
+static thread_local bool sharedArrayStarts = false;
+
+/*
+SharedArrayMarker
+	__shared__ declares one of these in front of every array, so two arrays that happen to be next to each other
+	are still two ranges.
+*/
+struct SharedArrayMarker {
+	SharedArrayMarker() {
+		sharedArrayStarts = true;
+	}
+};
+
+/*
+registerShared():
+	Called for every element of a __shared__ array when it is constructed, to know which addresses are shared memory.
+*/
+inline void registerShared(const void* address, size_t size) {
+	Block* block = runningBlock;
+	if (block == nullptr || block->current < 0 || isKernelLocal((uintptr_t)address)) {
+		return;
+	}
+	uintptr_t begin = (uintptr_t)address;
+	bool starts = sharedArrayStarts;
+	sharedArrayStarts = false;
+	if (!starts && !staticSharedRanges.empty() && staticSharedRanges.back().end == begin) {
+		staticSharedRanges.back().end = begin + size;
+	}
+	else if (!isShared(begin)) {
+		AddressRange range = {begin, begin + size};
+		staticSharedRanges.push_back(range);
+	}
+}
+
+/*
+Float
+	float that counts its loads and stores. See "Memory access counting" above.
+*/
+struct Float {
+	float value;
+
+	Float() {
+		registerShared(this, sizeof(Float));
+	}
+	Float(float value) : value(value) {}
+	EMU_ALWAYS_INLINE Float(const Float& other) : value(other.load()) {}
+
+	EMU_ALWAYS_INLINE Float& operator=(const Float& other) {
+		store(other.load());
+		return *this;
+	}
+	EMU_ALWAYS_INLINE Float& operator=(float other) {
+		store(other);
+		return *this;
+	}
+	EMU_ALWAYS_INLINE operator float() const {
+		return load();
+	}
+
+	EMU_ALWAYS_INLINE Float& operator+=(float other) {
+		store(load() + other);
+		return *this;
+	}
+	EMU_ALWAYS_INLINE Float& operator-=(float other) {
+		store(load() - other);
+		return *this;
+	}
+	EMU_ALWAYS_INLINE Float& operator*=(float other) {
+		store(load() * other);
+		return *this;
+	}
+	EMU_ALWAYS_INLINE Float& operator/=(float other) {
+		store(load() / other);
+		return *this;
+	}
+
+	// never inlined, so the return address is the access in the kernel
+	EMU_NOINLINE float load() const {
+		recordAccess(this, false, (uintptr_t)__builtin_return_address(0));
+		return value;
+	}
+	EMU_NOINLINE void store(float other) {
+		recordAccess(this, true, (uintptr_t)__builtin_return_address(0));
+		value = other;
+	}
+};
+static_assert(sizeof(Float) == sizeof(float), "emu::Float must have the layout of float");
+
+template <typename T>
+T* dynamicShared() {
+	return reinterpret_cast<T*>(dynamicSharedMemory.data());
+}
+
+/*
+kernelArgument():
+	Pass an argument to a kernel parameter. float buffers are handed to kernels built with emu::Float as they are.
+*/
+template <typename Param, typename Arg>
+typename std::enable_if<std::is_convertible<Arg, Param>::value, Param>::type kernelArgument(Arg argument) {
+	return argument;
+}
+
+template <typename Param, typename Arg>
+typename std::enable_if<!std::is_convertible<Arg*, Param>::value && std::is_pointer<Param>::value &&
+	sizeof(Arg) == sizeof(typename std::remove_pointer<Param>::type), Param>::type kernelArgument(Arg* argument) {
+	return reinterpret_cast<Param>(argument);
+}
+
+static void fiberEntry() {
+	Block* block = runningBlock;
+	(*block->kernel)();
+	block->fibers[block->current].finished = true;
+	// return to the scheduler through uc_link
+}
+
+static void syncThreads() {
+	Block* block = runningBlock;
+	if (block == nullptr || block->current < 0) {
+		fprintf(stderr, "__syncthreads() called outside of a kernel\n");
+		abort();
+	}
+	swapcontext(&block->fibers[block->current].context, &block->scheduler);
+}
+
+static void setThreadIdx(int threadId) {
+	threadIdx.x = threadId % blockDim.x;
+	threadIdx.y = threadId / blockDim.x % blockDim.y;
+	threadIdx.z = threadId / (blockDim.x * blockDim.y);
+}
+
+/*
+runBlock():
+	Run all threads of the block at blockIdx to their end.
+*/
+static void runBlock(Block& block, const std::function<void()>& kernel, BlockStatistics& statistics) {
+	int threadNumber = blockDim.x * blockDim.y * blockDim.z;
+	if ((int)block.fibers.size() < threadNumber) {
+		block.fibers.resize(threadNumber);
+	}
+	block.kernel = &kernel;
+	block.current = -1;
+	block.statistics = &statistics;
+	block.recordShared = (int)block.blockId < recordedBlockNumber;
+	memset(&statistics, 0, sizeof(statistics));
+	statistics.blockIdx = blockIdx;
+
+	// shared memory does not survive from one block to the next
+	memset(dynamicSharedMemory.data(), 0xff, dynamicSharedMemory.size());
+	for (size_t i = 0; i < staticSharedRanges.size(); i++) {
+		memset((void*)staticSharedRanges[i].begin, 0xff, staticSharedRanges[i].end - staticSharedRanges[i].begin);
+	}
+
+	for (int i = 0; i < threadNumber; i++) {
+		Fiber& fiber = block.fibers[i];
+		fiber.stack.resize(fiberStackSize);
+		fiber.finished = false;
+		getcontext(&fiber.context);
+		fiber.context.uc_stack.ss_sp = fiber.stack.data();
+		fiber.context.uc_stack.ss_size = fiber.stack.size();
+		fiber.context.uc_link = &block.scheduler;
+		makecontext(&fiber.context, fiberEntry, 0);
+	}
+
+	// one round per barrier
+	bool running = true;
+	while (running) {
+		running = false;
+		for (int i = 0; i < threadNumber; i++) {
+			Fiber& fiber = block.fibers[i];
+			if (fiber.finished) {
+				continue;
+			}
+			block.current = i;
+			setThreadIdx(i);
+			swapcontext(&block.scheduler, &fiber.context);
+			running = running || !fiber.finished;
+		}
+		block.current = -1;
+		statistics.barriers += running;
+	}
+}
+
+/*
+launchKernel():
+	Run kernel(args...) for every thread of the grid, and return when all of them are done.
+*/
+template <typename... KernelArgs, typename... Args>
+void launchKernel(void (*kernel)(KernelArgs...), dim3 grid, dim3 block, size_t sharedBytes, Args... args) {
+	std::function<void()> body = [&]() { kernel(kernelArgument<KernelArgs>(args)...); };
+
+	Block* outerBlock = runningBlock;
+	Block state;
+	runningBlock = &state;
+	gridDim = grid;
+	blockDim = block;
+	dynamicSharedMemory.assign(sharedBytes, 0);
+
+	lastLaunch.gridSize = grid;
+	lastLaunch.blockSize = block;
+	lastLaunch.dynamicSharedBytes = sharedBytes;
+	lastLaunch.blocks.resize((size_t)grid.x * grid.y * grid.z);
+	lastLaunch.sharedAccesses.clear();
+
+	size_t blockId = 0;
+	for (unsigned int z = 0; z < grid.z; z++) {
+		for (unsigned int y = 0; y < grid.y; y++) {
+			for (unsigned int x = 0; x < grid.x; x++) {
+				blockIdx.x = x;
+				blockIdx.y = y;
+				blockIdx.z = z;
+				state.blockId = (unsigned int)blockId;
+				runBlock(state, body, lastLaunch.blocks[blockId++]);
+			}
+		}
+	}
+	lastLaunch.sharedArrays.resize(1);
+	lastLaunch.sharedArrays[0].begin = (uintptr_t)dynamicSharedMemory.data();
+	lastLaunch.sharedArrays[0].end = lastLaunch.sharedArrays[0].begin + dynamicSharedMemory.size();
+	lastLaunch.sharedArrays.insert(lastLaunch.sharedArrays.end(), staticSharedRanges.begin(), staticSharedRanges.end());
+	runningBlock = outerBlock;
+}
+
+/*
+printLaunchStatistics():
+	Print the memory accesses of the last launch, in total and per block if perBlock is set.
+*/
+inline void printLaunchStatistics(FILE* file, bool perBlock) {
+	const LaunchStatistics& statistics = lastLaunchStatistics();
+	BlockStatistics total = statistics.total();
+	long blockNumber = (long)statistics.blocks.size();
+
+	fprintf(file, "grid (%u, %u, %u), block (%u, %u, %u), dynamic shared memory %zu bytes\n",
+		statistics.gridSize.x, statistics.gridSize.y, statistics.gridSize.z,
+		statistics.blockSize.x, statistics.blockSize.y, statistics.blockSize.z, statistics.dynamicSharedBytes);
+	fprintf(file, "total           : shared loads %ld, shared stores %ld, global loads %ld, global stores %ld\n",
+		total.sharedLoads, total.sharedStores, total.globalLoads, total.globalStores);
+	if (blockNumber > 0) {
+		fprintf(file, "average per block: shared loads %ld, shared stores %ld, global loads %ld, global stores %ld, barriers %ld\n",
+			total.sharedLoads / blockNumber, total.sharedStores / blockNumber,
+			total.globalLoads / blockNumber, total.globalStores / blockNumber, total.barriers / blockNumber);
+	}
+	if (perBlock) {
+		for (size_t i = 0; i < statistics.blocks.size(); i++) {
+			const BlockStatistics& block = statistics.blocks[i];
+			fprintf(file, "block (%u, %u, %u): shared loads %ld, shared stores %ld, global loads %ld, global stores %ld, barriers %ld\n",
+				block.blockIdx.x, block.blockIdx.y, block.blockIdx.z,
+				block.sharedLoads, block.sharedStores, block.globalLoads, block.globalStores, block.barriers);
+		}
+	}
+}
+
+} // namespace emu
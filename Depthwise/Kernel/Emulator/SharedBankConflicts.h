@@ -0,0 +1,312 @@
+#pragma once
+#include <dlfcn.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "HipEmulator.h"
+/*
+LDS Bank Conflicts of an emulated launch
+
+Takes the shared memory access log of a launch (emu::recordSharedAccesses(), HipEmulator.h) and replays it
+wavefront by wavefront: the accesses of the lanes of a wavefront to one site in the kernel, in the same barrier
+phase and the same iteration (n-th execution of the site by each lane), are one LDS instruction. The lanes of an
+instruction are served lanesPerCycle at a time (a half wavefront on GCN); lanes that hit different words of the
+same bank are serialized, lanes that read the same word are served at once (broadcast). So one cycle group costs
+the largest number of different words any bank has to deliver, and the conflict degree of an instruction is its
+cycles over its conflict free cycles (1 lane group, 1 cycle).
+Executions are paired by count, so when some lanes skip a site inside a loop (lane dependent trip counts, e.g. the
+border pixels of Depthwise_NHWC) they are paired with later iterations of the other lanes, and the degree of that
+site is an upper bound.
+
+Padding search: an array (or the part of it from baseOffset on) seen as rows of pitch words is remapped to rows of
+pitch + padding words, for every padding from 0 to banks - 1, and the log is replayed again. suggestPadding()
+returns the smallest padding with the fewest cycles.
+*/
+
+namespace emu {
+
+/*
+BankModel
+	32 banks of 4 bytes, 32 lanes per cycle and 64 lane wavefronts, like the LDS of gfx9 (DCU, MI50 / MI100).
+*/
+struct BankModel {
+	int banks;
+	int bankBytes;
+	int lanesPerCycle;
+	int wavefrontSize;
+
+	BankModel() : banks(32), bankBytes(4), lanesPerCycle(32), wavefrontSize(64) {}
+};
+
+/*
+SharedArrayPadding
+	Remap of one array for the padding search: words from baseOffset (in bytes) on are rows of pitch words,
+	padded to pitch + padding. pitch 0 is no remap.
+*/
+struct SharedArrayPadding {
+	int array;
+	uint32_t baseOffset;
+	int pitch;
+	int padding;
+};
+
+/*
+SharedInstructionConflicts
+	One access site of the kernel, over all of its wavefront executions.
+*/
+struct SharedInstructionConflicts {
+	uintptr_t site;
+	int array;
+	bool isStore;
+	long executions;	// wavefront instructions
+	long cycles;
+	long idealCycles;	// cycles without bank conflicts
+	int maxDegree;		// worst lane group, 1 is conflict free
+
+	double degree() const {
+		return idealCycles > 0 ? (double)cycles / idealCycles : 1.0;
+	}
+};
+
+struct BankConflictReport {
+	std::vector<SharedInstructionConflicts> instructions;	// in the order of their first execution
+	long cycles;
+	long idealCycles;
+	int maxDegree;
+
+	double degree() const {
+		return idealCycles > 0 ? (double)cycles / idealCycles : 1.0;
+	}
+
+	// cycles and conflict free cycles of the instructions on one array
+	void arrayCycles(int array, long& arrayCycles, long& arrayIdealCycles) const {
+		arrayCycles = 0;
+		arrayIdealCycles = 0;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (instructions[i].array == array) {
+				arrayCycles += instructions[i].cycles;
+				arrayIdealCycles += instructions[i].idealCycles;
+			}
+		}
+	}
+};
+
+inline uint32_t sharedWordAddress(const SharedAccess& access, const BankModel& model, const SharedArrayPadding* padding) {
+	uint32_t word = access.offset / model.bankBytes;
+	if (padding != nullptr && padding->pitch > 0 && access.array == padding->array && access.offset >= padding->baseOffset) {
+		uint32_t base = padding->baseOffset / model.bankBytes;
+		uint32_t relative = word - base;
+		word = base + relative / padding->pitch * (padding->pitch + padding->padding) + relative % padding->pitch;
+	}
+	return word;
+}
+
+/*
+SharedInstructionTrace
+	The access log grouped into wavefront instructions: instances[i] are the accesses (indices into
+	LaunchStatistics::sharedAccesses) of one execution of the site instructions[instruction[i]].
+*/
+struct SharedInstructionTrace {
+	std::vector<SharedInstructionConflicts> instructions;	// in the order of their first execution, no cycles yet
+	std::vector<size_t> instruction;
+	std::vector<std::vector<size_t> > instances;
+};
+
+inline SharedInstructionTrace traceSharedInstructions(const LaunchStatistics& launch, const BankModel& model = BankModel()) {
+	typedef std::tuple<unsigned int, int, int, uintptr_t> ThreadKey;			// block, phase, thread, site
+	typedef std::tuple<unsigned int, int, int, uintptr_t, int> InstanceKey;	// block, phase, wavefront, site, execution
+
+	SharedInstructionTrace trace;
+	std::map<ThreadKey, int> executions;
+	std::map<InstanceKey, size_t> instanceOf;
+	std::map<uintptr_t, size_t> instructionOf;
+	for (size_t i = 0; i < launch.sharedAccesses.size(); i++) {
+		const SharedAccess& access = launch.sharedAccesses[i];
+		int execution = executions[ThreadKey(access.block, access.phase, access.thread, access.site)]++;
+		InstanceKey key(access.block, access.phase, access.thread / model.wavefrontSize, access.site, execution);
+		std::map<InstanceKey, size_t>::iterator it = instanceOf.find(key);
+		if (it == instanceOf.end()) {
+			std::map<uintptr_t, size_t>::iterator site = instructionOf.find(access.site);
+			if (site == instructionOf.end()) {
+				SharedInstructionConflicts instruction = { access.site, access.array, access.isStore, 0, 0, 0, 1 };
+				site = instructionOf.insert(std::make_pair(access.site, trace.instructions.size())).first;
+				trace.instructions.push_back(instruction);
+			}
+			it = instanceOf.insert(std::make_pair(key, trace.instances.size())).first;
+			trace.instruction.push_back(site->second);
+			trace.instances.push_back(std::vector<size_t>());
+		}
+		trace.instances[it->second].push_back(i);
+	}
+	return trace;
+}
+
+/*
+analyzeBankConflicts():
+	Replay the shared memory access log of a launch, see the top of the file.
+*/
+inline BankConflictReport analyzeBankConflicts(const LaunchStatistics& launch, const SharedInstructionTrace& trace,
+	const BankModel& model = BankModel(), const SharedArrayPadding* padding = nullptr) {
+
+	BankConflictReport report;
+	report.instructions = trace.instructions;
+	report.cycles = 0;
+	report.idealCycles = 0;
+	report.maxDegree = 1;
+
+	// per lane group, the most different words one bank serves
+	int groups = (model.wavefrontSize + model.lanesPerCycle - 1) / model.lanesPerCycle;
+	std::vector<std::vector<uint32_t> > bankWords(model.banks);
+	for (size_t i = 0; i < trace.instances.size(); i++) {
+		SharedInstructionConflicts& instruction = report.instructions[trace.instruction[i]];
+		const std::vector<size_t>& lanes = trace.instances[i];
+		instruction.executions++;
+		for (int group = 0; group < groups; group++) {
+			for (int b = 0; b < model.banks; b++) {
+				bankWords[b].clear();
+			}
+			bool active = false;
+			int degree = 0;
+			for (size_t l = 0; l < lanes.size(); l++) {
+				const SharedAccess& access = launch.sharedAccesses[lanes[l]];
+				if (access.thread % model.wavefrontSize / model.lanesPerCycle != group) {
+					continue;
+				}
+				active = true;
+				uint32_t word = sharedWordAddress(access, model, padding);
+				std::vector<uint32_t>& words = bankWords[word % model.banks];
+				bool seen = false;
+				for (size_t w = 0; w < words.size() && !seen; w++) {
+					seen = words[w] == word;
+				}
+				if (!seen) {
+					words.push_back(word);
+					degree = words.size() > (size_t)degree ? (int)words.size() : degree;
+				}
+			}
+			if (active) {
+				instruction.cycles += degree;
+				instruction.idealCycles++;
+				instruction.maxDegree = degree > instruction.maxDegree ? degree : instruction.maxDegree;
+			}
+		}
+	}
+	for (size_t i = 0; i < report.instructions.size(); i++) {
+		report.cycles += report.instructions[i].cycles;
+		report.idealCycles += report.instructions[i].idealCycles;
+		report.maxDegree = report.instructions[i].maxDegree > report.maxDegree ? report.instructions[i].maxDegree : report.maxDegree;
+	}
+	return report;
+}
+
+inline BankConflictReport analyzeBankConflicts(const LaunchStatistics& launch, const BankModel& model = BankModel()) {
+	return analyzeBankConflicts(launch, traceSharedInstructions(launch, model), model);
+}
+
+/*
+PaddingSuggestion
+	Cycles of the instructions on one array with its current layout and with the best padding of its rows.
+*/
+struct PaddingSuggestion {
+	int array;
+	int pitch;
+	int padding;		// words added to every row, 0 if the current pitch is already the best
+	long cycles;		// current layout
+	long paddedCycles;	// pitch + padding
+	long idealCycles;
+};
+
+/*
+suggestPadding():
+	Replay the log with the rows of array (from baseOffset on, pitch words each) padded by 0 .. banks - 1 words.
+*/
+inline PaddingSuggestion suggestPadding(const LaunchStatistics& launch, int array, uint32_t baseOffset, int pitch,
+	const BankModel& model = BankModel()) {
+
+	PaddingSuggestion suggestion = { array, pitch, 0, 0, 0, 0 };
+	SharedInstructionTrace trace = traceSharedInstructions(launch, model);
+	for (int padding = 0; padding < model.banks; padding++) {
+		SharedArrayPadding remap = { array, baseOffset, pitch, padding };
+		BankConflictReport report = analyzeBankConflicts(launch, trace, model, &remap);
+		long cycles, idealCycles;
+		report.arrayCycles(array, cycles, idealCycles);
+		if (padding == 0) {
+			suggestion.cycles = cycles;
+			suggestion.paddedCycles = cycles;
+			suggestion.idealCycles = idealCycles;
+		}
+		else if (cycles < suggestion.paddedCycles) {
+			suggestion.padding = padding;
+			suggestion.paddedCycles = cycles;
+		}
+	}
+	return suggestion;
+}
+
+/*
+sharedAccessSiteName():
+	"file:line" of a site through addr2line when the binary has debug information (-g), "+0x<offset>" in the
+	binary otherwise (for addr2line -e <binary> by hand).
+*/
+inline std::string sharedAccessSiteName(uintptr_t site) {
+	static std::map<uintptr_t, std::string> names;
+	std::map<uintptr_t, std::string>::iterator it = names.find(site);
+	if (it != names.end()) {
+		return it->second;
+	}
+
+	char text[512];
+	Dl_info info;
+	if (dladdr((void*)site, &info) == 0 || info.dli_fname == nullptr) {
+		snprintf(text, sizeof(text), "0x%llx", (unsigned long long)site);
+		return names[site] = text;
+	}
+	// the return address is the instruction after the call
+	unsigned long long offset = (unsigned long long)(site - 1 - (uintptr_t)info.dli_fbase);
+	snprintf(text, sizeof(text), "+0x%llx", offset);
+	std::string name = text;
+
+	char command[1024];
+	// -i: the Float operators are inlined into the kernel, the last line is the kernel
+	snprintf(command, sizeof(command), "addr2line -i -e '%s' 0x%llx 2>/dev/null", info.dli_fname, offset);
+	FILE* pipe = popen(command, "r");
+	if (pipe != nullptr) {
+		char line[512];
+		while (fgets(line, sizeof(line), pipe) != nullptr) {
+			if (strncmp(line, "??", 2) != 0) {
+				line[strcspn(line, " \r\n")] = '\0';
+				const char* slash = strrchr(line, '/');
+				name = slash != nullptr ? slash + 1 : line;
+			}
+		}
+		pclose(pipe);
+	}
+	return names[site] = name;
+}
+
+/*
+printBankConflicts():
+	Total conflict degree of the launch and, if perInstruction is set, every instruction.
+*/
+inline void printBankConflicts(FILE* file, const LaunchStatistics& launch, const BankConflictReport& report, bool perInstruction) {
+	fprintf(file, "LDS cycles %ld, conflict free %ld: %.2f x, worst %d-way\n",
+		report.cycles, report.idealCycles, report.degree(), report.maxDegree);
+	if (!perInstruction) {
+		return;
+	}
+	for (size_t i = 0; i < report.instructions.size(); i++) {
+		const SharedInstructionConflicts& instruction = report.instructions[i];
+		const AddressRange& range = launch.sharedArrays[instruction.array];
+		fprintf(file, "\t%-40s %-5s array %d (%6lu bytes) executions %6ld, %.2f x, worst %d-way\n",
+			sharedAccessSiteName(instruction.site).c_str(), instruction.isStore ? "store" : "load",
+			instruction.array, (unsigned long)(range.end - range.begin), instruction.executions,
+			instruction.degree(), instruction.maxDegree);
+	}
+}
+
+} // namespace emu
@@ -0,0 +1,23 @@
+#pragma once
+/*
+Stand-in for the HIP runtime header when the kernels are built for the host emulator (see HipEmulator.h).
+Only what the kernels of this project use is provided.
+*/
+#include "../HipEmulator.h"
+
+#define __global__
+#define __device__
+#define __host__
+#define __forceinline__ inline
+#define EMU_CONCAT_(a, b) a##b
+#define EMU_CONCAT(a, b) EMU_CONCAT_(a, b)
+#define __shared__ static thread_local emu::SharedArrayMarker EMU_CONCAT(emuSharedArrayMarker, __LINE__); static thread_local
+#define HIP_DYNAMIC_SHARED(type, var) type* var = emu::dynamicShared<type>();
+
+#define __syncthreads() emu::syncThreads()
+
+typedef void* hipStream_t;
+
+#define HIP_KERNEL_NAME(...) __VA_ARGS__
+#define hipLaunchKernelGGL(kernelName, numBlocks, numThreads, memPerBlock, streamId, ...) \
+	emu::launchKernel(kernelName, dim3(numBlocks), dim3(numThreads), memPerBlock, __VA_ARGS__)
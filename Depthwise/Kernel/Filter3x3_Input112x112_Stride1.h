@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -12,7 +13,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const float* input, const float*
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// filter is 3 x 3. 9 elements in total
 	__shared__ float filterData[9];
@@ -80,6 +81,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const float* input, const float*
 		(blockIdx.y / blockGroup) * outputHeight * outputWidth +
 		(blockIdx.y & 3) * (outputHeight / blockGroup) * outputWidth +
 		(threadIdx.x / outputWidth) * 14 * outputWidth + threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / inputWidth) * 14 * paddedWidth + threadIdx.x % inputWidth;
 	int inputAccessOffset = 0;
@@ -118,7 +120,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const float* input, const float*
 		sum1 = sum1 + filterData[5] * intemp2;
 		sum2 = sum2 + filterData[2] * intemp2;
 
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += outputWidth;
 
 		inputAccessOffset += paddedWidth;
@@ -135,7 +137,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const float* input, const float*
 		sum2 = sum2 + filterData[5] * intemp2;
 		sum0 = sum0 + filterData[2] * intemp2;
 
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += outputWidth;
 
 		inputAccessOffset += paddedWidth;
@@ -152,7 +154,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const float* input, const float*
 		sum0 = sum0 + filterData[5] * intemp2;
 		sum1 = sum1 + filterData[2] * intemp2;
 
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += outputWidth;
 	}
 
@@ -167,7 +169,7 @@ __global__ void Filter3x3_Input112x112_Stride1(const float* input, const float*
 	sum0 = sum0 + filterData[8] * intemp2;
 	sum1 = sum1 + filterData[5] * intemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += inputWidth;
 
 	inputAccessOffset += paddedWidth;
@@ -178,5 +180,5 @@ __global__ void Filter3x3_Input112x112_Stride1(const float* input, const float*
 	intemp2 = inputData[inputAccessBase + inputAccessOffset + 2];
 	sum1 = sum1 + filterData[8] * intemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 }
@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -11,7 +12,7 @@ __global__ void Filter3x3_Input56x56_Stride1(const float* input, const float* fi
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	__shared__ float filterData[9];	// filter is 3 x 3 = 9
 	__shared__ float inputData[58 * 58]; // original input is 56 x 56, padded to be 58 x 58.
@@ -57,6 +58,7 @@ __global__ void Filter3x3_Input56x56_Stride1(const float* input, const float* fi
 
 	// convolution
 	int outputIdx = inputLoadIdxBase + (threadIdx.x / inputWidth) * 14 * inputWidth + threadIdx.x % inputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	// 4 * 56 threads are separated to 4 groups.
 	// first group handles 1 - 14 row
@@ -110,7 +112,7 @@ __global__ void Filter3x3_Input56x56_Stride1(const float* input, const float* fi
 		sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 		sum2 = sum2 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += inputWidth;
 
 		inputAccessOffset += paddedWidth;
@@ -129,7 +131,7 @@ __global__ void Filter3x3_Input56x56_Stride1(const float* input, const float* fi
 		sum2 = sum2 + filterData[filterAccessBase + 5] * inTemp2;
 		sum0 = sum0 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += inputWidth;
 
 		inputAccessOffset += paddedWidth;
@@ -148,7 +150,7 @@ __global__ void Filter3x3_Input56x56_Stride1(const float* input, const float* fi
 		sum0 = sum0 + filterData[filterAccessBase + 5] * inTemp2;
 		sum1 = sum1 + filterData[filterAccessBase + 2] * inTemp2;
 
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += inputWidth;
 	}
 	inputAccessOffset += paddedWidth;
@@ -164,7 +166,7 @@ __global__ void Filter3x3_Input56x56_Stride1(const float* input, const float* fi
 	sum0 = sum0 + filterData[filterAccessBase + 8] * inTemp2;
 	sum1 = sum1 + filterData[filterAccessBase + 5] * inTemp2;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += inputWidth;
 
 	inputAccessOffset += paddedWidth;
@@ -177,5 +179,5 @@ __global__ void Filter3x3_Input56x56_Stride1(const float* input, const float* fi
 	inTemp2 = inputData[inputAccessBase + inputAccessOffset + 2];
 	sum1 = sum1 + filterData[filterAccessBase + 8] * inTemp2;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 }
@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -12,7 +13,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 32 channels is a group.
 	__shared__ float filterData[32 * 25];	// filter is 5 x 5 = 25
@@ -92,6 +93,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 		blockIdx.y * channelGroupSize * outputHeight * outputWidth +
 		(threadIdx.x / outputWidth) * outputHeight * outputWidth +
 		threadIdx.x % outputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / outputWidth) * paddedWidth * inputHeight + threadIdx.x % outputWidth * 2;
 	int filterAccessBase = (threadIdx.x / outputWidth) * filterHeight * filterWidth;
@@ -176,7 +178,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 4th row
@@ -235,7 +237,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 6th row
@@ -293,7 +295,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	sum2 = sum2 + filterData[filterAccessBase + 24] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 8th row
@@ -351,7 +353,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 10th row
@@ -410,7 +412,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 12th row
@@ -463,7 +465,7 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	sum2 = sum2 + filterData[filterAccessBase + 24] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += outputWidth;
 
 	// 14th row
@@ -485,6 +487,6 @@ __global__ void Filter5x5_Input14x14_Stride2(const float* input, const float* fi
 	inTemp4 = inputData[inputAccessBase + 4 + inputAccessOffset];
 	sum0 = sum0 + filterData[filterAccessBase + 19] * inTemp4;
 
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += outputWidth;
 }
@@ -1,3 +1,4 @@
+#include "DepthwiseEpilogue.h"
 /*
 Depthwise Convolution Kernel.
 
@@ -12,7 +13,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 	int filterLayerNumber, int filterHeight, int filterWidth,
 	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
 	int padding, int stride,
-	float alpha, float beta) {
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
 
 	// every 8 channels is a group.
 	__shared__ float filterData[8 * 25];	// filter is 5 x 5 = 25
@@ -80,6 +81,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 
 	// convolution
 	int outputIdx = inputLoadIdxBase + (threadIdx.x / inputWidth) * inputHeight * inputWidth + threadIdx.x % inputWidth;
+	DepthwiseChannelEpilogue channelEpilogue(epilogue, outputIdx / (outputHeight * outputWidth) % outputChannel);
 
 	int inputAccessBase = (threadIdx.x / inputWidth) * paddedWidth * inputHeight + threadIdx.x % inputWidth;
 	int filterAccessBase = (threadIdx.x / inputWidth) * filterHeight * filterWidth;
@@ -195,7 +197,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 		sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 		sum3 = sum3 + filterData[filterAccessBase + 9] * inTemp4;
 		sum4 = sum4 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum0 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 4th row
@@ -240,7 +242,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 		sum3 = sum3 + filterData[filterAccessBase + 14] * inTemp4;
 		sum4 = sum4 + filterData[filterAccessBase + 9] * inTemp4;
 		sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum1 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 5th row
@@ -286,7 +288,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 		sum0 = sum0 + filterData[filterAccessBase + 9] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
 
-		output[outputIdx] = sum2 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 6th row
@@ -331,7 +333,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 		sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 		sum1 = sum1 + filterData[filterAccessBase + 9] * inTemp4;
 		sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum3 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum3 * alpha + beta);
 		outputIdx += inputWidth;
 
 		// 7th row
@@ -376,7 +378,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 		sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 		sum2 = sum2 + filterData[filterAccessBase + 9] * inTemp4;
 		sum3 = sum3 + filterData[filterAccessBase + 4] * inTemp4;
-		output[outputIdx] = sum4 * alpha + beta;
+		output[outputIdx] = channelEpilogue.apply(sum4 * alpha + beta);
 		outputIdx += inputWidth;
 	}
 
@@ -416,7 +418,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
 	sum3 = sum3 + filterData[filterAccessBase + 9] * inTemp4;
 	sum4 = sum4 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 24th row
@@ -455,7 +457,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 	sum3 = sum3 + filterData[filterAccessBase + 14] * inTemp4;
 	sum4 = sum4 + filterData[filterAccessBase + 9] * inTemp4;
 	sum0 = sum0 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 25th row
@@ -495,7 +497,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 	sum0 = sum0 + filterData[filterAccessBase + 9] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 4] * inTemp4;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 26th row
@@ -534,7 +536,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 	sum0 = sum0 + filterData[filterAccessBase + 14] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 9] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 4] * inTemp4;
-	output[outputIdx] = sum3 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum3 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 27th row
@@ -568,7 +570,7 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 	sum0 = sum0 + filterData[filterAccessBase + 19] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 14] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 9] * inTemp4;
-	output[outputIdx] = sum4 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum4 * alpha + beta);
 	outputIdx += inputWidth;
 
 	// 28th row
@@ -597,12 +599,12 @@ __global__ void Filter5x5_Input28x28_Stride1(const float* input, const float* fi
 	sum0 = sum0 + filterData[filterAccessBase + 24] * inTemp4;
 	sum1 = sum1 + filterData[filterAccessBase + 19] * inTemp4;
 	sum2 = sum2 + filterData[filterAccessBase + 14] * inTemp4;
-	output[outputIdx] = sum0 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum0 * alpha + beta);
 	outputIdx += inputWidth;
 
-	output[outputIdx] = sum1 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum1 * alpha + beta);
 	outputIdx += inputWidth;
 
-	output[outputIdx] = sum2 * alpha + beta;
+	output[outputIdx] = channelEpilogue.apply(sum2 * alpha + beta);
 	outputIdx += inputWidth;
 }
@@ -0,0 +1,133 @@
+#pragma once
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+/*
+Pointwise Convolution Kernel.
+
+Case: any input size, any input and output channel number.
+
+The 1 x 1 convolution of one image is the GEMM output[outputChannel][H * W] = filter[outputChannel][inputChannel] x input[inputChannel][H * W].
+Each block computes a PixelTile x OutputChannelTile output tile and walks over the input channels InputChannelTile at a time,
+staging the input and filter blocks in shared memory.
+Each thread computes 4 pixels x 4 output channels, 16 pixels / 16 output channels apart so the loads and stores of
+neighbouring threads are consecutive.
+
+Grid:
+	gridDim.x - output tiles of PixelTile pixels (output plane flattened)
+	gridDim.y - output channel / OutputChannelTile
+	gridDim.z - batch
+	blockDim.x - (PixelTile / 4) * (OutputChannelTile / 4)
+*/
+template <typename scalar_t, int PixelTile, int OutputChannelTile, int InputChannelTile>
+__global__ void Pointwise_Tiled(const scalar_t* __restrict__ input, const scalar_t* __restrict__ filter, scalar_t* __restrict__ output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int outputChannel,
+	float alpha, float beta, DepthwiseEpilogue epilogue) {
+
+	const int pixelThreads = PixelTile / 4;
+	const int threadNumber = (PixelTile / 4) * (OutputChannelTile / 4);
+
+	__shared__ float inputTile[InputChannelTile * PixelTile];
+	__shared__ float filterTile[InputChannelTile * OutputChannelTile];	// transposed, [input channel][output channel]
+
+	int batch = blockIdx.z;
+	int planeSize = inputHeight * inputWidth;
+	int firstPixel = blockIdx.x * PixelTile;
+	int firstOutputChannel = blockIdx.y * OutputChannelTile;
+	int pixelInTile = threadIdx.x % pixelThreads;
+	int channelInTile = threadIdx.x / pixelThreads;
+
+	const scalar_t* inputImage = input + (size_t)batch * inputChannel * planeSize;
+
+	float sum[4][4];
+	#pragma unroll
+	for (int i = 0; i < 4; i++) {
+		#pragma unroll
+		for (int j = 0; j < 4; j++) {
+			sum[i][j] = 0.0f;
+		}
+	}
+
+	for (int firstInputChannel = 0; firstInputChannel < inputChannel; firstInputChannel += InputChannelTile) {
+		for (int i = threadIdx.x; i < InputChannelTile * PixelTile; i += threadNumber) {
+			int inputChannelIdx = firstInputChannel + i / PixelTile;
+			int pixel = firstPixel + i % PixelTile;
+			float value = 0.0f;
+			if (inputChannelIdx < inputChannel && pixel < planeSize) {
+				value = inputImage[(size_t)inputChannelIdx * planeSize + pixel];
+			}
+			inputTile[i] = value;
+		}
+		for (int i = threadIdx.x; i < InputChannelTile * OutputChannelTile; i += threadNumber) {
+			int outputChannelIdx = firstOutputChannel + i / InputChannelTile;
+			int inputChannelIdx = firstInputChannel + i % InputChannelTile;
+			float weight = 0.0f;
+			if (outputChannelIdx < outputChannel && inputChannelIdx < inputChannel) {
+				weight = filter[(size_t)outputChannelIdx * inputChannel + inputChannelIdx];
+			}
+			filterTile[(i % InputChannelTile) * OutputChannelTile + i / InputChannelTile] = weight;
+		}
+		__syncthreads();
+
+		#pragma unroll
+		for (int ci = 0; ci < InputChannelTile; ci++) {
+			float inTemp[4];
+			float weightTemp[4];
+			#pragma unroll
+			for (int j = 0; j < 4; j++) {
+				inTemp[j] = inputTile[ci * PixelTile + pixelInTile + j * pixelThreads];
+				weightTemp[j] = filterTile[ci * OutputChannelTile + channelInTile + j * (OutputChannelTile / 4)];
+			}
+			#pragma unroll
+			for (int i = 0; i < 4; i++) {
+				#pragma unroll
+				for (int j = 0; j < 4; j++) {
+					sum[i][j] = sum[i][j] + weightTemp[i] * inTemp[j];
+				}
+			}
+		}
+		__syncthreads();
+	}
+
+	#pragma unroll
+	for (int i = 0; i < 4; i++) {
+		int outputChannelIdx = firstOutputChannel + channelInTile + i * (OutputChannelTile / 4);
+		if (outputChannelIdx >= outputChannel) {
+			continue;
+		}
+		DepthwiseChannelEpilogue channelEpilogue(epilogue, outputChannelIdx);
+		#pragma unroll
+		for (int j = 0; j < 4; j++) {
+			int pixel = firstPixel + pixelInTile + j * pixelThreads;
+			if (pixel < planeSize) {
+				output[((size_t)batch * outputChannel + outputChannelIdx) * planeSize + pixel] = channelEpilogue.apply(sum[i][j] * alpha + beta);
+			}
+		}
+	}
+}
+
+/*
+launchPointwise():
+	Launch Pointwise_Tiled with 64 pixel x 64 output channel tiles (256 threads) and 16 input channels per step.
+*/
+template <typename scalar_t>
+void launchPointwise(const scalar_t* input, const scalar_t* filter, scalar_t* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int outputChannel,
+	float alpha, float beta, DepthwiseEpilogue epilogue, hipStream_t stream = 0) {
+
+	const int pixelTile = 64;
+	const int outputChannelTile = 64;
+	const int inputChannelTile = 16;
+
+	dim3 gridSize((inputHeight * inputWidth + pixelTile - 1) / pixelTile,
+		(outputChannel + outputChannelTile - 1) / outputChannelTile, inputBatchNumber);
+	dim3 blockSize((pixelTile / 4) * (outputChannelTile / 4));
+
+	hipLaunchKernelGGL(HIP_KERNEL_NAME(Pointwise_Tiled<scalar_t, pixelTile, outputChannelTile, inputChannelTile>),
+		gridSize, blockSize, 0, stream,
+		input, filter, output,
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		outputChannel,
+		alpha, beta, epilogue);
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include <hip/hip_runtime.h>
+
+#define float emu::Float
+#include "Depthwise_Backward.h"
+#undef float
+
+#include "CPU_DepthwiseBackward.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the depthwise convolution backward.
+
+CPU_DepthwiseBackward() and Depthwise_Backward (run through the emulator) against plain loops, asking for
+both gradients, grad_input only and grad_weight only.
+The grad_input pass must write every input gradient exactly once.
+*/
+
+static bool checkValues(const char* name, const char* gradient, const std::vector<float>& values, const std::vector<double>& expected,
+	int inputChannel, int inputHeight, int inputWidth, int filterHeight, int stride, int dilation) {
+
+	for (size_t i = 0; i < values.size(); i++) {
+		if (!(std::fabs(values[i] - expected[i]) <= 1e-3 * (1.0 + std::fabs(expected[i])))) {
+			printf("Wrong! %s %s (C = %d, H = %d, W = %d, filter %d, stride %d, dilation %d): %d is %f, expected %f\n",
+				name, gradient, inputChannel, inputHeight, inputWidth, filterHeight, stride, dilation,
+				(int)i, values[i], expected[i]);
+			failures++;
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+checkBackward():
+	Run one shape. emulate - also run Depthwise_Backward, only for small shapes
+*/
+static void checkBackward(int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int stride, int padding, int dilation, bool emulate) {
+
+	int extent = (filterHeight - 1) * dilation + 1;
+	int outputHeight = (inputHeight + 2 * padding - extent) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - extent) / stride + 1;
+	int filterSize = filterHeight * filterHeight;
+
+	std::vector<float> input((size_t)inputBatchNumber * inputChannel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)inputChannel * filterSize);
+	std::vector<float> gradOutput((size_t)inputBatchNumber * inputChannel * outputHeight * outputWidth);
+
+	std::mt19937 generator(inputChannel * 1000 + inputHeight * 10 + filterHeight);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(gradOutput, generator);
+
+	std::vector<double> expectedInput(input.size(), 0.0);
+	std::vector<double> expectedFilter(filter.size(), 0.0);
+	for (int n = 0; n < inputBatchNumber; n++) {
+		for (int c = 0; c < inputChannel; c++) {
+			size_t planeIdx = (size_t)n * inputChannel + c;
+			for (int y = 0; y < outputHeight; y++) {
+				for (int x = 0; x < outputWidth; x++) {
+					double grad = gradOutput[(planeIdx * outputHeight + y) * outputWidth + x];
+					for (int ky = 0; ky < filterHeight; ky++) {
+						for (int kx = 0; kx < filterHeight; kx++) {
+							int inputY = y * stride - padding + ky * dilation;
+							int inputX = x * stride - padding + kx * dilation;
+							if (inputY < 0 || inputY >= inputHeight || inputX < 0 || inputX >= inputWidth) {
+								continue;
+							}
+							size_t inputIdx = (planeIdx * inputHeight + inputY) * inputWidth + inputX;
+							expectedInput[inputIdx] += grad * filter[(size_t)c * filterSize + ky * filterHeight + kx];
+							expectedFilter[(size_t)c * filterSize + ky * filterHeight + kx] += grad * input[inputIdx];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<float> gradInput(input.size());
+	std::vector<float> gradFilter(filter.size());
+	std::vector<float> workspace(depthwiseBackwardWorkspaceSize(inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterHeight, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation));
+
+	const char* names[] = { "CPU_DepthwiseBackward", "Depthwise_Backward" };
+	for (int run = 0; run < (emulate ? 2 : 1); run++) {
+		// both gradients, grad_input only, grad_weight only
+		for (int mode = 0; mode < 3; mode++) {
+			std::fill(gradInput.begin(), gradInput.end(), NAN);
+			std::fill(gradFilter.begin(), gradFilter.end(), NAN);
+			float* gradInputData = mode != 2 ? gradInput.data() : nullptr;
+			float* gradFilterData = mode != 1 ? gradFilter.data() : nullptr;
+
+			if (run == 0) {
+				CPU_DepthwiseBackward(gradOutput.data(), input.data(), filter.data(), gradInputData, gradFilterData,
+					inputBatchNumber, inputChannel, inputHeight, inputWidth,
+					filterHeight, filterHeight, outputHeight, outputWidth,
+					padding, padding, stride, stride, dilation, dilation);
+			}
+			else {
+				launchDepthwiseBackward(reinterpret_cast<const emu::Float*>(gradOutput.data()),
+					reinterpret_cast<const emu::Float*>(input.data()),
+					reinterpret_cast<const emu::Float*>(filter.data()),
+					reinterpret_cast<emu::Float*>(gradInputData), reinterpret_cast<emu::Float*>(gradFilterData),
+					reinterpret_cast<emu::Float*>(workspace.data()),
+					inputBatchNumber, inputChannel, inputHeight, inputWidth,
+					filterHeight, filterHeight, outputHeight, outputWidth,
+					padding, padding, stride, stride, dilation, dilation);
+
+				emu::BlockStatistics total = emu::lastLaunchStatistics().total();
+				if (mode == 1 && total.globalStores != (long)gradInput.size()) {
+					printf("Wrong! %s: %ld global stores for %d input gradients\n", names[run], total.globalStores, (int)gradInput.size());
+					failures++;
+				}
+			}
+
+			if (gradInputData != nullptr) {
+				checkValues(names[run], "grad_input", gradInput, expectedInput,
+					inputChannel, inputHeight, inputWidth, filterHeight, stride, dilation);
+			}
+			if (gradFilterData != nullptr) {
+				checkValues(names[run], "grad_weight", gradFilter, expectedFilter,
+					inputChannel, inputHeight, inputWidth, filterHeight, stride, dilation);
+			}
+		}
+	}
+}
+
+int main() {
+	// emulated, odd sizes, several bands per plane, dilation
+	checkBackward(2, 3, 20, 20, 3, 1, 1, 1, true);
+	checkBackward(3, 2, 15, 13, 5, 2, 2, 1, true);
+	checkBackward(1, 2, 14, 14, 3, 2, 1, 1, true);
+	checkBackward(2, 2, 50, 30, 3, 1, 2, 2, true);
+	checkBackward(1, 1, 40, 64, 5, 1, 2, 1, true);
+	// rows too wide for shared memory, read from global memory
+	checkBackward(1, 1, 4, 1700, 5, 1, 2, 1, true);
+
+	// CPU only, the shapes of the kernel set
+	const int layerConfigs[][4] = {	// input height / width, filter, stride, channel
+		{112, 3, 1, 32}, {112, 3, 2, 96}, {56, 3, 1, 144}, {56, 3, 2, 144}, {28, 3, 1, 192}, {28, 3, 2, 192},
+		{14, 3, 1, 384}, {14, 3, 2, 576}, {7, 3, 1, 960}, {56, 5, 2, 144}, {28, 5, 1, 240}, {14, 5, 1, 480},
+		{14, 5, 2, 480}, {7, 5, 1, 1152} };
+	const int layerNumber = sizeof(layerConfigs) / sizeof(layerConfigs[0]);
+	for (int i = 0; i < layerNumber; i++) {
+		int filterHeight = layerConfigs[i][1];
+		checkBackward(2, layerConfigs[i][3] / 8, layerConfigs[i][0], layerConfigs[i][0],
+			filterHeight, layerConfigs[i][2], (filterHeight - 1) / 2, 1, false);
+	}
+	// dilated layers of DeepLab style backbones (SIMD row kernels for the grad_input correlation)
+	checkBackward(1, 4, 33, 33, 3, 1, 4, 4, false);
+	checkBackward(2, 2, 65, 65, 5, 1, 4, 2, false);
+
+	return testResult("Depthwise convolution backward");
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include "EmulatedDepthwiseKernels.h"
+#include "SharedBankConflicts.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the shared memory access log of the emulator and the LDS bank conflict analysis
+(Emulator/SharedBankConflicts.h).
+
+Small kernels with known patterns: consecutive words, strides 2 and 32, broadcast, a column of a 32 word wide
+tile (and the padding that removes its conflicts), a loop (one instruction per iteration), a divergent branch,
+two barrier phases and two __shared__ arrays next to each other. Then every registry kernel: its log holds
+exactly the shared memory accesses the statistics count.
+*/
+
+// 4 words of shared memory per thread, read at threadIdx.x * stride (stride 0: all threads read word 0)
+__global__ void StridedRead(emu::Float* output, int stride) {
+	__shared__ emu::Float data[64 * 32];
+	for (int i = 0; i < 32; i++) {
+		data[threadIdx.x * 32 + i] = (float)i;
+	}
+	__syncthreads();
+	output[threadIdx.x] = data[(threadIdx.x * stride) % (64 * 32)];
+}
+
+// A column of a 32 x 64 tile, pitch 32 words; then a loop over 3 rows
+__global__ void ColumnRead(emu::Float* output) {
+	__shared__ emu::Float tile[64 * 32];
+	tile[threadIdx.x] = 1.0f;
+	__syncthreads();
+	float sum = tile[threadIdx.x * 32];
+	for (int row = 0; row < 3; row++) {
+		sum += tile[row * 32 + threadIdx.x % 32];
+	}
+	output[threadIdx.x] = sum;
+}
+
+// Every other lane stores; two arrays declared next to each other
+__global__ void DivergentStore(emu::Float* output) {
+	__shared__ emu::Float first[128];
+	__shared__ emu::Float second[128];
+	if (threadIdx.x % 2 == 0) {
+		first[threadIdx.x] = 1.0f;
+	}
+	second[threadIdx.x] = 2.0f;
+	__syncthreads();
+	float broadcast = first[0];
+	output[threadIdx.x] = broadcast + second[threadIdx.x];
+}
+
+static const emu::SharedInstructionConflicts* findInstruction(const emu::BankConflictReport& report, size_t index) {
+	return index < report.instructions.size() ? &report.instructions[index] : nullptr;
+}
+
+static void testPatterns() {
+	std::vector<float> output(128);
+	emu::recordSharedAccesses(1);
+
+	// stride 1: conflict free; stride 2: 2 words per bank; stride 32: one bank; stride 0: broadcast
+	const int strides[] = { 1, 2, 32, 0 };
+	const int degrees[] = { 1, 2, 32, 1 };
+	for (int s = 0; s < 4; s++) {
+		hipLaunchKernelGGL(StridedRead, dim3(2), dim3(64), 0, 0, output.data(), strides[s]);
+		emu::BankConflictReport report = emu::analyzeBankConflicts(emu::lastLaunchStatistics());
+		// the store loop (32 iterations, stride 32: 32-way) and the read; only the first block is recorded
+		EXPECT(report.instructions.size() == 2);
+		const emu::SharedInstructionConflicts* store = findInstruction(report, 0);
+		const emu::SharedInstructionConflicts* load = findInstruction(report, 1);
+		if (store == nullptr || load == nullptr) {
+			continue;
+		}
+		EXPECT(store->isStore && store->executions == 32 && store->maxDegree == 32 && store->idealCycles == 64);
+		if (!(!load->isStore && load->executions == 1 && load->idealCycles == 2 && load->maxDegree == degrees[s] &&
+			load->cycles == 2 * degrees[s])) {
+			printf("Wrong! stride %d: %ld cycles, worst %d-way, expected %d-way\n", strides[s], load->cycles,
+				load->maxDegree, degrees[s]);
+			failures++;
+		}
+	}
+
+	// the column of the tile is 32-way; pitch 33 makes it conflict free, the loop over the rows does not care
+	hipLaunchKernelGGL(ColumnRead, dim3(1), dim3(64), 0, 0, output.data());
+	const emu::LaunchStatistics& launch = emu::lastLaunchStatistics();
+	emu::BankConflictReport report = emu::analyzeBankConflicts(launch);
+	EXPECT(report.instructions.size() == 3);
+	if (report.instructions.size() == 3) {
+		EXPECT(report.instructions[1].maxDegree == 32 && report.instructions[1].executions == 1);
+		EXPECT(report.instructions[2].executions == 3 && report.instructions[2].degree() == 1.0);
+		int array = report.instructions[1].array;
+		emu::PaddingSuggestion suggestion = emu::suggestPadding(launch, array, 0, 32);
+		EXPECT(suggestion.padding == 1);
+		EXPECT(suggestion.cycles == report.cycles && suggestion.paddedCycles == suggestion.idealCycles);
+	}
+
+	// half of the lanes store: one instruction, 16 lanes per lane group; two arrays
+	hipLaunchKernelGGL(DivergentStore, dim3(1), dim3(128), 0, 0, output.data());
+	report = emu::analyzeBankConflicts(emu::lastLaunchStatistics());
+	EXPECT(report.instructions.size() == 4);
+	if (report.instructions.size() == 4) {
+		// 2 wavefronts, 2 lane groups each
+		EXPECT(report.instructions[0].executions == 2 && report.instructions[0].idealCycles == 4 && report.instructions[0].cycles == 4);
+		EXPECT(report.instructions[0].array != report.instructions[1].array);
+		EXPECT(report.instructions[2].array == report.instructions[0].array && report.instructions[2].maxDegree == 1);
+	}
+	// the log of the second phase follows the one of the first
+	const std::vector<emu::SharedAccess>& accesses = emu::lastLaunchStatistics().sharedAccesses;
+	EXPECT(accesses.size() == 64 + 128 + 128 + 128);
+	EXPECT(!accesses.empty() && accesses.front().phase == 0 && accesses.back().phase == 1);
+
+	emu::recordSharedAccesses(0);
+	hipLaunchKernelGGL(DivergentStore, dim3(1), dim3(128), 0, 0, output.data());
+	EXPECT(emu::lastLaunchStatistics().sharedAccesses.empty());
+}
+
+// Every registry kernel on its shape: one block recorded, every access logged once
+static void testRegistryKernels() {
+	const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+	for (size_t i = 0; i < entries.size(); i++) {
+		const DepthwiseKernelEntry& entry = entries[i];
+		const ConvShape& shape = entry.shape;
+		int channel = entry.channelGroupSize;
+		std::vector<float> input((size_t)channel * shape.inputHeight * shape.inputWidth, 1.0f);
+		std::vector<float> filter((size_t)channel * shape.filterHeight * shape.filterWidth, 1.0f);
+		std::vector<float> output((size_t)channel * shape.outputHeight() * shape.outputWidth());
+
+		emu::recordSharedAccesses(1);
+		hipLaunchKernelGGL(emulatedDepthwiseKernels[entry.id], dim3(1, entry.gridHeight(channel)), dim3(entry.blockSize, 1), 0, 0,
+			input.data(), filter.data(), output.data(),
+			1, channel, shape.inputHeight, shape.inputWidth,
+			channel, shape.filterHeight, shape.filterWidth,
+			1, channel, shape.outputHeight(), shape.outputWidth(),
+			shape.paddingHeight, shape.strideHeight,
+			1.0f, 0.0f, depthwiseNoEpilogue);
+		emu::recordSharedAccesses(0);
+
+		const emu::LaunchStatistics& launch = emu::lastLaunchStatistics();
+		const emu::BlockStatistics& block = launch.blocks[0];
+		emu::BankConflictReport report = emu::analyzeBankConflicts(launch);
+		long loads = 0;
+		for (size_t a = 0; a < launch.sharedAccesses.size(); a++) {
+			loads += !launch.sharedAccesses[a].isStore;
+		}
+		if ((long)launch.sharedAccesses.size() != block.sharedLoads + block.sharedStores || loads != block.sharedLoads ||
+			report.instructions.empty() || report.cycles < report.idealCycles) {
+			printf("Wrong! %s: %d accesses logged, %ld counted, %ld cycles, %ld conflict free\n", entry.name,
+				(int)launch.sharedAccesses.size(), block.sharedLoads + block.sharedStores, report.cycles, report.idealCycles);
+			failures++;
+		}
+	}
+}
+
+int main() {
+	testPatterns();
+	testRegistryKernels();
+
+	return testResult("LDS bank conflict analysis");
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <random>
+
+#include "DepthwiseBenchmark.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the benchmark harness: shape parsing, statistics and the numbers derived from them (throughput,
+max error). The parallel reference (referenceDepthwiseConvolution()) against a plain loop, bit for bit, with padding,
+stride and dilation.
+*/
+
+static void testShapes() {
+	DepthwiseBenchmarkShape shape;
+	EXPECT(parseDepthwiseBenchmarkShape("8,32,112,3,1", shape));
+	EXPECT(shape.batch == 8 && shape.channel == 32 && shape.height == 112 && shape.width == 112 && shape.filter == 3 && shape.stride == 1);
+	EXPECT(shape.outputHeight() == 112 && shape.outputWidth() == 112);
+
+	EXPECT(parseDepthwiseBenchmarkShape("1 144 56 40 5 2\n", shape));
+	EXPECT(shape.height == 56 && shape.width == 40 && shape.filter == 5 && shape.stride == 2);
+	EXPECT(shape.padding() == 2 && shape.outputHeight() == 28 && shape.outputWidth() == 20);
+
+	EXPECT(parseDepthwiseBenchmarkShape("1,16,14,3,2 # comment", shape));
+
+	EXPECT(!parseDepthwiseBenchmarkShape("1,16,14,3", shape));
+	EXPECT(!parseDepthwiseBenchmarkShape("1,16,14,14,3,1,1", shape));
+	EXPECT(!parseDepthwiseBenchmarkShape("1,16,0,3,1", shape));
+	EXPECT(!parseDepthwiseBenchmarkShape("1,16,x,3,1", shape));
+	EXPECT(!parseDepthwiseBenchmarkShape("1,16,1,4,1", shape));	// padded input smaller than the filter
+
+	// 2 flops per tap, 4 bytes per input / filter / output value
+	EXPECT(parseDepthwiseBenchmarkShape("2,4,8,3,1", shape));
+	EXPECT(shape.flops() == 2.0 * 2 * 4 * 8 * 8 * 9);
+	EXPECT(shape.bytes() == 4.0 * (2 * 4 * 8 * 8 + 4 * 9 + 2 * 4 * 8 * 8));
+}
+
+static void testStatistics() {
+	std::vector<double> samples;
+	for (int i = 100; i >= 1; i--) {
+		samples.push_back(i);
+	}
+	BenchmarkStatistics statistics = benchmarkStatistics(samples);
+	EXPECT(statistics.samples == 100);
+	EXPECT(statistics.min == 1.0 && statistics.max == 100.0);
+	EXPECT(statistics.median == 50.5);
+	EXPECT(statistics.mean == 50.5);
+	EXPECT(statistics.p95 == 95.0);
+	EXPECT(statistics.p99 == 99.0);
+
+	samples.assign(1, 7.0);
+	statistics = benchmarkStatistics(samples);
+	EXPECT(statistics.min == 7.0 && statistics.median == 7.0 && statistics.p95 == 7.0 && statistics.p99 == 7.0);
+
+	const double odd[] = { 3.0, 1.0, 2.0, 10.0, 4.0 };
+	statistics = benchmarkStatistics(std::vector<double>(odd, odd + 5));
+	EXPECT(statistics.median == 3.0 && statistics.p95 == 10.0 && statistics.p99 == 10.0);
+
+	statistics = benchmarkStatistics(std::vector<double>());
+	EXPECT(statistics.samples == 0 && statistics.median == 0.0);
+
+	// 1 GFLOP in 1000 us is 1000 GFLOP/s
+	DepthwiseBenchmarkResult result;
+	parseDepthwiseBenchmarkShape("1,1,8,3,1", result.shape);
+	result.time = benchmarkStatistics(std::vector<double>(1, 1.0));
+	EXPECT(std::fabs(result.gflops() - result.shape.flops() / 1e3) < 1e-9);
+	EXPECT(std::fabs(result.gbps() - result.shape.bytes() / 1e3) < 1e-9);
+
+	// relative to 1 + |reference|, NaN wins
+	const float reference[] = { 0.0f, 3.0f, -1.0f };
+	const float output[] = { 0.5f, 3.0f, -2.0f };
+	EXPECT(depthwiseBenchmarkError(output, reference, 3) == 0.5);
+	EXPECT(depthwiseBenchmarkError(reference, reference, 3) == 0.0);
+	const float wrong[] = { 0.0f, NAN, -1.0f };
+	EXPECT(std::isnan(depthwiseBenchmarkError(wrong, reference, 3)));
+}
+
+/*
+plainDepthwise():
+	One output at a time, every tap bounds checked, in double.
+*/
+static void plainDepthwise(const std::vector<float>& input, const std::vector<float>& filter, std::vector<float>& output,
+	int batch, int channel, int inputHeight, int inputWidth, int filterHeight, int filterWidth, int outputHeight, int outputWidth,
+	int paddingHeight, int paddingWidth, int strideHeight, int strideWidth, int dilationHeight, int dilationWidth) {
+
+	for (int n = 0; n < batch; n++) {
+		for (int c = 0; c < channel; c++) {
+			for (int y = 0; y < outputHeight; y++) {
+				for (int x = 0; x < outputWidth; x++) {
+					double sum = 0.0;
+					for (int ky = 0; ky < filterHeight; ky++) {
+						int inputY = y * strideHeight - paddingHeight + ky * dilationHeight;
+						for (int kx = 0; kx < filterWidth; kx++) {
+							int inputX = x * strideWidth - paddingWidth + kx * dilationWidth;
+							if (inputY >= 0 && inputY < inputHeight && inputX >= 0 && inputX < inputWidth) {
+								sum += (double)filter[(c * filterHeight + ky) * filterWidth + kx]
+									* input[(((size_t)n * channel + c) * inputHeight + inputY) * inputWidth + inputX];
+							}
+						}
+					}
+					output[(((size_t)n * channel + c) * outputHeight + y) * outputWidth + x] = (float)sum;
+				}
+			}
+		}
+	}
+}
+
+static void checkReference(int batch, int channel, int inputHeight, int inputWidth, int filterHeight, int filterWidth,
+	int padding, int stride, int dilation) {
+
+	int outputHeight = (inputHeight + 2 * padding - (filterHeight - 1) * dilation - 1) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - (filterWidth - 1) * dilation - 1) / stride + 1;
+	std::mt19937 generator(inputHeight * 100 + inputWidth + stride);
+	std::vector<float> input((size_t)batch * channel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)channel * filterHeight * filterWidth);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+
+	size_t outputSize = (size_t)batch * channel * outputHeight * outputWidth;
+	std::vector<float> expected(outputSize), output(outputSize, NAN);
+	plainDepthwise(input, filter, expected, batch, channel, inputHeight, inputWidth, filterHeight, filterWidth,
+		outputHeight, outputWidth, padding, padding, stride, stride, dilation, dilation);
+	referenceDepthwiseConvolution(input.data(), filter.data(), output.data(), batch, channel, inputHeight, inputWidth,
+		filterHeight, filterWidth, outputHeight, outputWidth, padding, padding, stride, stride, dilation, dilation);
+	if (output != expected) {
+		printf("Wrong! reference %dx%dx%dx%d filter %dx%d padding %d stride %d dilation %d\n", batch, channel,
+			inputHeight, inputWidth, filterHeight, filterWidth, padding, stride, dilation);
+		failures++;
+	}
+}
+
+static void testReference() {
+	checkReference(2, 3, 14, 14, 3, 3, 1, 1, 1);
+	checkReference(1, 4, 15, 17, 5, 5, 2, 2, 1);
+	checkReference(3, 2, 12, 9, 3, 5, 1, 3, 1);
+	checkReference(1, 2, 20, 20, 3, 3, 2, 1, 2);
+	checkReference(1, 2, 21, 18, 3, 3, 4, 2, 4);
+	// padding larger than the filter, input narrower than the filter
+	checkReference(1, 1, 4, 2, 5, 5, 6, 1, 1);
+	checkReference(1, 2, 7, 7, 1, 1, 0, 2, 1);
+
+	// the benchmark shape goes through the same reference
+	DepthwiseBenchmarkShape shape;
+	EXPECT(parseDepthwiseBenchmarkShape("2,3,9,11,5,2", shape));
+	std::vector<float> input(shape.inputSize()), filter(shape.filterSize());
+	for (size_t i = 0; i < input.size(); i++) {
+		input[i] = (float)(i % 13) - 6.0f;
+	}
+	for (size_t i = 0; i < filter.size(); i++) {
+		filter[i] = (float)(i % 7) * 0.25f;
+	}
+	std::vector<float> expected(shape.outputSize()), output(shape.outputSize(), NAN);
+	plainDepthwise(input, filter, expected, shape.batch, shape.channel, shape.height, shape.width, shape.filter, shape.filter,
+		shape.outputHeight(), shape.outputWidth(), shape.padding(), shape.padding(), shape.stride, shape.stride, 1, 1);
+	referenceDepthwise(shape, input.data(), filter.data(), output.data());
+	EXPECT(output == expected);
+}
+
+int main() {
+	testShapes();
+	testStatistics();
+	testReference();
+
+	return testResult("Benchmark harness");
+}
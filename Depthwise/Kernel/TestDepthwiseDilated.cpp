@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include "EmulatedDepthwiseKernels.h"
+#include "CPU_Depthwise.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the dilated (atrous) depthwise convolution.
+
+Depthwise_Dilated (run through the emulator) and the dilated SIMD row kernels of the CPU backend against plain
+loops, 3 x 3 and 5 x 5 filters with dilation 2 and 4 on the feature map sizes of DeepLab style backbones, with
+the fused epilogue. Depthwise_Dilated must stage every input of its receptive field exactly once per block, read
+K + 3 field rows per thread from shared memory and write every output exactly once; shapes it does not support go
+to Depthwise_Generic.
+*/
+
+/*
+referenceDepthwise():
+	Plain loops in double, "same" padding dilation * (filterSize - 1) / 2, stride 1, then the epilogue.
+*/
+static std::vector<float> referenceDepthwise(const std::vector<float>& input, const std::vector<float>& filter,
+	int batch, int channel, int height, int width, int filterSize, int dilation, const DepthwiseEpilogue& epilogue) {
+
+	int padding = dilation * (filterSize - 1) / 2;
+	std::vector<float> output((size_t)batch * channel * height * width);
+	for (int n = 0; n < batch; n++) {
+		for (int c = 0; c < channel; c++) {
+			const float* plane = input.data() + ((size_t)n * channel + c) * height * width;
+			DepthwiseChannelEpilogue channelEpilogue(epilogue, c);
+			for (int y = 0; y < height; y++) {
+				for (int x = 0; x < width; x++) {
+					double sum = 0.0;
+					for (int ky = 0; ky < filterSize; ky++) {
+						for (int kx = 0; kx < filterSize; kx++) {
+							int inputY = y - padding + ky * dilation;
+							int inputX = x - padding + kx * dilation;
+							if (inputY >= 0 && inputY < height && inputX >= 0 && inputX < width) {
+								sum += (double)filter[((size_t)c * filterSize + ky) * filterSize + kx] * plane[inputY * width + inputX];
+							}
+						}
+					}
+					output[(((size_t)n * channel + c) * height + y) * width + x] = channelEpilogue.apply((float)sum);
+				}
+			}
+		}
+	}
+	return output;
+}
+
+static bool checkValues(const char* name, const std::vector<float>& output, const std::vector<float>& expected,
+	int channel, int height, int width, int filterSize, int dilation) {
+
+	for (size_t i = 0; i < output.size(); i++) {
+		if (!(std::fabs(output[i] - expected[i]) <= 1e-4f * (1.0f + std::fabs(expected[i])))) {
+			printf("Wrong! %s (C = %d, H = %d, W = %d, filter %d, dilation %d): %d is %f, expected %f\n",
+				name, channel, height, width, filterSize, dilation, (int)i, output[i], expected[i]);
+			failures++;
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+checkDilated():
+	One shape on the emulated Depthwise_Dilated and on the CPU backend, epilogue with the given activation.
+*/
+static void checkDilated(int batch, int channel, int height, int width, int filterSize, int dilation, int activation) {
+	int padding = dilation * (filterSize - 1) / 2;
+
+	std::mt19937 generator(height * 100 + filterSize * 10 + dilation);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	std::vector<float> input((size_t)batch * channel * height * width);
+	std::vector<float> filter((size_t)channel * filterSize * filterSize);
+	std::vector<float> scale(channel);
+	std::vector<float> shift(channel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	for (int c = 0; c < channel; c++) {
+		scale[c] = 1.0f + 0.5f * distribution(generator);
+		shift[c] = distribution(generator);
+	}
+	DepthwiseEpilogue epilogue = { scale.data(), shift.data(), activation };
+	std::vector<float> expected = referenceDepthwise(input, filter, batch, channel, height, width, filterSize, dilation, epilogue);
+
+	ConvShape shape(height, width, filterSize, filterSize, padding, padding, 1, 1, dilation, dilation);
+	EXPECT(depthwiseDilatedSupported(shape) && shape.outputHeight() == height && shape.outputWidth() == width);
+
+	std::vector<float> output(expected.size(), NAN);
+	emulateDepthwise(input.data(), filter.data(), output.data(),
+		batch, channel, height, width,
+		filterSize, filterSize, height, width,
+		padding, padding, 1,
+		1.0f, 0.0f, epilogue, dilation);
+	checkValues("Depthwise_Dilated", output, expected, channel, height, width, filterSize, dilation);
+
+	// every block: the filter and its receptive field staged once, each output written once
+	const emu::LaunchStatistics& statistics = emu::lastLaunchStatistics();
+	int halo = (filterSize - 1) * dilation;
+	long fieldSize = (long)(depthwiseDilatedTileWidth + halo) * (depthwiseDilatedTileHeight + halo);
+	int tileNumber = ((width + depthwiseDilatedTileWidth - 1) / depthwiseDilatedTileWidth) *
+		((height + depthwiseDilatedTileHeight - 1) / depthwiseDilatedTileHeight);
+	EXPECT(statistics.blocks.size() == (size_t)tileNumber * channel * batch);
+	// a thread reads the filter and filterSize + rowsPerThread - 1 field rows for its rowsPerThread outputs
+	int rowsPerThread = depthwiseDilatedTileHeight / depthwiseDilatedBlockHeight;
+	long threadLoads = (long)depthwiseDilatedTileWidth * depthwiseDilatedBlockHeight *
+		(filterSize * filterSize + (filterSize + rowsPerThread - 1) * filterSize);
+	bool staged = true;
+	for (size_t b = 0; b < statistics.blocks.size(); b++) {
+		const emu::BlockStatistics& block = statistics.blocks[b];
+		staged = staged && block.sharedStores == fieldSize + filterSize * filterSize && block.sharedLoads == threadLoads;
+	}
+	EXPECT(staged);
+	EXPECT(statistics.total().globalStores == (long)output.size());
+
+	std::fill(output.begin(), output.end(), NAN);
+	CPU_Depthwise_Generic(input.data(), filter.data(), output.data(),
+		batch, channel, height, width,
+		channel, filterSize, filterSize,
+		batch, channel, height, width,
+		padding, padding, 1, 1, dilation, dilation,
+		1.0f, 0.0f, epilogue);
+	checkValues("CPU_Depthwise", output, expected, channel, height, width, filterSize, dilation);
+}
+
+int main() {
+	// feature maps of output stride 16 and 8 (513 x 513 crops), and one that is not a multiple of the tile
+	const int filterSizes[] = { 3, 5 };
+	const int dilations[] = { 2, 4 };
+	int activation = DepthwiseActivationNone;
+	for (int f = 0; f < 2; f++) {
+		for (int d = 0; d < 2; d++) {
+			checkDilated(1, 3, 33, 33, filterSizes[f], dilations[d], activation);
+			checkDilated(2, 2, 65, 65, filterSizes[f], dilations[d], (activation + 1) % (DepthwiseActivationHardSwish + 1));
+			checkDilated(1, 2, 20, 47, filterSizes[f], dilations[d], DepthwiseActivationReLU6);
+			activation = (activation + 2) % (DepthwiseActivationHardSwish + 1);
+		}
+	}
+
+	// what Depthwise_Dilated does not take: stride 2, dilation 3, another padding, 7 x 7
+	EXPECT(!depthwiseDilatedSupported(ConvShape(33, 33, 3, 3, 2, 2, 2, 2, 2, 2)));
+	EXPECT(!depthwiseDilatedSupported(ConvShape(33, 33, 3, 3, 3, 3, 1, 1, 3, 3)));
+	EXPECT(!depthwiseDilatedSupported(ConvShape(33, 33, 3, 3, 1, 1, 1, 1, 2, 2)));
+	EXPECT(!depthwiseDilatedSupported(ConvShape(33, 33, 7, 7, 6, 6, 1, 1, 2, 2)));
+	EXPECT(!depthwiseDilatedSupported(ConvShape(33, 33, 3, 3, 1, 1, 1, 1, 1, 1)));
+
+	return testResult("Dilated depthwise convolution");
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include "EmulatedDepthwiseKernels.h"
+#include "CPU_Depthwise.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the emulator.
+
+1) Barrier, shared memory and access counting semantics on small kernels with known behaviour.
+2) Every registered kernel and Depthwise_Generic, run through the emulator, against the CPU backend.
+   Every kernel must write each output exactly once.
+3) The same with the fused scale / shift / activation epilogue.
+4) Rectangular inputs through Depthwise_RowRollingRect: every registered kernel on an input of its height and
+   on one of its width, and the feature maps of 224 x 320 frames.
+*/
+
+#define float emu::Float
+/*
+Rotate the values of a block by one through shared memory. Needs the barrier.
+*/
+__global__ void Rotate_Block(const float* input, float* output) {
+	__shared__ float data[64];
+	int blockOffset = blockIdx.x * blockDim.x;
+	data[threadIdx.x] = input[blockOffset + threadIdx.x];
+	__syncthreads();
+	output[blockOffset + threadIdx.x] = data[(threadIdx.x + 1) % blockDim.x];
+}
+
+/*
+Read shared memory that only the first block writes.
+*/
+__global__ void Read_Stale_Shared(float* output) {
+	__shared__ float data[64];
+	if (blockIdx.x == 0) {
+		data[threadIdx.x] = 1.0f;
+	}
+	__syncthreads();
+	output[blockIdx.x * blockDim.x + threadIdx.x] = data[threadIdx.x];
+}
+
+/*
+Stage the block in dynamic shared memory, accumulate in a local.
+*/
+__global__ void Sum_Dynamic_Shared(const float* input, float* output) {
+	HIP_DYNAMIC_SHARED(float, data)
+	data[threadIdx.x] = input[threadIdx.x];
+	__syncthreads();
+	float sum = 0.0f;
+	for (int i = 0; i < (int)blockDim.x; i++) {
+		sum += data[i];
+	}
+	output[threadIdx.x] = sum;
+}
+#undef float
+
+static void testSmallKernels() {
+	const int blockSize = 64;
+	const int blockNumber = 3;
+	std::vector<float> input(blockSize * blockNumber);
+	std::vector<float> output(blockSize * blockNumber);
+	for (int i = 0; i < blockSize * blockNumber; i++) {
+		input[i] = (float)i;
+	}
+
+	hipLaunchKernelGGL(Rotate_Block, dim3(blockNumber), dim3(blockSize), 0, 0, input.data(), output.data());
+	for (int b = 0; b < blockNumber; b++) {
+		for (int t = 0; t < blockSize; t++) {
+			EXPECT(output[b * blockSize + t] == input[b * blockSize + (t + 1) % blockSize]);
+		}
+	}
+	const emu::LaunchStatistics& statistics = emu::lastLaunchStatistics();
+	EXPECT(statistics.blocks.size() == blockNumber);
+	for (int b = 0; b < blockNumber; b++) {
+		const emu::BlockStatistics& block = statistics.blocks[b];
+		EXPECT(block.blockIdx.x == (unsigned int)b);
+		EXPECT(block.globalLoads == blockSize && block.globalStores == blockSize);
+		EXPECT(block.sharedLoads == blockSize && block.sharedStores == blockSize);
+		EXPECT(block.barriers == 1);
+	}
+
+	hipLaunchKernelGGL(Read_Stale_Shared, dim3(2), dim3(blockSize), 0, 0, output.data());
+	for (int t = 0; t < blockSize; t++) {
+		EXPECT(output[t] == 1.0f);
+		EXPECT(std::isnan(output[blockSize + t]));
+	}
+
+	hipLaunchKernelGGL(Sum_Dynamic_Shared, dim3(1), dim3(blockSize), blockSize * sizeof(float), 0, input.data(), output.data());
+	for (int t = 0; t < blockSize; t++) {
+		EXPECT(output[t] == (float)(blockSize * (blockSize - 1) / 2));
+	}
+	const emu::BlockStatistics& block = emu::lastLaunchStatistics().blocks[0];
+	EXPECT(block.sharedStores == blockSize && block.sharedLoads == blockSize * blockSize);
+	EXPECT(block.globalLoads == blockSize && block.globalStores == blockSize);
+}
+
+/*
+checkDepthwise():
+	Run one shape through the emulator and compare it with CPU_Depthwise.
+	fused - random per channel scale and shift, and the given activation
+*/
+static void checkDepthwise(int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth, int filterHeight, int stride,
+	bool fused = false, int activation = DepthwiseActivationNone) {
+	int padding = (filterHeight - 1) / 2;
+	int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - filterHeight) / stride + 1;
+
+	std::vector<float> input((size_t)inputBatchNumber * inputChannel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)inputChannel * filterHeight * filterHeight);
+	std::vector<float> output((size_t)inputBatchNumber * inputChannel * outputHeight * outputWidth, NAN);
+	std::vector<float> expected(output.size());
+
+	std::mt19937 generator(inputHeight * 100 + filterHeight * 10 + stride);
+	randomFill(input, generator, 5.0f);
+	randomFill(filter, generator, 5.0f);
+
+	std::vector<float> scale(inputChannel);
+	std::vector<float> shift(inputChannel);
+	std::uniform_real_distribution<float> distribution(-5.0f, 5.0f);
+	for (int c = 0; c < inputChannel; c++) {
+		scale[c] = distribution(generator) * 0.2f;
+		shift[c] = distribution(generator);
+	}
+	DepthwiseEpilogue epilogue = depthwiseNoEpilogue;
+	if (fused) {
+		epilogue.scale = scale.data();
+		epilogue.shift = shift.data();
+		epilogue.activation = activation;
+	}
+
+	const DepthwiseKernelEntry* entry = emulateDepthwise(input.data(), filter.data(), output.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterHeight, outputHeight, outputWidth,
+		padding, padding, stride,
+		1.0f, 0.0f, epilogue);
+	const char* name = entry ? entry->name : "Depthwise_Generic";
+
+	CPU_Depthwise(input.data(), filter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, stride,
+		1.0f, 0.0f, epilogue);
+
+	for (size_t i = 0; i < output.size(); i++) {
+		if (!(std::fabs(output[i] - expected[i]) <= 1e-3f * (1.0f + std::fabs(expected[i])))) {
+			printf("Wrong! %s (C = %d, H = %d, W = %d, activation %d): output %d is %f, expected %f\n",
+				name, inputChannel, inputHeight, inputWidth, fused ? activation : -1, (int)i, output[i], expected[i]);
+			failures++;
+			return;
+		}
+	}
+
+	emu::BlockStatistics total = emu::lastLaunchStatistics().total();
+	if (total.globalStores != (long)output.size() || total.globalLoads < (long)(input.size() + filter.size())) {
+		printf("Wrong! %s: %ld global stores for %d outputs, %ld global loads for %d inputs\n",
+			name, total.globalStores, (int)output.size(), total.globalLoads, (int)(input.size() + filter.size()));
+		failures++;
+	}
+}
+
+int main() {
+	testSmallKernels();
+
+	// every registered kernel, with two channel groups
+	const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+	for (size_t i = 0; i < entries.size(); i++) {
+		const ConvShape& shape = entries[i].shape;
+		int inputChannel = 2 * entries[i].channelGroupSize;
+		checkDepthwise(1, inputChannel, shape.inputHeight, shape.inputWidth, shape.filterHeight, shape.strideHeight);
+	}
+
+	// no specialised kernel
+	checkDepthwise(2, 3, 7, 7, 3, 1);
+	checkDepthwise(1, 4, 33, 17, 5, 2);
+	checkDepthwise(1, 2, 9, 9, 7, 1);
+
+	// rectangular, one channel group: wider (two tiles, the last one partial) and narrower than the kernel, transposed
+	for (size_t i = 0; i < entries.size(); i++) {
+		const ConvShape& shape = entries[i].shape;
+		int inputChannel = entries[i].channelGroupSize;
+		int size = shape.inputHeight;
+		int longer = size + size / 2 + 1;
+		DepthwiseRectKernel rect;
+		ConvShape wide(size, longer, shape.filterHeight, shape.filterWidth, shape.paddingHeight, shape.strideHeight);
+		EXPECT(findDepthwiseRectKernel(wide, inputChannel, rect) && rect.entry == &entries[i] && !rect.transposed);
+		checkDepthwise(1, inputChannel, size, longer, shape.filterHeight, shape.strideHeight);
+		checkDepthwise(1, inputChannel, size, size / 2 + 1, shape.filterHeight, shape.strideHeight,
+			true, (int)i % (DepthwiseActivationHardSwish + 1));
+		ConvShape tall(longer, size, shape.filterHeight, shape.filterWidth, shape.paddingHeight, shape.strideHeight);
+		if (findDepthwiseRectKernel(tall, inputChannel, rect) && rect.entry == &entries[i]) {
+			EXPECT(rect.transposed);
+			checkDepthwise(1, inputChannel, longer, size, shape.filterHeight, shape.strideHeight);
+		}
+	}
+	// 224 x 320 frames through MobileNet V2 and 5 x 5 layers, 360 x 640 ones have no kernel
+	checkDepthwise(1, 1, 112, 160, 3, 2, true, DepthwiseActivationReLU6);
+	checkDepthwise(1, 2, 56, 80, 5, 2);
+	checkDepthwise(1, 32, 7, 10, 3, 1);
+	checkDepthwise(1, 2, 45, 80, 3, 1);
+
+	// fused epilogue, the activations in turn over the kernels
+	const int activationNumber = DepthwiseActivationHardSwish + 1;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const ConvShape& shape = entries[i].shape;
+		int inputChannel = 2 * entries[i].channelGroupSize;
+		checkDepthwise(1, inputChannel, shape.inputHeight, shape.inputWidth, shape.filterHeight, shape.strideHeight,
+			true, (int)i % activationNumber);
+	}
+	for (int activation = 0; activation < activationNumber; activation++) {
+		checkDepthwise(2, 3, 7, 7, 3, 1, true, activation);
+		checkDepthwise(1, 4, 33, 17, 5, 2, true, activation);
+	}
+
+	return testResult("Depthwise emulator");
+}
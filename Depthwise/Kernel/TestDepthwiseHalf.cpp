@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CPU_Depthwise.h"
+#include "CPU_DepthwiseNHWC.h"
+#include "CPU_DepthwisePointwise.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the fp16 / bf16 storage of the CPU backend.
+
+The conversions against known roundings (every fp16 value must survive the round trip), then
+CPU_Depthwise(), CPU_Depthwise_NHWC(), CPU_Pointwise() and CPU_DepthwisePointwise() on fp16 / bf16 tensors
+against the float ones on the same (widened) values: the arithmetic is fp32 in both, so the 16-bit output must be exactly the rounded float output.
+*/
+
+static uint16_t halfBits(float value) {
+	return depthwiseFromFloat<DepthwiseHalf>(value).bits;
+}
+
+static uint16_t bfloat16Bits(float value) {
+	return depthwiseFromFloat<DepthwiseBFloat16>(value).bits;
+}
+
+static void testConversions() {
+	// every fp16 value, NaN stays NaN
+	int wrong = 0;
+	for (uint32_t bits = 0; bits < 65536; bits++) {
+		DepthwiseHalf value = { (uint16_t)bits };
+		float widened = depthwiseToFloat(value);
+		bool nan = (bits & 0x7C00u) == 0x7C00u && (bits & 0x03FFu) != 0;
+		if (nan ? !std::isnan(widened) : halfBits(widened) != bits) {
+			wrong++;
+		}
+	}
+	EXPECT(wrong == 0);
+
+	EXPECT(depthwiseToFloat(DepthwiseHalf{ 0x3C00 }) == 1.0f);
+	EXPECT(depthwiseToFloat(DepthwiseHalf{ 0x0001 }) == std::ldexp(1.0f, -24));
+	EXPECT(depthwiseToFloat(DepthwiseHalf{ 0xFBFF }) == -65504.0f);
+	EXPECT(halfBits(65504.0f) == 0x7BFF);
+	EXPECT(halfBits(65520.0f) == 0x7C00);						// rounds up to inf
+	EXPECT(halfBits(-INFINITY) == 0xFC00);
+	EXPECT(halfBits(std::ldexp(1.0f, -25)) == 0x0000);			// tie, to even
+	EXPECT(halfBits(3.0f * std::ldexp(1.0f, -25)) == 0x0002);	// tie, to even
+	EXPECT(halfBits(1.0f + std::ldexp(1.0f, -11)) == 0x3C00);	// tie, to even
+	EXPECT(halfBits(1.0f + 3.0f * std::ldexp(1.0f, -11)) == 0x3C02);
+	EXPECT((halfBits(NAN) & 0x7C00) == 0x7C00 && (halfBits(NAN) & 0x03FF) != 0);
+
+	EXPECT(depthwiseToFloat(DepthwiseBFloat16{ 0x3F80 }) == 1.0f);
+	EXPECT(bfloat16Bits(1.0f) == 0x3F80);
+	EXPECT(bfloat16Bits(1.0f + std::ldexp(1.0f, -8)) == 0x3F80);			// tie, to even
+	EXPECT(bfloat16Bits(1.0f + 3.0f * std::ldexp(1.0f, -8)) == 0x3F82);	// tie, to even
+	EXPECT(bfloat16Bits(1.0f + 5.0f * std::ldexp(1.0f, -10)) == 0x3F81);
+	EXPECT(std::isnan(depthwiseToFloat(DepthwiseBFloat16{ bfloat16Bits(NAN) })));
+
+	// SIMD and scalar parts of the row conversions agree
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<float> distribution(-70000.0f, 70000.0f);
+	std::vector<float> values(53);
+	for (size_t i = 0; i < values.size(); i++) {
+		values[i] = i % 3 == 0 ? distribution(generator) * 1e-8f : distribution(generator);
+	}
+	values[5] = NAN;
+	std::vector<DepthwiseHalf> halves(values.size());
+	std::vector<DepthwiseBFloat16> bfloat16s(values.size());
+	std::vector<float> widened(values.size());
+	cpuDepthwiseStore(values.data(), halves.data(), (int)values.size());
+	cpuDepthwiseStore(values.data(), bfloat16s.data(), (int)values.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		EXPECT(i == 5 || halves[i].bits == halfBits(values[i]));
+		EXPECT(i == 5 || bfloat16s[i].bits == bfloat16Bits(values[i]));
+	}
+	EXPECT(std::isnan(depthwiseToFloat(halves[5])) && std::isnan(depthwiseToFloat(bfloat16s[5])));
+	cpuDepthwiseLoad(halves.data(), widened.data(), (int)values.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		EXPECT(i == 5 || widened[i] == depthwiseToFloat(halves[i]));
+	}
+	cpuDepthwiseLoad(bfloat16s.data(), widened.data(), (int)values.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		EXPECT(i == 5 || widened[i] == depthwiseToFloat(bfloat16s[i]));
+	}
+}
+
+/*
+expectRounded():
+	Every 16-bit output is the rounded float output.
+*/
+template <typename scalar_t>
+static void expectRounded(const char* kernel, const char* name, const std::vector<scalar_t>& output, const std::vector<float>& expected,
+	int inputChannel, int inputHeight, int inputWidth, int filterHeight, int stride, int dilation) {
+
+	for (size_t i = 0; i < expected.size(); i++) {
+		if (output[i].bits != depthwiseFromFloat<scalar_t>(expected[i]).bits) {
+			printf("Wrong! %s %s (C = %d, H = %d, W = %d, filter %d, stride %d, dilation %d): %d is %f, expected %f\n",
+				kernel, name, inputChannel, inputHeight, inputWidth, filterHeight, stride, dilation,
+				(int)i, depthwiseToFloat(output[i]), expected[i]);
+			failures++;
+			return;
+		}
+	}
+}
+
+/*
+checkStorage():
+	CPU_Depthwise_Generic() and CPU_Depthwise_NHWC() on scalar_t tensors against the float ones on the widened
+	values. The NHWC calls share one workspace.
+*/
+template <typename scalar_t>
+static void checkStorage(const char* name, int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int stride, int dilation, int activation) {
+
+	int padding = (filterHeight - 1) * dilation / 2;
+	int extent = (filterHeight - 1) * dilation + 1;
+	int outputHeight = (inputHeight + 2 * padding - extent) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - extent) / stride + 1;
+
+	std::vector<scalar_t> input((size_t)inputBatchNumber * inputChannel * inputHeight * inputWidth);
+	std::vector<scalar_t> filter((size_t)inputChannel * filterHeight * filterHeight);
+	std::vector<float> scale(inputChannel), shift(inputChannel);
+
+	std::mt19937 generator(inputChannel * 1000 + inputHeight * 10 + filterHeight);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	for (size_t i = 0; i < input.size(); i++) {
+		input[i] = depthwiseFromFloat<scalar_t>(distribution(generator));
+	}
+	for (size_t i = 0; i < filter.size(); i++) {
+		filter[i] = depthwiseFromFloat<scalar_t>(distribution(generator));
+	}
+	for (int c = 0; c < inputChannel; c++) {
+		scale[c] = distribution(generator);
+		shift[c] = distribution(generator);
+	}
+
+	DepthwiseEpilogue epilogue = depthwiseNoEpilogue;
+	if (activation != DepthwiseActivationNone) {
+		epilogue.scale = scale.data();
+		epilogue.shift = shift.data();
+		epilogue.activation = activation;
+	}
+
+	std::vector<float> floatInput(input.size()), floatFilter(filter.size());
+	for (size_t i = 0; i < input.size(); i++) {
+		floatInput[i] = depthwiseToFloat(input[i]);
+	}
+	for (size_t i = 0; i < filter.size(); i++) {
+		floatFilter[i] = depthwiseToFloat(filter[i]);
+	}
+
+	std::vector<float> expected((size_t)inputBatchNumber * inputChannel * outputHeight * outputWidth);
+	std::vector<scalar_t> output(expected.size());
+	CPU_Depthwise_Generic(floatInput.data(), floatFilter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue);
+	CPU_Depthwise_Generic(input.data(), filter.data(), output.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue);
+
+	expectRounded("CPU_Depthwise", name, output, expected, inputChannel, inputHeight, inputWidth, filterHeight, stride, dilation);
+
+	// the same tensors channels last
+	int inputPlaneSize = inputHeight * inputWidth;
+	std::vector<scalar_t> inputNHWC(input.size());
+	std::vector<float> floatInputNHWC(input.size());
+	for (int n = 0; n < inputBatchNumber; n++) {
+		for (int c = 0; c < inputChannel; c++) {
+			for (int p = 0; p < inputPlaneSize; p++) {
+				size_t nhwc = ((size_t)n * inputPlaneSize + p) * inputChannel + c;
+				size_t nchw = ((size_t)n * inputChannel + c) * inputPlaneSize + p;
+				inputNHWC[nhwc] = input[nchw];
+				floatInputNHWC[nhwc] = floatInput[nchw];
+			}
+		}
+	}
+	DepthwiseCpuWorkspace workspace;
+	CPU_Depthwise_NHWC(floatInputNHWC.data(), floatFilter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue, &workspace);
+	CPU_Depthwise_NHWC(inputNHWC.data(), filter.data(), output.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue, &workspace);
+	expectRounded("CPU_Depthwise_NHWC", name, output, expected, inputChannel, inputHeight, inputWidth, filterHeight, stride, dilation);
+}
+
+/*
+checkPointwiseStorage():
+	CPU_Pointwise() and CPU_DepthwisePointwise() on scalar_t tensors against the float ones on the widened values,
+	every call with the same workspace.
+*/
+template <typename scalar_t>
+static void checkPointwiseStorage(const char* name, int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int outputChannel, int filterHeight, int stride) {
+
+	int padding = (filterHeight - 1) / 2;
+	int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - filterHeight) / stride + 1;
+
+	std::vector<float> floatInput((size_t)inputBatchNumber * inputChannel * inputHeight * inputWidth);
+	std::vector<float> floatDepthwiseFilter((size_t)inputChannel * filterHeight * filterHeight);
+	std::vector<float> floatPointwiseFilter((size_t)outputChannel * inputChannel);
+	std::vector<float> scale(std::max(inputChannel, outputChannel)), shift(scale.size());
+	std::mt19937 generator(outputChannel * 1000 + inputChannel * 10 + filterHeight);
+	randomFill(floatInput, generator);
+	randomFill(floatDepthwiseFilter, generator);
+	randomFill(floatPointwiseFilter, generator);
+	randomFill(scale, generator);
+	randomFill(shift, generator);
+
+	// the 16-bit tensors, and the float ones set to their widened values
+	std::vector<scalar_t> input(floatInput.size()), depthwiseFilter(floatDepthwiseFilter.size()), pointwiseFilter(floatPointwiseFilter.size());
+	std::vector<float>* floats[] = { &floatInput, &floatDepthwiseFilter, &floatPointwiseFilter };
+	std::vector<scalar_t>* storages[] = { &input, &depthwiseFilter, &pointwiseFilter };
+	for (int t = 0; t < 3; t++) {
+		for (size_t i = 0; i < floats[t]->size(); i++) {
+			(*storages[t])[i] = depthwiseFromFloat<scalar_t>((*floats[t])[i]);
+			(*floats[t])[i] = depthwiseToFloat((*storages[t])[i]);
+		}
+	}
+
+	DepthwiseEpilogue depthwiseEpilogue = { scale.data(), shift.data(), DepthwiseActivationReLU6 };
+	DepthwiseEpilogue pointwiseEpilogue = { scale.data(), shift.data(), DepthwiseActivationNone };
+	DepthwiseCpuWorkspace workspace;
+
+	std::vector<float> expected((size_t)inputBatchNumber * outputChannel * inputHeight * inputWidth);
+	std::vector<scalar_t> output(expected.size());
+	CPU_Pointwise(floatInput.data(), floatPointwiseFilter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth, outputChannel,
+		1.0f, 0.0f, depthwiseEpilogue, &workspace);
+	CPU_Pointwise(input.data(), pointwiseFilter.data(), output.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth, outputChannel,
+		1.0f, 0.0f, depthwiseEpilogue, &workspace);
+	expectRounded("CPU_Pointwise", name, output, expected, inputChannel, inputHeight, inputWidth, 1, 1, 1);
+
+	expected.assign((size_t)inputBatchNumber * outputChannel * outputHeight * outputWidth, 0.0f);
+	output.resize(expected.size());
+	CPU_DepthwisePointwise(floatInput.data(), floatDepthwiseFilter.data(), floatPointwiseFilter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterHeight, outputChannel, outputHeight, outputWidth, padding, stride,
+		depthwiseEpilogue, pointwiseEpilogue, &workspace);
+	CPU_DepthwisePointwise(input.data(), depthwiseFilter.data(), pointwiseFilter.data(), output.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		filterHeight, filterHeight, outputChannel, outputHeight, outputWidth, padding, stride,
+		depthwiseEpilogue, pointwiseEpilogue, &workspace);
+	expectRounded("CPU_DepthwisePointwise", name, output, expected, inputChannel, inputHeight, inputWidth, filterHeight, stride, 1);
+}
+
+int main() {
+	testConversions();
+
+	const int layerConfigs[][4] = {	// input height / width, filter, stride, channel
+		{112, 3, 1, 32}, {112, 3, 2, 96}, {56, 3, 1, 144}, {28, 3, 2, 192}, {14, 3, 1, 384}, {7, 3, 1, 960},
+		{56, 5, 2, 144}, {28, 5, 1, 240}, {14, 5, 2, 480}, {7, 5, 1, 1152} };
+	const int layerNumber = sizeof(layerConfigs) / sizeof(layerConfigs[0]);
+	for (int i = 0; i < layerNumber; i++) {
+		int activation = i % 2 == 0 ? DepthwiseActivationNone : DepthwiseActivationReLU6;
+		checkStorage<DepthwiseHalf>("fp16", 1, layerConfigs[i][3] / 8, layerConfigs[i][0], layerConfigs[i][0],
+			layerConfigs[i][1], layerConfigs[i][2], 1, activation);
+		checkStorage<DepthwiseBFloat16>("bf16", 1, layerConfigs[i][3] / 8, layerConfigs[i][0], layerConfigs[i][0],
+			layerConfigs[i][1], layerConfigs[i][2], 1, activation);
+	}
+	// odd widths, generic row kernel, SiLU
+	checkStorage<DepthwiseHalf>("fp16", 2, 3, 13, 19, 7, 1, 1, DepthwiseActivationSiLU);
+	checkStorage<DepthwiseBFloat16>("bf16", 2, 3, 17, 11, 3, 1, 2, DepthwiseActivationHardSwish);
+	// filter window taller than the input
+	checkStorage<DepthwiseHalf>("fp16", 1, 17, 4, 5, 7, 2, 1, DepthwiseActivationReLU);
+
+	// pointwise and fused blocks: a large plane (pixel blocks), a small one with many channels (output channel blocks)
+	checkPointwiseStorage<DepthwiseHalf>("fp16", 2, 16, 56, 56, 24, 3, 1);
+	checkPointwiseStorage<DepthwiseBFloat16>("bf16", 1, 96, 14, 14, 40, 5, 2);
+	checkPointwiseStorage<DepthwiseHalf>("fp16", 1, 300, 7, 7, 66, 3, 1);
+
+	return testResult("Depthwise convolution fp16 / bf16 storage");
+}
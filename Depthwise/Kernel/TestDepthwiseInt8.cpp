@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CPU_DepthwiseInt8.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the quantized (int8) depthwise convolution.
+
+CPU_Depthwise_Int8() against a plain loop over the window with int32 sums and the same float requantization,
+so the int8 outputs must match exactly: non zero zero points (padding must act as real 0), per channel filter
+scales, bias, every clamp (none / ReLU / ReLU6) and the SIMD and scalar parts of every row.
+*/
+
+/*
+checkInt8():
+	One quantized layer, filterHeight x filterHeight, padding (filterHeight - 1) / 2.
+*/
+static void checkInt8(int batch, int channel, int inputHeight, int inputWidth, int filterHeight, int stride,
+	int inputZeroPoint, int outputZeroPoint, bool withBias, int activation) {
+
+	int padding = (filterHeight - 1) / 2;
+	int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - filterHeight) / stride + 1;
+
+	std::mt19937 generator(channel * 1000 + inputHeight * 10 + filterHeight + stride);
+	std::uniform_int_distribution<int> valueDistribution(-128, 127);
+	std::uniform_real_distribution<float> scaleDistribution(0.002f, 0.02f);
+	std::uniform_int_distribution<int> biasDistribution(-2000, 2000);
+
+	std::vector<int8_t> input((size_t)batch * channel * inputHeight * inputWidth);
+	std::vector<int8_t> filter((size_t)channel * filterHeight * filterHeight);
+	std::vector<float> filterScale(channel);
+	std::vector<int32_t> bias(channel);
+	for (size_t i = 0; i < input.size(); i++) {
+		input[i] = (int8_t)valueDistribution(generator);
+	}
+	for (size_t i = 0; i < filter.size(); i++) {
+		filter[i] = (int8_t)valueDistribution(generator);
+	}
+	for (int c = 0; c < channel; c++) {
+		filterScale[c] = scaleDistribution(generator);
+		bias[c] = biasDistribution(generator);
+	}
+
+	DepthwiseQuantization quantization;
+	quantization.inputScale = 0.05f;
+	quantization.inputZeroPoint = inputZeroPoint;
+	quantization.filterScale = filterScale.data();
+	quantization.bias = withBias ? bias.data() : nullptr;
+	quantization.outputScale = 0.04f * filterHeight;
+	quantization.outputZeroPoint = outputZeroPoint;
+	quantization.activation = activation;
+
+	int low, high;
+	cpuDepthwiseQuantizedRange(quantization, low, high);
+
+	std::vector<int8_t> output((size_t)batch * channel * outputHeight * outputWidth);
+	CPU_Depthwise_Int8(input.data(), filter.data(), output.data(),
+		batch, channel, inputHeight, inputWidth,
+		channel, filterHeight, filterHeight,
+		batch, channel, outputHeight, outputWidth,
+		padding, stride, quantization);
+
+	int clamped = 0;
+	for (int n = 0; n < batch; n++) {
+		for (int c = 0; c < channel; c++) {
+			float multiplier = quantization.inputScale * filterScale[c] / quantization.outputScale;
+			for (int y = 0; y < outputHeight; y++) {
+				for (int x = 0; x < outputWidth; x++) {
+					int32_t sum = withBias ? bias[c] : 0;
+					for (int ky = 0; ky < filterHeight; ky++) {
+						for (int kx = 0; kx < filterHeight; kx++) {
+							int iy = y * stride + ky - padding;
+							int ix = x * stride + kx - padding;
+							if (iy < 0 || iy >= inputHeight || ix < 0 || ix >= inputWidth) {
+								continue;
+							}
+							int value = input[(((size_t)n * channel + c) * inputHeight + iy) * inputWidth + ix];
+							sum += (value - inputZeroPoint) * filter[((size_t)c * filterHeight + ky) * filterHeight + kx];
+						}
+					}
+					int expected = (int)std::nearbyint((float)sum * multiplier) + outputZeroPoint;
+					if (expected < low || expected > high) {
+						clamped++;
+					}
+					expected = std::min(std::max(expected, low), high);
+
+					int value = output[(((size_t)n * channel + c) * outputHeight + y) * outputWidth + x];
+					if (value != expected) {
+						printf("Wrong! CPU_Depthwise_Int8 (C = %d, H = %d, W = %d, filter %d, stride %d, activation %d): "
+							"(%d, %d, %d, %d) is %d, expected %d\n", channel, inputHeight, inputWidth, filterHeight, stride, activation,
+							n, c, y, x, value, expected);
+						failures++;
+						return;
+					}
+				}
+			}
+		}
+	}
+
+	// the scales are chosen so that the clamp is exercised
+	if (activation != DepthwiseActivationNone && clamped == 0) {
+		printf("Wrong! CPU_Depthwise_Int8 (C = %d, filter %d, activation %d): clamp never reached\n", channel, filterHeight, activation);
+		failures++;
+	}
+}
+
+int main() {
+	// the shapes of the kernel set
+	const int layerConfigs[][4] = {	// input height / width, filter, stride, channel
+		{112, 3, 1, 32}, {112, 3, 2, 96}, {56, 3, 1, 144}, {56, 3, 2, 144}, {28, 3, 1, 192}, {28, 3, 2, 192},
+		{14, 3, 1, 384}, {14, 3, 2, 576}, {7, 3, 1, 960},
+		{56, 5, 2, 144}, {28, 5, 1, 240}, {14, 5, 1, 480}, {14, 5, 2, 480}, {7, 5, 1, 1152} };
+	const int layerNumber = sizeof(layerConfigs) / sizeof(layerConfigs[0]);
+	const int activations[] = { DepthwiseActivationNone, DepthwiseActivationReLU, DepthwiseActivationReLU6 };
+	for (int i = 0; i < layerNumber; i++) {
+		checkInt8(1, layerConfigs[i][3] / 8, layerConfigs[i][0], layerConfigs[i][0], layerConfigs[i][1], layerConfigs[i][2],
+			i % 5 - 2, 3 - i % 7, i % 2 == 0, activations[i % 3]);
+	}
+
+	// odd widths, zero points at the ends of the range, generic row kernel
+	checkInt8(2, 3, 9, 23, 3, 1, -128, -128, true, DepthwiseActivationReLU6);
+	checkInt8(2, 5, 17, 37, 5, 2, 127, 10, false, DepthwiseActivationReLU);
+	checkInt8(1, 4, 6, 5, 3, 2, 0, 0, true, DepthwiseActivationNone);
+	checkInt8(1, 3, 13, 19, 7, 1, 5, -5, true, DepthwiseActivationReLU6);
+	checkInt8(1, 3, 11, 11, 3, 3, -7, 0, false, DepthwiseActivationNone);
+
+	return testResult("Depthwise convolution int8");
+}
@@ -72,6 +72,7 @@ for param in paramList:
         with open("result.txt", "r") as f:
             lines = f.readlines()
             for i in range(0, len(lines), 3):
+                # MIOpen time is nan when the benchmark was built without MIOpen
                 if lines[i] == "Kernel Calculation Correct.\n":
                     print("Kernel Calculation Correct.")
                     miopenTime += float(lines[i + 1].replace("MIOpen time : ", "").replace(" ms.\n", ""))
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CPU_DepthwiseNCHWc.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the blocked channel (NCHWc) depthwise convolution.
+
+CPU_Depthwise_NCHWc() against CPU_Depthwise_Generic() on the NCHW tensor, for nChw8c and nChw16c, channel
+numbers that are not a multiple of the block and two layers chained in NCHWc (the padded channels of the first
+output must be zero, or they would leak into the second layer through its padded filter).
+*/
+
+/*
+checkNCHWc():
+	Run two depthwise layers (filterHeight / stride / dilation, then 3 x 3 stride 1 with ReLU6) in NCHWc.
+*/
+static void checkNCHWc(int batch, int channel, int inputHeight, int inputWidth,
+	int filterHeight, int stride, int padding, int dilation, int activation, int channelBlock) {
+
+	int extent = (filterHeight - 1) * dilation + 1;
+	int outputHeight = (inputHeight + 2 * padding - extent) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - extent) / stride + 1;
+
+	std::mt19937 generator(channel * 1000 + inputHeight * 10 + filterHeight + channelBlock);
+	std::vector<float> input((size_t)batch * channel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)channel * filterHeight * filterHeight);
+	std::vector<float> secondFilter((size_t)channel * 9);
+	std::vector<float> scale(channel), shift(channel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(secondFilter, generator);
+	randomFill(scale, generator);
+	randomFill(shift, generator);
+
+	DepthwiseEpilogue epilogue = depthwiseNoEpilogue;
+	if (activation != DepthwiseActivationNone) {
+		epilogue.scale = scale.data();
+		epilogue.shift = shift.data();
+		epilogue.activation = activation;
+	}
+	DepthwiseEpilogue secondEpilogue = { nullptr, shift.data(), DepthwiseActivationReLU6 };
+
+	// NCHW reference
+	std::vector<float> expected((size_t)batch * channel * outputHeight * outputWidth);
+	std::vector<float> secondExpected(expected.size());
+	CPU_Depthwise_Generic(input.data(), filter.data(), expected.data(),
+		batch, channel, inputHeight, inputWidth,
+		channel, filterHeight, filterHeight,
+		batch, channel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue);
+	CPU_Depthwise_Generic(expected.data(), secondFilter.data(), secondExpected.data(),
+		batch, channel, outputHeight, outputWidth,
+		channel, 3, 3,
+		batch, channel, outputHeight, outputWidth,
+		1, 1, 1, 1, 1, 1,
+		1.0f, 0.0f, secondEpilogue);
+
+	// filters reordered once, activations stay in NCHWc between the layers
+	std::vector<float> blockedInput(cpuDepthwiseNCHWcSize(batch, channel, inputHeight, inputWidth, channelBlock));
+	std::vector<float> blockedFilter(cpuDepthwiseNCHWcSize(1, channel, filterHeight, filterHeight, channelBlock));
+	std::vector<float> blockedSecondFilter(cpuDepthwiseNCHWcSize(1, channel, 3, 3, channelBlock));
+	std::vector<float> blockedOutput(cpuDepthwiseNCHWcSize(batch, channel, outputHeight, outputWidth, channelBlock), NAN);
+	std::vector<float> blockedSecondOutput(blockedOutput.size(), NAN);
+	cpuReorderNCHWToNCHWc(input.data(), blockedInput.data(), batch, channel, inputHeight, inputWidth, channelBlock);
+	cpuReorderDepthwiseFilterNCHWc(filter.data(), blockedFilter.data(), channel, filterHeight, filterHeight, channelBlock);
+	cpuReorderDepthwiseFilterNCHWc(secondFilter.data(), blockedSecondFilter.data(), channel, 3, 3, channelBlock);
+
+	CPU_Depthwise_NCHWc(blockedInput.data(), blockedFilter.data(), blockedOutput.data(),
+		batch, channel, inputHeight, inputWidth,
+		channel, filterHeight, filterHeight,
+		batch, channel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		channelBlock, 1.0f, 0.0f, epilogue);
+	CPU_Depthwise_NCHWc(blockedOutput.data(), blockedSecondFilter.data(), blockedSecondOutput.data(),
+		batch, channel, outputHeight, outputWidth,
+		channel, 3, 3,
+		batch, channel, outputHeight, outputWidth,
+		1, 1, 1, 1, 1, 1,
+		channelBlock, 1.0f, 0.0f, secondEpilogue);
+
+	std::vector<float> output(expected.size(), NAN);
+	std::vector<float> secondOutput(expected.size(), NAN);
+	cpuReorderNCHWcToNCHW(blockedOutput.data(), output.data(), batch, channel, outputHeight, outputWidth, channelBlock);
+	cpuReorderNCHWcToNCHW(blockedSecondOutput.data(), secondOutput.data(), batch, channel, outputHeight, outputWidth, channelBlock);
+
+	const std::vector<float>* outputs[] = { &output, &secondOutput };
+	const std::vector<float>* references[] = { &expected, &secondExpected };
+	for (int layer = 0; layer < 2; layer++) {
+		for (size_t i = 0; i < expected.size(); i++) {
+			float value = (*outputs[layer])[i];
+			float reference = (*references[layer])[i];
+			if (!(std::fabs(value - reference) <= 1e-4f * (1.0f + std::fabs(reference)))) {
+				printf("Wrong! CPU_Depthwise_NCHWc nChw%dc layer %d (C = %d, H = %d, W = %d, filter %d, stride %d, dilation %d): "
+					"%d is %f, expected %f\n", channelBlock, layer, channel, inputHeight, inputWidth, filterHeight, stride, dilation,
+					(int)i, value, reference);
+				failures++;
+				break;
+			}
+		}
+	}
+
+	// padded channels of the last block
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(channel, channelBlock);
+	size_t outputBlockSize = (size_t)outputHeight * outputWidth * channelBlock;
+	for (int n = 0; n < batch; n++) {
+		const float* lastBlock = blockedOutput.data() + ((size_t)n * blockNumber + blockNumber - 1) * outputBlockSize;
+		for (size_t i = 0; i < outputBlockSize; i++) {
+			if ((blockNumber - 1) * channelBlock + (int)(i % channelBlock) >= channel && lastBlock[i] != 0.0f) {
+				printf("Wrong! CPU_Depthwise_NCHWc nChw%dc (C = %d): padded channel is %f\n", channelBlock, channel, lastBlock[i]);
+				failures++;
+				break;
+			}
+		}
+	}
+}
+
+int main() {
+	const int channelBlocks[] = { 8, 16 };
+	for (int i = 0; i < 2; i++) {
+		int channelBlock = channelBlocks[i];
+		// odd channel numbers, every activation, stride 2, 5 x 5, dilation, no padding
+		checkNCHWc(2, 20, 9, 9, 3, 1, 1, 1, DepthwiseActivationNone, channelBlock);
+		checkNCHWc(1, 70, 11, 7, 3, 2, 1, 1, DepthwiseActivationReLU, channelBlock);
+		checkNCHWc(2, 5, 8, 13, 5, 1, 2, 1, DepthwiseActivationReLU6, channelBlock);
+		checkNCHWc(1, 33, 12, 12, 5, 2, 2, 1, DepthwiseActivationSiLU, channelBlock);
+		checkNCHWc(1, 64, 10, 10, 3, 1, 2, 2, DepthwiseActivationHardSwish, channelBlock);
+		checkNCHWc(1, 3, 6, 6, 3, 1, 0, 1, DepthwiseActivationNone, channelBlock);
+		checkNCHWc(1, 17, 4, 5, 7, 1, 3, 1, DepthwiseActivationReLU, channelBlock);
+
+		// the shapes of the kernel set
+		const int layerConfigs[][4] = {	// input height / width, filter, stride, channel
+			{112, 3, 1, 32}, {56, 3, 2, 144}, {28, 3, 1, 192}, {14, 3, 2, 576}, {7, 3, 1, 960},
+			{56, 5, 2, 144}, {28, 5, 1, 240}, {14, 5, 2, 480}, {7, 5, 1, 1152} };
+		const int layerNumber = sizeof(layerConfigs) / sizeof(layerConfigs[0]);
+		for (int l = 0; l < layerNumber; l++) {
+			int filterHeight = layerConfigs[l][1];
+			checkNCHWc(1, layerConfigs[l][3], layerConfigs[l][0], layerConfigs[l][0],
+				filterHeight, layerConfigs[l][2], (filterHeight - 1) / 2, 1, DepthwiseActivationReLU6, channelBlock);
+		}
+	}
+
+	return testResult("Depthwise convolution NCHWc");
+}
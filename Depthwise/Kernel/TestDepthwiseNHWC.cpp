@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+#include "DepthwiseRegistry.h"
+
+#define float emu::Float
+#include "Depthwise_NHWC.h"
+#undef float
+
+#include "CPU_DepthwiseNHWC.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the channels last depthwise convolution.
+
+CPU_Depthwise_NHWC() and Depthwise_NHWC (run through the emulator) against CPU_Depthwise_Generic() on the
+NCHW copy of the same tensor, with and without the epilogue. Channel numbers that are not a multiple of the
+vector width / channel tile check the remainders.
+*/
+
+/*
+checkNHWC():
+	Run one shape. emulate - also run Depthwise_NHWC, only for small shapes
+*/
+static void checkNHWC(int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterHeight, int stride, int padding, int dilation, int activation, bool emulate) {
+
+	int extent = (filterHeight - 1) * dilation + 1;
+	int outputHeight = (inputHeight + 2 * padding - extent) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - extent) / stride + 1;
+	int inputPlaneSize = inputHeight * inputWidth;
+	int outputPlaneSize = outputHeight * outputWidth;
+
+	std::vector<float> input((size_t)inputBatchNumber * inputChannel * inputPlaneSize);
+	std::vector<float> filter((size_t)inputChannel * filterHeight * filterHeight);
+	std::vector<float> scale(inputChannel), shift(inputChannel);
+
+	std::mt19937 generator(inputChannel * 1000 + inputHeight * 10 + filterHeight);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(scale, generator);
+	randomFill(shift, generator);
+
+	DepthwiseEpilogue epilogue = depthwiseNoEpilogue;
+	if (activation != DepthwiseActivationNone) {
+		epilogue.scale = scale.data();
+		epilogue.shift = shift.data();
+		epilogue.activation = activation;
+	}
+
+	// NCHW reference
+	std::vector<float> expected((size_t)inputBatchNumber * inputChannel * outputPlaneSize);
+	CPU_Depthwise_Generic(input.data(), filter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue);
+
+	std::vector<float> inputNHWC(input.size());
+	for (int n = 0; n < inputBatchNumber; n++) {
+		for (int c = 0; c < inputChannel; c++) {
+			for (int p = 0; p < inputPlaneSize; p++) {
+				inputNHWC[((size_t)n * inputPlaneSize + p) * inputChannel + c] = input[((size_t)n * inputChannel + c) * inputPlaneSize + p];
+			}
+		}
+	}
+
+	std::vector<float> output(expected.size());
+	const char* names[] = { "CPU_Depthwise_NHWC", "Depthwise_NHWC" };
+	for (int run = 0; run < (emulate ? 2 : 1); run++) {
+		std::fill(output.begin(), output.end(), NAN);
+		if (run == 0) {
+			CPU_Depthwise_NHWC(inputNHWC.data(), filter.data(), output.data(),
+				inputBatchNumber, inputChannel, inputHeight, inputWidth,
+				inputChannel, filterHeight, filterHeight,
+				inputBatchNumber, inputChannel, outputHeight, outputWidth,
+				padding, padding, stride, stride, dilation, dilation,
+				1.0f, 0.0f, epilogue);
+		}
+		else {
+			launchDepthwiseNHWC(reinterpret_cast<const emu::Float*>(inputNHWC.data()),
+				reinterpret_cast<const emu::Float*>(filter.data()),
+				reinterpret_cast<emu::Float*>(output.data()),
+				inputBatchNumber, inputChannel, inputHeight, inputWidth,
+				inputChannel, filterHeight, filterHeight,
+				inputBatchNumber, inputChannel, outputHeight, outputWidth,
+				padding, padding, stride, stride, dilation, dilation,
+				1.0f, 0.0f, epilogue);
+
+			emu::BlockStatistics total = emu::lastLaunchStatistics().total();
+			if (total.globalStores != (long)output.size()) {
+				printf("Wrong! %s: %ld global stores for %d outputs\n", names[run], total.globalStores, (int)output.size());
+				failures++;
+			}
+		}
+
+		for (int n = 0; n < inputBatchNumber; n++) {
+			for (int c = 0; c < inputChannel; c++) {
+				for (int p = 0; p < outputPlaneSize; p++) {
+					float value = output[((size_t)n * outputPlaneSize + p) * inputChannel + c];
+					float reference = expected[((size_t)n * inputChannel + c) * outputPlaneSize + p];
+					if (!(std::fabs(value - reference) <= 1e-4f * (1.0f + std::fabs(reference)))) {
+						printf("Wrong! %s (C = %d, H = %d, W = %d, filter %d, stride %d, dilation %d, activation %d): "
+							"batch %d channel %d pixel %d is %f, expected %f\n",
+							names[run], inputChannel, inputHeight, inputWidth, filterHeight, stride, dilation, activation,
+							n, c, p, value, reference);
+						failures++;
+						n = inputBatchNumber;
+						c = inputChannel;
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+int main() {
+	// emulated, odd channel numbers, every activation, stride 2, 5 x 5, dilation, no padding
+	checkNHWC(2, 20, 9, 9, 3, 1, 1, 1, DepthwiseActivationNone, true);
+	checkNHWC(1, 70, 11, 7, 3, 2, 1, 1, DepthwiseActivationReLU, true);
+	checkNHWC(2, 5, 8, 13, 5, 1, 2, 1, DepthwiseActivationReLU6, true);
+	checkNHWC(1, 33, 12, 12, 5, 2, 2, 1, DepthwiseActivationSiLU, true);
+	checkNHWC(1, 64, 10, 10, 3, 1, 2, 2, DepthwiseActivationHardSwish, true);
+	checkNHWC(1, 3, 6, 6, 3, 1, 0, 1, DepthwiseActivationNone, true);
+	checkNHWC(1, 17, 4, 5, 7, 1, 3, 1, DepthwiseActivationReLU, true);
+
+	// CPU only, the shapes of the kernel set
+	const int layerConfigs[][4] = {	// input height / width, filter, stride, channel
+		{112, 3, 1, 32}, {112, 3, 2, 96}, {56, 3, 1, 144}, {56, 3, 2, 144}, {28, 3, 1, 192}, {28, 3, 2, 192},
+		{14, 3, 1, 384}, {14, 3, 2, 576}, {7, 3, 1, 960}, {56, 5, 2, 144}, {28, 5, 1, 240}, {14, 5, 1, 480},
+		{14, 5, 2, 480}, {7, 5, 1, 1152} };
+	const int layerNumber = sizeof(layerConfigs) / sizeof(layerConfigs[0]);
+	for (int i = 0; i < layerNumber; i++) {
+		int filterHeight = layerConfigs[i][1];
+		checkNHWC(2, layerConfigs[i][3], layerConfigs[i][0], layerConfigs[i][0],
+			filterHeight, layerConfigs[i][2], (filterHeight - 1) / 2, 1, i % 2 == 0 ? DepthwiseActivationNone : DepthwiseActivationReLU6, false);
+	}
+
+	return testResult("Depthwise convolution NHWC");
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CPU_DepthwiseNetwork.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the network executor (DepthwiseNetwork.h, CPU_DepthwiseNetwork.h).
+
+The plan of the MobileNet V2 backbone (shapes, fused steps, 3 buffers, 2 for a chain without residuals), plans
+that must be rejected, and for every plan a replay of the buffer assignment: each step reads the activation it
+expects, never writes a buffer it reads. Then the whole backbone on the host, fused and unfused, against the
+layers run one by one with freshly allocated activations; the second run does not grow the workspace.
+*/
+
+/*
+checkBuffers():
+	Replay plan: every buffer remembers the step whose output it holds, a step must find its input and residual
+	where the plan says, and must not overwrite them.
+*/
+static void checkBuffers(const std::vector<DepthwiseNetworkLayer>& layers, const DepthwiseNetworkPlan& plan) {
+	std::vector<int> holds(plan.bufferSizes.size(), -2);
+	// step whose output is the input of every layer, -1 for the network input
+	std::vector<int> producer(layers.size() + 1, -1);
+	for (size_t s = 0; s < plan.steps.size(); s++) {
+		const DepthwiseNetworkStep& step = plan.steps[s];
+		int expectedInput = (int)s - 1;
+		int input = step.inputBuffer == DepthwiseNetworkInput ? -1 : holds[step.inputBuffer];
+		EXPECT(input == expectedInput);
+
+		int last = step.fused ? step.layer + 1 : step.layer;
+		int r = layers[last].residual;
+		EXPECT((r < 0) == (step.residualBuffer == DepthwiseNetworkNone));
+		if (r >= 0) {
+			int residual = step.residualBuffer == DepthwiseNetworkInput ? -1 : holds[step.residualBuffer];
+			EXPECT(residual == producer[r]);
+			EXPECT(step.residualBuffer != step.outputBuffer);
+		}
+		EXPECT(step.outputBuffer != step.inputBuffer);
+		if (s + 1 == plan.steps.size()) {
+			EXPECT(step.outputBuffer == DepthwiseNetworkOutput);
+		}
+		else {
+			EXPECT(step.outputBuffer >= 0 && plan.bufferSizes[step.outputBuffer] >= step.outputSize(plan.batch));
+			holds[step.outputBuffer] = (int)s;
+		}
+		producer[last + 1] = (int)s;
+	}
+}
+
+static void testPlan() {
+	std::vector<DepthwiseNetworkLayer> layers = depthwiseMobileNetV2Layers();
+	int depthwiseNumber = 0;
+	for (size_t i = 0; i < layers.size(); i++) {
+		depthwiseNumber += layers[i].kind == DepthwiseNetworkDepthwise;
+	}
+	EXPECT(depthwiseNumber == 17 && layers.size() == 17 + 34);
+
+	DepthwiseNetworkPlan plan;
+	EXPECT(planDepthwiseNetwork(layers, 1, 32, 112, 112, true, plan));
+	EXPECT(plan.outputChannel == 1280 && plan.outputHeight == 7 && plan.outputWidth == 7);
+	// every depthwise layer is fused with its projection, the expansions and the last convolution are not
+	EXPECT(plan.steps.size() == 34);
+	EXPECT(plan.bufferSizes.size() == 3);
+	checkBuffers(layers, plan);
+	// the largest activation: 96 x 112 x 112 (expansion of the second block)
+	size_t largest = 0;
+	for (size_t i = 0; i < plan.bufferSizes.size(); i++) {
+		largest = std::max(largest, plan.bufferSizes[i]);
+	}
+	EXPECT(largest == (size_t)96 * 112 * 112);
+
+	EXPECT(planDepthwiseNetwork(layers, 2, 32, 112, 112, false, plan));
+	EXPECT(plan.steps.size() == layers.size() && plan.bufferSizes.size() == 3);
+	checkBuffers(layers, plan);
+
+	// a chain without residuals: ping-pong
+	std::vector<DepthwiseNetworkLayer> chain;
+	for (int i = 0; i < 5; i++) {
+		chain.push_back(depthwiseNetworkDepthwiseLayer(3, i % 2 + 1, DepthwiseActivationReLU));
+		chain.push_back(depthwiseNetworkPointwiseLayer(8 + 8 * i, DepthwiseActivationNone, -1));
+	}
+	EXPECT(planDepthwiseNetwork(chain, 1, 4, 40, 40, false, plan));
+	EXPECT(plan.bufferSizes.size() == 2);
+	checkBuffers(chain, plan);
+	EXPECT(planDepthwiseNetwork(chain, 1, 4, 40, 40, true, plan));
+	EXPECT(plan.steps.size() == 5 && plan.bufferSizes.size() == 2);
+	checkBuffers(chain, plan);
+
+	// a residual around the whole network reads the network input
+	std::vector<DepthwiseNetworkLayer> block;
+	block.push_back(depthwiseNetworkPointwiseLayer(16, DepthwiseActivationReLU6, -1));
+	block.push_back(depthwiseNetworkDepthwiseLayer(5, 1, DepthwiseActivationReLU6));
+	block.push_back(depthwiseNetworkPointwiseLayer(4, DepthwiseActivationNone, 0));
+	EXPECT(planDepthwiseNetwork(block, 1, 4, 9, 9, true, plan));
+	EXPECT(plan.steps.size() == 2 && plan.steps.back().residualBuffer == DepthwiseNetworkInput);
+	checkBuffers(block, plan);
+
+	// rejected: a residual of another shape, from a later layer, stride 0, no layers
+	block[2].outputChannel = 8;
+	EXPECT(!planDepthwiseNetwork(block, 1, 4, 9, 9, true, plan) && !plan.error.empty());
+	block[2].outputChannel = 4;
+	block[1].residual = 2;
+	EXPECT(!planDepthwiseNetwork(block, 1, 4, 9, 9, true, plan));
+	block[1].residual = -1;
+	block[1].stride = 0;
+	EXPECT(!planDepthwiseNetwork(block, 1, 4, 9, 9, true, plan));
+	EXPECT(!planDepthwiseNetwork(std::vector<DepthwiseNetworkLayer>(), 1, 4, 9, 9, true, plan));
+}
+
+/*
+referenceNetwork():
+	The layers one by one, a new activation per layer, residuals from a copy of every layer input.
+*/
+static std::vector<float> referenceNetwork(const std::vector<DepthwiseNetworkLayer>& layers, const std::vector<float>& input,
+	int batch, int channel, int height, int width) {
+
+	std::vector<std::vector<float> > layerInputs;
+	std::vector<float> activation = input;
+	for (size_t i = 0; i < layers.size(); i++) {
+		const DepthwiseNetworkLayer& layer = layers[i];
+		layerInputs.push_back(activation);
+		std::vector<float> output;
+		if (layer.kind == DepthwiseNetworkDepthwise) {
+			int padding = (layer.filterSize - 1) / 2;
+			int outputHeight = (height + 2 * padding - layer.filterSize) / layer.stride + 1;
+			int outputWidth = (width + 2 * padding - layer.filterSize) / layer.stride + 1;
+			output.resize((size_t)batch * channel * outputHeight * outputWidth);
+			CPU_Depthwise_Generic(activation.data(), static_cast<const float*>(layer.filter), output.data(),
+				batch, channel, height, width,
+				channel, layer.filterSize, layer.filterSize,
+				batch, channel, outputHeight, outputWidth,
+				padding, padding, layer.stride, layer.stride, 1, 1,
+				1.0f, 0.0f, layer.epilogue);
+			height = outputHeight;
+			width = outputWidth;
+		}
+		else {
+			output.resize((size_t)batch * layer.outputChannel * height * width);
+			CPU_Pointwise(activation.data(), static_cast<const float*>(layer.filter), output.data(),
+				batch, channel, height, width,
+				layer.outputChannel,
+				1.0f, 0.0f, layer.epilogue);
+			channel = layer.outputChannel;
+		}
+		if (layer.residual >= 0) {
+			const std::vector<float>& residual = layerInputs[layer.residual];
+			for (size_t j = 0; j < output.size(); j++) {
+				output[j] += residual[j];
+			}
+		}
+		activation.swap(output);
+	}
+	return activation;
+}
+
+// MobileNet V2 with random weights and BatchNorm scales, fused and unfused, against the reference
+static void testMobileNetV2() {
+	const int batch = 1, channel = 32, height = 56, width = 56;
+	std::vector<DepthwiseNetworkLayer> layers = depthwiseMobileNetV2Layers();
+
+	std::mt19937 generator(7);
+	std::vector<std::vector<float> > filters(layers.size());
+	std::vector<std::vector<float> > scales(layers.size());
+	int layerChannel = channel;
+	for (size_t i = 0; i < layers.size(); i++) {
+		DepthwiseNetworkLayer& layer = layers[i];
+		int fanIn = layer.kind == DepthwiseNetworkDepthwise ? layer.filterSize * layer.filterSize : layerChannel;
+		int outputChannel = layer.kind == DepthwiseNetworkDepthwise ? layerChannel : layer.outputChannel;
+		filters[i].resize((size_t)outputChannel * fanIn);
+		randomFill(filters[i], generator, std::sqrt(3.0f / fanIn));
+		scales[i].resize(outputChannel);
+		randomFill(scales[i], generator, 0.5f);
+		for (int c = 0; c < outputChannel; c++) {
+			scales[i][c] += 1.0f;
+		}
+		layer.filter = filters[i].data();
+		layer.epilogue.scale = scales[i].data();
+		layerChannel = outputChannel;
+	}
+
+	std::vector<float> input((size_t)batch * channel * height * width);
+	randomFill(input, generator, 1.0f);
+	std::vector<float> expected = referenceNetwork(layers, input, batch, channel, height, width);
+
+	for (int fuse = 0; fuse < 2; fuse++) {
+		DepthwiseCpuNetwork network;
+		network.layers = layers;
+		EXPECT(network.prepare(batch, channel, height, width, fuse != 0));
+		EXPECT(expected.size() == (size_t)batch * network.plan.outputChannel * network.plan.outputHeight * network.plan.outputWidth);
+
+		size_t workspaceBytes = 0;
+		for (int run = 0; run < 2; run++) {
+			std::vector<float> output(expected.size(), NAN);
+			network.run(input.data(), output.data());
+			double maxError = 0.0;
+			for (size_t i = 0; i < expected.size(); i++) {
+				double error = std::fabs(output[i] - expected[i]) / (1.0 + std::fabs(expected[i]));
+				maxError = error > maxError || error != error ? error : maxError;
+			}
+			if (!(maxError <= 1e-4)) {
+				printf("Wrong! MobileNet V2 %s, run %d: relative error %g\n", fuse ? "fused" : "unfused", run, maxError);
+				failures++;
+			}
+			if (run == 0) {
+				workspaceBytes = network.workspace.bytes();
+			}
+		}
+		EXPECT(workspaceBytes > 0 && network.workspace.bytes() == workspaceBytes);
+	}
+}
+
+int main() {
+	// the default schedules, no tuning file
+	setenv("DEPTHWISE_TUNING", "0", 1);
+
+	testPlan();
+	testMobileNetV2();
+
+	return testResult("Depthwise network executor");
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+
+#include "DepthwiseOccupancy.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the occupancy calculator (DepthwiseOccupancy.h).
+
+Hand computed launches limited by each resource (wave slots, VGPRs, SGPRs, LDS, blocks per CU) on the built in
+targets, launches that do not fit, the dispatch waves of a grid, target overrides, and the resources of the
+kernel variants against their launch geometry: every registry kernel runs on every target.
+*/
+
+static KernelResources kernelResources(int blockSize, int sharedMemoryBytes, int vgprs, int sgprs, int64_t gridBlocks) {
+	KernelResources resources;
+	resources.name = "test";
+	resources.blockSize = blockSize;
+	resources.sharedMemoryBytes = sharedMemoryBytes;
+	resources.vgprs = vgprs;
+	resources.sgprs = sgprs;
+	resources.gridBlocks = gridBlocks;
+	return resources;
+}
+
+static bool near(double value, double expected) {
+	return std::fabs(value - expected) <= 1e-6 * (1.0 + std::fabs(expected));
+}
+
+/*
+checkOccupancy():
+	blocksPerCU, limiter and occupancy of one launch.
+*/
+static void checkOccupancy(const char* targetName, const KernelResources& resources,
+	int blocksPerCU, int limiter, double occupancy) {
+
+	const DcuTarget* target = findDcuTarget(targetName);
+	EXPECT(target != nullptr);
+	if (target == nullptr) {
+		return;
+	}
+	OccupancyReport report = computeOccupancy(*target, resources);
+	if (report.blocksPerCU != blocksPerCU || report.limiter != limiter || !near(report.occupancy, occupancy)) {
+		printf("Wrong! %s: block %d, LDS %d, VGPR %d, SGPR %d: %d blocks per CU (%s), occupancy %f, "
+			"expected %d (%s), %f\n", targetName, resources.blockSize, resources.sharedMemoryBytes,
+			resources.vgprs, resources.sgprs, report.blocksPerCU, occupancyLimiterName(report.limiter),
+			report.occupancy, blocksPerCU, occupancyLimiterName(limiter), occupancy);
+		failures++;
+	}
+}
+
+static void testLimits() {
+	// 4 waves per block; 27 KB of LDS, 2 blocks of 64 KB
+	checkOccupancy("gfx906", kernelResources(256, 27 * 1024, 24, 40, 0), 2, OccupancyLimitedBySharedMemory, 8.0 / 40);
+	// LDS is allocated in granules of 512 bytes: 16385 bytes take 16896, 3 blocks
+	checkOccupancy("gfx906", kernelResources(64, 16385, 24, 40, 0), 3, OccupancyLimitedBySharedMemory, 3.0 / 40);
+	// 65 VGPRs take 68, 3 waves per SIMD, 12 per CU
+	checkOccupancy("gfx906", kernelResources(256, 1024, 65, 40, 0), 3, OccupancyLimitedByVgprs, 12.0 / 40);
+	// 100 SGPRs take 112, 7 waves per SIMD
+	checkOccupancy("gfx906", kernelResources(256, 1024, 24, 100, 0), 7, OccupancyLimitedBySgprs, 28.0 / 40);
+	// single wave blocks: 40 wave slots but 16 blocks per CU
+	checkOccupancy("gfx906", kernelResources(64, 0, 24, 40, 0), 16, OccupancyLimitedByBlocks, 16.0 / 40);
+	// nothing but the wave slots
+	checkOccupancy("dcu", kernelResources(256, 1024, 24, 40, 0), 10, OccupancyLimitedByWaves, 1.0);
+	// partial wave: 224 threads are 4 waves
+	checkOccupancy("dcu", kernelResources(224, 0, 24, 40, 0), 10, OccupancyLimitedByWaves, 1.0);
+
+	// gfx90a: 8 waves per SIMD, 512 VGPRs in granules of 8 (65 take 72, 7 waves)
+	checkOccupancy("gfx90a", kernelResources(256, 1024, 24, 40, 0), 8, OccupancyLimitedByWaves, 1.0);
+	checkOccupancy("gfx90a", kernelResources(256, 1024, 65, 40, 0), 7, OccupancyLimitedByVgprs, 28.0 / 32);
+	checkOccupancy("gfx90a", kernelResources(256, 1024, 300, 40, 0), 1, OccupancyLimitedByVgprs, 4.0 / 32);
+
+	// launches that do not fit
+	checkOccupancy("gfx906", kernelResources(2048, 0, 24, 40, 0), 0, OccupancyDoesNotFit, 0.0);
+	checkOccupancy("gfx906", kernelResources(256, 70000, 24, 40, 0), 0, OccupancyDoesNotFit, 0.0);
+	checkOccupancy("gfx906", kernelResources(256, 1024, 300, 40, 0), 0, OccupancyDoesNotFit, 0.0);
+	checkOccupancy("gfx906", kernelResources(256, 1024, 24, 110, 0), 0, OccupancyDoesNotFit, 0.0);
+	// 16 waves, but 129 VGPRs leave 1 wave per SIMD
+	checkOccupancy("gfx906", kernelResources(1024, 0, 129, 40, 0), 0, OccupancyDoesNotFit, 0.0);
+}
+
+static void testDispatch() {
+	// 2 blocks on each of 64 CUs: 300 blocks are 2 full rounds and 44 of 128 slots
+	OccupancyReport report = computeOccupancy(*findDcuTarget("dcu"), kernelResources(256, 27 * 1024, 24, 40, 300));
+	EXPECT(near(report.dispatchWaves, 300.0 / 128));
+	EXPECT(near(report.lastWaveUtilization, 44.0 / 128));
+
+	report = computeOccupancy(*findDcuTarget("dcu"), kernelResources(256, 27 * 1024, 24, 40, 256));
+	EXPECT(near(report.dispatchWaves, 2.0) && near(report.lastWaveUtilization, 1.0));
+
+	// overrides
+	DcuTarget target = *findDcuTarget("dcu");
+	EXPECT(setDcuTargetField(target, "cu", 60) && target.computeUnits == 60);
+	EXPECT(setDcuTargetField(target, "waves", 8) && target.maxWavesPerSimd == 8);
+	EXPECT(setDcuTargetField(target, "lds", 32 * 1024) && target.ldsBytesPerComputeUnit == 32 * 1024);
+	EXPECT(!setDcuTargetField(target, "cache", 16));
+	EXPECT(!setDcuTargetField(target, "cu", 0));
+	report = computeOccupancy(target, kernelResources(256, 27 * 1024, 24, 40, 300));
+	EXPECT(report.blocksPerCU == 1 && near(report.occupancy, 4.0 / 32) && near(report.dispatchWaves, 5.0));
+
+	EXPECT(findDcuTarget("gfx1100") == nullptr);
+	EXPECT(dcuTargets().size() >= 4 && findDcuTarget(dcuTargets()[0].name) == &dcuTargets()[0]);
+}
+
+static void testKernelResources() {
+	// Depthwise_Generic, 112 x 112, 3 x 3, stride 1: 32 x 8 tiles, filter and a 34 x 10 input tile staged
+	ConvShape shape(112, 112, 3, 3, 1, 1);
+	KernelResources generic = depthwiseGenericResources(shape, 2, 32);
+	EXPECT(generic.blockSize == 256);
+	EXPECT(generic.sharedMemoryBytes == (9 + 34 * 10) * 4);
+	EXPECT(generic.gridBlocks == 4 * 14 * 32 * 2);
+
+	// a given tile
+	generic = depthwiseGenericResources(shape, 1, 32, 16, 16);
+	EXPECT(generic.blockSize == 256 && generic.sharedMemoryBytes == (9 + 18 * 18) * 4 && generic.gridBlocks == 7 * 7 * 32);
+
+	// 31 x 31 with dilation 4: the 152 x 152 input tile does not fit, only the filter is staged
+	generic = depthwiseGenericResources(ConvShape(224, 224, 31, 31, 60, 60, 1, 1, 4, 4), 1, 8, 32, 32);
+	EXPECT(generic.sharedMemoryBytes == 31 * 31 * 4);
+
+	// Depthwise_NHWC, 32 channels: 8 threads across (32 channels), 32 pixels per block
+	KernelResources nhwc = depthwiseNHWCResources(shape, 1, 32);
+	EXPECT(nhwc.blockSize == 256 && nhwc.sharedMemoryBytes == 9 * 32 * 4 && nhwc.gridBlocks == 112 * 112 / 32);
+	nhwc = depthwiseNHWCResources(shape, 1, 576);
+	EXPECT(nhwc.sharedMemoryBytes == 9 * 64 * 4 && nhwc.gridBlocks == 112 * 112 / 16 * 9);
+
+	// Depthwise_RowRollingRect of the 112 x 112 kernel on 112 x 160: 112 threads, two tiles per channel
+	DepthwiseRectKernel rect;
+	EXPECT(findDepthwiseRectKernel(ConvShape(112, 160, 3, 3, 1, 1), 32, rect));
+	KernelResources rectResources = depthwiseRectResources(rect, 2, 32);
+	EXPECT(rectResources.blockSize == 112 && rectResources.sharedMemoryBytes == (9 + 112 * 114) * 4);
+	EXPECT(rectResources.gridBlocks == 2 * 32 * 2);
+	EXPECT(computeOccupancy(dcuTargets()[0], rectResources).blocksPerCU >= 1);
+
+	// every registry kernel fits on every target, with its own geometry
+	const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+	const std::vector<DcuTarget>& targets = dcuTargets();
+	for (size_t i = 0; i < entries.size(); i++) {
+		int channel = entries[i].channelGroupSize * 4;
+		KernelResources resources = depthwiseKernelResources(entries[i], 2, channel);
+		EXPECT(resources.blockSize == entries[i].blockSize);
+		EXPECT(resources.sharedMemoryBytes == entries[i].sharedMemoryBytes);
+		EXPECT(resources.gridBlocks == 2 * entries[i].gridHeight(channel));
+		for (size_t t = 0; t < targets.size(); t++) {
+			OccupancyReport report = computeOccupancy(targets[t], resources);
+			if (report.blocksPerCU < 1 || !(report.occupancy > 0.0f && report.occupancy <= 1.0f)) {
+				printf("Wrong! %s does not run on %s\n", entries[i].name, targets[t].name);
+				failures++;
+			}
+		}
+		OccupancyReport report = computeOccupancy(targets[0], depthwiseGenericResources(entries[i].shape, 2, channel));
+		EXPECT(report.blocksPerCU >= 1);
+	}
+}
+
+int main() {
+	testLimits();
+	testDispatch();
+	testKernelResources();
+
+	return testResult("Depthwise occupancy calculator");
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+
+#define float emu::Float
+#include "DepthwisePointwise_Fused.h"
+#undef float
+
+#include "CPU_DepthwisePointwise.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the fused depthwise separable block.
+
+CPU_DepthwisePointwise() and DepthwisePointwise_Fused (run through the emulator) against CPU_Depthwise()
+followed by a plain pointwise loop. The fused kernel must not write anything but the block output.
+*/
+
+/*
+checkBlock():
+	Run one block shape with the given activations (scale and shift are random when an activation is set).
+	emulate - also run DepthwisePointwise_Fused, only for small shapes
+*/
+static void checkBlock(int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth, int filterHeight, int stride,
+	int outputChannel, int depthwiseActivation, int pointwiseActivation, bool emulate) {
+
+	int padding = (filterHeight - 1) / 2;
+	int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - filterHeight) / stride + 1;
+	int outputPlaneSize = outputHeight * outputWidth;
+
+	std::vector<float> input((size_t)inputBatchNumber * inputChannel * inputHeight * inputWidth);
+	std::vector<float> depthwiseFilter((size_t)inputChannel * filterHeight * filterHeight);
+	std::vector<float> pointwiseFilter((size_t)outputChannel * inputChannel);
+	std::vector<float> depthwiseScale(inputChannel), depthwiseShift(inputChannel);
+	std::vector<float> pointwiseScale(outputChannel), pointwiseShift(outputChannel);
+
+	std::mt19937 generator(inputChannel * 1000 + inputHeight * 10 + outputChannel);
+	randomFill(input, generator);
+	randomFill(depthwiseFilter, generator);
+	randomFill(pointwiseFilter, generator);
+	randomFill(depthwiseScale, generator);
+	randomFill(depthwiseShift, generator);
+	randomFill(pointwiseScale, generator);
+	randomFill(pointwiseShift, generator);
+
+	DepthwiseEpilogue depthwiseEpilogue = depthwiseNoEpilogue;
+	if (depthwiseActivation != DepthwiseActivationNone) {
+		depthwiseEpilogue.scale = depthwiseScale.data();
+		depthwiseEpilogue.shift = depthwiseShift.data();
+		depthwiseEpilogue.activation = depthwiseActivation;
+	}
+	DepthwiseEpilogue pointwiseEpilogue = depthwiseNoEpilogue;
+	if (pointwiseActivation != DepthwiseActivationNone) {
+		pointwiseEpilogue.scale = pointwiseScale.data();
+		pointwiseEpilogue.shift = pointwiseShift.data();
+		pointwiseEpilogue.activation = pointwiseActivation;
+	}
+
+	// unfused: depthwise output through memory, then pointwise
+	std::vector<float> depthwiseOutput((size_t)inputBatchNumber * inputChannel * outputPlaneSize);
+	std::vector<float> expected((size_t)inputBatchNumber * outputChannel * outputPlaneSize);
+	CPU_Depthwise(input.data(), depthwiseFilter.data(), depthwiseOutput.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputWidth,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputWidth,
+		padding, stride,
+		1.0f, 0.0f, depthwiseEpilogue);
+	for (int n = 0; n < inputBatchNumber; n++) {
+		for (int co = 0; co < outputChannel; co++) {
+			DepthwiseChannelEpilogue channelEpilogue(pointwiseEpilogue, co);
+			for (int p = 0; p < outputPlaneSize; p++) {
+				double sum = 0.0;
+				for (int ci = 0; ci < inputChannel; ci++) {
+					sum += (double)pointwiseFilter[(size_t)co * inputChannel + ci] *
+						depthwiseOutput[((size_t)n * inputChannel + ci) * outputPlaneSize + p];
+				}
+				expected[((size_t)n * outputChannel + co) * outputPlaneSize + p] = channelEpilogue.apply((float)sum);
+			}
+		}
+	}
+
+	std::vector<float> output(expected.size(), NAN);
+	const char* names[] = { "CPU_DepthwisePointwise", "DepthwisePointwise_Fused" };
+	for (int run = 0; run < (emulate ? 2 : 1); run++) {
+		std::fill(output.begin(), output.end(), NAN);
+		if (run == 0) {
+			CPU_DepthwisePointwise(input.data(), depthwiseFilter.data(), pointwiseFilter.data(), output.data(),
+				inputBatchNumber, inputChannel, inputHeight, inputWidth,
+				filterHeight, filterHeight,
+				outputChannel, outputHeight, outputWidth,
+				padding, stride,
+				depthwiseEpilogue, pointwiseEpilogue);
+		}
+		else {
+			launchDepthwisePointwise(reinterpret_cast<const emu::Float*>(input.data()),
+				reinterpret_cast<const emu::Float*>(depthwiseFilter.data()),
+				reinterpret_cast<const emu::Float*>(pointwiseFilter.data()),
+				reinterpret_cast<emu::Float*>(output.data()),
+				inputBatchNumber, inputChannel, inputHeight, inputWidth,
+				filterHeight, filterHeight,
+				outputChannel, outputHeight, outputWidth,
+				padding, stride,
+				depthwiseEpilogue, pointwiseEpilogue);
+
+			emu::BlockStatistics total = emu::lastLaunchStatistics().total();
+			if (total.globalStores != (long)output.size()) {
+				printf("Wrong! %s: %ld global stores for %d outputs\n", names[run], total.globalStores, (int)output.size());
+				failures++;
+			}
+		}
+
+		for (size_t i = 0; i < output.size(); i++) {
+			if (!(std::fabs(output[i] - expected[i]) <= 1e-3f * (1.0f + std::fabs(expected[i])))) {
+				printf("Wrong! %s (C = %d -> %d, H = %d, W = %d, filter %d, stride %d): output %d is %f, expected %f\n",
+					names[run], inputChannel, outputChannel, inputHeight, inputWidth, filterHeight, stride,
+					(int)i, output[i], expected[i]);
+				failures++;
+				break;
+			}
+		}
+	}
+}
+
+int main() {
+	// emulated, odd sizes and channel numbers to cover the partial tiles
+	checkBlock(1, 24, 20, 20, 3, 1, 40, DepthwiseActivationNone, DepthwiseActivationNone, true);
+	checkBlock(2, 20, 15, 13, 5, 2, 70, DepthwiseActivationReLU6, DepthwiseActivationNone, true);
+	checkBlock(1, 32, 14, 14, 3, 1, 16, DepthwiseActivationSiLU, DepthwiseActivationHardSwish, true);
+	checkBlock(1, 8, 9, 9, 7, 1, 8, DepthwiseActivationReLU, DepthwiseActivationReLU6, true);
+
+	// CPU only, MobileNet V2 blocks
+	checkBlock(2, 32, 112, 112, 3, 1, 16, DepthwiseActivationReLU6, DepthwiseActivationNone, false);
+	checkBlock(1, 144, 56, 56, 3, 2, 24, DepthwiseActivationReLU6, DepthwiseActivationNone, false);
+	checkBlock(1, 960, 7, 7, 3, 1, 160, DepthwiseActivationReLU6, DepthwiseActivationNone, false);
+	checkBlock(1, 240, 28, 28, 5, 1, 80, DepthwiseActivationSiLU, DepthwiseActivationNone, false);
+
+	return testResult("Depthwise pointwise block");
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "DepthwiseRegistry.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the kernel registry, no DCU needed.
+
+Checks that every depthwise layer of the benchmarked networks is dispatched to the kernel it was written for,
+that unsupported shapes fall back to the generic kernel, and that the launch geometry of every entry is valid.
+Rectangular feature maps (224 x 320 and 360 x 640 video frames) find the kernel of their height or width.
+*/
+
+static const char* findKernelName(int channel, int inputHeight, int inputWidth, int filterSize, int padding, int stride) {
+	const DepthwiseKernelEntry* entry = findDepthwiseKernel(
+		ConvShape(inputHeight, inputWidth, filterSize, filterSize, padding, stride), channel);
+	return entry ? entry->name : "";
+}
+
+static void testNetworkLayers() {
+	// channel, input size, filter size, stride, expected kernel
+	struct {
+		int channel;
+		int inputHeight;
+		int filterSize;
+		int stride;
+		const char* kernel;
+	} layers[] = {
+		// MobileNet V2
+		{32, 112, 3, 1, "Filter3x3_Input112x112_Stride1"},
+		{96, 112, 3, 2, "Filter3x3_Input112x112_Stride2"},
+		{144, 56, 3, 1, "Filter3x3_Input56x56_Stride1"},
+		{144, 56, 3, 2, "Filter3x3_Input56x56_Stride2"},
+		{192, 28, 3, 1, "Filter3x3_Input28x28_Stride1"},
+		{192, 28, 3, 2, "Filter3x3_Input28x28_Stride2"},
+		{384, 14, 3, 1, "Filter3x3_Input14x14_Stride1"},
+		{576, 14, 3, 1, "Filter3x3_Input14x14_Stride1"},
+		{576, 14, 3, 2, "Filter3x3_Input14x14_Stride2"},
+		{960, 7, 3, 1, "Filter3x3_Input7x7_Stride1"},
+		// EfficientNet B0
+		{144, 56, 5, 2, "Filter5x5_Input56x56_Stride2"},
+		{240, 28, 5, 1, "Filter5x5_Input28x28_Stride1"},
+		{480, 14, 5, 1, "Filter5x5_Input14x14_Stride1"},
+		{672, 14, 5, 2, "Filter5x5_Input14x14_Stride2"},
+		{1152, 7, 5, 1, "Filter5x5_Input7x7_Stride1"},
+	};
+
+	for (size_t i = 0; i < sizeof(layers) / sizeof(layers[0]); i++) {
+		const char* name = findKernelName(layers[i].channel, layers[i].inputHeight, layers[i].inputHeight,
+			layers[i].filterSize, (layers[i].filterSize - 1) / 2, layers[i].stride);
+		if (strcmp(name, layers[i].kernel) != 0) {
+			printf("Wrong! C = %d, H = %d, K = %d, S = %d: expected %s, got '%s'\n",
+				layers[i].channel, layers[i].inputHeight, layers[i].filterSize, layers[i].stride, layers[i].kernel, name);
+			failures++;
+		}
+	}
+}
+
+static void testFallback() {
+	// channel number not multiple of the channel group size
+	EXPECT(findDepthwiseKernel(ConvShape(7, 7, 3, 3, 1, 1), 48) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(56, 56, 3, 3, 1, 2), 3) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(14, 14, 3, 3, 1, 1), 0) == nullptr);
+	// no kernel for the size
+	EXPECT(findDepthwiseKernel(ConvShape(96, 96, 3, 3, 1, 1), 32) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(7, 7, 3, 3, 1, 2), 32) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(14, 14, 7, 7, 3, 1), 32) == nullptr);
+	// rectangular input or filter
+	EXPECT(findDepthwiseKernel(ConvShape(14, 28, 3, 3, 1, 1), 32) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(14, 14, 3, 5, 1, 1), 32) == nullptr);
+	// padding, stride or dilation the kernels are not written for
+	EXPECT(findDepthwiseKernel(ConvShape(14, 14, 3, 3, 0, 1), 32) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(14, 14, 3, 3, 1, 1, 1, 2, 1, 1), 32) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(14, 14, 3, 3, 2, 2, 1, 1, 2, 2), 32) == nullptr);
+	// shapes out of the key range
+	EXPECT(findDepthwiseKernel(ConvShape(0, 0, 3, 3, 1, 1), 32) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(1 << 12, 1 << 12, 3, 3, 1, 1), 32) == nullptr);
+	EXPECT(findDepthwiseKernel(ConvShape(14, 14, 3, 3, 1, 16), 32) == nullptr);
+}
+
+static void testEntries() {
+	const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+	EXPECT((int)entries.size() == DepthwiseKernelNumber);
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		const DepthwiseKernelEntry& entry = entries[i];
+		EXPECT(entry.id == (int)i);
+		EXPECT(entry.blockSize > 0 && entry.blockSize <= 1024);
+		EXPECT(entry.sharedMemoryBytes > 0 && entry.sharedMemoryBytes <= 64 * 1024);
+		EXPECT(entry.channelGroupSize > 0 && entry.blocksPerChannelGroup > 0);
+
+		// every entry is found under its own shape, and shapes are unique
+		EXPECT(findDepthwiseKernel(entry.shape, entry.channelGroupSize) == &entry);
+		for (size_t j = 0; j < i; j++) {
+			EXPECT(!(entries[j].shape == entry.shape));
+		}
+
+		// grid covers the channels
+		EXPECT(entry.gridHeight(entry.channelGroupSize * 3) == 3 * entry.blocksPerChannelGroup);
+	}
+}
+
+static void testRectangular() {
+	DepthwiseRectKernel rect;
+
+	// 224 x 320 frames through MobileNet V2: the height matches from 112 x 160 on, the tiles cover the width
+	EXPECT(findDepthwiseRectKernel(ConvShape(112, 160, 3, 3, 1, 1), 32, rect));
+	EXPECT(strcmp(rect.entry->name, "Filter3x3_Input112x112_Stride1") == 0 && !rect.transposed);
+	EXPECT(rect.tileNumber == 2 && rect.blockSize == 112);
+	EXPECT(findDepthwiseRectKernel(ConvShape(56, 80, 3, 3, 1, 2), 144, rect));
+	EXPECT(strcmp(rect.entry->name, "Filter3x3_Input56x56_Stride2") == 0 && !rect.transposed);
+	EXPECT(rect.tileNumber == 2 && rect.blockSize == 28 * 2);
+	EXPECT(findDepthwiseRectKernel(ConvShape(7, 10, 5, 5, 2, 1), 960, rect));
+	EXPECT(strcmp(rect.entry->name, "Filter5x5_Input7x7_Stride1") == 0 && rect.tileNumber == 2);
+
+	// only the width matches: transposed
+	EXPECT(findDepthwiseRectKernel(ConvShape(45, 28, 3, 3, 1, 1), 64, rect));
+	EXPECT(strcmp(rect.entry->name, "Filter3x3_Input28x28_Stride1") == 0 && rect.transposed);
+	EXPECT(rect.tileNumber == 2 && rect.blockSize == 28 * 8);
+	// both match: the height is preferred
+	EXPECT(findDepthwiseRectKernel(ConvShape(14, 28, 3, 3, 1, 1), 64, rect));
+	EXPECT(strcmp(rect.entry->name, "Filter3x3_Input14x14_Stride1") == 0 && !rect.transposed);
+
+	// a block never holds more shared memory than the square kernel of the same size
+	const std::vector<DepthwiseKernelEntry>& entries = depthwiseKernelEntries();
+	for (size_t i = 0; i < entries.size(); i++) {
+		const ConvShape& shape = entries[i].shape;
+		ConvShape wide(shape.inputHeight, 3 * shape.inputHeight + 1, shape.filterHeight, shape.filterWidth,
+			shape.paddingHeight, shape.strideHeight);
+		EXPECT(findDepthwiseRectKernel(wide, entries[i].channelGroupSize, rect) && rect.entry == &entries[i]);
+		EXPECT(rect.tileNumber == (wide.outputWidth() + shape.outputWidth() - 1) / shape.outputWidth());
+		EXPECT(rect.blockSize > 0 && rect.blockSize <= 1024 && rect.sharedMemoryBytes <= 64 * 1024);
+	}
+
+	// 360 x 640 frames: 45 x 80 and 90 x 160 have no kernel; square, dilated and non "same" shapes are not rectangular
+	EXPECT(!findDepthwiseRectKernel(ConvShape(45, 80, 3, 3, 1, 1), 64, rect));
+	EXPECT(!findDepthwiseRectKernel(ConvShape(90, 160, 3, 3, 1, 2), 64, rect));
+	EXPECT(!findDepthwiseRectKernel(ConvShape(56, 56, 3, 3, 1, 1), 64, rect));
+	EXPECT(!findDepthwiseRectKernel(ConvShape(56, 80, 3, 3, 2, 2, 1, 1, 2, 2), 64, rect));
+	EXPECT(!findDepthwiseRectKernel(ConvShape(56, 80, 3, 3, 0, 1), 64, rect));
+	EXPECT(!findDepthwiseRectKernel(ConvShape(56, 80, 3, 3, 1, 2), 63, rect));
+}
+
+int main() {
+	testNetworkLayers();
+	testFallback();
+	testEntries();
+	testRectangular();
+
+	return testResult("Depthwise registry");
+}
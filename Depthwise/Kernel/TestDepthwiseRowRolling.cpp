@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include <hip/hip_runtime.h>
+
+#include "DepthwiseEpilogue.h"
+#include "Filter3x3_Input7x7_Stride1.h"
+#include "Filter3x3_Input14x14_Stride1.h"
+#include "Filter3x3_Input14x14_Stride2.h"
+#include "Filter3x3_Input28x28_Stride1.h"
+#include "Filter3x3_Input28x28_Stride2.h"
+#include "Filter3x3_Input56x56_Stride2.h"
+#include "Filter5x5_Input7x7_Stride1.h"
+#include "Filter5x5_Input14x14_Stride1.h"
+#include "Filter5x5_Input14x14_Stride2.h"
+#include "Filter5x5_Input28x28_Stride1.h"
+#include "Filter5x5_Input56x56_Stride2.h"
+#include "Depthwise_RowRolling.h"
+#include "DepthwiseRegistry.h"
+#include "CPU_Depthwise.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of Depthwise_RowRolling, run through the host emulator.
+
+1) Every instantiation that matches a hand-written kernel must give bit-exact the same output.
+2) The generated kernels registered for new resolutions must match the CPU backend.
+3) Depthwise_RowRollingRect on a square input is bit-exact with Depthwise_RowRolling, transposed too (on the
+   transposed input and filter). Rectangular inputs are checked in TestDepthwiseEmulator.cpp.
+*/
+
+typedef void (*DepthwiseKernelFunction)(const float* input, const float* filter, float* output,
+	int inputBatchNumber, int inputChannel, int inputHeight, int inputWidth,
+	int filterLayerNumber, int filterHeight, int filterWidth,
+	int outputBatchNumber, int outputChannel, int outputHeight, int outputWidth,
+	int padding, int stride,
+	float alpha, float beta, DepthwiseEpilogue epilogue);
+
+/*
+runKernel():
+	Run a kernel on random data with the launch geometry of the hand-written kernels and return its output.
+*/
+static std::vector<float> runKernel(DepthwiseKernelFunction kernel, int inputBatchNumber, int inputChannel, int inputHeight,
+	int filterHeight, int stride, int channelGroupSize, int blocksPerChannelGroup, int blockSize) {
+
+	int padding = (filterHeight - 1) / 2;
+	int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+
+	std::vector<float> input(inputBatchNumber * inputChannel * inputHeight * inputHeight);
+	std::vector<float> filter(inputChannel * filterHeight * filterHeight);
+	std::vector<float> output(inputBatchNumber * inputChannel * outputHeight * outputHeight, NAN);
+
+	std::mt19937 generator(inputHeight * 100 + filterHeight * 10 + stride);
+	randomFill(input, generator, 5.0f);
+	randomFill(filter, generator, 5.0f);
+
+	dim3 gridSize(inputBatchNumber, inputChannel / channelGroupSize * blocksPerChannelGroup);
+	hipLaunchKernelGGL(kernel, gridSize, dim3(blockSize, 1), 0, 0,
+		input.data(), filter.data(), output.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputHeight,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputHeight,
+		padding, stride,
+		1.0f, 0.0f, depthwiseNoEpilogue);
+	return output;
+}
+
+template <int InputSize, int FilterSize, int Stride, int ChannelGroupSize>
+static void compareWithHandWritten(DepthwiseKernelFunction handWritten, const char* name) {
+	typedef RowRollingSchedule<InputSize, FilterSize, Stride> Schedule;
+	int inputBatchNumber = 2;
+	int inputChannel = 2 * ChannelGroupSize;
+	int blockSize = Schedule::outputSize * ChannelGroupSize;
+
+	std::vector<float> expected = runKernel(handWritten, inputBatchNumber, inputChannel, InputSize, FilterSize, Stride,
+		ChannelGroupSize, 1, blockSize);
+	std::vector<float> generated = runKernel(Depthwise_RowRolling<float, InputSize, FilterSize, Stride, ChannelGroupSize>,
+		inputBatchNumber, inputChannel, InputSize, FilterSize, Stride, ChannelGroupSize, 1, blockSize);
+
+	if (memcmp(expected.data(), generated.data(), expected.size() * sizeof(float)) != 0) {
+		int mismatch = 0;
+		for (size_t i = 0; i < expected.size(); i++) {
+			mismatch += memcmp(&expected[i], &generated[i], sizeof(float)) != 0;
+		}
+		printf("Wrong! Depthwise_RowRolling<%d, %d, %d, %d> differs from %s in %d of %d outputs\n",
+			InputSize, FilterSize, Stride, ChannelGroupSize, name, mismatch, (int)expected.size());
+		failures++;
+	}
+}
+
+/*
+compareWithCPU():
+	Run a registered kernel with the geometry from the registry and compare it with CPU_Depthwise.
+*/
+static void compareWithCPU(DepthwiseKernelFunction kernel, int inputHeight, int filterHeight, int stride) {
+	int padding = (filterHeight - 1) / 2;
+	int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+
+	const DepthwiseKernelEntry* entry = findDepthwiseKernel(
+		ConvShape(inputHeight, inputHeight, filterHeight, filterHeight, padding, stride), 64);
+	if (entry == nullptr) {
+		printf("Wrong! no kernel registered for input %d, filter %d, stride %d\n", inputHeight, filterHeight, stride);
+		failures++;
+		return;
+	}
+
+	int inputBatchNumber = 2;
+	int inputChannel = 2 * entry->channelGroupSize;
+	std::vector<float> output = runKernel(kernel, inputBatchNumber, inputChannel, inputHeight, filterHeight, stride,
+		entry->channelGroupSize, entry->blocksPerChannelGroup, entry->blockSize);
+
+	// same data as runKernel()
+	std::vector<float> input(inputBatchNumber * inputChannel * inputHeight * inputHeight);
+	std::vector<float> filter(inputChannel * filterHeight * filterHeight);
+	std::vector<float> expected(output.size());
+	std::mt19937 generator(inputHeight * 100 + filterHeight * 10 + stride);
+	randomFill(input, generator, 5.0f);
+	randomFill(filter, generator, 5.0f);
+	CPU_Depthwise(input.data(), filter.data(), expected.data(),
+		inputBatchNumber, inputChannel, inputHeight, inputHeight,
+		inputChannel, filterHeight, filterHeight,
+		inputBatchNumber, inputChannel, outputHeight, outputHeight,
+		padding, stride,
+		1.0f, 0.0f, depthwiseNoEpilogue);
+
+	for (size_t i = 0; i < output.size(); i++) {
+		if (!(std::fabs(output[i] - expected[i]) <= 1e-3f * (1.0f + std::fabs(expected[i])))) {
+			printf("Wrong! %s: output %d is %f, expected %f\n", entry->name, (int)i, output[i], expected[i]);
+			failures++;
+			return;
+		}
+	}
+}
+
+// Transpose every plane of a (planes, height, width) array
+static std::vector<float> transposePlanes(const std::vector<float>& data, int planes, int height, int width) {
+	std::vector<float> transposed(data.size());
+	for (int p = 0; p < planes; p++) {
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				transposed[((size_t)p * width + x) * height + y] = data[((size_t)p * height + y) * width + x];
+			}
+		}
+	}
+	return transposed;
+}
+
+/*
+compareRectWithSquare():
+	One tile of Depthwise_RowRollingRect on a square input against Depthwise_RowRolling, bit-exact. The transposed
+	kernel on input and filter must give the transposed output of Depthwise_RowRolling on their transposes.
+*/
+template <int InputSize, int FilterSize, int Stride, int ChannelGroupSize>
+static void compareRectWithSquare() {
+	typedef RowRollingSchedule<InputSize, FilterSize, Stride> Schedule;
+	const int outputSize = Schedule::outputSize;
+	int inputBatchNumber = 2;
+	int inputChannel = 2 * ChannelGroupSize;
+	int planes = inputBatchNumber * inputChannel;
+
+	std::mt19937 generator(InputSize * 100 + FilterSize * 10 + Stride);
+	std::vector<float> input((size_t)planes * InputSize * InputSize);
+	std::vector<float> filter((size_t)inputChannel * FilterSize * FilterSize);
+	randomFill(input, generator, 5.0f);
+	randomFill(filter, generator, 5.0f);
+	std::vector<float> inputT = transposePlanes(input, planes, InputSize, InputSize);
+	std::vector<float> filterT = transposePlanes(filter, inputChannel, FilterSize, FilterSize);
+
+	dim3 gridSize(inputBatchNumber, inputChannel / ChannelGroupSize);
+	dim3 rectGridSize(inputBatchNumber, inputChannel / ChannelGroupSize, 1);
+	dim3 blockSize(outputSize * ChannelGroupSize, 1);
+	for (int transposed = 0; transposed < 2; transposed++) {
+		std::vector<float> expected((size_t)planes * outputSize * outputSize, NAN);
+		std::vector<float> rect(expected.size(), NAN);
+		hipLaunchKernelGGL((Depthwise_RowRolling<float, InputSize, FilterSize, Stride, ChannelGroupSize>), gridSize, blockSize, 0, 0,
+			(transposed ? inputT : input).data(), (transposed ? filterT : filter).data(), expected.data(),
+			inputBatchNumber, inputChannel, InputSize, InputSize,
+			inputChannel, FilterSize, FilterSize,
+			inputBatchNumber, inputChannel, outputSize, outputSize,
+			Schedule::padding, Stride,
+			1.0f, 0.0f, depthwiseNoEpilogue);
+		if (transposed) {
+			hipLaunchKernelGGL((Depthwise_RowRollingRect<float, InputSize, FilterSize, Stride, ChannelGroupSize, true>), rectGridSize, blockSize, 0, 0,
+				input.data(), filter.data(), rect.data(),
+				inputBatchNumber, inputChannel, InputSize, InputSize,
+				inputChannel, FilterSize, FilterSize,
+				inputBatchNumber, inputChannel, outputSize, outputSize,
+				Schedule::padding, Stride,
+				1.0f, 0.0f, depthwiseNoEpilogue);
+			expected = transposePlanes(expected, planes, outputSize, outputSize);
+		}
+		else {
+			hipLaunchKernelGGL((Depthwise_RowRollingRect<float, InputSize, FilterSize, Stride, ChannelGroupSize, false>), rectGridSize, blockSize, 0, 0,
+				input.data(), filter.data(), rect.data(),
+				inputBatchNumber, inputChannel, InputSize, InputSize,
+				inputChannel, FilterSize, FilterSize,
+				inputBatchNumber, inputChannel, outputSize, outputSize,
+				Schedule::padding, Stride,
+				1.0f, 0.0f, depthwiseNoEpilogue);
+		}
+		if (memcmp(expected.data(), rect.data(), expected.size() * sizeof(float)) != 0) {
+			printf("Wrong! Depthwise_RowRollingRect<%d, %d, %d, %d>%s differs from Depthwise_RowRolling on a square input\n",
+				InputSize, FilterSize, Stride, ChannelGroupSize, transposed ? " transposed" : "");
+			failures++;
+		}
+	}
+}
+
+int main() {
+	// stride 1
+	compareWithHandWritten<7, 3, 1, 32>(Filter3x3_Input7x7_Stride1, "Filter3x3_Input7x7_Stride1");
+	compareWithHandWritten<14, 3, 1, 16>(Filter3x3_Input14x14_Stride1, "Filter3x3_Input14x14_Stride1");
+	compareWithHandWritten<28, 3, 1, 8>(Filter3x3_Input28x28_Stride1, "Filter3x3_Input28x28_Stride1");
+	compareWithHandWritten<7, 5, 1, 32>(Filter5x5_Input7x7_Stride1, "Filter5x5_Input7x7_Stride1");
+	compareWithHandWritten<14, 5, 1, 16>(Filter5x5_Input14x14_Stride1, "Filter5x5_Input14x14_Stride1");
+	compareWithHandWritten<28, 5, 1, 8>(Filter5x5_Input28x28_Stride1, "Filter5x5_Input28x28_Stride1");
+
+	// stride 2
+	compareWithHandWritten<14, 3, 2, 32>(Filter3x3_Input14x14_Stride2, "Filter3x3_Input14x14_Stride2");
+	compareWithHandWritten<28, 3, 2, 8>(Filter3x3_Input28x28_Stride2, "Filter3x3_Input28x28_Stride2");
+	compareWithHandWritten<56, 3, 2, 2>(Filter3x3_Input56x56_Stride2, "Filter3x3_Input56x56_Stride2");
+	compareWithHandWritten<14, 5, 2, 32>(Filter5x5_Input14x14_Stride2, "Filter5x5_Input14x14_Stride2");
+	compareWithHandWritten<56, 5, 2, 2>(Filter5x5_Input56x56_Stride2, "Filter5x5_Input56x56_Stride2");
+
+	// generated kernels registered in DepthwiseKernelList.h
+#define DEPTHWISE_KERNEL(name, ...)
+#define DEPTHWISE_ROW_ROLLING_KERNEL(name, inputHeight, filterSize, stride, channelGroupSize) \
+	compareWithCPU(Depthwise_RowRolling<float, inputHeight, filterSize, stride, channelGroupSize>, inputHeight, filterSize, stride);
+#include "DepthwiseKernelList.h"
+#undef DEPTHWISE_KERNEL
+#undef DEPTHWISE_ROW_ROLLING_KERNEL
+
+	// rectangular inputs
+	compareRectWithSquare<14, 3, 1, 16>();
+	compareRectWithSquare<28, 5, 1, 8>();
+	compareRectWithSquare<56, 3, 2, 2>();
+	compareRectWithSquare<10, 5, 2, 32>();
+	compareRectWithSquare<7, 5, 1, 32>();
+
+
+	return testResult("Depthwise row rolling kernels");
+}
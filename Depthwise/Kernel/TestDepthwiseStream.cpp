@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CPU_DepthwiseStream.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the out-of-core depthwise convolution (CPU_DepthwiseStream.h).
+
+CPU_Depthwise_Stream() against CPU_Depthwise_Generic() on the whole tensor, bit for bit, for band heights that do
+and do not divide the output, strides larger than the filter, dilation and an epilogue. The source counts the
+reads: every input row is read at most once and never more than a band (with its halo) at a time. The band memory
+does not grow with the image height. Then a raw file through DepthwiseMappedSource / DepthwiseFileSink, a file of
+the wrong size and a failing sink.
+*/
+
+/*
+MemorySource:
+	A whole tensor in memory, counting how often every input row is read and the largest read.
+*/
+struct MemorySource {
+	const std::vector<float>* input;
+	int channel;
+	int height;
+	int width;
+	std::vector<int> reads;
+	int largestRead;
+
+	bool read(int n, int c, int firstRow, int rowNumber, float* rows, size_t pitch) {
+		largestRead = std::max(largestRead, rowNumber);
+		for (int row = 0; row < rowNumber; row++) {
+			size_t index = ((size_t)n * channel + c) * height + firstRow + row;
+			reads[index]++;
+			std::copy(input->begin() + index * width, input->begin() + (index + 1) * width, rows + (size_t)row * pitch);
+		}
+		return true;
+	}
+};
+
+/*
+MemorySink:
+	Writes into a tensor, failing after failAfter writes (-1: never).
+*/
+struct MemorySink {
+	std::vector<float>* output;
+	int channel;
+	int height;
+	int width;
+	int failAfter;
+
+	bool write(int n, int c, int firstRow, int rowNumber, const float* rows) {
+		if (failAfter == 0) {
+			return false;
+		}
+		failAfter--;
+		size_t index = ((size_t)n * channel + c) * height + firstRow;
+		std::copy(rows, rows + (size_t)rowNumber * width, output->begin() + index * width);
+		return true;
+	}
+};
+
+/*
+checkStream():
+	One problem streamed with bands of bandRows output rows, against the whole tensor.
+*/
+static void checkStream(int batch, int channel, int inputHeight, int inputWidth, int filterSize, int stride,
+	int padding, int dilation, int activation, int bandRows) {
+
+	int extent = (filterSize - 1) * dilation + 1;
+	int outputHeight = (inputHeight + 2 * padding - extent) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - extent) / stride + 1;
+
+	std::mt19937 generator(inputHeight * 100 + filterSize * 10 + stride + bandRows);
+	std::vector<float> input((size_t)batch * channel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)channel * filterSize * filterSize);
+	std::vector<float> scale(channel), shift(channel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(scale, generator);
+	randomFill(shift, generator);
+	DepthwiseEpilogue epilogue = { scale.data(), shift.data(), activation };
+	if (activation == DepthwiseActivationNone) {
+		epilogue = depthwiseNoEpilogue;
+	}
+
+	size_t outputSize = (size_t)batch * channel * outputHeight * outputWidth;
+	std::vector<float> expected(outputSize);
+	CPU_Depthwise_Generic(input.data(), filter.data(), expected.data(),
+		batch, channel, inputHeight, inputWidth,
+		channel, filterSize, filterSize,
+		batch, channel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue);
+
+	MemorySource source = { &input, channel, inputHeight, inputWidth,
+		std::vector<int>((size_t)batch * channel * inputHeight, 0), 0 };
+	std::vector<float> output(outputSize, NAN);
+	MemorySink sink = { &output, channel, outputHeight, outputWidth, -1 };
+	DepthwiseStreamSchedule schedule = { bandRows, 0 };
+	DepthwiseCpuWorkspace workspace;
+	bool streamed = CPU_Depthwise_Stream(source, filter.data(), sink,
+		batch, channel, inputHeight, inputWidth,
+		filterSize, filterSize, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue, schedule, &workspace);
+
+	int mismatches = 0;
+	for (size_t i = 0; i < outputSize; i++) {
+		mismatches += !(output[i] == expected[i]);
+	}
+	int rereads = 0;
+	for (size_t i = 0; i < source.reads.size(); i++) {
+		rereads += source.reads[i] > 1;
+	}
+	int band = bandRows > 0 ? std::min(bandRows, outputHeight) : std::min(depthwiseStreamBandRows, outputHeight);
+	if (!streamed || mismatches != 0 || rereads != 0 || source.largestRead > (band - 1) * stride + extent) {
+		printf("Wrong! %dx%dx%dx%d filter %d stride %d padding %d dilation %d band %d: %d mismatches, %d rows read twice, "
+			"largest read %d rows\n", batch, channel, inputHeight, inputWidth, filterSize, stride, padding, dilation, bandRows,
+			mismatches, rereads, source.largestRead);
+		failures++;
+	}
+	size_t bandBytes = depthwiseStreamBytes(inputWidth, filterSize, filterSize, outputHeight, outputWidth,
+		padding, stride, stride, dilation, dilation, schedule);
+	EXPECT(workspace.bytes() >= bandBytes && workspace.bytes() < 2 * bandBytes);
+}
+
+static void testBands() {
+	checkStream(1, 3, 37, 41, 3, 1, 1, 1, DepthwiseActivationNone, 8);
+	checkStream(2, 2, 40, 33, 3, 1, 1, 1, DepthwiseActivationReLU6, 1);
+	checkStream(1, 2, 41, 40, 3, 2, 1, 1, DepthwiseActivationNone, 5);
+	checkStream(1, 2, 50, 29, 5, 2, 2, 1, DepthwiseActivationHardSwish, 7);
+	checkStream(1, 2, 45, 38, 5, 1, 2, 1, DepthwiseActivationSiLU, 0);
+	checkStream(1, 2, 36, 36, 3, 1, 2, 2, DepthwiseActivationReLU, 6);
+	checkStream(1, 1, 33, 30, 5, 1, 8, 4, DepthwiseActivationNone, 4);
+	checkStream(1, 2, 30, 31, 7, 1, 3, 1, DepthwiseActivationNone, 9);
+	// the filter spans fewer rows than the stride: rows between the bands are never read
+	checkStream(1, 2, 30, 30, 1, 3, 0, 1, DepthwiseActivationNone, 4);
+	// one band larger than the output, no padding
+	checkStream(1, 2, 12, 20, 3, 1, 0, 1, DepthwiseActivationNone, 100);
+}
+
+// the band memory depends on the width and the band, not on the height
+static void testMemory() {
+	DepthwiseStreamSchedule schedule = { 32, 0 };
+	size_t small = depthwiseStreamBytes(4096, 3, 3, 1000, 4096, 1, 1, 1, 1, 1, schedule);
+	size_t large = depthwiseStreamBytes(4096, 3, 3, 1000000, 4096, 1, 1, 1, 1, 1, schedule);
+	EXPECT(small == large);
+	EXPECT(small == ((size_t)34 * (4098 + 2 * CPU_VECTOR_WIDTH) + (size_t)32 * 4096) * sizeof(float));
+	DepthwiseStreamSchedule wide = { 64, 0 };
+	EXPECT(depthwiseStreamBytes(4096, 3, 3, 1000, 4096, 1, 1, 1, 1, 1, wide) > small);
+}
+
+static void testFiles() {
+	const int batch = 1, channel = 3, height = 70, width = 50;
+	char inputPath[] = "/tmp/depthwiseStreamInputXXXXXX";
+	char outputPath[] = "/tmp/depthwiseStreamOutputXXXXXX";
+	int inputFile = mkstemp(inputPath);
+	int outputFile = mkstemp(outputPath);
+	EXPECT(inputFile >= 0 && outputFile >= 0);
+	if (inputFile < 0 || outputFile < 0) {
+		return;
+	}
+	::close(outputFile);
+
+	std::mt19937 generator(3);
+	std::vector<float> input((size_t)batch * channel * height * width);
+	std::vector<float> filter((size_t)channel * 9);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	EXPECT(::write(inputFile, input.data(), input.size() * sizeof(float)) == (ssize_t)(input.size() * sizeof(float)));
+	::close(inputFile);
+
+	std::vector<float> expected(input.size());
+	CPU_Depthwise_Generic(input.data(), filter.data(), expected.data(),
+		batch, channel, height, width, channel, 3, 3, batch, channel, height, width,
+		1, 1, 1, 1, 1, 1, 1.0f, 0.0f, depthwiseNoEpilogue);
+
+	DepthwiseMappedSource source;
+	DepthwiseFileSink sink;
+	EXPECT(source.open(inputPath, batch, channel, height, width));
+	EXPECT(sink.open(outputPath, batch, channel, height, width));
+	DepthwiseStreamSchedule schedule = { 16, 0 };
+	EXPECT(CPU_Depthwise_Stream(source, filter.data(), sink,
+		batch, channel, height, width, 3, 3, height, width,
+		1, 1, 1, 1, 1, 1, 1.0f, 0.0f, depthwiseNoEpilogue, schedule));
+	EXPECT(sink.close());
+
+	std::vector<float> output(expected.size(), NAN);
+	FILE* file = fopen(outputPath, "rb");
+	EXPECT(file != nullptr && fread(output.data(), sizeof(float), output.size(), file) == output.size());
+	if (file != nullptr) {
+		EXPECT(fgetc(file) == EOF);
+		fclose(file);
+	}
+	EXPECT(output == expected);
+
+	// a file of another shape is rejected
+	DepthwiseMappedSource wrong;
+	EXPECT(!wrong.open(inputPath, batch, channel, height + 1, width) && !wrong.error.empty());
+	EXPECT(!wrong.open("/nonexistent/depthwise.raw", batch, channel, height, width));
+
+	// a failing sink stops the stream
+	MemorySource memory = { &input, channel, height, width, std::vector<int>((size_t)batch * channel * height, 0), 0 };
+	MemorySink failing = { &output, channel, height, width, 2 };
+	EXPECT(!CPU_Depthwise_Stream(memory, filter.data(), failing,
+		batch, channel, height, width, 3, 3, height, width,
+		1, 1, 1, 1, 1, 1, 1.0f, 0.0f, depthwiseNoEpilogue, schedule));
+
+	remove(inputPath);
+	remove(outputPath);
+}
+
+int main() {
+	testBands();
+	testMemory();
+	testFiles();
+
+	return testResult("Depthwise streaming");
+}
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CPU_DepthwiseTuning.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the autotuner.
+
+CPU_Depthwise_Scheduled() against CPU_Depthwise_Generic() for row bands and thread numbers (the schedule must
+not change a single bit), the tuning file (round trip, other hosts kept, other versions ignored, a stored
+variant that is no longer a candidate is tuned again, writers sharing the file keep each other's records), and CPU_Depthwise_Tuned() end to end: the first call
+tunes and writes the record, the result is the one of CPU_Depthwise_Generic(). A workspace reused across layers
+gives the same results and stops growing once it has seen the largest one.
+*/
+
+static const char* tuningPath = "TestDepthwiseTuning.txt";
+
+/*
+checkSchedule():
+	Every schedule gives the output of CPU_Depthwise_Generic(), bit for bit.
+*/
+static void checkSchedule(int batch, int channel, int inputHeight, int inputWidth, int filterHeight, int stride, int dilation) {
+	int padding = (filterHeight - 1) * dilation / 2;
+	int extent = (filterHeight - 1) * dilation + 1;
+	int outputHeight = (inputHeight + 2 * padding - extent) / stride + 1;
+	int outputWidth = (inputWidth + 2 * padding - extent) / stride + 1;
+
+	std::mt19937 generator(channel * 100 + inputHeight + filterHeight);
+	std::vector<float> input((size_t)batch * channel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)channel * filterHeight * filterHeight);
+	std::vector<float> shift(channel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(shift, generator);
+	DepthwiseEpilogue epilogue = { nullptr, shift.data(), DepthwiseActivationReLU6 };
+
+	std::vector<float> expected((size_t)batch * channel * outputHeight * outputWidth);
+	CPU_Depthwise_Generic(input.data(), filter.data(), expected.data(),
+		batch, channel, inputHeight, inputWidth,
+		channel, filterHeight, filterHeight,
+		batch, channel, outputHeight, outputWidth,
+		padding, padding, stride, stride, dilation, dilation,
+		1.0f, 0.0f, epilogue);
+
+	const DepthwiseCpuSchedule schedules[] = { { 1, 0 }, { 3, 2 }, { 16, 1 }, { outputHeight + 5, 0 } };
+	for (int s = 0; s < 4; s++) {
+		std::vector<float> output(expected.size(), NAN);
+		CPU_Depthwise_Scheduled(input.data(), filter.data(), output.data(),
+			batch, channel, inputHeight, inputWidth,
+			channel, filterHeight, filterHeight,
+			batch, channel, outputHeight, outputWidth,
+			padding, padding, stride, stride, dilation, dilation,
+			1.0f, 0.0f, epilogue, schedules[s]);
+		for (size_t i = 0; i < expected.size(); i++) {
+			if (!(output[i] == expected[i])) {
+				printf("Wrong! CPU_Depthwise_Scheduled rowTile %d threads %d (C = %d, H = %d, filter %d, stride %d, dilation %d): "
+					"%d is %f, expected %f\n", schedules[s].rowTile, schedules[s].threadNumber, channel, inputHeight,
+					filterHeight, stride, dilation, (int)i, output[i], expected[i]);
+				failures++;
+				break;
+			}
+		}
+	}
+}
+
+static void testDatabase() {
+	remove(tuningPath);
+	std::vector<DepthwiseTuningConfig> candidates;
+	candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 0, 0));
+	candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 4, 0));
+	candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuNCHWc, 8, 0, 0));
+	candidates.push_back(depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 16, 0));
+
+	// fake timings: the band of 4 rows is fastest, the NCHWc candidate cannot run
+	int runs = 0;
+	auto run = [&](const DepthwiseTuningConfig& config) {
+		runs++;
+		if (config.variant == DepthwiseVariantCpuNCHWc) {
+			return -1.0f;
+		}
+		return config.tileHeight == 4 ? 1.0f : 2.0f + config.tileHeight;
+	};
+
+	std::string key = depthwiseTuningKey("cpu", 4, 1, 32, ConvShape(112, 112, 3, 3, 1, 1));
+	{
+		DepthwiseTuningDatabase database(tuningPath);
+		DepthwiseTuningConfig config = depthwiseTune(database, "hostA", key, candidates, run, 1, 3);
+		EXPECT(config.sameSchedule(candidates[1]) && config.milliseconds == 1.0f);
+		EXPECT(runs == 3 * 4 + 1);
+		database.store("hostB", key, candidates[3]);
+	}
+
+	// a new process: the record is read back and nothing is timed
+	{
+		runs = 0;
+		DepthwiseTuningDatabase database(tuningPath);
+		DepthwiseTuningConfig config = depthwiseTune(database, "hostA", key, candidates, run, 1, 3);
+		EXPECT(config.sameSchedule(candidates[1]) && runs == 0);
+		EXPECT(database.find("hostB", key, config) && config.sameSchedule(candidates[3]));
+		EXPECT(!database.find("hostC", key, config));
+		EXPECT(!database.find("hostA", depthwiseTuningKey("cpu", 2, 1, 32, ConvShape(112, 112, 3, 3, 1, 1)), config));
+
+		// the stored winner is not a candidate any more
+		std::vector<DepthwiseTuningConfig> others(candidates.begin() + 2, candidates.end());
+		config = depthwiseTune(database, "hostA", key, others, run, 1, 3);
+		EXPECT(config.sameSchedule(candidates[3]) && runs == 1 + 4);
+	}
+
+	// a file of another version is ignored
+	FILE* file = fopen(tuningPath, "w");
+	fprintf(file, "depthwise-tuning %d\nhostA %s 2 0 0 0 1.0\n", DEPTHWISE_TUNING_VERSION + 1, key.c_str());
+	fclose(file);
+	{
+		DepthwiseTuningConfig config;
+		DepthwiseTuningDatabase database(tuningPath);
+		EXPECT(!database.find("hostA", key, config));
+	}
+	remove(tuningPath);
+
+	EXPECT(depthwiseFingerprintToken("Intel(R) Xeon(R) Gold 6248\t@ 2.50GHz") == "Intel(R)_Xeon(R)_Gold_6248_@_2.50GHz");
+	EXPECT(depthwiseCpuFingerprint().find(' ') == std::string::npos);
+}
+
+/*
+checkTuned():
+	CPU_Depthwise_Tuned() on the process wide database (DEPTHWISE_TUNING_FILE = tuningPath).
+*/
+// Files next to the tuning file other than the file itself and its lock, i.e. temporary files left behind
+static int leftoverFiles() {
+	int count = 0;
+	DIR* directory = opendir(".");
+	if (directory == nullptr) {
+		return -1;
+	}
+	std::string prefix = std::string(tuningPath) + ".";
+	while (dirent* entry = readdir(directory)) {
+		std::string name = entry->d_name;
+		count += name.compare(0, prefix.size(), prefix) == 0 && name != prefix + "lock";
+	}
+	closedir(directory);
+	return count;
+}
+
+static void testSharedFile() {
+	remove(tuningPath);
+	DepthwiseTuningConfig config = depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, 4, 0);
+	std::string first = depthwiseTuningKey("cpu", 4, 1, 32, ConvShape(56, 56, 3, 3, 1, 1));
+	std::string second = depthwiseTuningKey("cpu", 4, 1, 64, ConvShape(28, 28, 3, 3, 1, 1));
+
+	// both opened the file before either wrote: the second write keeps the first record
+	{
+		DepthwiseTuningDatabase a(tuningPath), b(tuningPath);
+		EXPECT(a.store("hostA", first, config));
+		EXPECT(b.store("hostB", second, config));
+		DepthwiseTuningDatabase c(tuningPath);
+		DepthwiseTuningConfig found;
+		EXPECT(c.find("hostA", first, found) && found.sameSchedule(config));
+		EXPECT(c.find("hostB", second, found) && found.sameSchedule(config));
+	}
+
+	// processes storing at the same time
+	const int processes = 4, recordsPerProcess = 16;
+	std::vector<pid_t> children;
+	for (int p = 0; p < processes; p++) {
+		pid_t child = fork();
+		if (child == 0) {
+			DepthwiseTuningDatabase database(tuningPath);
+			bool ok = true;
+			for (int r = 0; r < recordsPerProcess; r++) {
+				ok = database.store("host" + std::to_string(p), depthwiseTuningKey("cpu", 4, 1, r + 1, ConvShape(14, 14, 3, 3, 1, 1)),
+					depthwiseTuningConfig(DepthwiseVariantCpuPlanes, 0, p, r)) && ok;
+			}
+			_exit(ok ? 0 : 1);
+		}
+		children.push_back(child);
+	}
+	for (size_t i = 0; i < children.size(); i++) {
+		int status = -1;
+		EXPECT(children[i] > 0 && waitpid(children[i], &status, 0) == children[i] && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	DepthwiseTuningDatabase database(tuningPath);
+	int missing = 0;
+	for (int p = 0; p < processes; p++) {
+		for (int r = 0; r < recordsPerProcess; r++) {
+			DepthwiseTuningConfig found;
+			missing += !(database.find("host" + std::to_string(p), depthwiseTuningKey("cpu", 4, 1, r + 1, ConvShape(14, 14, 3, 3, 1, 1)), found) &&
+				found.tileHeight == p && found.threadNumber == r);
+		}
+	}
+	DepthwiseTuningConfig found;
+	EXPECT(missing == 0);
+	EXPECT(database.find("hostA", first, found) && database.find("hostB", second, found));
+	EXPECT(leftoverFiles() == 0);
+
+	remove(tuningPath);
+	remove((std::string(tuningPath) + ".lock").c_str());
+}
+
+static void checkTuned(int batch, int channel, int inputHeight, int filterHeight, int stride) {
+	int padding = (filterHeight - 1) / 2;
+	int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+
+	std::mt19937 generator(channel + inputHeight);
+	std::vector<float> input((size_t)batch * channel * inputHeight * inputHeight);
+	std::vector<float> filter((size_t)channel * filterHeight * filterHeight);
+	std::vector<float> scale(channel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(scale, generator);
+	DepthwiseEpilogue epilogue = { scale.data(), nullptr, DepthwiseActivationReLU };
+
+	std::vector<float> expected((size_t)batch * channel * outputHeight * outputHeight);
+	CPU_Depthwise_Generic(input.data(), filter.data(), expected.data(),
+		batch, channel, inputHeight, inputHeight,
+		channel, filterHeight, filterHeight,
+		batch, channel, outputHeight, outputHeight,
+		padding, padding, stride, stride, 1, 1,
+		1.0f, 0.0f, epilogue);
+
+	std::string key = depthwiseTuningKey("cpu", 4, batch, channel, ConvShape(inputHeight, inputHeight, filterHeight, filterHeight, padding, stride));
+	// the second call runs the stored winner with a workspace
+	DepthwiseCpuWorkspace workspace;
+	for (int call = 0; call < 2; call++) {
+		std::vector<float> output(expected.size(), NAN);
+		CPU_Depthwise_Tuned(input.data(), filter.data(), output.data(),
+			batch, channel, inputHeight, inputHeight,
+			channel, filterHeight, filterHeight,
+			batch, channel, outputHeight, outputHeight,
+			padding, padding, stride, stride, 1, 1,
+			1.0f, 0.0f, epilogue, call == 1 ? &workspace : nullptr);
+		for (size_t i = 0; i < expected.size(); i++) {
+			if (!(std::fabs(output[i] - expected[i]) <= 1e-5f * (1.0f + std::fabs(expected[i])))) {
+				printf("Wrong! CPU_Depthwise_Tuned call %d (C = %d, H = %d, filter %d, stride %d): %d is %f, expected %f\n",
+					call, channel, inputHeight, filterHeight, stride, (int)i, output[i], expected[i]);
+				failures++;
+				break;
+			}
+		}
+	}
+
+	DepthwiseTuningConfig config;
+	EXPECT(depthwiseTuningDatabase().find(depthwiseCpuFingerprint(), key, config) && config.milliseconds >= 0.0f);
+	DepthwiseTuningDatabase reloaded(tuningPath);
+	EXPECT(reloaded.find(depthwiseCpuFingerprint(), key, config));
+}
+
+/*
+testWorkspace():
+	One DepthwiseCpuWorkspace for a sequence of layers, twice: bit for bit the output of CPU_Depthwise_Generic(),
+	and the second pass does not grow the workspace.
+*/
+static void testWorkspace() {
+	const int layers[][4] = { { 16, 56, 3, 1 }, { 32, 28, 5, 2 }, { 8, 112, 3, 2 }, { 64, 7, 3, 1 } };
+	const DepthwiseCpuSchedule schedules[] = { depthwiseDefaultCpuSchedule, { 4, 0 } };
+	DepthwiseCpuWorkspace workspace;
+	size_t firstPassBytes = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (int l = 0; l < 4; l++) {
+			int channel = layers[l][0], inputHeight = layers[l][1], filterHeight = layers[l][2], stride = layers[l][3];
+			int padding = (filterHeight - 1) / 2;
+			int outputHeight = (inputHeight + 2 * padding - filterHeight) / stride + 1;
+
+			std::mt19937 generator(l);
+			std::vector<float> input((size_t)channel * inputHeight * inputHeight);
+			std::vector<float> filter((size_t)channel * filterHeight * filterHeight);
+			randomFill(input, generator);
+			randomFill(filter, generator);
+
+			std::vector<float> expected((size_t)channel * outputHeight * outputHeight);
+			CPU_Depthwise_Generic(input.data(), filter.data(), expected.data(),
+				1, channel, inputHeight, inputHeight,
+				channel, filterHeight, filterHeight,
+				1, channel, outputHeight, outputHeight,
+				padding, padding, stride, stride, 1, 1,
+				1.0f, 0.0f, depthwiseNoEpilogue);
+
+			std::vector<float> output(expected.size(), NAN);
+			CPU_Depthwise_Scheduled(input.data(), filter.data(), output.data(),
+				1, channel, inputHeight, inputHeight,
+				channel, filterHeight, filterHeight,
+				1, channel, outputHeight, outputHeight,
+				padding, padding, stride, stride, 1, 1,
+				1.0f, 0.0f, depthwiseNoEpilogue, schedules[l % 2], &workspace);
+			if (output != expected) {
+				printf("Wrong! CPU_Depthwise_Scheduled with a reused workspace, pass %d layer %d\n", pass, l);
+				failures++;
+			}
+		}
+		if (pass == 0) {
+			firstPassBytes = workspace.bytes();
+		}
+	}
+	EXPECT(firstPassBytes > 0 && workspace.bytes() == firstPassBytes);
+
+	workspace.release();
+	EXPECT(workspace.bytes() == 0);
+}
+
+int main() {
+	// odd heights, bands of 1 / 3 / 16 rows, stride 2, dilation, 5 x 5, generic filter
+	checkSchedule(2, 3, 13, 17, 3, 1, 1);
+	checkSchedule(1, 4, 29, 11, 3, 2, 1);
+	checkSchedule(1, 2, 37, 37, 5, 1, 1);
+	checkSchedule(1, 5, 20, 9, 5, 2, 1);
+	checkSchedule(1, 3, 18, 18, 3, 1, 2);
+	checkSchedule(2, 2, 15, 14, 7, 1, 1);
+
+	testWorkspace();
+
+	testDatabase();
+	testSharedFile();
+
+	setenv("DEPTHWISE_TUNING_FILE", tuningPath, 1);
+	unsetenv("DEPTHWISE_TUNING");
+	checkTuned(1, 32, 56, 3, 1);
+	checkTuned(2, 16, 28, 5, 2);
+	remove(tuningPath);
+	remove((std::string(tuningPath) + ".lock").c_str());
+
+	return testResult("Depthwise autotuner");
+}
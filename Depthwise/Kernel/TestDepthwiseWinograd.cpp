@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CPU_DepthwiseTuning.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the Winograd depthwise convolution (CPU_DepthwiseWinograd.h).
+
+F(2 x 2, 3 x 3) and F(4 x 4, 3 x 3) against the direct path (CPU_Depthwise_Generic()) on the 3 x 3 stride 1
+family (7 ... 112), odd sizes whose last tiles stick out of the output, padding 0, a channel number that is not a
+multiple of the channel block and every epilogue. The error against the direct path is printed per shape. The
+blocked kernel against CPU_Depthwise_NCHWc(), padded channels zero. The transformed filter is reused while the
+weights stay the same and transformed again when they change in place. The autotuner offers Winograd for float
+3 x 3 stride 1 only.
+*/
+
+/*
+checkWinograd():
+	Both tiles on one problem, the error of each against the direct path must stay below bound.
+*/
+static void checkWinograd(int batch, int channel, int inputHeight, int inputWidth, int padding, int activation, double bound) {
+	int outputHeight = inputHeight + 2 * padding - 2;
+	int outputWidth = inputWidth + 2 * padding - 2;
+
+	std::mt19937 generator(channel * 1000 + inputHeight * 10 + padding);
+	std::vector<float> input((size_t)batch * channel * inputHeight * inputWidth);
+	std::vector<float> filter((size_t)channel * 9);
+	std::vector<float> scale(channel), shift(channel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(scale, generator);
+	randomFill(shift, generator);
+	DepthwiseEpilogue epilogue = { scale.data(), shift.data(), activation };
+
+	std::vector<float> direct((size_t)batch * channel * outputHeight * outputWidth);
+	CPU_Depthwise_Generic(input.data(), filter.data(), direct.data(),
+		batch, channel, inputHeight, inputWidth,
+		channel, 3, 3,
+		batch, channel, outputHeight, outputWidth,
+		padding, padding, 1, 1, 1, 1,
+		1.0f, 0.0f, epilogue);
+
+	for (int tile = 2; tile <= 4; tile += 2) {
+		std::vector<float> output(direct.size(), NAN);
+		CPU_Depthwise_Winograd(input.data(), filter.data(), output.data(),
+			batch, channel, inputHeight, inputWidth, outputHeight, outputWidth,
+			padding, padding, 1.0f, 0.0f, epilogue, tile);
+		double error = depthwiseWinogradError(output.data(), direct.data(), direct.size());
+		printf("F(%dx%d, 3x3) N=%d C=%d %dx%d padding %d: max error %.2e\n", tile, tile, batch, channel,
+			inputHeight, inputWidth, padding, error);
+		if (!(error <= bound)) {
+			printf("Wrong! F(%dx%d, 3x3) error %g above %g\n", tile, tile, error, bound);
+			failures++;
+		}
+	}
+}
+
+// CPU_Depthwise_WinogradNCHWc() on blocked tensors, against the direct NCHWc kernel
+static void testBlocked() {
+	const int batch = 2, channel = 11, height = 15, width = 10;
+	const int channelBlock = cpuDepthwiseNCHWcBlock();
+	std::mt19937 generator(5);
+	std::vector<float> input((size_t)batch * channel * height * width);
+	std::vector<float> filter((size_t)channel * 9);
+	std::vector<float> shift(channel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(shift, generator);
+	DepthwiseEpilogue epilogue = { nullptr, shift.data(), DepthwiseActivationReLU6 };
+
+	std::vector<float> blockedInput(cpuDepthwiseNCHWcSize(batch, channel, height, width, channelBlock));
+	std::vector<float> blockedFilter(cpuDepthwiseNCHWcSize(1, channel, 3, 3, channelBlock));
+	std::vector<float> direct(blockedInput.size()), output(blockedInput.size(), NAN);
+	cpuReorderNCHWToNCHWc(input.data(), blockedInput.data(), batch, channel, height, width, channelBlock);
+	cpuReorderDepthwiseFilterNCHWc(filter.data(), blockedFilter.data(), channel, 3, 3, channelBlock);
+	CPU_Depthwise_NCHWc(blockedInput.data(), blockedFilter.data(), direct.data(),
+		batch, channel, height, width, channel, 3, 3, batch, channel, height, width,
+		1, 1, 1, 1, 1, 1, channelBlock, 1.0f, 0.0f, epilogue);
+
+	DepthwiseWinogradFilter winogradFilter;
+	CPU_Depthwise_WinogradNCHWc<4>(blockedInput.data(), cpuDepthwiseWinogradFilter<4>(filter.data(), channel, channelBlock, winogradFilter),
+		output.data(), batch, channel, height, width, height, width, 1, 1, channelBlock, 1.0f, 0.0f, epilogue);
+	EXPECT(depthwiseWinogradError(output.data(), direct.data(), direct.size()) <= 1e-5);
+	int blockNumber = cpuDepthwiseNCHWcBlockNumber(channel, channelBlock);
+	for (int n = 0; n < batch; n++) {
+		const float* lastBlock = output.data() + ((size_t)n * blockNumber + blockNumber - 1) * height * width * channelBlock;
+		for (int p = 0; p < height * width; p++) {
+			for (int b = channel - (blockNumber - 1) * channelBlock; b < channelBlock; b++) {
+				EXPECT(lastBlock[(size_t)p * channelBlock + b] == 0.0f);
+			}
+		}
+	}
+}
+
+static void testFilterCache() {
+	const int channel = 5, height = 9;
+	std::mt19937 generator(11);
+	std::vector<float> input((size_t)channel * height * height);
+	std::vector<float> filter((size_t)channel * 9);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+
+	DepthwiseCpuWorkspace workspace;
+	std::vector<float> first(input.size()), second(input.size()), direct(input.size());
+	CPU_Depthwise_Winograd(input.data(), filter.data(), first.data(), 1, channel, height, height, height, height,
+		1, 1, 1.0f, 0.0f, depthwiseNoEpilogue, 4, &workspace);
+	const float* transformed = workspace.winogradFilter.data.data();
+	uint64_t checksum = workspace.winogradFilter.checksum;
+	EXPECT(workspace.winogradFilter.source == filter.data() && workspace.winogradFilter.tile == 4);
+
+	// same weights: the transform is reused
+	CPU_Depthwise_Winograd(input.data(), filter.data(), second.data(), 1, channel, height, height, height, height,
+		1, 1, 1.0f, 0.0f, depthwiseNoEpilogue, 4, &workspace);
+	EXPECT(workspace.winogradFilter.data.data() == transformed && workspace.winogradFilter.checksum == checksum);
+	EXPECT(first == second);
+
+	// weights changed in place: transformed again, the result follows the new weights
+	filter[4] += 1.0f;
+	CPU_Depthwise_Winograd(input.data(), filter.data(), second.data(), 1, channel, height, height, height, height,
+		1, 1, 1.0f, 0.0f, depthwiseNoEpilogue, 4, &workspace);
+	EXPECT(workspace.winogradFilter.checksum != checksum);
+	CPU_Depthwise_Generic(input.data(), filter.data(), direct.data(), 1, channel, height, height, channel, 3, 3,
+		1, channel, height, height, 1, 1, 1, 1, 1, 1, 1.0f, 0.0f, depthwiseNoEpilogue);
+	EXPECT(depthwiseWinogradError(second.data(), direct.data(), direct.size()) <= 1e-5);
+
+	// another tile
+	CPU_Depthwise_Winograd(input.data(), filter.data(), second.data(), 1, channel, height, height, height, height,
+		1, 1, 1.0f, 0.0f, depthwiseNoEpilogue, 2, &workspace);
+	EXPECT(workspace.winogradFilter.tile == 2);
+	EXPECT(depthwiseWinogradError(second.data(), direct.data(), direct.size()) <= 1e-5);
+}
+
+static void testCandidates() {
+	EXPECT(depthwiseWinogradSupported(3, 3, 1, 1, 1, 1));
+	EXPECT(!depthwiseWinogradSupported(3, 3, 2, 2, 1, 1));
+	EXPECT(!depthwiseWinogradSupported(5, 5, 1, 1, 1, 1));
+	EXPECT(!depthwiseWinogradSupported(3, 3, 1, 1, 2, 2));
+
+	int winograd = 0;
+	std::vector<DepthwiseTuningConfig> candidates = cpuDepthwiseTuningCandidates(true, 1, 32, 56, true);
+	for (size_t i = 0; i < candidates.size(); i++) {
+		winograd += candidates[i].variant == DepthwiseVariantCpuWinograd;
+	}
+	EXPECT(winograd == 2 && candidates[0].variant == DepthwiseVariantCpuPlanes);
+	candidates = cpuDepthwiseTuningCandidates(false, 1, 32, 56, true);
+	for (size_t i = 0; i < candidates.size(); i++) {
+		EXPECT(candidates[i].variant != DepthwiseVariantCpuWinograd);
+	}
+	candidates = cpuDepthwiseTuningCandidates(true, 1, 32, 56);
+	for (size_t i = 0; i < candidates.size(); i++) {
+		EXPECT(candidates[i].variant != DepthwiseVariantCpuWinograd);
+	}
+}
+
+int main() {
+	// the Filter3x3_Input*_Stride1 family
+	const int sizes[] = { 7, 14, 28, 56, 112 };
+	for (int i = 0; i < 5; i++) {
+		checkWinograd(1, 8, sizes[i], sizes[i], 1, DepthwiseActivationNone, 1e-5);
+	}
+	// partial tiles, partial channel block, no padding, every epilogue
+	checkWinograd(2, 5, 13, 11, 1, DepthwiseActivationReLU6, 1e-5);
+	checkWinograd(1, 19, 10, 17, 0, DepthwiseActivationReLU, 1e-5);
+	checkWinograd(1, 3, 23, 9, 2, DepthwiseActivationSiLU, 1e-5);
+	checkWinograd(1, 17, 6, 6, 1, DepthwiseActivationHardSwish, 1e-5);
+	checkWinograd(1, 4, 3, 3, 1, DepthwiseActivationNone, 1e-5);
+
+	testBlocked();
+	testFilterCache();
+	testCandidates();
+
+	return testResult("Depthwise Winograd");
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emulator/hip/hip_runtime.h, the kernels run on the host
+#include <hip/hip_runtime.h>
+#include "DepthwiseEpilogue.h"
+
+#define float emu::Float
+#include "Pointwise_Tiled.h"
+#undef float
+
+#include "CPU_Pointwise.h"
+#include "DepthwiseTestUtil.h"
+
+/*
+Host side test of the pointwise convolution.
+
+1) CPU_Pointwise() on every layer of pointwiseLayerConfigs (MobileNet V2) against a plain loop.
+2) Pointwise_Tiled, run through the emulator, on small shapes with partial tiles.
+*/
+
+/*
+checkPointwise():
+	Run one layer. activation other than none also sets a random scale and shift.
+*/
+static void checkPointwise(int inputBatchNumber, int inputChannel, int inputHeight, int outputChannel, int activation, bool emulate) {
+	int planeSize = inputHeight * inputHeight;
+
+	std::vector<float> input((size_t)inputBatchNumber * inputChannel * planeSize);
+	std::vector<float> filter((size_t)outputChannel * inputChannel);
+	std::vector<float> scale(outputChannel), shift(outputChannel);
+
+	std::mt19937 generator(inputChannel * 1000 + inputHeight * 10 + outputChannel);
+	randomFill(input, generator);
+	randomFill(filter, generator);
+	randomFill(scale, generator);
+	randomFill(shift, generator);
+
+	DepthwiseEpilogue epilogue = depthwiseNoEpilogue;
+	if (activation != DepthwiseActivationNone) {
+		epilogue.scale = scale.data();
+		epilogue.shift = shift.data();
+		epilogue.activation = activation;
+	}
+
+	std::vector<float> expected((size_t)inputBatchNumber * outputChannel * planeSize);
+	for (int n = 0; n < inputBatchNumber; n++) {
+		for (int co = 0; co < outputChannel; co++) {
+			DepthwiseChannelEpilogue channelEpilogue(epilogue, co);
+			for (int p = 0; p < planeSize; p++) {
+				double sum = 0.0;
+				for (int ci = 0; ci < inputChannel; ci++) {
+					sum += (double)filter[(size_t)co * inputChannel + ci] * input[((size_t)n * inputChannel + ci) * planeSize + p];
+				}
+				expected[((size_t)n * outputChannel + co) * planeSize + p] = channelEpilogue.apply((float)sum);
+			}
+		}
+	}
+
+	std::vector<float> output(expected.size());
+	const char* names[] = { "CPU_Pointwise", "Pointwise_Tiled" };
+	for (int run = 0; run < (emulate ? 2 : 1); run++) {
+		std::fill(output.begin(), output.end(), NAN);
+		if (run == 0) {
+			CPU_Pointwise(input.data(), filter.data(), output.data(),
+				inputBatchNumber, inputChannel, inputHeight, inputHeight,
+				outputChannel,
+				1.0f, 0.0f, epilogue);
+		}
+		else {
+			launchPointwise(reinterpret_cast<const emu::Float*>(input.data()), reinterpret_cast<const emu::Float*>(filter.data()),
+				reinterpret_cast<emu::Float*>(output.data()),
+				inputBatchNumber, inputChannel, inputHeight, inputHeight,
+				outputChannel,
+				1.0f, 0.0f, epilogue);
+		}
+
+		for (size_t i = 0; i < output.size(); i++) {
+			if (!(std::fabs(output[i] - expected[i]) <= 1e-3f * (1.0f + std::fabs(expected[i])))) {
+				printf("Wrong! %s (%d x %d x %d -> %d): output %d is %f, expected %f\n",
+					names[run], inputChannel, inputHeight, inputHeight, outputChannel, (int)i, output[i], expected[i]);
+				failures++;
+				break;
+			}
+		}
+	}
+}
+
+int main() {
+	// Input Channel, Input Height/Width, Output Channel
+	const int pointwiseLayerConfigs[][3] = {
+		{32, 112, 16}, {16, 112, 96}, {96, 56, 24}, {24, 56, 144}, {144, 56, 24},
+		{144, 28, 32}, {32, 28, 192}, {192, 28, 32}, {192, 14, 64}, {64, 14, 384}, {384, 14, 64},
+		{384, 14, 96}, {96, 14, 576}, {576, 14, 96}, {576, 7, 160}, {160, 7, 960}, {960, 7, 160},
+		{960, 7, 320}, {320, 7, 1280} };
+	const int layerNumber = sizeof(pointwiseLayerConfigs) / sizeof(pointwiseLayerConfigs[0]);
+	for (int i = 0; i < layerNumber; i++) {
+		checkPointwise(1, pointwiseLayerConfigs[i][0], pointwiseLayerConfigs[i][1], pointwiseLayerConfigs[i][2],
+			i % 2 == 0 ? DepthwiseActivationNone : DepthwiseActivationReLU6, false);
+	}
+	checkPointwise(3, 20, 9, 36, DepthwiseActivationHardSwish, false);
+
+	// emulated, partial pixel / channel tiles
+	checkPointwise(1, 24, 9, 40, DepthwiseActivationNone, true);
+	checkPointwise(2, 70, 7, 100, DepthwiseActivationSiLU, true);
+	checkPointwise(1, 16, 14, 16, DepthwiseActivationReLU, true);
+
+	return testResult("Pointwise convolution");
+}